@@ -0,0 +1,298 @@
+#include "autocorrectindex.h"
+#include "completiondictionary.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QHash>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace {
+struct Header {
+    char magic[4];
+    uint32_t version;
+    uint32_t wordCount;
+    uint32_t bucketCount;
+    uint32_t entryCount;
+    uint32_t charCount;
+};
+
+constexpr char Magic[4] = {'O', 'S', 'K', 'A'};
+constexpr uint32_t Version = 2;
+
+// Distinct deletes of a PrefixLength string: C(7,0) + C(7,1) + C(7,2)
+constexpr int MaxDeletes = 1 + 7 + 21;
+static_assert(AutocorrectIndex::PrefixLength == 7 && AutocorrectIndex::MaxDistance == 2,
+              "MaxDeletes must match the prefix length and distance");
+
+// Fixed-size set of delete hashes; lookups never touch the heap
+struct DeleteSet {
+    uint32_t hashes[MaxDeletes];
+    int count = 0;
+
+    void add(uint32_t hash)
+    {
+        for (int i = 0; i < count; ++i) {
+            if (hashes[i] == hash) return;
+        }
+        if (count < MaxDeletes)
+            hashes[count++] = hash;
+    }
+};
+
+// FNV-1a over the UTF-16 code units
+uint32_t hashChars(const char16_t *s, int length)
+{
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < length; ++i) {
+        hash = (hash ^ (s[i] & 0xff)) * 16777619u;
+        hash = (hash ^ (s[i] >> 8)) * 16777619u;
+    }
+    return hash;
+}
+
+// Adds s and every string reachable from it by up to `distance` deletions
+void collectDeletes(const char16_t *s, int length, int distance, DeleteSet &out)
+{
+    out.add(hashChars(s, length));
+    if (distance == 0 || length <= 1) return;
+
+    char16_t shorter[AutocorrectIndex::PrefixLength];
+    for (int i = 0; i < length; ++i) {
+        std::copy(s, s + i, shorter);
+        std::copy(s + i + 1, s + length, shorter + i);
+        collectDeletes(shorter, length - 1, distance - 1, out);
+    }
+}
+
+// Optimal string alignment distance (adjacent transpositions cost one).
+// Returns bound + 1 as soon as the distance is known to exceed bound.
+int editDistance(const char16_t *a, int la, const char16_t *b, int lb, int bound)
+{
+    if (std::abs(la - lb) > bound) return bound + 1;
+
+    constexpr int Columns = AutocorrectIndex::MaxWordLength + 1;
+    int before[Columns];
+    int previous[Columns];
+    int current[Columns];
+    for (int j = 0; j <= lb; ++j)
+        previous[j] = j;
+
+    for (int i = 1; i <= la; ++i) {
+        current[0] = i;
+        int rowMin = i;
+        for (int j = 1; j <= lb; ++j) {
+            const int cost = a[i - 1] == b[j - 1] ? 0 : 1;
+            int value = std::min({previous[j] + 1, current[j - 1] + 1, previous[j - 1] + cost});
+            if (i > 1 && j > 1 && a[i - 1] == b[j - 2] && a[i - 2] == b[j - 1])
+                value = std::min(value, before[j - 2] + 1);
+            current[j] = value;
+            rowMin = std::min(rowMin, value);
+        }
+        if (rowMin > bound) return bound + 1;
+        std::copy(previous, previous + lb + 1, before);
+        std::copy(current, current + lb + 1, previous);
+    }
+    return std::min(previous[lb], bound + 1);
+}
+}
+
+AutocorrectIndex::~AutocorrectIndex()
+{
+    close();
+}
+
+bool AutocorrectIndex::open(const QString &path)
+{
+    close();
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::ReadOnly))
+        return false;
+
+    const qint64 size = m_file.size();
+    if (size < qint64(sizeof(Header))) {
+        close();
+        return false;
+    }
+
+    const uchar *data = m_file.map(0, size);
+    if (!data) {
+        close();
+        return false;
+    }
+
+    const auto *header = reinterpret_cast<const Header *>(data);
+    const quint64 wordsSize = quint64(header->wordCount) * sizeof(Word);
+    const quint64 bucketsSize = (quint64(header->bucketCount) + 1) * sizeof(uint32_t);
+    const quint64 entriesSize = quint64(header->entryCount) * sizeof(Entry);
+    const quint64 charsSize = quint64(header->charCount) * sizeof(char16_t);
+    if (memcmp(header->magic, Magic, sizeof(Magic)) != 0 || header->version != Version
+        || header->bucketCount == 0 || (header->bucketCount & (header->bucketCount - 1)) != 0
+        || quint64(size) < sizeof(Header) + wordsSize + bucketsSize + entriesSize + charsSize) {
+        qWarning("Invalid autocorrect index: %s", qPrintable(path));
+        close();
+        return false;
+    }
+
+    const uchar *p = data + sizeof(Header);
+    const auto *words = reinterpret_cast<const Word *>(p);
+    p += wordsSize;
+    const auto *buckets = reinterpret_cast<const uint32_t *>(p);
+    p += bucketsSize;
+    const auto *entries = reinterpret_cast<const Entry *>(p);
+
+    // correct() follows these without checking: every word's text must lie
+    // in the character block and fit the edit distance rows, every bucket
+    // range in the entries, and every entry name a word
+    bool valid = buckets[0] == 0 && buckets[header->bucketCount] <= header->entryCount;
+    for (uint32_t i = 0; valid && i < header->bucketCount; ++i)
+        valid = buckets[i] <= buckets[i + 1];
+    for (uint32_t i = 0; valid && i < header->entryCount; ++i)
+        valid = entries[i].word < header->wordCount;
+    for (uint32_t i = 0; valid && i < header->wordCount; ++i)
+        valid = words[i].length <= uint32_t(MaxWordLength)
+                && uint64_t(words[i].offset) + words[i].length <= header->charCount;
+    if (!valid) {
+        qWarning("Invalid autocorrect index: %s", qPrintable(path));
+        close();
+        return false;
+    }
+
+    m_words = words;
+    m_buckets = buckets;
+    m_entries = entries;
+    m_chars = reinterpret_cast<const char16_t *>(p + entriesSize);
+    m_wordCount = header->wordCount;
+    m_bucketMask = header->bucketCount - 1;
+    return true;
+}
+
+void AutocorrectIndex::close()
+{
+    m_words = nullptr;
+    m_buckets = nullptr;
+    m_entries = nullptr;
+    m_chars = nullptr;
+    m_wordCount = 0;
+    m_bucketMask = 0;
+    if (m_file.isOpen())
+        m_file.close(); // also unmaps
+}
+
+bool AutocorrectIndex::isOpen() const { return m_words != nullptr; }
+
+QString AutocorrectIndex::correct(const QString &word) const
+{
+    const int length = int(word.size());
+    if (!m_words || length < 2 || length > MaxWordLength) return QString();
+
+    char16_t input[MaxWordLength];
+    for (int i = 0; i < length; ++i)
+        input[i] = word.at(i).toLower().unicode();
+    const int maxDistance = length <= 4 ? 1 : MaxDistance;
+
+    DeleteSet deletes;
+    collectDeletes(input, std::min(length, int(PrefixLength)), maxDistance, deletes);
+
+    int bestDistance = maxDistance;
+    uint32_t bestFreq = 0;
+    const Word *best = nullptr;
+    for (int i = 0; i < deletes.count; ++i) {
+        const uint32_t hash = deletes.hashes[i];
+        const uint32_t bucket = hash & m_bucketMask;
+        for (uint32_t e = m_buckets[bucket]; e < m_buckets[bucket + 1]; ++e) {
+            if (m_entries[e].hash != hash) continue;
+            const Word &candidate = m_words[m_entries[e].word];
+            const int distance = editDistance(input, length, m_chars + candidate.offset,
+                                              int(candidate.length), bestDistance);
+            if (distance == 0)
+                return QString(); // spelled correctly
+            if (distance < bestDistance || (distance == bestDistance && candidate.freq > bestFreq)) {
+                bestDistance = distance;
+                bestFreq = candidate.freq;
+                best = &candidate;
+            }
+        }
+    }
+
+    if (!best) return QString();
+    return QString(reinterpret_cast<const QChar *>(m_chars + best->offset), qsizetype(best->length));
+}
+
+// ---------------------------------------------------------------------------
+// Compilation (word list → delete index file)
+// ---------------------------------------------------------------------------
+bool AutocorrectIndex::compile(const QString &wordListPath, const QString &outPath)
+{
+    QHash<QString, uint32_t> freqs;
+    const bool read = CompletionDictionary::readWordList(wordListPath,
+        [&freqs](const QString &word, uint32_t freq) {
+            if (word.size() > MaxWordLength) return;
+            uint32_t &stored = freqs[word];
+            stored = std::max(stored, freq);
+        });
+    if (!read)
+        return false;
+
+    std::vector<Word> words;
+    std::vector<Entry> entries;
+    std::vector<char16_t> chars;
+    words.reserve(freqs.size());
+    for (auto it = freqs.cbegin(); it != freqs.cend(); ++it) {
+        const QString &word = it.key();
+        const auto *s = reinterpret_cast<const char16_t *>(word.utf16());
+        const uint32_t index = uint32_t(words.size());
+        words.push_back({uint32_t(chars.size()), uint32_t(word.size()), it.value()});
+        chars.insert(chars.end(), s, s + word.size());
+
+        DeleteSet deletes;
+        collectDeletes(s, std::min(int(word.size()), int(PrefixLength)), MaxDistance, deletes);
+        for (int i = 0; i < deletes.count; ++i)
+            entries.push_back({deletes.hashes[i], index});
+    }
+
+    // About one entry per bucket; entries are grouped by bucket so a probe
+    // reads one contiguous run
+    uint32_t bucketCount = 1;
+    while (bucketCount < entries.size())
+        bucketCount <<= 1;
+    const uint32_t mask = bucketCount - 1;
+    std::sort(entries.begin(), entries.end(), [mask](const Entry &a, const Entry &b) {
+        return (a.hash & mask) < (b.hash & mask);
+    });
+    std::vector<uint32_t> buckets(size_t(bucketCount) + 1, 0);
+    for (const Entry &entry : entries)
+        ++buckets[(entry.hash & mask) + 1];
+    for (size_t i = 1; i < buckets.size(); ++i)
+        buckets[i] += buckets[i - 1];
+
+    QDir().mkpath(QFileInfo(outPath).path());
+    QSaveFile out(outPath);
+    if (!out.open(QIODevice::WriteOnly))
+        return false;
+
+    Header header{};
+    memcpy(header.magic, Magic, sizeof(Magic));
+    header.version = Version;
+    header.wordCount = uint32_t(words.size());
+    header.bucketCount = bucketCount;
+    header.entryCount = uint32_t(entries.size());
+    header.charCount = uint32_t(chars.size());
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char *>(words.data()), qint64(words.size() * sizeof(Word)));
+    out.write(reinterpret_cast<const char *>(buckets.data()), qint64(buckets.size() * sizeof(uint32_t)));
+    out.write(reinterpret_cast<const char *>(entries.data()), qint64(entries.size() * sizeof(Entry)));
+    out.write(reinterpret_cast<const char *>(chars.data()), qint64(chars.size() * sizeof(char16_t)));
+    return out.commit();
+}
+
+QString AutocorrectIndex::compiledPath()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation)
+           + QStringLiteral("/autocorrect.idx");
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <QFile>
+#include <QString>
+#include <cstdint>
+
+// Read-only spelling-correction index using symmetric deletes (SymSpell).
+//
+// Every dictionary word is indexed under all strings obtained by deleting up
+// to MaxDistance characters from its first PrefixLength characters. A lookup
+// generates the same deletes for the typed word, so candidates within the
+// edit distance are found with a handful of hash probes instead of a scan.
+// Candidates are then verified with a bounded edit distance.
+//
+// Layout (native endian), produced once by compile() and mapped as-is:
+//   Header { "OSKA", version, wordCount, bucketCount, entryCount, charCount }
+//   Word[wordCount]             offset/length into the character pool, freq
+//   uint32_t[bucketCount + 1]   first entry of each hash bucket
+//   Entry[entryCount]           delete hash and word index, grouped by bucket
+//   char16_t[charCount]         lower-case word characters
+class AutocorrectIndex
+{
+public:
+    static constexpr int MaxDistance = 2;
+    static constexpr int PrefixLength = 7;
+    static constexpr int MaxWordLength = 32;
+
+    AutocorrectIndex() = default;
+    ~AutocorrectIndex();
+
+    AutocorrectIndex(const AutocorrectIndex &) = delete;
+    AutocorrectIndex &operator=(const AutocorrectIndex &) = delete;
+
+    bool open(const QString &path);
+    void close();
+    bool isOpen() const;
+
+    // Most frequent dictionary word closest to word, in lower case. Empty when
+    // word is already in the dictionary or nothing is close enough. Short
+    // words only tolerate a single edit.
+    QString correct(const QString &word) const;
+
+    static bool compile(const QString &wordListPath, const QString &outPath);
+    static QString compiledPath();
+
+    struct Word {
+        uint32_t offset;
+        uint32_t length;
+        uint32_t freq;
+    };
+    struct Entry {
+        uint32_t hash;
+        uint32_t word;
+    };
+
+private:
+    QFile m_file;
+    const Word *m_words = nullptr;
+    const uint32_t *m_buckets = nullptr;
+    const Entry *m_entries = nullptr;
+    const char16_t *m_chars = nullptr;
+    uint32_t m_wordCount = 0;
+    uint32_t m_bucketMask = 0;
+};
@@ -0,0 +1,273 @@
+#include "clipboardmodel.h"
+
+#include <QHash>
+#include <QTextBoundaryFinder>
+
+#include <algorithm>
+
+namespace {
+constexpr int PreviewLines = 3;
+constexpr int PreviewChars = 160;
+// Previews are published in batches to keep the number of queued calls low
+constexpr int BatchSize = 32;
+}
+
+ClipboardModel::ClipboardModel(QObject *parent)
+    : QAbstractListModel(parent)
+{
+    m_pool.setMaxThreadCount(1);
+}
+
+ClipboardModel::~ClipboardModel()
+{
+    // Stop the worker early and make sure it no longer references us
+    ++m_generation;
+    ++m_filterGeneration;
+    m_pool.waitForDone();
+}
+
+int ClipboardModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : int(m_rows.size());
+}
+
+QVariant ClipboardModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_rows.size())
+        return QVariant();
+    const int entry = m_rows.at(index.row());
+    const QString &text = m_entries.at(entry);
+    const Preview &preview = m_previews.at(entry);
+
+    switch (role) {
+    case TextRole:
+        return text;
+    case PreviewRole:
+        if (preview.ready)
+            return preview.text;
+        // Bounded placeholder until the worker gets to this entry
+        return text.left(PreviewChars).replace(QLatin1Char('\n'), QLatin1Char(' '));
+    case LengthRole:
+        return preview.ready ? preview.length : int(text.size());
+    case LineCountRole:
+        return preview.lineCount;
+    }
+    return QVariant();
+}
+
+QHash<int, QByteArray> ClipboardModel::roleNames() const
+{
+    return {
+        {TextRole, "text"},
+        {PreviewRole, "preview"},
+        {LengthRole, "length"},
+        {LineCountRole, "lineCount"},
+    };
+}
+
+void ClipboardModel::setEntries(const QStringList &entries)
+{
+    const QStringList previousEntries = m_entries;
+    const QVector<Preview> previousPreviews = m_previews;
+
+    beginResetModel();
+    m_entries = entries;
+    m_previews = QVector<Preview>(entries.size());
+    m_ids.clear();
+    applyFilter();
+    endResetModel();
+
+    schedulePreviews(previousEntries, previousPreviews);
+}
+
+void ClipboardModel::setStoredEntries(const QVector<StoredEntry> &entries)
+{
+    ++m_generation; // nothing left for the worker to do
+
+    beginResetModel();
+    m_entries = QStringList();
+    m_previews.clear();
+    m_ids.clear();
+    m_entries.reserve(entries.size());
+    m_previews.reserve(entries.size());
+    m_ids.reserve(entries.size());
+    for (const StoredEntry &entry : entries) {
+        m_entries.append(QString());
+        m_previews.append(entry.preview);
+        m_ids.append(entry.id);
+    }
+    applyFilter();
+    endResetModel();
+}
+
+QString ClipboardModel::entryText(int row) const
+{
+    if (row < 0 || row >= m_rows.size()) return QString();
+    return m_entries.at(m_rows.at(row));
+}
+
+quint64 ClipboardModel::entryId(int row) const
+{
+    if (row < 0 || row >= m_rows.size() || m_ids.isEmpty()) return 0;
+    return m_ids.at(m_rows.at(row));
+}
+
+void ClipboardModel::setFilter(const QString &filter)
+{
+    if (m_filter == filter) return;
+    beginResetModel();
+    m_filter = filter;
+    applyFilter();
+    endResetModel();
+}
+
+// Runs inside a model reset. Full texts can be large, so they are matched
+// on the worker, which resets the rows again when it is done; until then
+// nothing is shown.
+void ClipboardModel::applyFilter()
+{
+    const int generation = ++m_filterGeneration;
+    m_rows.clear();
+    if (m_filter.isEmpty() || !m_ids.isEmpty()) {
+        // Stored entries have no body in memory; they filter on the preview
+        m_rows.reserve(m_entries.size());
+        for (int i = 0; i < m_entries.size(); ++i) {
+            if (m_filter.isEmpty() || m_previews.at(i).text.contains(m_filter, Qt::CaseInsensitive))
+                m_rows.append(i);
+        }
+        return;
+    }
+
+    const QStringList entries = m_entries;
+    const QString filter = m_filter;
+    // Ahead of previews still waiting: the filter is what the user sees
+    m_pool.start([this, generation, entries, filter]() {
+        QVector<int> rows;
+        for (int i = 0; i < entries.size(); ++i) {
+            if (m_filterGeneration.load() != generation) return;
+            if (entries.at(i).contains(filter, Qt::CaseInsensitive))
+                rows.append(i);
+        }
+        QMetaObject::invokeMethod(this, [this, generation, rows]() {
+            applyFilteredRows(generation, rows);
+        }, Qt::QueuedConnection);
+    }, 1);
+}
+
+void ClipboardModel::applyFilteredRows(int generation, const QVector<int> &rows)
+{
+    if (generation != m_filterGeneration.load()) return;
+    beginResetModel();
+    m_rows = rows;
+    endResetModel();
+}
+
+void ClipboardModel::schedulePreviews(const QStringList &previousEntries,
+                                      const QVector<Preview> &previousPreviews)
+{
+    const int generation = ++m_generation;
+    const QStringList entries = m_entries;
+
+    m_pool.start([this, generation, entries, previousEntries, previousPreviews]() {
+        // Entries that survived the refresh keep their preview
+        QHash<QString, Preview> known;
+        for (int i = 0; i < previousEntries.size(); ++i) {
+            if (previousPreviews.at(i).ready)
+                known.insert(previousEntries.at(i), previousPreviews.at(i));
+        }
+
+        QVector<Preview> batch;
+        int first = 0;
+        for (int i = 0; i < entries.size(); ++i) {
+            if (m_generation.load() != generation) return;
+            auto it = known.constFind(entries.at(i));
+            batch.append(it != known.cend() ? it.value() : makePreview(entries.at(i)));
+            if (batch.size() == BatchSize || i == entries.size() - 1) {
+                QMetaObject::invokeMethod(this, [this, generation, first, batch]() {
+                    applyPreviews(generation, first, batch);
+                }, Qt::QueuedConnection);
+                first = i + 1;
+                batch.clear();
+            }
+        }
+    });
+}
+
+void ClipboardModel::applyPreviews(int generation, int first, const QVector<Preview> &previews)
+{
+    if (generation != m_generation.load()) return;
+    for (int i = 0; i < previews.size() && first + i < m_previews.size(); ++i)
+        m_previews[first + i] = previews.at(i);
+    // Only the visible rows showing this batch's entries
+    const auto begin = std::lower_bound(m_rows.cbegin(), m_rows.cend(), first);
+    const auto end = std::lower_bound(begin, m_rows.cend(), first + int(previews.size()));
+    if (begin != end)
+        emit dataChanged(index(int(begin - m_rows.cbegin())), index(int(end - m_rows.cbegin()) - 1),
+                         {PreviewRole, LengthRole, LineCountRole});
+}
+
+ClipboardModel::Preview ClipboardModel::makePreview(const QString &text)
+{
+    Preview preview;
+    preview.ready = true;
+    preview.length = int(text.size());
+    if (text.isEmpty()) return preview;
+    preview.lineCount = int(text.count(QLatin1Char('\n')))
+                        + (text.endsWith(QLatin1Char('\n')) ? 0 : 1);
+
+    // Collapse whitespace runs and drop blank lines, reading only as much
+    // of the entry as the preview can show
+    QString out;
+    out.reserve(PreviewChars + PreviewLines + 1);
+    int lines = 0;
+    bool lineHasText = false;
+    bool pendingSpace = false;
+    bool truncated = false;
+    qsizetype i = 0;
+    for (; i < text.size(); ++i) {
+        const QChar c = text.at(i);
+        if (c == QLatin1Char('\n')) {
+            if (lineHasText) {
+                if (++lines == PreviewLines) break;
+                out.append(QLatin1Char('\n'));
+            }
+            lineHasText = false;
+            pendingSpace = false;
+        } else if (c.isSpace()) {
+            pendingSpace = lineHasText;
+        } else {
+            // A little past the limit so the grapheme cut below has room
+            if (out.size() > PreviewChars + 8) {
+                truncated = true;
+                break;
+            }
+            if (pendingSpace)
+                out.append(QLatin1Char(' '));
+            out.append(c);
+            lineHasText = true;
+            pendingSpace = false;
+        }
+    }
+    if (out.endsWith(QLatin1Char('\n')))
+        out.chop(1);
+
+    // Stopped at the line limit: only truncated if something visible follows
+    for (; !truncated && i < text.size(); ++i) {
+        if (!text.at(i).isSpace())
+            truncated = true;
+    }
+
+    if (out.size() > PreviewChars) {
+        QTextBoundaryFinder finder(QTextBoundaryFinder::Grapheme, out);
+        finder.setPosition(PreviewChars);
+        if (!finder.isAtBoundary())
+            finder.toPreviousBoundary();
+        out.truncate(finder.position());
+        truncated = true;
+    }
+    if (truncated)
+        out.append(QChar(0x2026));
+
+    preview.text = out;
+    return preview;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <QAbstractListModel>
+#include <QStringList>
+#include <QThreadPool>
+#include <QVector>
+
+#include <atomic>
+
+// Clipboard history exposed to the ListView on the clipboard page.
+//
+// Delegates never see the raw entry: previews (a few whitespace-collapsed
+// lines cut at a grapheme boundary) and line counts are computed once per
+// entry on a worker thread and reused across refreshes, so opening the page
+// costs the same for a handful of entries or thousands of them, however big
+// they are. The full text is only handed out when an entry is pasted.
+//
+// Entries from the native clipboard store arrive with their preview already
+// computed and without a body; they are identified by their store id.
+class ClipboardModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    enum Role {
+        TextRole = Qt::UserRole + 1,
+        PreviewRole,
+        LengthRole,
+        LineCountRole,
+    };
+
+    struct Preview {
+        QString text;
+        int length = 0;
+        int lineCount = 0;
+        bool ready = false;
+    };
+
+    struct StoredEntry {
+        quint64 id;
+        Preview preview;
+    };
+
+    explicit ClipboardModel(QObject *parent = nullptr);
+    ~ClipboardModel() override;
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role) const override;
+    QHash<int, QByteArray> roleNames() const override;
+
+    void setEntries(const QStringList &entries);
+    void setStoredEntries(const QVector<StoredEntry> &entries);
+    // Full text (empty for stored entries) and store id of a visible row
+    QString entryText(int row) const;
+    quint64 entryId(int row) const;
+    // Case-insensitive substring filter over the full text, matched on the
+    // worker; stored entries, which have no body here, match on their
+    // preview right away
+    Q_INVOKABLE void setFilter(const QString &filter);
+
+    static Preview makePreview(const QString &text);
+
+private:
+    void schedulePreviews(const QStringList &previousEntries, const QVector<Preview> &previousPreviews);
+    void applyPreviews(int generation, int first, const QVector<Preview> &previews);
+    void applyFilter();
+    void applyFilteredRows(int generation, const QVector<int> &rows);
+
+    QStringList m_entries;
+    QVector<Preview> m_previews;   // parallel to m_entries
+    QVector<quint64> m_ids;        // parallel to m_entries, stored entries only
+    QVector<int> m_rows;           // entry index of each visible row, ascending
+    QString m_filter;
+
+    QThreadPool m_pool;            // one worker; waited for on destruction
+    std::atomic<int> m_generation{0};         // of the entries being previewed
+    std::atomic<int> m_filterGeneration{0};   // of the filter being matched
+};
@@ -0,0 +1,130 @@
+#include "clipboardowner.h"
+#include "selectionmonitor.h"
+#include "tracer.h"
+
+#include <KSystemClipboard>
+
+namespace {
+
+// Reports reads of the text back to the owner. KSystemClipboard calls
+// data() from the source's send handler, which writes the result into the
+// pipe the target gave us.
+class TransientMimeData : public QMimeData
+{
+public:
+    explicit TransientMimeData(ClipboardOwner *owner)
+        : m_owner(owner)
+    {
+    }
+
+protected:
+    QVariant retrieveData(const QString &mimeType, QMetaType type) const override
+    {
+        if (mimeType != QLatin1String(ClipboardOwner::PasswordHint)) {
+            QPointer<ClipboardOwner> owner = m_owner;
+            QMetaObject::invokeMethod(owner, [owner]() {
+                if (owner) emit owner->served();
+            }, Qt::QueuedConnection);
+        }
+        return QMimeData::retrieveData(mimeType, type);
+    }
+
+private:
+    QPointer<ClipboardOwner> m_owner;
+};
+
+} // namespace
+
+ClipboardOwner::ClipboardOwner(SelectionMonitor *monitor, QObject *parent)
+    : QObject(parent)
+    , m_monitor(monitor)
+{
+    m_restoreTimer.setSingleShot(true);
+    connect(&m_restoreTimer, &QTimer::timeout, this, &ClipboardOwner::restore);
+    connect(this, &ClipboardOwner::served, this, &ClipboardOwner::onServed);
+    connect(m_monitor, &SelectionMonitor::copied, this, &ClipboardOwner::onCopied);
+}
+
+void ClipboardOwner::offer(const QString &text, const QString &marker)
+{
+    OSK_TRACE_SCOPE("ClipboardOwner::offer");
+    KSystemClipboard *clipboard = KSystemClipboard::instance();
+
+    // Back-to-back offers restore to what the user had before the first
+    if (!m_transient && !m_monitor->isCopying()) {
+        m_saved.clear();
+        if (!m_monitor->startCopy(SnapshotLimit) && !m_monitor->isAvailable())
+            snapshot(clipboard->mimeData(QClipboard::Clipboard));
+    }
+
+    auto *mime = new TransientMimeData(this);
+    mime->setText(text);
+    mime->setData(QString::fromLatin1(PasswordHint), QByteArrayLiteral("secret"));
+    mime->setData(marker, QByteArray());
+    m_transient = mime;
+    clipboard->setMimeData(mime, QClipboard::Clipboard);   // takes ownership
+    m_restoreTimer.start(RestoreFallbackMs);
+}
+
+void ClipboardOwner::restore()
+{
+    m_restoreTimer.stop();
+    if (m_monitor->isCopying()) {
+        m_restoreWhenCopied = true;
+        return;
+    }
+    m_restoreWhenCopied = false;
+    // The clipboard deletes our data once another selection replaces it;
+    // a selection the user made in the meantime stays
+    if (!m_transient) {
+        m_saved.clear();
+        return;
+    }
+    m_transient = nullptr;
+
+    OSK_TRACE_SCOPE("ClipboardOwner::restore");
+    KSystemClipboard *clipboard = KSystemClipboard::instance();
+    if (m_saved.isEmpty()) {
+        clipboard->clear(QClipboard::Clipboard);
+        return;
+    }
+    auto *mime = new QMimeData;
+    for (const auto &format : std::as_const(m_saved))
+        mime->setData(format.first, format.second);
+    m_saved.clear();
+    clipboard->setMimeData(mime, QClipboard::Clipboard);
+}
+
+void ClipboardOwner::onServed()
+{
+    if (m_transient)
+        m_restoreTimer.start(RestoreLingerMs);
+}
+
+void ClipboardOwner::onCopied()
+{
+    m_saved = m_monitor->takeCopy();
+    if (m_restoreWhenCopied)
+        restore();
+}
+
+// Without data-control the copy goes through KSystemClipboard, which reads
+// each format synchronously; the same formats are kept
+void ClipboardOwner::snapshot(const QMimeData *source)
+{
+    m_saved.clear();
+    if (!source) return;
+    OSK_TRACE_SCOPE("ClipboardOwner::snapshot");
+
+    // Images come in one format per encoder; PNG is enough to restore
+    qsizetype total = 0;
+    const QStringList formats = source->formats();
+    for (const QString &format : formats) {
+        if (!format.startsWith(QLatin1String("text/")) && format != QLatin1String("image/png"))
+            continue;
+        const QByteArray data = source->data(format);
+        if (total + data.size() > SnapshotLimit) continue;
+        total += data.size();
+        m_saved.append({format, data});
+    }
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <QByteArray>
+#include <QMimeData>
+#include <QObject>
+#include <QPair>
+#include <QPointer>
+#include <QString>
+#include <QTimer>
+#include <QVector>
+
+class SelectionMonitor;
+
+// Puts text on the Wayland selection ourselves, without Klipper, and puts
+// the user's clipboard back once the paste has been served.
+//
+// KSystemClipboard drives the data-control protocol, so this works while
+// the overlay has no keyboard focus, and the target reads the text straight
+// from our process through the transfer pipe. The transient selection
+// carries the password-manager hint, which keeps it out of Klipper's (and
+// our own) history. Whatever was on the clipboard before is copied first,
+// its text and PNG formats only, by SelectionMonitor in the background: the
+// offer does not wait for the owning application to write it. After the
+// target has read the text (or after a fallback delay) it is offered
+// again, unless something else took the selection in between.
+class ClipboardOwner : public QObject
+{
+    Q_OBJECT
+
+public:
+    // Readers that see this set to "secret" do not record the selection
+    static constexpr char PasswordHint[] = "x-kde-passwordManagerHint";
+    // Formats of the previous selection kept for restoring, in total
+    static constexpr qsizetype SnapshotLimit = 16 * 1024 * 1024;
+    // Further format requests after the first read are still served
+    static constexpr int RestoreLingerMs = 300;
+    // Restore even when nobody reads the text
+    static constexpr int RestoreFallbackMs = 3000;
+
+    explicit ClipboardOwner(SelectionMonitor *monitor, QObject *parent = nullptr);
+
+    // marker is offered as an extra, empty format that identifies this
+    // selection when the compositor announces it
+    void offer(const QString &text, const QString &marker);
+    // Puts the saved selection back now (no-op when nothing is pending)
+    void restore();
+
+signals:
+    // The target asked for the offered text
+    void served();
+
+private:
+    void onServed();
+    void onCopied();
+    void snapshot(const QMimeData *source);
+
+    SelectionMonitor *m_monitor;
+    QPointer<QMimeData> m_transient;   // ours until someone replaces it
+    bool m_restoreWhenCopied = false;
+    QVector<QPair<QString, QByteArray>> m_saved;
+    QTimer m_restoreTimer;
+};
@@ -0,0 +1,469 @@
+#include "clipboardstore.h"
+#include "clipboardmodel.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QSet>
+#include <QStandardPaths>
+#include <QThread>
+
+#include <zstd.h>
+
+#include <cstdio>
+#include <cstring>
+#include <memory>
+
+namespace {
+struct LogHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t generation;
+};
+
+struct IndexHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t recordSize;
+    uint32_t reserved;
+    uint64_t generation;   // must match the log it describes
+};
+
+constexpr char LogMagic[4] = {'O', 'S', 'K', 'L'};
+constexpr char IndexMagic[4] = {'O', 'S', 'K', 'I'};
+constexpr uint32_t Version = 1;
+
+// Bodies above this size are compressed
+constexpr int CompressThreshold = 4096;
+constexpr int CompressLevel = 3;
+// Compaction kicks in once dead bodies outweigh live ones past this size
+constexpr qint64 CompactMinLogSize = 1 << 20;
+
+quint64 contentHash(const QByteArray &utf8)
+{
+    const QByteArray digest = QCryptographicHash::hash(utf8, QCryptographicHash::Sha1);
+    quint64 hash = 0;
+    memcpy(&hash, digest.constData(), sizeof(hash));
+    return hash ? hash : 1; // 0 means "no entry"
+}
+
+uint64_t newGeneration()
+{
+    return uint64_t(QDateTime::currentMSecsSinceEpoch());
+}
+
+LogHeader makeLogHeader(uint64_t generation)
+{
+    LogHeader header{};
+    memcpy(header.magic, LogMagic, sizeof(LogMagic));
+    header.version = Version;
+    header.generation = generation;
+    return header;
+}
+
+IndexHeader makeIndexHeader(uint64_t generation)
+{
+    IndexHeader header{};
+    memcpy(header.magic, IndexMagic, sizeof(IndexMagic));
+    header.version = Version;
+    header.recordSize = sizeof(ClipboardStore::IndexRecord);
+    header.generation = generation;
+    return header;
+}
+}
+
+ClipboardStore::ClipboardStore(const QString &directory, QObject *parent)
+    : QObject(parent)
+    , m_directory(directory)
+{
+}
+
+ClipboardStore::~ClipboardStore()
+{
+    if (m_compactor)
+        m_compactor->wait();
+    close();
+}
+
+bool ClipboardStore::open()
+{
+    close();
+    QDir().mkpath(m_directory);
+    m_log.setFileName(m_directory + QStringLiteral("/log"));
+    m_index.setFileName(m_directory + QStringLiteral("/index"));
+    if (!m_log.open(QIODevice::ReadWrite) || !m_index.open(QIODevice::ReadWrite)) {
+        qWarning("Cannot open clipboard store in %s", qPrintable(m_directory));
+        close();
+        return false;
+    }
+
+    LogHeader logHeader{};
+    IndexHeader indexHeader{};
+    const qint64 indexSize = m_index.size();
+    if (m_log.read(reinterpret_cast<char *>(&logHeader), sizeof(logHeader)) != sizeof(logHeader)
+        || m_index.read(reinterpret_cast<char *>(&indexHeader), sizeof(indexHeader)) != sizeof(indexHeader)) {
+        return startFresh();
+    }
+    if (memcmp(logHeader.magic, LogMagic, sizeof(LogMagic)) != 0 || logHeader.version != Version
+        || memcmp(indexHeader.magic, IndexMagic, sizeof(IndexMagic)) != 0
+        || indexHeader.version != Version || indexHeader.recordSize != sizeof(IndexRecord)
+        || indexHeader.generation != logHeader.generation) {
+        qWarning("Discarding inconsistent clipboard store in %s", qPrintable(m_directory));
+        return startFresh();
+    }
+
+    // Drop a partial record left by an interrupted write
+    const qint64 count = (indexSize - qint64(sizeof(IndexHeader))) / qint64(sizeof(IndexRecord));
+    m_index.resize(qint64(sizeof(IndexHeader)) + count * qint64(sizeof(IndexRecord)));
+
+    // Only the index is read at startup, in place; bodies stay on disk
+    m_logSize = quint64(m_log.size());
+    if (!mapIndex()) return startFresh();
+    return true;
+}
+
+bool ClipboardStore::mapIndex()
+{
+    unmapIndex();
+    const qint64 size = m_index.size();
+    m_indexMap = m_index.map(0, size);
+    if (!m_indexMap) {
+        qWarning("Cannot map clipboard index in %s", qPrintable(m_directory));
+        return false;
+    }
+    m_records = reinterpret_cast<const IndexRecord *>(m_indexMap + sizeof(IndexHeader));
+    m_recordCount = qsizetype((size - qint64(sizeof(IndexHeader))) / qint64(sizeof(IndexRecord)));
+    return true;
+}
+
+void ClipboardStore::unmapIndex()
+{
+    if (m_indexMap)
+        m_index.unmap(m_indexMap);
+    m_indexMap = nullptr;
+    m_records = nullptr;
+    m_recordCount = 0;
+}
+
+bool ClipboardStore::hasBody(const IndexRecord &record) const
+{
+    return (record.flags & Tombstone)
+           || (record.offset <= m_logSize && record.storedSize <= m_logSize - record.offset);
+}
+
+bool ClipboardStore::startFresh()
+{
+    unmapIndex();
+    const uint64_t generation = newGeneration();
+    const LogHeader logHeader = makeLogHeader(generation);
+    const IndexHeader indexHeader = makeIndexHeader(generation);
+    if (!m_log.resize(0) || !m_index.resize(0)
+        || !m_log.seek(0) || !m_index.seek(0)
+        || m_log.write(reinterpret_cast<const char *>(&logHeader), sizeof(logHeader)) != sizeof(logHeader)
+        || m_index.write(reinterpret_cast<const char *>(&indexHeader), sizeof(indexHeader)) != sizeof(indexHeader)) {
+        close();
+        return false;
+    }
+    m_log.flush();
+    m_index.flush();
+    m_logSize = sizeof(logHeader);
+    return true;
+}
+
+void ClipboardStore::close()
+{
+    unmapLog();
+    unmapIndex();
+    m_logSize = 0;
+    if (m_log.isOpen()) m_log.close();
+    if (m_index.isOpen()) m_index.close();
+}
+
+bool ClipboardStore::isOpen() const { return m_index.isOpen(); }
+
+void ClipboardStore::unmapLog()
+{
+    if (m_logMap)
+        m_log.unmap(m_logMap);
+    m_logMap = nullptr;
+    m_logMapSize = 0;
+}
+
+const ClipboardStore::IndexRecord *ClipboardStore::findRecord(quint64 hash, bool includeRemoved) const
+{
+    for (qsizetype i = m_recordCount; i-- > 0;) {
+        const IndexRecord &record = m_records[i];
+        if (record.hash != hash || !hasBody(record)) continue;
+        if (!(record.flags & Tombstone)) return &record;
+        if (!includeRemoved) return nullptr;
+    }
+    return nullptr;
+}
+
+QVector<ClipboardStore::IndexRecord> ClipboardStore::liveRecords() const
+{
+    QVector<IndexRecord> live;
+    QSet<quint64> seen;
+    for (qsizetype i = m_recordCount; i-- > 0 && live.size() < MaxEntries;) {
+        const IndexRecord &record = m_records[i];
+        if (!hasBody(record) || seen.contains(record.hash)) continue;
+        seen.insert(record.hash);
+        if (!(record.flags & Tombstone))
+            live.append(record);
+    }
+    return live;
+}
+
+QVector<ClipboardStore::Summary> ClipboardStore::entries() const
+{
+    QVector<Summary> out;
+    const QVector<IndexRecord> live = liveRecords();
+    out.reserve(live.size());
+    for (const IndexRecord &record : live) {
+        out.append({record.hash,
+                    QString(reinterpret_cast<const QChar *>(record.preview), record.previewLength),
+                    int(record.length), int(record.lineCount), record.timestamp});
+    }
+    return out;
+}
+
+// ---------------------------------------------------------------------------
+// Writing
+// ---------------------------------------------------------------------------
+bool ClipboardStore::appendBody(IndexRecord &record, const QByteArray &stored)
+{
+    record.offset = quint64(m_log.size());
+    record.storedSize = uint32_t(stored.size());
+    if (!m_log.seek(qint64(record.offset)) || m_log.write(stored) != stored.size())
+        return false;
+    // Body before index record, so a crash never leaves a dangling record
+    if (!m_log.flush()) return false;
+    m_logSize = record.offset + record.storedSize;
+    return true;
+}
+
+bool ClipboardStore::appendRecord(const IndexRecord &record)
+{
+    if (!m_index.seek(m_index.size())
+        || m_index.write(reinterpret_cast<const char *>(&record), sizeof(record)) != sizeof(record))
+        return false;
+    m_index.flush();
+    // Remapped to take in the new record; earlier record pointers go stale
+    return mapIndex();
+}
+
+void ClipboardStore::add(const QString &text)
+{
+    if (!isOpen() || text.isEmpty()) return;
+
+    const QByteArray utf8 = text.toUtf8();
+    const quint64 hash = contentHash(utf8);
+    if (m_recordCount > 0 && m_records[m_recordCount - 1].hash == hash
+        && !(m_records[m_recordCount - 1].flags & Tombstone))
+        return; // already the newest entry
+
+    IndexRecord record{};
+    if (const IndexRecord *known = findRecord(hash, true)) {
+        // Known content: point at the existing body
+        record = *known;
+    } else {
+        record.hash = hash;
+        record.rawSize = uint32_t(utf8.size());
+        record.length = uint32_t(text.size());
+
+        QByteArray stored = utf8;
+        if (utf8.size() > CompressThreshold) {
+            QByteArray compressed(qsizetype(ZSTD_compressBound(size_t(utf8.size()))), Qt::Uninitialized);
+            const size_t size = ZSTD_compress(compressed.data(), size_t(compressed.size()),
+                                              utf8.constData(), size_t(utf8.size()), CompressLevel);
+            if (!ZSTD_isError(size) && qsizetype(size) < utf8.size()) {
+                compressed.truncate(qsizetype(size));
+                stored = compressed;
+                record.flags |= Compressed;
+            }
+        }
+        if (!appendBody(record, stored)) {
+            qWarning("Failed to write clipboard entry");
+            return;
+        }
+
+        const ClipboardModel::Preview preview = ClipboardModel::makePreview(text);
+        record.lineCount = uint32_t(preview.lineCount);
+        record.previewLength = uint16_t(qMin<qsizetype>(preview.text.size(), PreviewCapacity));
+        memcpy(record.preview, preview.text.constData(), record.previewLength * sizeof(char16_t));
+    }
+    record.flags &= ~uint32_t(Tombstone);
+    record.timestamp = QDateTime::currentMSecsSinceEpoch();
+
+    if (!appendRecord(record)) return;
+    emit entriesChanged();
+    maybeCompact();
+}
+
+void ClipboardStore::remove(quint64 hash)
+{
+    if (!findRecord(hash, false)) return;
+    IndexRecord tombstone{};
+    tombstone.hash = hash;
+    tombstone.flags = Tombstone;
+    tombstone.timestamp = QDateTime::currentMSecsSinceEpoch();
+    if (appendRecord(tombstone))
+        emit entriesChanged();
+}
+
+// ---------------------------------------------------------------------------
+// Reading
+// ---------------------------------------------------------------------------
+QByteArray ClipboardStore::readStored(const IndexRecord &record)
+{
+    const quint64 end = record.offset + record.storedSize;
+    if (end > m_logMapSize) {
+        // The log grew since it was mapped
+        unmapLog();
+        const qint64 size = m_log.size();
+        m_logMap = m_log.map(0, size);
+        if (!m_logMap) return QByteArray();
+        m_logMapSize = quint64(size);
+        if (end > m_logMapSize) return QByteArray();
+    }
+    return QByteArray(reinterpret_cast<const char *>(m_logMap + record.offset),
+                      qsizetype(record.storedSize));
+}
+
+QString ClipboardStore::load(quint64 hash)
+{
+    const IndexRecord *record = findRecord(hash, false);
+    if (!record) return QString();
+
+    const QByteArray stored = readStored(*record);
+    if (!(record->flags & Compressed))
+        return QString::fromUtf8(stored);
+
+    QByteArray raw(qsizetype(record->rawSize), Qt::Uninitialized);
+    const size_t size = ZSTD_decompress(raw.data(), size_t(raw.size()),
+                                        stored.constData(), size_t(stored.size()));
+    if (ZSTD_isError(size) || size != record->rawSize) {
+        qWarning("Corrupt clipboard entry %llx", static_cast<unsigned long long>(hash));
+        return QString();
+    }
+    return QString::fromUtf8(raw);
+}
+
+// ---------------------------------------------------------------------------
+// Compaction
+// ---------------------------------------------------------------------------
+void ClipboardStore::maybeCompact()
+{
+    if (m_compactor) return;
+
+    const QVector<IndexRecord> live = liveRecords();
+    qint64 liveBytes = 0;
+    QSet<quint64> counted;
+    for (const IndexRecord &record : live) {
+        if (!counted.contains(record.hash)) {
+            counted.insert(record.hash);
+            liveBytes += record.storedSize;
+        }
+    }
+    const qint64 logSize = m_log.size();
+    const bool logBloated = logSize > CompactMinLogSize && logSize > 2 * liveBytes;
+    const bool indexBloated = m_recordCount > 4 * MaxEntries;
+    if (!logBloated && !indexBloated) return;
+
+    // Oldest first, as the files are laid out
+    QVector<IndexRecord> snapshot(live.crbegin(), live.crend());
+    const int snapshotSize = int(m_recordCount);
+    const QString directory = m_directory;
+    auto ok = std::make_shared<bool>(false);
+
+    m_compactor = QThread::create([directory, snapshot, ok]() {
+        *ok = writeCompacted(directory, snapshot);
+    });
+    m_compactor->setParent(this);
+    connect(m_compactor, &QThread::finished, this, [this, snapshotSize, ok]() {
+        m_compactor->deleteLater();
+        m_compactor = nullptr;
+        finishCompaction(snapshotSize, *ok);
+    });
+    m_compactor->start(QThread::LowPriority);
+}
+
+// Worker thread: copies live bodies into fresh files next to the current ones
+bool ClipboardStore::writeCompacted(const QString &directory, const QVector<IndexRecord> &live)
+{
+    QFile oldLog(directory + QStringLiteral("/log"));
+    QFile newLog(directory + QStringLiteral("/log.compact"));
+    QFile newIndex(directory + QStringLiteral("/index.compact"));
+    if (!oldLog.open(QIODevice::ReadOnly)
+        || !newLog.open(QIODevice::WriteOnly | QIODevice::Truncate)
+        || !newIndex.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+
+    const uint64_t generation = newGeneration();
+    const LogHeader logHeader = makeLogHeader(generation);
+    const IndexHeader indexHeader = makeIndexHeader(generation);
+    newLog.write(reinterpret_cast<const char *>(&logHeader), sizeof(logHeader));
+    newIndex.write(reinterpret_cast<const char *>(&indexHeader), sizeof(indexHeader));
+
+    for (IndexRecord record : live) {
+        if (!oldLog.seek(qint64(record.offset))) return false;
+        const QByteArray body = oldLog.read(qint64(record.storedSize));
+        if (body.size() != qsizetype(record.storedSize)) return false;
+        record.offset = quint64(newLog.pos());
+        if (newLog.write(body) != body.size()) return false;
+        if (newIndex.write(reinterpret_cast<const char *>(&record), sizeof(record)) != sizeof(record))
+            return false;
+    }
+    return newLog.flush() && newIndex.flush();
+}
+
+void ClipboardStore::finishCompaction(int snapshotSize, bool ok)
+{
+    const QString compactLog = m_directory + QStringLiteral("/log.compact");
+    const QString compactIndex = m_directory + QStringLiteral("/index.compact");
+    if (!ok || !isOpen()) {
+        QFile::remove(compactLog);
+        QFile::remove(compactIndex);
+        return;
+    }
+
+    // Changes made while the worker ran, with their bodies, to be replayed
+    struct Pending {
+        IndexRecord record;
+        QByteArray stored;
+    };
+    QVector<Pending> pending;
+    for (qsizetype i = snapshotSize; i < m_recordCount; ++i) {
+        const IndexRecord &record = m_records[i];
+        pending.append({record, (record.flags & Tombstone) ? QByteArray() : readStored(record)});
+    }
+
+    close();
+    // Log first: if we stop in between, the generation check discards the pair
+    if (std::rename(QFile::encodeName(compactLog).constData(),
+                    QFile::encodeName(m_directory + QStringLiteral("/log")).constData()) != 0
+        || std::rename(QFile::encodeName(compactIndex).constData(),
+                       QFile::encodeName(m_directory + QStringLiteral("/index")).constData()) != 0) {
+        qWarning("Failed to swap in compacted clipboard store");
+    }
+    if (!open()) return;
+
+    for (Pending &p : pending) {
+        if (!(p.record.flags & Tombstone)) {
+            if (const IndexRecord *known = findRecord(p.record.hash, true)) {
+                p.record.offset = known->offset;
+                p.record.storedSize = known->storedSize;
+            } else if (!appendBody(p.record, p.stored)) {
+                continue;
+            }
+        }
+        appendRecord(p.record);
+    }
+    emit entriesChanged();
+}
+
+QString ClipboardStore::defaultDirectory()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)
+           + QStringLiteral("/clipboard");
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <QFile>
+#include <QObject>
+#include <QString>
+#include <QVector>
+#include <cstdint>
+
+class QThread;
+
+// Persistent clipboard history that does not depend on Klipper.
+//
+// Two append-only files live in the store directory:
+//   log    entry bodies (UTF-8, zstd-compressed above a size threshold)
+//   index  fixed-size records: content hash, body location, sizes, line
+//          count, timestamp and a ready-made preview
+// Opening maps the index and never touches the log, so history is listed
+// without reading a single body, and records are read from that mapping
+// rather than copied; a body is read (from a mapping of the log) only when
+// its entry is pasted. Search sees the previews, not the bodies. Re-copying known content appends an index
+// record that points at the existing body, and removal appends a tombstone.
+// When dead space dominates, compaction rewrites both files on a worker
+// thread and swaps them in.
+class ClipboardStore : public QObject
+{
+    Q_OBJECT
+
+public:
+    static constexpr int MaxEntries = 200;
+    static constexpr int PreviewCapacity = 176;
+
+    struct Summary {
+        quint64 hash;
+        QString preview;
+        int length;
+        int lineCount;
+        qint64 timestamp;
+    };
+
+    struct IndexRecord {
+        uint64_t hash;
+        uint64_t offset;        // body position in the log
+        uint32_t storedSize;    // bytes in the log
+        uint32_t rawSize;       // UTF-8 bytes before compression
+        uint32_t length;        // UTF-16 length of the text
+        uint32_t lineCount;
+        uint32_t flags;
+        uint16_t previewLength;
+        char16_t preview[PreviewCapacity];
+        int64_t timestamp;      // ms since the epoch
+    };
+
+    explicit ClipboardStore(const QString &directory, QObject *parent = nullptr);
+    ~ClipboardStore() override;
+
+    bool open();
+    void close();
+    bool isOpen() const;
+
+    void add(const QString &text);
+    void remove(quint64 hash);
+    QString load(quint64 hash);
+
+    // Live entries, newest first, at most MaxEntries
+    QVector<Summary> entries() const;
+
+    static QString defaultDirectory();
+
+signals:
+    void entriesChanged();
+
+private:
+    enum Flag : uint32_t {
+        Compressed = 1u << 0,
+        Tombstone = 1u << 1,
+    };
+
+    // Newest record for hash; with includeRemoved, bodies hidden by a
+    // tombstone are returned too
+    const IndexRecord *findRecord(quint64 hash, bool includeRemoved) const;
+    QVector<IndexRecord> liveRecords() const;
+    // False for a record whose body was lost with the end of the log
+    bool hasBody(const IndexRecord &record) const;
+    bool mapIndex();
+    void unmapIndex();
+    QByteArray readStored(const IndexRecord &record);
+    bool appendBody(IndexRecord &record, const QByteArray &stored);
+    bool appendRecord(const IndexRecord &record);
+    bool startFresh();
+    void unmapLog();
+    void maybeCompact();
+    void finishCompaction(int snapshotSize, bool ok);
+    static bool writeCompacted(const QString &directory, const QVector<IndexRecord> &live);
+
+    QString m_directory;
+    QFile m_log;
+    QFile m_index;
+    uchar *m_logMap = nullptr;
+    quint64 m_logMapSize = 0;
+    uchar *m_indexMap = nullptr;
+    const IndexRecord *m_records = nullptr;   // whole index, oldest first, mapped
+    qsizetype m_recordCount = 0;
+    quint64 m_logSize = 0;
+    QThread *m_compactor = nullptr;
+};
@@ -0,0 +1,276 @@
+#include "completiondictionary.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QTextStream>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <map>
+#include <queue>
+#include <vector>
+
+namespace {
+struct Header {
+    char magic[4];
+    uint32_t version;
+    uint32_t nodeCount;
+    uint32_t reserved;
+};
+
+constexpr char Magic[4] = {'O', 'S', 'K', 'W'};
+constexpr uint32_t Version = 2;
+
+// Every word of a list without frequencies, less its length
+constexpr uint32_t UnweightedFrequency = 1000;
+
+// Shared by all dictionaries, so a generation never repeats across them
+std::atomic<uint64_t> g_nextGeneration{1};
+}
+
+CompletionDictionary::~CompletionDictionary()
+{
+    close();
+}
+
+bool CompletionDictionary::open(const QString &path)
+{
+    close();
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::ReadOnly))
+        return false;
+
+    const qint64 size = m_file.size();
+    if (size < qint64(sizeof(Header))) {
+        close();
+        return false;
+    }
+
+    const uchar *data = m_file.map(0, size);
+    if (!data) {
+        close();
+        return false;
+    }
+
+    const auto *header = reinterpret_cast<const Header *>(data);
+    if (memcmp(header->magic, Magic, sizeof(Magic)) != 0 || header->version != Version
+        || header->nodeCount == 0
+        || size < qint64(sizeof(Header) + header->nodeCount * sizeof(Node))) {
+        qWarning("Invalid completion dictionary: %s", qPrintable(path));
+        close();
+        return false;
+    }
+
+    // Lookups index children without checking: every child range must lie
+    // in the file, after its parent (as compile() lays them out), so no walk
+    // can leave the mapping or come back to a node it has passed
+    const auto *nodes = reinterpret_cast<const Node *>(data + sizeof(Header));
+    for (uint32_t i = 0; i < header->nodeCount; ++i) {
+        const Node &node = nodes[i];
+        if (node.childCount != 0
+            && (node.firstChild <= i || uint64_t(node.firstChild) + node.childCount > header->nodeCount)) {
+            qWarning("Invalid completion dictionary: %s", qPrintable(path));
+            close();
+            return false;
+        }
+    }
+
+    m_nodes = nodes;
+    m_nodeCount = header->nodeCount;
+    m_generation = g_nextGeneration++;
+    return true;
+}
+
+void CompletionDictionary::close()
+{
+    if (m_nodes)
+        m_generation = g_nextGeneration++;
+    m_nodes = nullptr;
+    m_nodeCount = 0;
+    if (m_file.isOpen())
+        m_file.close(); // also unmaps
+}
+
+bool CompletionDictionary::isOpen() const { return m_nodes != nullptr; }
+
+int CompletionDictionary::findChild(const Node &node, char16_t ch) const
+{
+    const Node *first = m_nodes + node.firstChild;
+    const Node *last = first + node.childCount;
+    const Node *it = std::lower_bound(first, last, ch,
+        [](const Node &n, char16_t c) { return n.ch < c; });
+    return (it != last && it->ch == ch) ? int(it - m_nodes) : -1;
+}
+
+int CompletionDictionary::findNode(const QString &prefix) const
+{
+    if (!m_nodes) return -1;
+    int index = 0;
+    for (const QChar c : prefix) {
+        index = findChild(m_nodes[index], c.toLower().unicode());
+        if (index < 0) return -1;
+    }
+    return index;
+}
+
+QStringList CompletionDictionary::complete(const QString &prefix, int maxResults) const
+{
+    QStringList results;
+    const int start = findNode(prefix);
+    if (start < 0 || maxResults <= 0) return results;
+
+    // Best-first search over subtree maxima. A queue entry is either a
+    // subtree (expand it) or a finished word (emit it); since a subtree's
+    // score bounds every word inside it, words pop in frequency order.
+    struct Item {
+        uint32_t score;
+        uint32_t node;
+        bool word;
+        QString text;
+        bool operator<(const Item &o) const { return score < o.score; }
+    };
+    std::priority_queue<Item> queue;
+    queue.push({m_nodes[start].maxFreq, uint32_t(start), false, prefix.toLower()});
+
+    while (!queue.empty() && results.size() < maxResults) {
+        Item item = queue.top();
+        queue.pop();
+
+        if (item.word) {
+            results.append(item.text);
+            continue;
+        }
+
+        const Node &node = m_nodes[item.node];
+        if (node.freq)
+            queue.push({node.freq, item.node, true, item.text});
+        for (uint32_t i = 0; i < node.childCount; ++i) {
+            const uint32_t child = node.firstChild + i;
+            queue.push({m_nodes[child].maxFreq, child, false,
+                        item.text + QChar(m_nodes[child].ch)});
+        }
+    }
+    return results;
+}
+
+// ---------------------------------------------------------------------------
+// Compilation (word list → flat trie file)
+// ---------------------------------------------------------------------------
+bool CompletionDictionary::compile(const QString &wordListPath, const QString &outPath)
+{
+    struct BuildNode {
+        std::map<char16_t, uint32_t> children;
+        uint32_t freq = 0;
+        uint32_t maxFreq = 0;
+    };
+    std::vector<BuildNode> nodes(1);
+
+    const bool read = readWordList(wordListPath, [&nodes](const QString &word, uint32_t freq) {
+        uint32_t index = 0;
+        for (const QChar c : word) {
+            auto it = nodes[index].children.find(c.unicode());
+            if (it == nodes[index].children.end()) {
+                const uint32_t next = uint32_t(nodes.size());
+                nodes[index].children.emplace(c.unicode(), next);
+                nodes.emplace_back();
+                index = next;
+            } else {
+                index = it->second;
+            }
+        }
+        nodes[index].freq = std::max(nodes[index].freq, freq);
+    });
+    if (!read)
+        return false;
+
+    // Subtree maxima (children always have a larger index than their parent)
+    for (size_t i = nodes.size(); i-- > 0;) {
+        BuildNode &n = nodes[i];
+        n.maxFreq = n.freq;
+        for (const auto &[ch, child] : n.children)
+            n.maxFreq = std::max(n.maxFreq, nodes[child].maxFreq);
+    }
+
+    // Breadth-first layout so siblings are contiguous
+    std::vector<Node> flat;
+    flat.reserve(nodes.size());
+    std::vector<uint32_t> order{0};
+    flat.push_back({0, 0, 0, nodes[0].freq, nodes[0].maxFreq});
+    for (size_t i = 0; i < order.size(); ++i) {
+        const BuildNode &n = nodes[order[i]];
+        flat[i].firstChild = uint32_t(flat.size());
+        flat[i].childCount = uint16_t(n.children.size());
+        for (const auto &[ch, child] : n.children) {
+            order.push_back(child);
+            flat.push_back({ch, 0, 0, nodes[child].freq, nodes[child].maxFreq});
+        }
+    }
+
+    QDir().mkpath(QFileInfo(outPath).path());
+    QSaveFile out(outPath);
+    if (!out.open(QIODevice::WriteOnly))
+        return false;
+
+    Header header{};
+    memcpy(header.magic, Magic, sizeof(Magic));
+    header.version = Version;
+    header.nodeCount = uint32_t(flat.size());
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char *>(flat.data()), qint64(flat.size() * sizeof(Node)));
+    return out.commit();
+}
+
+bool CompletionDictionary::readWordList(const QString &path,
+                                        const std::function<void(const QString &, uint32_t)> &fn)
+{
+    QFile in(path);
+    if (!in.open(QIODevice::ReadOnly | QIODevice::Text))
+        return false;
+
+    // Lines without a frequency say nothing about how common the word is
+    // (/usr/share/dict/words is alphabetical), so they all rank alike, the
+    // shorter words first.
+    QTextStream stream(&in);
+    QString line;
+    while (stream.readLineInto(&line)) {
+        const QStringList parts = line.simplified().split(QLatin1Char(' '), Qt::SkipEmptyParts);
+        if (parts.isEmpty() || parts.first().startsWith(QLatin1Char('#'))) continue;
+        bool ok = false;
+        uint32_t freq = parts.size() > 1 ? parts.at(1).toUInt(&ok) : 0;
+        if (!ok)
+            freq = UnweightedFrequency - uint32_t(qMin<qsizetype>(parts.first().size(), UnweightedFrequency - 1));
+        if (freq == 0) continue;
+        fn(parts.first().toLower(), freq);
+    }
+    return true;
+}
+
+bool CompletionDictionary::isUpToDate(const QString &wordListPath, const QString &compiledPath)
+{
+    const QFileInfo compiled(compiledPath);
+    if (!compiled.exists()) return false;
+    if (wordListPath.isEmpty()) return true;
+    return compiled.lastModified() >= QFileInfo(wordListPath).lastModified();
+}
+
+QString CompletionDictionary::defaultSourcePath()
+{
+    const QStringList candidates = {
+        QDir::homePath() + QStringLiteral("/.local/share/osk/words.txt"),
+        QStringLiteral("/usr/share/dict/words"),
+    };
+    for (const QString &path : candidates) {
+        if (QFileInfo::exists(path))
+            return path;
+    }
+    return QString();
+}
+
+QString CompletionDictionary::compiledPath()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation)
+           + QStringLiteral("/words.dict");
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <QFile>
+#include <QString>
+#include <QStringList>
+#include <cstdint>
+#include <functional>
+
+// Read-only word-completion dictionary backed by a memory-mapped flat trie.
+//
+// The file is produced once by compile() from a plain word list ("word" or
+// "word frequency" per line) and then mapped as-is: opening it is a single
+// mmap and one pass checking the child ranges, with no heap allocation for
+// the nodes.
+//
+// Layout (native endian):
+//   Header { "OSKW", version, nodeCount, reserved }
+//   Node[nodeCount], node 0 is the root. Children of a node are stored
+//   contiguously and sorted by character, so a step is a binary search.
+//   Every node carries the highest word frequency in its subtree, which lets
+//   complete() run a best-first search that touches only the top branches.
+class CompletionDictionary
+{
+public:
+    CompletionDictionary() = default;
+    ~CompletionDictionary();
+
+    CompletionDictionary(const CompletionDictionary &) = delete;
+    CompletionDictionary &operator=(const CompletionDictionary &) = delete;
+
+    bool open(const QString &path);
+    void close();
+    bool isOpen() const;
+    // Changes whenever a file is opened or closed, so anything built from
+    // the words (e.g. swipe templates) can tell it is stale
+    uint64_t generation() const { return m_generation; }
+
+    // Up to maxResults completions for prefix, most frequent first.
+    // Lookup is case-insensitive; results are lower case.
+    QStringList complete(const QString &prefix, int maxResults) const;
+
+    // Calls fn(word, frequency) for every word below prefix, in trie order.
+    template<typename Fn>
+    void forEachWord(const QString &prefix, Fn &&fn) const;
+
+    static bool compile(const QString &wordListPath, const QString &outPath);
+    // Calls fn(word, frequency) for every entry of a plain word list; words are lower case
+    static bool readWordList(const QString &path,
+                             const std::function<void(const QString &, uint32_t)> &fn);
+    static bool isUpToDate(const QString &wordListPath, const QString &compiledPath);
+
+    // First existing word list: ~/.local/share/osk/words.txt, /usr/share/dict/words
+    static QString defaultSourcePath();
+    static QString compiledPath();
+
+    struct Node {
+        char16_t ch;
+        uint16_t childCount;
+        uint32_t firstChild;
+        uint32_t freq;      // 0 when the node does not end a word
+        uint32_t maxFreq;   // highest freq in this subtree
+    };
+
+private:
+    int findNode(const QString &prefix) const;
+    int findChild(const Node &node, char16_t ch) const;
+    template<typename Fn>
+    void walk(uint32_t index, QString &word, Fn &fn) const;
+
+    QFile m_file;
+    const Node *m_nodes = nullptr;
+    uint32_t m_nodeCount = 0;
+    uint64_t m_generation = 0;
+};
+
+template<typename Fn>
+void CompletionDictionary::forEachWord(const QString &prefix, Fn &&fn) const
+{
+    const int start = findNode(prefix);
+    if (start < 0) return;
+    QString word = prefix.toLower();
+    walk(uint32_t(start), word, fn);
+}
+
+template<typename Fn>
+void CompletionDictionary::walk(uint32_t index, QString &word, Fn &fn) const
+{
+    const Node &node = m_nodes[index];
+    if (node.freq)
+        fn(word, node.freq);
+    for (uint32_t i = 0; i < node.childCount; ++i) {
+        const uint32_t child = node.firstChild + i;
+        word.append(QChar(m_nodes[child].ch));
+        walk(child, word, fn);
+        word.chop(1);
+    }
+}
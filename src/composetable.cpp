@@ -0,0 +1,162 @@
+#include "composetable.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QTextStream>
+
+#include <xkbcommon/xkbcommon.h>
+#include <xkbcommon/xkbcommon-compose.h>
+#include <memory>
+#include <vector>
+
+namespace {
+// Input symbol for a keysym in a sequence, or 0 when the OSK cannot type it
+char32_t composeSymbol(xkb_keysym_t sym)
+{
+    if (sym == XKB_KEY_Multi_key) return ComposeDfa::ComposeKey;
+    if (const uint8_t dead = ComposeDfa::deadKeyIndex(sym)) return ComposeDfa::deadKey(dead);
+    return xkb_keysym_to_utf32(sym);
+}
+
+// System table for a locale, as listed in compose.dir ("path: locale")
+QString systemComposeFile(const QString &locale)
+{
+    const QString localeDir = qEnvironmentVariable("XLOCALEDIR", QStringLiteral("/usr/share/X11/locale"));
+    QFile dir(localeDir + QStringLiteral("/compose.dir"));
+    if (!dir.open(QIODevice::ReadOnly | QIODevice::Text))
+        return QString();
+    QTextStream stream(&dir);
+    QString line;
+    while (stream.readLineInto(&line)) {
+        if (line.startsWith(QLatin1Char('#'))) continue;
+        const qsizetype colon = line.indexOf(QLatin1Char(':'));
+        if (colon > 0 && line.mid(colon + 1).trimmed() == locale)
+            return localeDir + QLatin1Char('/') + line.left(colon).trimmed();
+    }
+    return QString();
+}
+}
+
+ComposeTable::~ComposeTable()
+{
+    close();
+}
+
+bool ComposeTable::open(const QString &path)
+{
+    close();
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::ReadOnly))
+        return false;
+
+    const qint64 size = m_file.size();
+    const uchar *data = size > 0 ? m_file.map(0, size) : nullptr;
+    if (!data || !m_dfa.attach(data, size_t(size))) {
+        qWarning("Invalid compose table: %s", qPrintable(path));
+        close();
+        return false;
+    }
+    return true;
+}
+
+void ComposeTable::close()
+{
+    m_dfa.detach();
+    if (m_file.isOpen())
+        m_file.close(); // also unmaps
+}
+
+bool ComposeTable::isOpen() const { return m_dfa.isAttached(); }
+
+bool ComposeTable::compile(const QString &locale, const QString &outPath)
+{
+    std::unique_ptr<xkb_context, decltype(&xkb_context_unref)> context(
+        xkb_context_new(XKB_CONTEXT_NO_FLAGS), &xkb_context_unref);
+    if (!context) return false;
+    const QByteArray localeName = locale.toUtf8();
+    std::unique_ptr<xkb_compose_table, decltype(&xkb_compose_table_unref)> table(
+        xkb_compose_table_new_from_locale(context.get(), localeName.constData(), XKB_COMPOSE_COMPILE_NO_FLAGS),
+        &xkb_compose_table_unref);
+    if (!table) return false;
+    std::unique_ptr<xkb_compose_table_iterator, decltype(&xkb_compose_table_iterator_free)> it(
+        xkb_compose_table_iterator_new(table.get()), &xkb_compose_table_iterator_free);
+    if (!it) return false;
+
+    ComposeDfa::Builder builder;
+    std::vector<char32_t> symbols;
+    while (xkb_compose_table_entry *entry = xkb_compose_table_iterator_next(it.get())) {
+        size_t length = 0;
+        const xkb_keysym_t *sequence = xkb_compose_table_entry_sequence(entry, &length);
+        symbols.clear();
+        for (size_t i = 0; i < length; ++i) {
+            const char32_t symbol = composeSymbol(sequence[i]);
+            if (!symbol) break;
+            symbols.push_back(symbol);
+        }
+        if (symbols.size() != length) continue;
+
+        std::u32string output = QString::fromUtf8(xkb_compose_table_entry_utf8(entry)).toStdU32String();
+        // Entries may give only a keysym ("<a> <b> : ssharp")
+        if (output.empty()) {
+            if (const char32_t c = xkb_keysym_to_utf32(xkb_compose_table_entry_keysym(entry)))
+                output.push_back(c);
+        }
+        builder.add(symbols, output);
+    }
+
+    const std::vector<uint8_t> image = builder.build();
+    if (image.empty()) return false;
+    QDir().mkpath(QFileInfo(outPath).path());
+    QSaveFile out(outPath);
+    if (!out.open(QIODevice::WriteOnly))
+        return false;
+    out.write(reinterpret_cast<const char *>(image.data()), qint64(image.size()));
+    return out.commit();
+}
+
+bool ComposeTable::isUpToDate(const QString &locale, const QString &compiledPath)
+{
+    const QFileInfo compiled(compiledPath);
+    if (!compiled.exists()) return false;
+    for (const QString &path : sourcePaths(locale)) {
+        if (QFileInfo(path).lastModified() > compiled.lastModified())
+            return false;
+    }
+    return true;
+}
+
+QString ComposeTable::locale()
+{
+    for (const char *name : {"LC_ALL", "LC_CTYPE", "LANG"}) {
+        const QString value = qEnvironmentVariable(name);
+        if (!value.isEmpty()) return value;
+    }
+    return QStringLiteral("C");
+}
+
+QStringList ComposeTable::sourcePaths(const QString &locale)
+{
+    const QString configHome = qEnvironmentVariable("XDG_CONFIG_HOME", QDir::homePath() + QStringLiteral("/.config"));
+    const QStringList candidates = {
+        qEnvironmentVariable("XCOMPOSEFILE"),
+        configHome + QStringLiteral("/XCompose"),
+        QDir::homePath() + QStringLiteral("/.XCompose"),
+        systemComposeFile(locale),
+    };
+    QStringList paths;
+    for (const QString &path : candidates) {
+        if (!path.isEmpty() && QFileInfo::exists(path))
+            paths.append(path);
+    }
+    return paths;
+}
+
+QString ComposeTable::compiledPath(const QString &locale)
+{
+    QString name = locale;
+    name.replace(QLatin1Char('/'), QLatin1Char('_'));
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation)
+           + QStringLiteral("/compose-") + name + QStringLiteral(".dfa");
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <QFile>
+#include <QString>
+#include <QStringList>
+
+#include "core/composedfa.h"
+
+// The user's Compose table, compiled once per locale into a ComposeDfa
+// image under the cache directory and memory-mapped from there.
+//
+// compile() reads the sequences with libxkbcommon, which resolves the same
+// files the rest of the desktop uses: $XCOMPOSEFILE, ~/.config/XCompose or
+// ~/.XCompose, and the locale's system table (including its "include"
+// lines). Later starts only map the image; it is rebuilt when one of those
+// files is newer than it.
+class ComposeTable
+{
+public:
+    ComposeTable() = default;
+    ~ComposeTable();
+
+    ComposeTable(const ComposeTable &) = delete;
+    ComposeTable &operator=(const ComposeTable &) = delete;
+
+    bool open(const QString &path);
+    void close();
+    bool isOpen() const;
+    const ComposeDfa &dfa() const { return m_dfa; }
+
+    static bool compile(const QString &locale, const QString &outPath);
+    static bool isUpToDate(const QString &locale, const QString &compiledPath);
+
+    // LC_ALL, LC_CTYPE or LANG, as libxkbcommon picks it
+    static QString locale();
+    // Existing files the table for locale may be read from
+    static QStringList sourcePaths(const QString &locale);
+    static QString compiledPath(const QString &locale);
+
+private:
+    QFile m_file;
+    ComposeDfa m_dfa;
+};
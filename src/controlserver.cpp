@@ -0,0 +1,44 @@
+#include "controlserver.h"
+#include "keyboardcontroller.h"
+#include "singleinstance.h"
+
+#include <QLocalSocket>
+
+ControlServer::ControlServer(KeyboardController *controller, QObject *parent)
+    : QObject(parent)
+    , m_controller(controller)
+{
+    connect(&m_server, &QLocalServer::newConnection, this, &ControlServer::onNewConnection);
+}
+
+bool ControlServer::listen()
+{
+    const QString path = QString::fromStdString(SingleInstance::runtimePath("control.sock"));
+    if (path.isEmpty()) return false;
+    // The instance lock is ours, so a socket file left here is stale
+    QLocalServer::removeServer(path);
+    m_server.setSocketOptions(QLocalServer::UserAccessOption);
+    if (!m_server.listen(path)) {
+        qWarning("Cannot listen on %s: %s", qPrintable(path), qPrintable(m_server.errorString()));
+        return false;
+    }
+    return true;
+}
+
+void ControlServer::onNewConnection()
+{
+    while (QLocalSocket *socket = m_server.nextPendingConnection()) {
+        connect(socket, &QLocalSocket::disconnected, socket, &QObject::deleteLater);
+        connect(socket, &QLocalSocket::readyRead, this, [this, socket]() {
+            if (!socket->canReadLine()) {
+                if (socket->bytesAvailable() > 256) socket->disconnectFromServer();
+                return;
+            }
+            const QString command = QString::fromUtf8(socket->readLine()).trimmed();
+            const bool ok = m_controller->runCommand(command);
+            socket->write(ok ? QByteArrayLiteral("ok\n")
+                             : QByteArrayLiteral("unknown command: ") + command.toUtf8() + '\n');
+            socket->disconnectFromServer();
+        });
+    }
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <QLocalServer>
+#include <QObject>
+
+class KeyboardController;
+
+// Takes commands from later launches of osk (see SingleInstance) on
+// $XDG_RUNTIME_DIR/osk/control.sock: one line in, one line back ("ok" or
+// why the command was refused).
+class ControlServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ControlServer(KeyboardController *controller, QObject *parent = nullptr);
+
+    bool listen();
+
+private:
+    void onNewConnection();
+
+    KeyboardController *m_controller;
+    QLocalServer m_server;
+};
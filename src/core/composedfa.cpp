@@ -0,0 +1,244 @@
+#include "composedfa.h"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+
+namespace {
+struct Header {
+    char magic[4];
+    uint32_t version;
+    uint32_t columnCount;
+    uint32_t columnPages;
+    uint32_t slotCount;
+    uint32_t outputLength;
+    uint32_t sequenceCount;
+    uint32_t reserved;
+};
+
+constexpr char Magic[4] = {'O', 'S', 'K', 'C'};
+
+constexpr std::size_t align4(std::size_t n) { return (n + 3) & ~std::size_t(3); }
+
+// Byte offsets of the arrays after the header
+struct Layout {
+    std::size_t pages, columns, slots, outputs, end;
+
+    Layout(std::size_t symbolPages, std::size_t columnPages, std::size_t slotCount,
+           std::size_t outputLength, std::size_t slotSize)
+    {
+        pages = sizeof(Header);
+        columns = pages + symbolPages * sizeof(uint16_t);
+        slots = align4(columns + columnPages * 256 * sizeof(uint16_t));
+        outputs = slots + slotCount * slotSize;
+        end = outputs + outputLength * sizeof(char32_t);
+    }
+};
+} // namespace
+
+void ComposeDfa::Builder::add(std::span<const char32_t> symbols, std::u32string_view output)
+{
+    if (symbols.empty() || output.empty() || output.size() > MaxOutput) return;
+    for (const char32_t symbol : symbols) {
+        if (symbol > MaxSymbol) return;
+    }
+
+    uint32_t node = 0;
+    for (const char32_t symbol : symbols) {
+        // Going through an accepting node makes it a prefix again
+        m_nodes[node].output.clear();
+        auto &children = m_nodes[node].children;
+        auto it = std::find_if(children.begin(), children.end(),
+                               [symbol](const auto &child) { return child.first == symbol; });
+        if (it != children.end()) {
+            node = it->second;
+            continue;
+        }
+        const uint32_t child = uint32_t(m_nodes.size());
+        children.emplace_back(symbol, child);
+        m_nodes.emplace_back();
+        node = child;
+    }
+    // Longer sequences under it are unreachable now; their nodes are left
+    // behind and never laid out
+    m_nodes[node].children.clear();
+    m_nodes[node].output.assign(output);
+}
+
+std::vector<uint8_t> ComposeDfa::Builder::build() const
+{
+    // Nodes reachable from the start, parents before children
+    std::vector<uint32_t> order {0};
+    std::map<char32_t, uint32_t> uses;
+    for (std::size_t i = 0; i < order.size(); ++i) {
+        for (const auto &[symbol, child] : m_nodes[order[i]].children) {
+            ++uses[symbol];
+            order.push_back(child);
+        }
+    }
+
+    // Frequent symbols get the low columns: they appear in most fan-outs,
+    // which then pack into the gaps near the start of the slot array
+    std::vector<std::pair<uint32_t, char32_t>> byUse;
+    byUse.reserve(uses.size());
+    for (const auto &[symbol, count] : uses)
+        byUse.emplace_back(count, symbol);
+    std::stable_sort(byUse.begin(), byUse.end(), [](const auto &a, const auto &b) { return a.first > b.first; });
+    const uint32_t columnCount = uint32_t(std::min<std::size_t>(byUse.size(), UINT16_MAX));
+
+    std::vector<uint16_t> pages(SymbolPages, 0);
+    std::vector<uint16_t> columns(256, 0);   // page 0 stays empty
+    std::map<char32_t, uint16_t> columnOf;
+    for (uint32_t i = 0; i < columnCount; ++i) {
+        const char32_t symbol = byUse[i].second;
+        uint16_t &page = pages[symbol >> 8];
+        if (!page) {
+            page = uint16_t(columns.size() / 256);
+            columns.resize(columns.size() + 256, 0);
+        }
+        columns[std::size_t(page) * 256 + (symbol & 0xff)] = uint16_t(i + 1);
+        columnOf[symbol] = uint16_t(i + 1);
+    }
+
+    // Double-array placement, first fit: each node's children go at
+    // base + column for the lowest base whose slots are all free
+    std::vector<Slot> slots(1, Slot {0, Free});
+    std::vector<uint32_t> slotOf(m_nodes.size(), 0);
+    std::u32string outputs;
+    uint32_t sequenceCount = 0;
+    std::size_t firstFree = 1;
+    std::vector<uint16_t> fanout;
+
+    for (const uint32_t node : order) {
+        const Node &n = m_nodes[node];
+        const uint32_t slot = slotOf[node];
+        if (!n.output.empty()) {
+            slots[slot].base = Accepting | uint32_t(outputs.size()) << 8 | uint32_t(n.output.size());
+            outputs += n.output;
+            ++sequenceCount;
+            continue;
+        }
+
+        fanout.clear();
+        for (const auto &[symbol, child] : n.children) {
+            auto it = columnOf.find(symbol);
+            if (it != columnOf.end()) fanout.push_back(it->second);
+        }
+        if (fanout.empty()) continue;
+        std::sort(fanout.begin(), fanout.end());
+
+        while (firstFree < slots.size() && slots[firstFree].check != Free)
+            ++firstFree;
+        uint32_t base = firstFree > fanout.front() ? uint32_t(firstFree - fanout.front()) : 0;
+        for (;; ++base) {
+            bool fits = true;
+            for (const uint16_t column : fanout) {
+                const std::size_t target = base + column;
+                if (target < slots.size() && slots[target].check != Free) {
+                    fits = false;
+                    break;
+                }
+            }
+            if (fits) break;
+        }
+
+        slots[slot].base = base;
+        const std::size_t needed = std::size_t(base) + fanout.back() + 1;
+        if (slots.size() < needed)
+            slots.resize(needed, Slot {0, Free});
+        for (const auto &[symbol, child] : n.children) {
+            auto it = columnOf.find(symbol);
+            if (it == columnOf.end()) continue;
+            const uint32_t target = base + it->second;
+            slots[target].check = slot;
+            slotOf[child] = target;
+        }
+    }
+    // Offsets must fit next to the length in a slot's base
+    if (outputs.size() >= (std::size_t(1) << 23)) return {};
+
+    const Layout layout(SymbolPages, columns.size() / 256, slots.size(), outputs.size(), sizeof(Slot));
+    std::vector<uint8_t> image(layout.end, 0);
+    Header header {};
+    std::memcpy(header.magic, Magic, sizeof(Magic));
+    header.version = Version;
+    header.columnCount = columnCount;
+    header.columnPages = uint32_t(columns.size() / 256);
+    header.slotCount = uint32_t(slots.size());
+    header.outputLength = uint32_t(outputs.size());
+    header.sequenceCount = sequenceCount;
+    std::memcpy(image.data(), &header, sizeof(header));
+    std::memcpy(image.data() + layout.pages, pages.data(), pages.size() * sizeof(uint16_t));
+    std::memcpy(image.data() + layout.columns, columns.data(), columns.size() * sizeof(uint16_t));
+    std::memcpy(image.data() + layout.slots, slots.data(), slots.size() * sizeof(Slot));
+    std::memcpy(image.data() + layout.outputs, outputs.data(), outputs.size() * sizeof(char32_t));
+    return image;
+}
+
+bool ComposeDfa::attach(const void *data, std::size_t size)
+{
+    detach();
+    if (size < sizeof(Header) || reinterpret_cast<uintptr_t>(data) % 4 != 0) return false;
+    const auto *bytes = static_cast<const uint8_t *>(data);
+    Header header;
+    std::memcpy(&header, bytes, sizeof(header));
+    if (std::memcmp(header.magic, Magic, sizeof(Magic)) != 0 || header.version != Version
+        || header.slotCount == 0 || header.columnPages == 0 || header.columnPages > UINT16_MAX + 1u)
+        return false;
+    const Layout layout(SymbolPages, header.columnPages, header.slotCount, header.outputLength, sizeof(Slot));
+    if (size < layout.end) return false;
+
+    // Everything step() and output() index with is checked once here, so a
+    // damaged cache is rejected instead of read out of bounds
+    const auto *pages = reinterpret_cast<const uint16_t *>(bytes + layout.pages);
+    for (std::size_t i = 0; i < SymbolPages; ++i) {
+        if (pages[i] >= header.columnPages) return false;
+    }
+    const auto *slots = reinterpret_cast<const Slot *>(bytes + layout.slots);
+    for (uint32_t i = 0; i < header.slotCount; ++i) {
+        const uint32_t base = slots[i].base;
+        if ((base & Accepting) && ((base & ~Accepting) >> 8) + (base & 0xff) > header.outputLength)
+            return false;
+    }
+
+    m_pages = pages;
+    m_columns = reinterpret_cast<const uint16_t *>(bytes + layout.columns);
+    m_slots = slots;
+    m_outputs = reinterpret_cast<const char32_t *>(bytes + layout.outputs);
+    m_slotCount = header.slotCount;
+    m_sequenceCount = header.sequenceCount;
+    return true;
+}
+
+void ComposeDfa::detach()
+{
+    m_pages = nullptr;
+    m_columns = nullptr;
+    m_slots = nullptr;
+    m_outputs = nullptr;
+    m_slotCount = 0;
+    m_sequenceCount = 0;
+}
+
+ComposeDfa::State ComposeDfa::step(State state, char32_t symbol) const
+{
+    if (state >= m_slotCount || symbol > MaxSymbol) return NoMatch;
+    const uint32_t base = m_slots[state].base;
+    if (base & Accepting) return NoMatch;
+    const uint16_t column = m_columns[std::size_t(m_pages[symbol >> 8]) * 256 + (symbol & 0xff)];
+    if (!column) return NoMatch;
+    const uint32_t next = base + column;
+    return next < m_slotCount && m_slots[next].check == state ? next : NoMatch;
+}
+
+bool ComposeDfa::accepts(State state) const
+{
+    return state < m_slotCount && (m_slots[state].base & Accepting);
+}
+
+std::u32string_view ComposeDfa::output(State state) const
+{
+    if (!accepts(state)) return {};
+    const uint32_t base = m_slots[state].base & ~Accepting;
+    return std::u32string_view(m_outputs + (base >> 8), base & 0xff);
+}
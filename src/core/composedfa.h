@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Compose sequences (Multi_key and dead-key combinations) compiled to a DFA
+// that resolves one key at a time.
+//
+// Input symbols are codepoints, plus the Compose key and the dead keys just
+// above the Unicode range. A symbol finds its column through a two-level
+// table (256-symbol pages; pages without symbols share one zero page) and a
+// transition is base[state] + column, confirmed by check[] — a double-array
+// trie, so a step is a handful of array reads however large the table is.
+// Accepting states carry their output in place of a base.
+//
+// Builder produces one flat image (native endian); attach() validates it
+// and reads it in place, so a cached image is mapped rather than parsed:
+//   Header { "OSKC", version, counts }
+//   uint16_t page[SymbolPages]          column page of each symbol page
+//   uint16_t column[columnPages * 256]  0 for symbols no sequence uses
+//   Slot slot[slotCount]                slot 0 is the start state
+//   char32_t output[outputLength]
+class ComposeDfa
+{
+public:
+    static constexpr char32_t ComposeKey = 0x110000;   // Multi_key
+    static constexpr char32_t MaxSymbol = ComposeKey + 0xff;
+    // Dead keys are numbered from 1 by keysym, dead_grave (0xfe50) first;
+    // 0 for keysyms outside the dead-key block
+    static constexpr uint8_t deadKeyIndex(uint32_t keysym)
+    {
+        return keysym >= 0xfe50 && keysym < 0xfea0 ? uint8_t(keysym - 0xfe50 + 1) : 0;
+    }
+    static constexpr char32_t deadKey(uint8_t index) { return ComposeKey + index; }
+
+    using State = uint32_t;
+    static constexpr State Start = 0;
+    static constexpr State NoMatch = UINT32_MAX;
+
+    class Builder
+    {
+    public:
+        // Later definitions win, as in Compose files: a sequence replaces
+        // one that is a prefix of it, and vice versa. Outputs longer than
+        // MaxOutput are ignored.
+        void add(std::span<const char32_t> symbols, std::u32string_view output);
+        std::vector<uint8_t> build() const;
+
+    private:
+        struct Node {
+            std::vector<std::pair<char32_t, uint32_t>> children;
+            std::u32string output;   // set on accepting nodes
+        };
+        std::vector<Node> m_nodes {Node {}};   // node 0 is the start
+    };
+
+    static constexpr std::size_t MaxOutput = 0xff;
+
+    // Reads an image in place; data must stay valid and 4-byte aligned
+    bool attach(const void *data, std::size_t size);
+    void detach();
+    bool isAttached() const { return m_slots != nullptr; }
+    std::size_t sequenceCount() const { return m_sequenceCount; }
+
+    // Next state after symbol, or NoMatch when no sequence continues so
+    State step(State state, char32_t symbol) const;
+    bool accepts(State state) const;
+    // What an accepting state types; empty for other states
+    std::u32string_view output(State state) const;
+
+private:
+    struct Slot {
+        uint32_t base;    // Accepting | offset << 8 | length on accepting states
+        uint32_t check;   // state the slot is a transition of, or Free
+    };
+    static constexpr uint32_t Accepting = 1u << 31;
+    static constexpr uint32_t Free = UINT32_MAX;
+    static constexpr std::size_t SymbolPages = (MaxSymbol >> 8) + 1;
+    static constexpr uint32_t Version = 1;
+
+    const uint16_t *m_pages = nullptr;
+    const uint16_t *m_columns = nullptr;
+    const Slot *m_slots = nullptr;
+    const char32_t *m_outputs = nullptr;
+    uint32_t m_slotCount = 0;
+    uint32_t m_sequenceCount = 0;
+};
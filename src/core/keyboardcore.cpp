@@ -0,0 +1,63 @@
+#include "keyboardcore.h"
+
+#include <linux/input-event-codes.h>
+
+char16_t KeyboardCore::character(int keyCode) const
+{
+    return m_keys ? m_keys->unit(keyCode, m_modifiers.shiftLevel()) : 0;
+}
+
+KeyboardCore::Press KeyboardCore::press(int keyCode)
+{
+    Press press;
+    press.sendMask = m_modifiers.activeMask();
+    press.plain = m_modifiers.isPlain();
+
+    if (!press.plain) {
+        // Modifier combo — not regular typing
+        resetBuffer();
+        press.buffer = BufferChange::Reset;
+    } else if (keyCode == KEY_BACKSPACE) {
+        if (!m_buffer.isEmpty())
+            m_buffer.chop();
+        else
+            m_buffer.setAtWordStart(false);
+        press.buffer = BufferChange::Chopped;
+    } else if (keyCode == KEY_SPACE || keyCode == KEY_ENTER || keyCode == KEY_TAB) {
+        resetBuffer(true);
+        press.buffer = BufferChange::Reset;
+    } else if (keyCode == KEY_ESC) {
+        resetBuffer();
+        press.buffer = BufferChange::Reset;
+    } else if (const char16_t c = character(keyCode)) {
+        m_buffer.append(c);
+        press.buffer = BufferChange::Appended;
+    }
+    return press;
+}
+
+void KeyboardCore::resetBuffer(bool atWordStart)
+{
+    m_buffer.clear();
+    m_buffer.setAtWordStart(atWordStart);
+}
+
+std::optional<KeyboardCore::TriggerMatch> KeyboardCore::matchTrigger() const
+{
+    if (m_buffer.isEmpty()) return std::nullopt;
+    return matchTrigger(m_buffer.view());
+}
+
+std::optional<KeyboardCore::TriggerMatch> KeyboardCore::matchTrigger(std::u16string_view text) const
+{
+    std::optional<TriggerMatch> found;
+    if (m_triggers) {
+        if (const auto match = m_triggers->match(text))
+            found = TriggerMatch{match->id, match->length, false};
+    }
+    if (m_scopedTriggers) {
+        if (const auto match = m_scopedTriggers->match(text); match && (!found || match->length >= found->length))
+            found = TriggerMatch{match->id, match->length, true};
+    }
+    return found;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+#include "keytable.h"
+#include "modifierstate.h"
+#include "triggertable.h"
+#include "typebuffer.h"
+
+// The state machine behind a key press, without Qt and without allocating:
+// modifier state, the type buffer and trigger matching over the current
+// layout's KeyTable.
+//
+// KeyboardController owns one and adapts it to QML properties, the uinput
+// device and the timers; everything it decides per key lives here.
+class KeyboardCore
+{
+public:
+    // What a press did to the type buffer
+    enum class BufferChange : uint8_t {
+        None,
+        Appended,   // a character was typed
+        Chopped,    // backspace
+        Reset,      // separator, Esc or a modifier combination
+    };
+
+    struct Press {
+        uint16_t sendMask = 0;     // ModifierState bits to hold for the key
+        bool plain = true;         // regular typing (see ModifierState::isPlain)
+        BufferChange buffer = BufferChange::None;
+    };
+
+    ModifierState &modifiers() { return m_modifiers; }
+    const ModifierState &modifiers() const { return m_modifiers; }
+    TypeBuffer &buffer() { return m_buffer; }
+    const TypeBuffer &buffer() const { return m_buffer; }
+
+    // A trigger found in the global table or in the scoped one
+    struct TriggerMatch {
+        uint32_t id;
+        std::size_t length;
+        bool scoped;
+    };
+
+    // All are borrowed and must outlive the core (or be replaced first).
+    // Scoped triggers are the focused window's own, checked after the
+    // global ones: the longer match wins, the scoped one on a tie.
+    void setKeyTable(const KeyTable *table) { m_keys = table; }
+    void setTriggers(const TriggerTable *global, const TriggerTable *scoped = nullptr)
+    {
+        m_triggers = global;
+        m_scopedTriggers = scoped;
+    }
+
+    // Character a key types at the current shift level, or 0
+    char16_t character(int keyCode) const;
+
+    // Updates the buffer for a key about to be sent. One-shot modifiers are
+    // left for the caller to end once the key is out.
+    Press press(int keyCode);
+    // Drops the buffer, e.g. after a pause or an expansion
+    void resetBuffer(bool atWordStart = false);
+
+    // Trigger ending the buffer, or text
+    std::optional<TriggerMatch> matchTrigger() const;
+    std::optional<TriggerMatch> matchTrigger(std::u16string_view text) const;
+
+private:
+    ModifierState m_modifiers;
+    TypeBuffer m_buffer;
+    const KeyTable *m_keys = nullptr;
+    const TriggerTable *m_triggers = nullptr;
+    const TriggerTable *m_scopedTriggers = nullptr;
+};
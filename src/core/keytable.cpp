@@ -0,0 +1,71 @@
+#include "keytable.h"
+
+#include <algorithm>
+#include <linux/input-event-codes.h>
+
+void KeyTable::clear()
+{
+    m_chars.fill(0);
+    m_deadKeys.fill(0);
+}
+
+char32_t KeyTable::character(int keyCode, uint8_t level) const
+{
+    if (keyCode <= 0 || keyCode >= KeyCount) return 0;
+    return m_chars[keyCode * Levels + (level & (Shift | AltGr))];
+}
+
+uint8_t KeyTable::deadKey(int keyCode, uint8_t level) const
+{
+    if (keyCode <= 0 || keyCode >= KeyCount) return 0;
+    return m_deadKeys[keyCode * Levels + (level & (Shift | AltGr))];
+}
+
+char16_t KeyTable::unit(int keyCode, bool shift) const
+{
+    const char32_t c = character(keyCode, shift ? Shift : 0);
+    return isPrintable(c) && c < 0x10000 ? char16_t(c) : 0;
+}
+
+int KeyTable::find(char32_t ch, uint8_t *level) const
+{
+    uint16_t stroke = NoStroke;
+    if (ch < FlatCodepoints) {
+        stroke = m_strokes[ch];
+    } else {
+        auto it = std::lower_bound(m_extraStrokes.begin(), m_extraStrokes.end(), ch,
+                                   [](const auto &entry, char32_t c) { return entry.first < c; });
+        if (it != m_extraStrokes.end() && it->first == ch)
+            stroke = it->second;
+    }
+    if (stroke == NoStroke) return -1;
+    if (level) *level = uint8_t(stroke >> 8);
+    return stroke & 0xff;
+}
+
+// The lowest level wins, then the lowest keycode, so digits come from the
+// number row and plain keys beat shifted ones
+void KeyTable::index()
+{
+    m_strokes.fill(NoStroke);
+    m_extraStrokes.clear();
+    for (int level = 0; level < Levels; ++level) {
+        for (int code = 1; code < KeyCount; ++code) {
+            const char32_t c = m_chars[code * Levels + level];
+            if (!isPrintable(c) && c != U'\t') continue;
+            const uint16_t stroke = uint16_t(code | level << 8);
+            if (c < FlatCodepoints) {
+                if (m_strokes[c] == NoStroke) m_strokes[c] = stroke;
+            } else {
+                m_extraStrokes.emplace_back(c, stroke);
+            }
+        }
+    }
+    // Stable, so the first stroke found above stays first among equals
+    std::stable_sort(m_extraStrokes.begin(), m_extraStrokes.end(),
+                     [](const auto &a, const auto &b) { return a.first < b.first; });
+    m_extraStrokes.erase(std::unique(m_extraStrokes.begin(), m_extraStrokes.end(),
+                                     [](const auto &a, const auto &b) { return a.first == b.first; }),
+                         m_extraStrokes.end());
+    m_strokes[U'\n'] = KEY_ENTER;
+}
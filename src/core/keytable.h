@@ -0,0 +1,48 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Keycode × level → codepoint, and codepoint → keycode + level, for one
+// compiled layout. Filled by KeyMap; lookups are a table index.
+//
+// The reverse direction is a direct array for the first 2K codepoints and
+// a sorted vector above, built once by index() so that no lookup allocates.
+class KeyTable
+{
+public:
+    static constexpr int KeyCount = 256;
+    static constexpr int Levels = 4;               // none, Shift, AltGr, both
+    // Level bits, as in KeyMap::Modifier
+    static constexpr uint8_t Shift = 1u << 0;
+    static constexpr uint8_t AltGr = 1u << 1;
+
+    static bool isPrintable(char32_t c) { return c >= 0x20 && c != 0x7f; }
+
+    void set(int keyCode, int level, char32_t c) { m_chars[keyCode * Levels + level] = c; }
+    // Dead keys type nothing themselves; index as ComposeDfa::deadKeyIndex
+    void setDeadKey(int keyCode, int level, uint8_t index) { m_deadKeys[keyCode * Levels + level] = index; }
+    void clear();
+    // Rebuilds the reverse tables after the characters changed
+    void index();
+
+    // Codepoint at a level (Shift/AltGr bits), or 0
+    char32_t character(int keyCode, uint8_t level) const;
+    // Dead key at a level, or 0
+    uint8_t deadKey(int keyCode, uint8_t level) const;
+    // Printable BMP character a key types, or 0
+    char16_t unit(int keyCode, bool shift) const;
+    // Keycode producing ch (setting *level), or -1
+    int find(char32_t ch, uint8_t *level) const;
+
+private:
+    static constexpr int FlatCodepoints = 0x800;
+    static constexpr uint16_t NoStroke = 0xffff;   // keycode | level << 8
+
+    std::array<char32_t, KeyCount * Levels> m_chars {};
+    std::array<uint8_t, KeyCount * Levels> m_deadKeys {};
+    std::array<uint16_t, FlatCodepoints> m_strokes {};
+    std::vector<std::pair<char32_t, uint16_t>> m_extraStrokes;   // sorted by codepoint
+};
@@ -0,0 +1,43 @@
+#include "modifierstate.h"
+
+void ModifierState::toggle(Modifier modifier)
+{
+    if (m_locked & modifier) {
+        m_active &= ~modifier;
+        m_locked &= ~modifier;
+    } else if (m_active & modifier) {
+        m_locked |= modifier;
+    } else {
+        m_active |= modifier;
+    }
+}
+
+void ModifierState::toggleCapsLock()
+{
+    m_capsLock = !m_capsLock;
+}
+
+uint16_t ModifierState::activeMask() const
+{
+    return m_active | (m_capsLock ? Shift : 0);
+}
+
+uint16_t ModifierState::lockedMask() const
+{
+    return m_locked | (m_capsLock ? Shift : 0);
+}
+
+uint16_t ModifierState::consumeOneShot()
+{
+    const uint16_t ended = m_active & ~m_locked;
+    m_active = m_locked;
+    return ended;
+}
+
+uint16_t ModifierState::clear()
+{
+    const uint16_t changed = m_active | (m_capsLock ? CapsLock : 0);
+    m_active = m_locked = 0;
+    m_capsLock = false;
+    return changed;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+
+// One-shot / locked modifier state of the on-screen keyboard.
+//
+// Tapping a modifier cycles off → one-shot → locked → off; a one-shot
+// modifier applies to the next key only. Caps Lock is separate and is typed
+// as a held Shift. Masks use the same bits as recorded macros.
+class ModifierState
+{
+public:
+    enum Modifier : uint16_t {
+        Shift    = 1 << 10,
+        Ctrl     = 1 << 11,
+        Alt      = 1 << 12,
+        Meta     = 1 << 13,
+        // Only reported in change masks; never part of a send mask
+        CapsLock = 1 << 14,
+    };
+    static constexpr uint16_t Modifiers = Shift | Ctrl | Alt | Meta;
+
+    bool isActive(Modifier modifier) const { return m_active & modifier; }
+    bool isLocked(Modifier modifier) const { return m_locked & modifier; }
+    bool capsLock() const { return m_capsLock; }
+    // Letters come out in upper case
+    bool shiftLevel() const { return (m_active & Shift) || m_capsLock; }
+    // No Ctrl, Alt or Meta: the key is regular typing
+    bool isPlain() const { return !(m_active & (Ctrl | Alt | Meta)); }
+
+    void toggle(Modifier modifier);
+    void toggleCapsLock();
+
+    // Modifiers to hold while a key is sent, and between keys
+    uint16_t activeMask() const;
+    uint16_t lockedMask() const;
+
+    // Ends one-shot modifiers after a key; returns the ones that changed
+    uint16_t consumeOneShot();
+    // Drops everything, locks included; returns what changed
+    uint16_t clear();
+
+private:
+    uint16_t m_active = 0;
+    uint16_t m_locked = 0;   // subset of m_active
+    bool m_capsLock = false;
+};
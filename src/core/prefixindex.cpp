@@ -0,0 +1,124 @@
+#include "prefixindex.h"
+
+#include <algorithm>
+#include <bit>
+
+std::size_t PrefixIndex::lowerBound(std::u16string_view text) const
+{
+    return std::size_t(std::lower_bound(m_entries.begin(), m_entries.end(), text,
+                                        [](const Entry &entry, std::u16string_view t) { return entry.trigger < t; })
+                       - m_entries.begin());
+}
+
+std::size_t PrefixIndex::find(std::u16string_view trigger) const
+{
+    const std::size_t i = lowerBound(trigger);
+    return i < m_entries.size() && m_entries[i].trigger == trigger ? i : m_entries.size();
+}
+
+uint32_t PrefixIndex::better(uint32_t a, uint32_t b) const
+{
+    if (a == NoEntry) return b;
+    if (b == NoEntry) return a;
+    const uint32_t ua = m_entries[a].uses, ub = m_entries[b].uses;
+    return ua > ub || (ua == ub && a < b) ? a : b;
+}
+
+void PrefixIndex::rebuildTree()
+{
+    m_leaves = std::bit_ceil(std::max<std::size_t>(1, m_entries.size()));
+    m_tree.assign(2 * m_leaves, NoEntry);
+    for (std::size_t i = 0; i < m_entries.size(); ++i)
+        m_tree[m_leaves + i] = uint32_t(i);
+    for (std::size_t node = m_leaves - 1; node > 0; --node)
+        m_tree[node] = better(m_tree[2 * node], m_tree[2 * node + 1]);
+}
+
+void PrefixIndex::add(std::u16string_view trigger, uint32_t uses)
+{
+    if (trigger.empty()) return;
+    const std::size_t i = lowerBound(trigger);
+    if (i < m_entries.size() && m_entries[i].trigger == trigger) {
+        ++m_entries[i].refs;
+        return;
+    }
+    m_entries.insert(m_entries.begin() + i, Entry {trigger, uses, 1});
+    rebuildTree();
+}
+
+void PrefixIndex::add(std::span<const Item> items)
+{
+    const std::size_t sorted = m_entries.size();
+    m_entries.reserve(sorted + items.size());
+    for (const Item &item : items) {
+        if (!item.trigger.empty())
+            m_entries.push_back({item.trigger, item.uses, 1});
+    }
+    auto byTrigger = [](const Entry &a, const Entry &b) { return a.trigger < b.trigger; };
+    std::stable_sort(m_entries.begin() + sorted, m_entries.end(), byTrigger);
+    std::inplace_merge(m_entries.begin(), m_entries.begin() + sorted, m_entries.end(), byTrigger);
+
+    // Fold duplicates into the first of each run
+    auto out = m_entries.begin();
+    for (auto it = m_entries.begin(); it != m_entries.end(); ++it) {
+        if (out != m_entries.begin() && (out - 1)->trigger == it->trigger)
+            (out - 1)->refs += it->refs;
+        else if (out++ != it)
+            *(out - 1) = *it;
+    }
+    m_entries.erase(out, m_entries.end());
+    rebuildTree();
+}
+
+void PrefixIndex::remove(std::u16string_view trigger)
+{
+    const std::size_t i = find(trigger);
+    if (i == m_entries.size()) return;
+    if (--m_entries[i].refs > 0) return;
+    m_entries.erase(m_entries.begin() + i);
+    rebuildTree();
+}
+
+void PrefixIndex::clear()
+{
+    m_entries.clear();
+    m_tree.clear();
+    m_leaves = 0;
+}
+
+void PrefixIndex::setUses(std::u16string_view trigger, uint32_t uses)
+{
+    const std::size_t i = find(trigger);
+    if (i == m_entries.size()) return;
+    m_entries[i].uses = uses;
+    for (std::size_t node = (m_leaves + i) / 2; node > 0; node /= 2)
+        m_tree[node] = better(m_tree[2 * node], m_tree[2 * node + 1]);
+}
+
+std::size_t PrefixIndex::cover(std::size_t first, std::size_t last, uint32_t *frontier) const
+{
+    std::size_t size = 0;
+    for (std::size_t l = first + m_leaves, r = last + m_leaves; l < r; l /= 2, r /= 2) {
+        if (l & 1) push(frontier, size, uint32_t(l++));
+        if (r & 1) push(frontier, size, uint32_t(--r));
+    }
+    return size;
+}
+
+// The frontier is a binary heap ordered by each node's best entry
+void PrefixIndex::push(uint32_t *frontier, std::size_t &size, uint32_t node) const
+{
+    if (m_tree[node] == NoEntry) return;
+    frontier[size++] = node;
+    std::push_heap(frontier, frontier + size, [this](uint32_t a, uint32_t b) {
+        return better(m_tree[a], m_tree[b]) == m_tree[b];
+    });
+}
+
+uint32_t PrefixIndex::popBest(uint32_t *frontier, std::size_t &size) const
+{
+    std::pop_heap(frontier, frontier + size, [this](uint32_t a, uint32_t b) {
+        return better(m_tree[a], m_tree[b]) == m_tree[b];
+    });
+    return frontier[--size];
+}
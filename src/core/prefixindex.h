@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <vector>
+
+// Triggers sorted by text, for suggesting shortcuts while their trigger is
+// still being typed.
+//
+// Every trigger starting with a prefix sits in one contiguous run, found by
+// binary search. A max tree over the use counts then yields the most used
+// entries of the run best first, so a one-character prefix costs the same
+// as a long one however many triggers share it.
+//
+// Adding or removing a trigger inserts or erases one entry in place, which
+// moves the entries after it, so the tree is rebuilt over the new
+// positions: linear in the number of triggers, without re-sorting. A use
+// count change refreshes only its leaf-to-root path. Bulk loads are sorted
+// once. The same trigger may be added more than once (e.g. in several
+// scopes); it stays until removed as often, and only its first add and
+// last remove touch the tree. Trigger text is referenced, not copied, and
+// must stay valid while its entry is here. complete() does not allocate.
+class PrefixIndex
+{
+public:
+    struct Item {
+        std::u16string_view trigger;
+        uint32_t uses = 0;
+    };
+    using Candidate = Item;
+
+    void add(std::u16string_view trigger, uint32_t uses);
+    // Many at once (loading, imports): one sort instead of an insert each
+    void add(std::span<const Item> items);
+    void remove(std::u16string_view trigger);
+    void clear();
+    std::size_t size() const { return m_entries.size(); }
+
+    void setUses(std::u16string_view trigger, uint32_t uses);
+
+    // Fills out with the triggers that extend prefix, most used first (then
+    // alphabetically), skipping those accept() rejects; returns how many
+    template <typename Accept>
+    std::size_t complete(std::u16string_view prefix, std::span<Candidate> out, Accept &&accept) const;
+
+private:
+    static constexpr uint32_t NoEntry = UINT32_MAX;
+    // Nodes waiting in a search; a search gives up when it runs out
+    static constexpr std::size_t Frontier = 256;
+
+    struct Entry {
+        std::u16string_view trigger;
+        uint32_t uses = 0;
+        uint32_t refs = 0;
+    };
+
+    std::size_t lowerBound(std::u16string_view text) const;
+    std::size_t find(std::u16string_view trigger) const;
+    // Entry ahead of the other: more uses, then earlier
+    uint32_t better(uint32_t a, uint32_t b) const;
+    // Every node, after entries moved: O(n)
+    void rebuildTree();
+
+    // Top-level nodes covering [first, last), into frontier; returns the count
+    std::size_t cover(std::size_t first, std::size_t last, uint32_t *frontier) const;
+    // Pops the node whose best entry ranks highest
+    uint32_t popBest(uint32_t *frontier, std::size_t &size) const;
+    void push(uint32_t *frontier, std::size_t &size, uint32_t node) const;
+
+    std::vector<Entry> m_entries;   // sorted by trigger
+    std::vector<uint32_t> m_tree;   // best entry per node; leaves from m_leaves
+    std::size_t m_leaves = 0;
+};
+
+template <typename Accept>
+std::size_t PrefixIndex::complete(std::u16string_view prefix, std::span<Candidate> out, Accept &&accept) const
+{
+    if (prefix.empty() || out.empty() || m_entries.empty()) return 0;
+    std::size_t first = lowerBound(prefix);
+    std::size_t last = first;
+    // The run ends where the prefix stops matching: binary search again
+    for (std::size_t step = m_entries.size() - first; step > 0;) {
+        const std::size_t half = step / 2;
+        if (m_entries[last + half].trigger.starts_with(prefix)) {
+            last += half + 1;
+            step -= half + 1;
+        } else {
+            step = half;
+        }
+    }
+    // The prefix itself has been typed in full; only longer triggers help
+    if (first < last && m_entries[first].trigger.size() == prefix.size())
+        ++first;
+    if (first >= last) return 0;
+
+    uint32_t frontier[Frontier];
+    std::size_t size = cover(first, last, frontier);
+    std::size_t count = 0;
+    while (count < out.size() && size > 0) {
+        const uint32_t node = popBest(frontier, size);
+        if (node >= m_leaves) {
+            const Entry &entry = m_entries[node - m_leaves];
+            if (accept(entry.trigger))
+                out[count++] = {entry.trigger, entry.uses};
+            continue;
+        }
+        if (size + 2 > Frontier) break;
+        push(frontier, size, 2 * node);
+        push(frontier, size, 2 * node + 1);
+    }
+    return count;
+}
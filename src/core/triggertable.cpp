@@ -0,0 +1,114 @@
+#include "triggertable.h"
+
+#include <algorithm>
+#include <functional>
+
+uint32_t TriggerTable::hash(std::u16string_view text)
+{
+    // FNV-1a over UTF-16 code units
+    uint32_t h = 2166136261u;
+    for (const char16_t c : text) {
+        h = (h ^ (c & 0xff)) * 16777619u;
+        h = (h ^ (c >> 8)) * 16777619u;
+    }
+    return h;
+}
+
+std::size_t TriggerTable::probe(std::u16string_view text, uint32_t h) const
+{
+    const std::size_t mask = m_slots.size() - 1;
+    for (std::size_t i = h & mask;; i = (i + 1) & mask) {
+        const Slot &slot = m_slots[i];
+        if (slot.length == 0 || (slot.hash == h && trigger(slot) == text))
+            return i;
+    }
+}
+
+void TriggerTable::grow()
+{
+    std::vector<Slot> old = std::move(m_slots);
+    m_slots.assign(std::max<std::size_t>(16, old.size() * 2), Slot());
+    const std::size_t mask = m_slots.size() - 1;
+    for (const Slot &slot : old) {
+        if (slot.length == 0) continue;
+        std::size_t i = slot.hash & mask;
+        while (m_slots[i].length != 0)
+            i = (i + 1) & mask;
+        m_slots[i] = slot;
+    }
+}
+
+void TriggerTable::insert(std::u16string_view trigger, uint32_t id)
+{
+    if (trigger.empty()) return;
+    if ((m_count + 1) * 2 > m_slots.size())
+        grow();
+
+    const uint32_t h = hash(trigger);
+    Slot &slot = m_slots[probe(trigger, h)];
+    if (slot.length != 0) {
+        slot.text = trigger.data();
+        slot.id = id;
+        return;
+    }
+    slot = {trigger.data(), uint32_t(trigger.size()), h, id};
+    ++m_count;
+
+    const uint32_t length = uint32_t(trigger.size());
+    auto it = std::lower_bound(m_lengths.begin(), m_lengths.end(), length, std::greater<uint32_t>());
+    const std::size_t k = std::size_t(it - m_lengths.begin());
+    if (it == m_lengths.end() || *it != length) {
+        m_lengths.insert(it, length);
+        m_lengthCounts.insert(m_lengthCounts.begin() + std::ptrdiff_t(k), 0);
+    }
+    ++m_lengthCounts[k];
+}
+
+void TriggerTable::remove(std::u16string_view trigger)
+{
+    if (m_count == 0 || trigger.empty()) return;
+    std::size_t hole = probe(trigger, hash(trigger));
+    if (m_slots[hole].length == 0) return;
+    const uint32_t length = m_slots[hole].length;
+
+    // Later slots of the probe run move back into the hole when their home
+    // slot lies at or before it, so no lookup stops short of them
+    const std::size_t mask = m_slots.size() - 1;
+    for (std::size_t i = (hole + 1) & mask; m_slots[i].length != 0; i = (i + 1) & mask) {
+        const std::size_t home = m_slots[i].hash & mask;
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            m_slots[hole] = m_slots[i];
+            hole = i;
+        }
+    }
+    m_slots[hole] = Slot();
+    --m_count;
+
+    auto it = std::lower_bound(m_lengths.begin(), m_lengths.end(), length, std::greater<uint32_t>());
+    const std::size_t k = std::size_t(it - m_lengths.begin());
+    if (--m_lengthCounts[k] == 0) {
+        m_lengths.erase(it);
+        m_lengthCounts.erase(m_lengthCounts.begin() + std::ptrdiff_t(k));
+    }
+}
+
+void TriggerTable::clear()
+{
+    m_slots.clear();
+    m_lengths.clear();
+    m_lengthCounts.clear();
+    m_count = 0;
+}
+
+std::optional<TriggerTable::Match> TriggerTable::match(std::u16string_view text) const
+{
+    if (m_count == 0) return std::nullopt;
+    for (const uint32_t length : m_lengths) {
+        if (length > text.size()) continue;
+        const std::u16string_view tail = text.substr(text.size() - length);
+        const Slot &slot = m_slots[probe(tail, hash(tail))];
+        if (slot.length != 0)
+            return Match {slot.id, length};
+    }
+    return std::nullopt;
+}
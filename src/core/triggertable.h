@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+// Trigger text → id lookup for shortcut expansion.
+//
+// Triggers are indexed by an open-addressing hash table; the distinct
+// trigger lengths are kept longest first, so matching the end of the type
+// buffer costs one probe per distinct length and the longest trigger wins.
+// Trigger text is not copied: it stays where its owner keeps it (the
+// shortcut library's mapping) and must outlive its entry here. Edits change
+// the table in place (removal shifts the probe run back, so there are no
+// tombstones); they may allocate, match() does not.
+class TriggerTable
+{
+public:
+    struct Match {
+        uint32_t id;
+        std::size_t length;
+    };
+
+    // A later insert of the same trigger replaces its id, and the text it
+    // refers to
+    void insert(std::u16string_view trigger, uint32_t id);
+    void remove(std::u16string_view trigger);
+    void clear();
+    bool isEmpty() const { return m_count == 0; }
+
+    // Trigger that ends text
+    std::optional<Match> match(std::u16string_view text) const;
+
+private:
+    struct Slot {
+        const char16_t *text = nullptr;
+        uint32_t length = 0;   // 0: empty slot
+        uint32_t hash = 0;
+        uint32_t id = 0;
+    };
+
+    static uint32_t hash(std::u16string_view text);
+    static std::u16string_view trigger(const Slot &slot) { return {slot.text, slot.length}; }
+    // Slot holding text, or the empty slot where it would go
+    std::size_t probe(std::u16string_view text, uint32_t h) const;
+    void grow();
+
+    std::vector<Slot> m_slots;      // power-of-two size, at most half full
+    std::vector<uint32_t> m_lengths;   // distinct trigger lengths, descending
+    std::vector<uint32_t> m_lengthCounts;   // triggers of each length
+    std::size_t m_count = 0;
+};
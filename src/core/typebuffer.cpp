@@ -0,0 +1,37 @@
+#include "typebuffer.h"
+
+#include <algorithm>
+
+void TypeBuffer::makeRoom(std::size_t n)
+{
+    if (m_size + n <= Capacity) return;
+    const std::size_t keep = std::min({m_size, Capacity / 2, Capacity - n});
+    std::copy(m_chars.begin() + (m_size - keep), m_chars.begin() + m_size, m_chars.begin());
+    m_size = keep;
+    m_atWordStart = false;
+}
+
+void TypeBuffer::append(char16_t c)
+{
+    makeRoom(1);
+    m_chars[m_size++] = c;
+}
+
+void TypeBuffer::append(std::u16string_view text)
+{
+    if (text.size() > Capacity)
+        text = text.substr(text.size() - Capacity);
+    makeRoom(text.size());
+    std::copy(text.begin(), text.end(), m_chars.begin() + m_size);
+    m_size += text.size();
+}
+
+void TypeBuffer::chop(std::size_t n)
+{
+    m_size -= std::min(n, m_size);
+}
+
+void TypeBuffer::clear()
+{
+    m_size = 0;
+}
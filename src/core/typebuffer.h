@@ -0,0 +1,37 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <string_view>
+
+// The text typed since the last word boundary or pause, matched against
+// shortcut triggers and used for completion and autocorrect.
+//
+// Fixed storage: when it fills up the older half is dropped, which only
+// ever loses text longer than any trigger or word.
+class TypeBuffer
+{
+public:
+    static constexpr std::size_t Capacity = 128;
+
+    std::u16string_view view() const { return {m_chars.data(), m_size}; }
+    bool isEmpty() const { return m_size == 0; }
+    std::size_t size() const { return m_size; }
+    bool endsWith(std::u16string_view text) const { return view().ends_with(text); }
+
+    void append(char16_t c);
+    void append(std::u16string_view text);
+    void chop(std::size_t n = 1);
+    void clear();
+
+    // The buffer began right after a separator, so its first word is whole
+    bool atWordStart() const { return m_atWordStart; }
+    void setAtWordStart(bool atWordStart) { m_atWordStart = atWordStart; }
+
+private:
+    void makeRoom(std::size_t n);
+
+    std::array<char16_t, Capacity> m_chars {};
+    std::size_t m_size = 0;
+    bool m_atWordStart = false;
+};
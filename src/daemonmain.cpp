@@ -0,0 +1,22 @@
+#include <QCoreApplication>
+
+#include "injectiondaemon.h"
+#include "tracer.h"
+
+// osk-daemon: keeps the uinput device alive independently of the UI.
+// Deliberately free of GUI libraries (QtCore, QtNetwork, QtDBus) so it
+// stays small while resident.
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    app.setOrganizationName(QStringLiteral("osk"));
+    app.setApplicationName(QStringLiteral("osk-daemon"));
+    Tracer::initFromEnvironment();
+
+    InjectionDaemon daemon;
+    if (!daemon.listen()) {
+        qInfo("osk-daemon is already running");
+        return 0;
+    }
+    return app.exec();
+}
@@ -0,0 +1,45 @@
+#include "flickrecognizer.h"
+
+#include <algorithm>
+#include <cmath>
+
+void FlickRecognizer::begin(QPointF pos, int64_t timeMs, double keyHeight)
+{
+    m_origin = pos;
+    m_minDistance = keyHeight * MinDistance;
+    m_active = true;
+    m_history[0] = {pos, timeMs};
+    m_count = 1;
+}
+
+void FlickRecognizer::reset()
+{
+    m_active = false;
+}
+
+FlickRecognizer::Direction FlickRecognizer::update(QPointF pos, int64_t timeMs)
+{
+    if (!m_active) return None;
+    m_history[m_count % HistorySize] = {pos, timeMs};
+    ++m_count;
+
+    const double dx = pos.x() - m_origin.x();
+    const double dy = pos.y() - m_origin.y();
+    if (std::abs(dy) < m_minDistance || std::abs(dy) < std::abs(dx) * Verticality)
+        return None;
+
+    // Oldest sample still inside the velocity window
+    const int oldest = m_count > HistorySize ? m_count - HistorySize : 0;
+    const Sample *from = &m_history[(m_count - 1) % HistorySize];
+    for (int i = m_count - 2; i >= oldest; --i) {
+        const Sample &s = m_history[i % HistorySize];
+        if (timeMs - s.timeMs > VelocityWindowMs) break;
+        from = &s;
+    }
+    const int64_t elapsed = std::max<int64_t>(timeMs - from->timeMs, 1);
+    const double velocity = std::abs(pos.y() - from->pos.y()) / double(elapsed);
+    if (velocity < MinVelocity) return None;
+
+    m_active = false;
+    return dy < 0 ? Up : Down;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <QPointF>
+#include <array>
+#include <cstdint>
+
+// Per-key flick recognizer.
+//
+// Fed the pointer samples of one key press, it decides at most once whether
+// the press became a vertical flick. A flick needs to travel a fraction of
+// the key height, move fast enough over the last few samples (a slow drag
+// is not a flick), and stay mostly vertical.
+class FlickRecognizer
+{
+public:
+    enum Direction : uint8_t { None, Up, Down };
+
+    // Fraction of the key height a flick must cover
+    static constexpr double MinDistance = 0.35;
+    // Pixels per millisecond over the velocity window
+    static constexpr double MinVelocity = 0.3;
+    static constexpr int64_t VelocityWindowMs = 60;
+    // |dy| must exceed |dx| by this factor
+    static constexpr double Verticality = 1.5;
+
+    void begin(QPointF pos, int64_t timeMs, double keyHeight);
+    // Direction of the flick once it is recognised, None otherwise (and on
+    // every later sample)
+    Direction update(QPointF pos, int64_t timeMs);
+    void reset();
+
+private:
+    struct Sample {
+        QPointF pos;
+        int64_t timeMs;
+    };
+    static constexpr int HistorySize = 8;
+
+    QPointF m_origin;
+    double m_minDistance = 0;
+    bool m_active = false;
+    std::array<Sample, HistorySize> m_history {};
+    int m_count = 0;      // samples recorded, including the press
+};
@@ -0,0 +1,94 @@
+#include "injectiondaemon.h"
+#include "injectionprotocol.h"
+#include "keymap.h"
+#include "tracer.h"
+#include "typeserver.h"
+#include "virtualkeyboard.h"
+
+#include <QLocalServer>
+#include <QLocalSocket>
+
+using namespace InjectionProtocol;
+
+InjectionDaemon::InjectionDaemon(QObject *parent)
+    : QObject(parent)
+    , m_vk(new VirtualKeyboard(VirtualKeyboard::Backend::Local, this))
+    , m_keymap(new KeyMap(this))
+    , m_server(new QLocalServer(this))
+    , m_typeServer(new TypeServer(m_vk, m_keymap, this))
+{
+    connect(m_server, &QLocalServer::newConnection, this, &InjectionDaemon::acceptClients);
+}
+
+InjectionDaemon::~InjectionDaemon()
+{
+    const auto clients = m_held.keys();
+    for (QLocalSocket *client : clients)
+        dropClient(client);
+}
+
+bool InjectionDaemon::listen()
+{
+    const QString path = injectionSocketPath();
+    if (!listenExclusive(m_server, path))
+        return false;
+    qInfo("Injection daemon listening on %s", qPrintable(path));
+    if (m_typeServer->listen())
+        qInfo("Text injection listening on %s", qPrintable(typeSocketPath()));
+    return true;
+}
+
+VirtualKeyboard *InjectionDaemon::keyboard() const { return m_vk; }
+
+void InjectionDaemon::acceptClients()
+{
+    while (QLocalSocket *client = m_server->nextPendingConnection()) {
+        m_held.insert(client, {});
+        connect(client, &QLocalSocket::readyRead, this, [this, client]() { readClient(client); });
+        connect(client, &QLocalSocket::disconnected, this, [this, client]() { dropClient(client); });
+    }
+}
+
+void InjectionDaemon::readClient(QLocalSocket *client)
+{
+    OSK_TRACE_SCOPE("InjectionDaemon::readClient");
+    auto held = m_held.find(client);
+    if (held == m_held.end()) return;
+
+    Message message;
+    while (client->bytesAvailable() >= qint64(sizeof(message))) {
+        client->read(reinterpret_cast<char *>(&message), sizeof(message));
+        switch (message.op) {
+        case Hello: {
+            const Message reply {Hello, uint8_t(m_vk->isReady() ? DeviceReady : 0), 0, Version};
+            client->write(reinterpret_cast<const char *>(&reply), sizeof(reply));
+            break;
+        }
+        case Press:
+            held->insert(message.code);
+            m_vk->sendKeyPress(message.code);
+            break;
+        case Release:
+            held->remove(message.code);
+            m_vk->sendKeyRelease(message.code);
+            break;
+        case Tap:
+            m_vk->sendKey(message.code);
+            break;
+        default:
+            qWarning("Dropping client that sent unknown op %u", unsigned(message.op));
+            client->disconnectFromServer();
+            return;
+        }
+    }
+}
+
+void InjectionDaemon::dropClient(QLocalSocket *client)
+{
+    auto held = m_held.find(client);
+    if (held == m_held.end()) return;
+    for (const uint32_t code : std::as_const(*held))
+        m_vk->sendKeyRelease(code);
+    m_held.erase(held);
+    client->deleteLater();
+}
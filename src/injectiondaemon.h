@@ -0,0 +1,43 @@
+#pragma once
+
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <cstdint>
+
+class QLocalServer;
+class QLocalSocket;
+class KeyMap;
+class TypeServer;
+class VirtualKeyboard;
+
+// Headless owner of the uinput device (osk-daemon).
+//
+// The device is created once and outlives any number of UI processes, so
+// starting or restarting the UI neither recreates it nor waits for udev.
+// Clients speak InjectionProtocol over a Unix-domain socket. Keys a client
+// pressed and never released are released when it disconnects, so a UI
+// that crashes with Shift held does not leave the session shifted.
+// The daemon also hosts the TypeServer used by osk-type.
+class InjectionDaemon : public QObject
+{
+    Q_OBJECT
+public:
+    explicit InjectionDaemon(QObject *parent = nullptr);
+    ~InjectionDaemon() override;
+
+    // False if another daemon already serves the socket
+    bool listen();
+    VirtualKeyboard *keyboard() const;
+
+private:
+    void acceptClients();
+    void readClient(QLocalSocket *client);
+    void dropClient(QLocalSocket *client);
+
+    VirtualKeyboard *m_vk = nullptr;
+    KeyMap *m_keymap = nullptr;
+    QLocalServer *m_server = nullptr;
+    TypeServer *m_typeServer = nullptr;
+    QHash<QLocalSocket *, QSet<uint32_t>> m_held;   // keys pressed per client
+};
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <QDir>
+#include <QFile>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QStandardPaths>
+#include <QString>
+#include <cstdint>
+
+// Wire format between osk-daemon, which owns the uinput device, and its
+// clients (the UI process and local tools).
+//
+// Every message is a fixed 8-byte frame in host byte order; both ends run
+// on the same machine, so there is nothing to negotiate beyond the version
+// exchanged in the Hello handshake.
+namespace InjectionProtocol {
+
+constexpr uint32_t Version = 1;
+
+enum Op : uint8_t {
+    Hello = 0,      // client → daemon; daemon replies Hello, flags = ready, code = Version
+    Press = 1,
+    Release = 2,
+    Tap = 3,        // press + release
+};
+
+enum Flag : uint8_t {
+    DeviceReady = 1u << 0,
+};
+
+struct Message {
+    uint8_t op;
+    uint8_t flags;
+    uint16_t reserved;
+    uint32_t code;  // evdev keycode, or Version for Hello
+};
+static_assert(sizeof(Message) == 8, "injection frames are 8 bytes");
+
+// $XDG_RUNTIME_DIR/osk/<name>; the directory is private to the user
+inline QString socketPath(const QString &name)
+{
+    const QString dir = QStandardPaths::writableLocation(QStandardPaths::RuntimeLocation)
+                        + QStringLiteral("/osk");
+    QDir().mkpath(dir);
+    QFile::setPermissions(dir, QFile::ReadOwner | QFile::WriteOwner | QFile::ExeOwner);
+    return dir + QLatin1Char('/') + name;
+}
+
+inline QString injectionSocketPath() { return socketPath(QStringLiteral("inject.sock")); }
+inline QString typeSocketPath() { return socketPath(QStringLiteral("type.sock")); }
+
+// Listens on path unless another process already answers there; a socket
+// file nobody answers on is left over from a crash and is replaced
+inline bool listenExclusive(QLocalServer *server, const QString &path)
+{
+    server->setSocketOptions(QLocalServer::UserAccessOption);
+    if (server->listen(path))
+        return true;
+    QLocalSocket probe;
+    probe.connectToServer(path);
+    if (probe.waitForConnected(200))
+        return false;
+    QLocalServer::removeServer(path);
+    if (!server->listen(path)) {
+        qWarning("Cannot listen on %s: %s", qPrintable(path), qPrintable(server->errorString()));
+        return false;
+    }
+    return true;
+}
+
+} // namespace InjectionProtocol
@@ -0,0 +1,266 @@
+#include "inputmethod.h"
+#include "tracer.h"
+
+#include <QSocketNotifier>
+
+#include <wayland-client.h>
+#include "input-method-unstable-v2-client-protocol.h"
+
+#include <cstring>
+#include <utility>
+
+InputMethod::InputMethod(QObject *parent)
+    : QObject(parent)
+{
+    m_confirmTimer.setSingleShot(true);
+    m_confirmTimer.setInterval(ConfirmMs);
+    connect(&m_confirmTimer, &QTimer::timeout, this, [this]() {
+        qWarning("The text field did not show \"%s\" in time; replacing it with keys",
+                 qPrintable(m_waitingBefore));
+        abandonReplace();
+    });
+}
+
+InputMethod::~InputMethod()
+{
+    disconnectFromCompositor();
+}
+
+bool InputMethod::connectToCompositor()
+{
+    if (m_method) return true;
+    m_display = wl_display_connect(nullptr);
+    if (!m_display) return false;
+
+    static const wl_registry_listener registryListener = {
+        &InputMethod::registryGlobal,
+        &InputMethod::registryGlobalRemove,
+    };
+    m_registry = wl_display_get_registry(m_display);
+    wl_registry_add_listener(m_registry, &registryListener, this);
+    wl_display_roundtrip(m_display);
+    if (!m_manager || !m_seat) {
+        disconnectFromCompositor();
+        return false;
+    }
+
+    static const zwp_input_method_v2_listener methodListener = {
+        &InputMethod::onActivate,
+        &InputMethod::onDeactivate,
+        &InputMethod::onSurroundingText,
+        &InputMethod::onTextChangeCause,
+        &InputMethod::onContentType,
+        &InputMethod::onDone,
+        &InputMethod::onUnavailable,
+    };
+    m_method = zwp_input_method_manager_v2_get_input_method(m_manager, m_seat);
+    zwp_input_method_v2_add_listener(m_method, &methodListener, this);
+    // "unavailable" arrives right away when another input method has the seat
+    wl_display_roundtrip(m_display);
+    if (!m_method) {
+        disconnectFromCompositor();
+        return false;
+    }
+
+    m_notifier = new QSocketNotifier(wl_display_get_fd(m_display), QSocketNotifier::Read, this);
+    connect(m_notifier, &QSocketNotifier::activated, this, &InputMethod::dispatch);
+    return true;
+}
+
+void InputMethod::disconnectFromCompositor()
+{
+    delete m_notifier;
+    m_notifier = nullptr;
+    if (m_method) zwp_input_method_v2_destroy(m_method);
+    if (m_manager) zwp_input_method_manager_v2_destroy(m_manager);
+    if (m_seat) wl_seat_destroy(m_seat);
+    if (m_registry) wl_registry_destroy(m_registry);
+    m_method = nullptr;
+    m_manager = nullptr;
+    m_seat = nullptr;
+    m_registry = nullptr;
+    if (m_display) wl_display_disconnect(m_display);
+    m_display = nullptr;
+    m_pending = {};
+    m_current = {};
+    m_waitingBefore.clear();
+    m_waitingText.clear();
+    m_confirmTimer.stop();
+}
+
+bool InputMethod::isAvailable() const { return m_method != nullptr; }
+bool InputMethod::isActive() const { return m_method && m_current.active; }
+bool InputMethod::hasSurroundingText() const { return isActive() && m_current.hasText; }
+
+QString InputMethod::textBeforeCursor() const
+{
+    if (!hasSurroundingText()) return QString();
+    const uint32_t end = qMin(qMin(m_current.cursor, m_current.anchor), uint32_t(m_current.text.size()));
+    return QString::fromUtf8(m_current.text.constData(), qsizetype(end));
+}
+
+void InputMethod::commitString(const QString &text)
+{
+    if (!isActive() || text.isEmpty()) return;
+    zwp_input_method_v2_commit_string(m_method, text.toUtf8().constData());
+    zwp_input_method_v2_commit(m_method, m_serial);
+    flush();
+}
+
+bool InputMethod::canReplace(const QString &before) const
+{
+    return hasSurroundingText() && m_current.cursor == m_current.anchor
+           && textBeforeCursor().endsWith(before);
+}
+
+void InputMethod::replace(const QString &before, const QString &text)
+{
+    if (!isActive()) return;
+    OSK_TRACE_SCOPE("InputMethod::replace");
+    // Lengths are UTF-8 bytes
+    const QByteArray removed = before.toUtf8();
+    if (!removed.isEmpty())
+        zwp_input_method_v2_delete_surrounding_text(m_method, uint32_t(removed.size()), 0);
+    if (!text.isEmpty())
+        zwp_input_method_v2_commit_string(m_method, text.toUtf8().constData());
+    zwp_input_method_v2_commit(m_method, m_serial);
+    flush();
+}
+
+void InputMethod::replaceWhenTyped(const QString &before, const QString &text)
+{
+    abandonReplace();
+    if (canReplace(before)) {
+        replace(before, text);
+        return;
+    }
+    m_waitingBefore = before;
+    m_waitingText = text;
+    m_confirmTimer.start();
+}
+
+void InputMethod::abandonReplace()
+{
+    if (m_waitingBefore.isEmpty()) return;
+    m_confirmTimer.stop();
+    const QString before = std::exchange(m_waitingBefore, QString());
+    emit replaceAbandoned(before, std::exchange(m_waitingText, QString()));
+}
+
+void InputMethod::registryGlobal(void *data, wl_registry *registry, uint32_t name,
+                                 const char *interface, uint32_t version)
+{
+    Q_UNUSED(version);
+    auto *self = static_cast<InputMethod *>(data);
+    if (std::strcmp(interface, zwp_input_method_manager_v2_interface.name) == 0) {
+        self->m_manager = static_cast<zwp_input_method_manager_v2 *>(
+            wl_registry_bind(registry, name, &zwp_input_method_manager_v2_interface, 1));
+    } else if (std::strcmp(interface, wl_seat_interface.name) == 0 && !self->m_seat) {
+        // The first seat; the OSK drives a single one
+        self->m_seat = static_cast<wl_seat *>(wl_registry_bind(registry, name, &wl_seat_interface, 1));
+    }
+}
+
+void InputMethod::registryGlobalRemove(void *, wl_registry *, uint32_t)
+{
+}
+
+void InputMethod::onActivate(void *data, zwp_input_method_v2 *)
+{
+    auto *self = static_cast<InputMethod *>(data);
+    // Activation starts from a clean state; the field resends what it supports
+    self->m_pending = {};
+    self->m_pending.active = true;
+}
+
+void InputMethod::onDeactivate(void *data, zwp_input_method_v2 *)
+{
+    static_cast<InputMethod *>(data)->m_pending.active = false;
+}
+
+void InputMethod::onSurroundingText(void *data, zwp_input_method_v2 *, const char *text,
+                                    uint32_t cursor, uint32_t anchor)
+{
+    State &pending = static_cast<InputMethod *>(data)->m_pending;
+    pending.hasText = true;
+    pending.text = QByteArray(text);
+    pending.cursor = cursor;
+    pending.anchor = anchor;
+}
+
+void InputMethod::onTextChangeCause(void *, zwp_input_method_v2 *, uint32_t)
+{
+}
+
+void InputMethod::onContentType(void *, zwp_input_method_v2 *, uint32_t, uint32_t)
+{
+}
+
+void InputMethod::onDone(void *data, zwp_input_method_v2 *)
+{
+    auto *self = static_cast<InputMethod *>(data);
+    ++self->m_serial;
+    self->applyPending();
+}
+
+void InputMethod::onUnavailable(void *data, zwp_input_method_v2 *)
+{
+    auto *self = static_cast<InputMethod *>(data);
+    qWarning("Another input method has the seat; typing through uinput");
+    self->abandonReplace();
+    zwp_input_method_v2_destroy(self->m_method);
+    self->m_method = nullptr;
+    const bool wasActive = self->m_current.active;
+    self->m_current = {};
+    self->m_pending = {};
+    if (wasActive)
+        emit self->activeChanged(false);
+    emit self->unavailable();
+}
+
+void InputMethod::applyPending()
+{
+    const State previous = m_current;
+    m_current = m_pending;
+    // Surrounding text must be resent before every done; the rest persists
+    m_pending.hasText = false;
+    m_pending.text.clear();
+    m_pending.cursor = m_pending.anchor = 0;
+
+    if (previous.active != m_current.active) {
+        if (!m_current.active) {
+            m_waitingBefore.clear();
+            m_waitingText.clear();
+            m_confirmTimer.stop();
+        }
+        emit activeChanged(m_current.active);
+    }
+    // The replacement goes out first, so listeners see it as pending no more
+    // and the text they are told about is about to change again
+    if (!m_waitingBefore.isEmpty() && canReplace(m_waitingBefore)) {
+        m_confirmTimer.stop();
+        const QString before = std::exchange(m_waitingBefore, QString());
+        replace(before, std::exchange(m_waitingText, QString()));
+    }
+    if (previous.hasText != m_current.hasText || previous.text != m_current.text
+        || previous.cursor != m_current.cursor || previous.anchor != m_current.anchor)
+        emit surroundingTextChanged();
+}
+
+void InputMethod::dispatch()
+{
+    if (wl_display_dispatch(m_display) < 0) {
+        qWarning("Lost the Wayland connection of the input method");
+        abandonReplace();
+        const bool wasActive = isActive();
+        disconnectFromCompositor();
+        if (wasActive)
+            emit activeChanged(false);
+        emit unavailable();
+    }
+}
+
+void InputMethod::flush()
+{
+    if (m_display) wl_display_flush(m_display);
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <QByteArray>
+#include <QObject>
+#include <QString>
+#include <QTimer>
+
+class QSocketNotifier;
+struct wl_display;
+struct wl_registry;
+struct wl_seat;
+struct zwp_input_method_manager_v2;
+struct zwp_input_method_v2;
+
+// The input method of the seat, over zwp_input_method_v2.
+//
+// With it, text goes straight into the focused text field: whole strings
+// are committed and a trigger is replaced with one delete_surrounding_text,
+// and the field's surrounding text is known. Compositors that do not offer
+// the protocol (KWin offers only input-method-v1, to the keyboard it
+// launches itself), or where another input method holds the seat, leave
+// isAvailable() false and typing stays on uinput.
+//
+// Uses a Wayland connection of its own, so the protocol objects are
+// dispatched here rather than by Qt's platform plugin.
+class InputMethod : public QObject
+{
+    Q_OBJECT
+
+public:
+    // How long replaceWhenTyped() waits for the field to show the text
+    static constexpr int ConfirmMs = 250;
+
+    explicit InputMethod(QObject *parent = nullptr);
+    ~InputMethod() override;
+
+    // false when there is no Wayland display or no input method manager
+    bool connectToCompositor();
+    bool isAvailable() const;
+    // A text field on the seat has focus
+    bool isActive() const;
+    // The field reports its contents (not every toolkit does)
+    bool hasSurroundingText() const;
+    // Text before the cursor, or before the selection when there is one
+    QString textBeforeCursor() const;
+
+    void commitString(const QString &text);
+    // True when before is what precedes the cursor, so replace() is safe
+    bool canReplace(const QString &before) const;
+    // Deletes before (just left of the cursor) and inserts text as one change
+    void replace(const QString &before, const QString &text);
+    // replace() once the field shows before: keys sent through uinput reach
+    // the application later than this connection's requests. Handed back by
+    // replaceAbandoned() when that does not happen within ConfirmMs.
+    void replaceWhenTyped(const QString &before, const QString &text);
+    bool hasPendingReplace() const { return !m_waitingBefore.isEmpty(); }
+    // Hands the waiting replacement back right away, e.g. before more keys
+    // follow the trigger
+    void abandonReplace();
+
+signals:
+    void activeChanged(bool active);
+    void surroundingTextChanged();
+    void unavailable();
+    // A replaceWhenTyped() that cannot be done here; before is still in the
+    // field, left of where the keys go
+    void replaceAbandoned(const QString &before, const QString &text);
+
+private:
+    struct State {
+        bool active = false;
+        bool hasText = false;
+        QByteArray text;
+        uint32_t cursor = 0;
+        uint32_t anchor = 0;
+    };
+
+    static void registryGlobal(void *data, wl_registry *registry, uint32_t name,
+                               const char *interface, uint32_t version);
+    static void registryGlobalRemove(void *data, wl_registry *registry, uint32_t name);
+    static void onActivate(void *data, zwp_input_method_v2 *method);
+    static void onDeactivate(void *data, zwp_input_method_v2 *method);
+    static void onSurroundingText(void *data, zwp_input_method_v2 *method,
+                                  const char *text, uint32_t cursor, uint32_t anchor);
+    static void onTextChangeCause(void *data, zwp_input_method_v2 *method, uint32_t cause);
+    static void onContentType(void *data, zwp_input_method_v2 *method, uint32_t hint, uint32_t purpose);
+    static void onDone(void *data, zwp_input_method_v2 *method);
+    static void onUnavailable(void *data, zwp_input_method_v2 *method);
+
+    void applyPending();
+    void dispatch();
+    void flush();
+    void disconnectFromCompositor();
+
+    wl_display *m_display = nullptr;
+    wl_registry *m_registry = nullptr;
+    wl_seat *m_seat = nullptr;
+    zwp_input_method_manager_v2 *m_manager = nullptr;
+    zwp_input_method_v2 *m_method = nullptr;
+    QSocketNotifier *m_notifier = nullptr;
+
+    uint32_t m_serial = 0;   // done events received, echoed by commit
+    State m_pending;
+    State m_current;
+
+    // A replaceWhenTyped() waiting for its text to show up
+    QString m_waitingBefore;
+    QString m_waitingText;
+    QTimer m_confirmTimer;
+};
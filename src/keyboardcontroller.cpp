@@ -1,7 +1,21 @@
 #include "keyboardcontroller.h"
+#include "autocorrectindex.h"
+#include "clipboardmodel.h"
+#include "clipboardowner.h"
+#include "clipboardstore.h"
+#include "completiondictionary.h"
+#include "composetable.h"
+#include "inputmethod.h"
+#include "keymap.h"
+#include "macroengine.h"
+#include "shortcutlibrary.h"
+#include "swipedecoder.h"
+#include "tracer.h"
+#include "typeserver.h"
 #include "virtualkeyboard.h"
 
 #include <linux/input-event-codes.h>
+#include <array>
 #include <QAction>
 #include <QApplication>
 #include <QClipboard>
@@ -14,6 +28,8 @@
 #include <QStandardPaths>
 #include <QKeyEvent>
 #include <QKeySequence>
+#include <QMimeData>
+#include <QQmlEngine>
 #include <QQuickWindow>
 #include <QScreen>
 #include <QFileDialog>
@@ -24,64 +40,115 @@
 #include <QDBusMessage>
 #include <QDBusReply>
 #include <QDBusVariant>
+#include <QThread>
 #include <KGlobalAccel>
+#include <KSystemClipboard>
 #include <LayerShellQt/Window>
 
-// ---------------------------------------------------------------------------
-// Evdev keycode → character mapping
-// ---------------------------------------------------------------------------
-QChar KeyboardController::evdevToChar(int keyCode, bool shift)
-{
-    // Letters: KEY_Q=16 .. KEY_P=25, KEY_A=30 .. KEY_L=38, KEY_Z=44 .. KEY_M=50
-    static const char letterMap[] = {
-        // index 0-9: keycodes 16-25 (top row)
-        'q','w','e','r','t','y','u','i','o','p',
-        // index 10-13: gap (keycodes 26-29)
-        0, 0, 0, 0,
-        // index 14-22: keycodes 30-38 (home row)
-        'a','s','d','f','g','h','j','k','l',
-        // index 23-27: gap (keycodes 39-43)
-        0, 0, 0, 0, 0,
-        // index 28-34: keycodes 44-50 (bottom row)
-        'z','x','c','v','b','n','m'
-    };
+#include <unistd.h>
+#include <utility>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
 
-    if (keyCode >= 16 && keyCode <= 50) {
-        char c = letterMap[keyCode - 16];
-        if (c != 0)
-            return shift ? QChar(c).toUpper() : QChar(c);
-    }
+namespace {
+// Settings are written synchronously when the QSettings goes away; keep
+// every write in one place so traces show what it costs
+void storeSetting(const QString &key, const QVariant &value)
+{
+    OSK_TRACE_SCOPE("QSettings::setValue");
+    QSettings().setValue(key, value);
+}
 
-    // Number row: KEY_1=2 .. KEY_0=11
-    static const char numNormal[]  = "1234567890";
-    static const char numShift[]   = "!@#$%^&*()";
-    if (keyCode >= 2 && keyCode <= 11) {
-        int idx = keyCode - 2;
-        return QChar(shift ? numShift[idx] : numNormal[idx]);
-    }
+// Macro modifiers of a KeyMap level
+uint16_t macroLevel(uint8_t level)
+{
+    return ((level & KeyMap::Shift) ? MacroEngine::ModShift : 0)
+           | ((level & KeyMap::AltGr) ? MacroEngine::ModAltGr : 0);
+}
+}
 
-    // Punctuation keys
-    switch (keyCode) {
-    case 41: return shift ? QChar('~') : QChar('`');
-    case 12: return shift ? QChar('_') : QChar('-');
-    case 13: return shift ? QChar('+') : QChar('=');
-    case 26: return shift ? QChar('{') : QChar('[');
-    case 27: return shift ? QChar('}') : QChar(']');
-    case 43: return shift ? QChar('|') : QChar('\\');
-    case 39: return shift ? QChar(':') : QChar(';');
-    case 40: return shift ? QChar('"') : QChar('\'');
-    case 51: return shift ? QChar('<') : QChar(',');
-    case 52: return shift ? QChar('>') : QChar('.');
-    case 53: return shift ? QChar('?') : QChar('/');
-    case 57: return QChar(' ');  // space
+void KeyboardController::typeText(const QString &text)
+{
+    if (!m_vk || !m_vk->isReady()) return;
+    // Locked modifiers must not leak into the text; released once for the
+    // whole run rather than around every character
+    const uint16_t held = m_vk->modifiers();
+    m_vk->setModifiers(0);
+    for (const char32_t ch : text.toUcs4()) {
+        uint8_t level = 0;
+        const int code = m_keymap->fromChar(ch, &level);
+        if (code < 0) continue;
+        m_vk->sendKeyAtLevel(uint32_t(code), level & KeyMap::Shift, level & KeyMap::AltGr);
     }
+    m_vk->setModifiers(held);
+}
 
-    return QChar(); // non-character key
+// Text the user picked as a whole (a completion, a swipe, a composed
+// character): one commit when a text field is reachable through
+// input-method-v2, keystrokes otherwise
+void KeyboardController::insertText(const QString &text)
+{
+    m_fieldSyncTimer.stop();
+    if (m_inputMethod->isActive())
+        m_inputMethod->commitString(text);
+    else
+        typeText(text);
 }
 
-// ---------------------------------------------------------------------------
-// Character → evdev keycode (reverse of evdevToChar)
-// ---------------------------------------------------------------------------
+void KeyboardController::onTextFocusChanged(bool focused)
+{
+    // The new field's text replaces whatever the buffer held
+    m_core.resetBuffer();
+    m_bufferTimer.stop();
+    clearSuggestions();
+    syncBufferWithField();
+
+    if (!m_followTextFocus || !m_window) return;
+    if (focused) {
+        if (!m_window->isVisible()) {
+            m_window->show();
+            m_shownForTextFocus = true;
+        }
+        return;
+    }
+    // Moving between fields deactivates and reactivates; only hide when
+    // focus stays away, and never while an OSK page is being typed into
+    QTimer::singleShot(200, this, [this]() {
+        if (!m_shownForTextFocus || m_inputMethod->isActive() || m_textInputMode
+            || m_settingsVisible || m_shortcutPageVisible || m_clipboardPageVisible)
+            return;
+        m_shownForTextFocus = false;
+        if (m_window) m_window->hide();
+    });
+}
+
+// The field's text before the cursor is what the buffer stands for; it
+// differs after clicks, cursor keys or edits by the application itself.
+// A buffer ahead of the field (keys it has not caught up with) is kept.
+void KeyboardController::syncBufferWithField()
+{
+    if (!m_inputMethod->hasSurroundingText() || m_inputMethod->hasPendingReplace()) return;
+
+    // The run since the last separator, as typing would have buffered it
+    const QString before = m_inputMethod->textBeforeCursor();
+    qsizetype start = before.size();
+    while (start > 0 && !before.at(start - 1).isSpace())
+        --start;
+    const QString token = before.mid(start);
+    const std::u16string_view buffered = m_core.buffer().view();
+    const std::u16string_view field = ShortcutMatcher::view(token);
+    if (buffered.substr(0, field.size()) == field && (buffered.size() > field.size() || buffered == field))
+        return;
+
+    const QString tail = token.right(qsizetype(TypeBuffer::Capacity / 2));
+    m_core.resetBuffer(tail.size() == token.size());
+    m_core.buffer().append(ShortcutMatcher::view(tail));
+    if (m_core.buffer().isEmpty())
+        clearSuggestions();
+    else
+        updateSuggestions();
+}
 
 // ---------------------------------------------------------------------------
 // Constructor / Destructor
@@ -89,7 +156,37 @@ QChar KeyboardController::evdevToChar(int keyCode, bool shift)
 KeyboardController::KeyboardController(QObject *parent)
     : QObject(parent)
 {
-    m_vk = new VirtualKeyboard(this);
+    m_vk = new VirtualKeyboard(VirtualKeyboard::Backend::Auto, this);
+    m_keymap = new KeyMap(this);
+    m_core.setKeyTable(&m_keymap->table());
+    connect(m_keymap, &KeyMap::changed, this, &KeyboardController::keymapChanged);
+    connect(m_vk, &VirtualKeyboard::readyChanged, this, &KeyboardController::serveTypeClients);
+    serveTypeClients();
+    m_clipboardModel = new ClipboardModel(this);
+    m_dictionary = std::make_unique<CompletionDictionary>();
+    m_swipeDecoder = std::make_unique<SwipeDecoder>();
+    m_autocorrectIndex = std::make_unique<AutocorrectIndex>();
+    m_composeTable = std::make_unique<ComposeTable>();
+    m_macroEngine = new MacroEngine(m_vk, this);
+    m_pasteSequencer = new PasteSequencer(this);
+    connect(m_pasteSequencer, &PasteSequencer::ready, this, &KeyboardController::sendPaste);
+    // Without input-method-v2 (or with another input method on the seat)
+    // everything goes through uinput as before
+    m_inputMethod = new InputMethod(this);
+    if (m_inputMethod->connectToCompositor())
+        qInfo("Text input through input-method-v2");
+    connect(m_inputMethod, &InputMethod::activeChanged, this, &KeyboardController::onTextFocusChanged);
+    connect(m_inputMethod, &InputMethod::surroundingTextChanged, &m_fieldSyncTimer, qOverload<>(&QTimer::start));
+    connect(m_inputMethod, &InputMethod::unavailable, this, &KeyboardController::inputMethodAvailableChanged);
+    // A trigger the field did not show in time goes the uinput way after all
+    connect(m_inputMethod, &InputMethod::replaceAbandoned, this,
+            [this](const QString &trigger, const QString &expansion) {
+        pasteOverTrigger(int(trigger.size()), expansion);
+    });
+    connect(m_macroEngine, &MacroEngine::recordingChanged,
+            this, &KeyboardController::macroRecordingChanged);
+    connect(m_macroEngine, &MacroEngine::playingChanged,
+            this, &KeyboardController::macroPlayingChanged);
 
     QSettings s;
     m_backgroundColor = s.value(QStringLiteral("backgroundColor"),
@@ -109,29 +206,70 @@ KeyboardController::KeyboardController(QObject *parent)
         QDir::homePath() + QStringLiteral("/.local/share/whisper.cpp/ggml-base.en.bin")).toString();
 
     // Load shortcuts
-    m_shortcuts = s.value(QStringLiteral("shortcuts")).toList();
-
-    // Migrate old "snippets" data if present
-    if (m_shortcuts.isEmpty() && s.contains(QStringLiteral("snippets"))) {
-        const QStringList oldSnippets = s.value(QStringLiteral("snippets")).toStringList();
-        for (const QString &text : oldSnippets) {
-            QVariantMap entry;
-            entry[QStringLiteral("shortcut")] = QString();
-            entry[QStringLiteral("expansion")] = text;
-            m_shortcuts.append(entry);
+    m_shortcutLibrary = new ShortcutLibrary(ShortcutLibrary::defaultDirectory(), this);
+    // Migrate shortcuts kept in QSettings, and old "snippets" before that
+    if (m_shortcutLibrary->open() && m_shortcutLibrary->count() == 0) {
+        QVector<ShortcutLibrary::Entry> migrated;
+        const QVariantList stored = s.value(QStringLiteral("shortcuts")).toList();
+        for (const QVariant &v : stored) {
+            const QVariantMap entry = v.toMap();
+            migrated.append({entry.value(QStringLiteral("shortcut")).toString(),
+                             entry.value(QStringLiteral("expansion")).toString(),
+                             entry.value(QStringLiteral("scope")).toString()});
+        }
+        if (migrated.isEmpty()) {
+            const QStringList oldSnippets = s.value(QStringLiteral("snippets")).toStringList();
+            for (const QString &text : oldSnippets)
+                migrated.append({QString(), text, QString()});
+        }
+        // Kept in the settings until the library has them on disk
+        if (m_shortcutLibrary->appendAll(migrated)) {
+            s.remove(QStringLiteral("shortcuts"));
+            s.remove(QStringLiteral("snippets"));
         }
-        saveShortcuts();
-        s.remove(QStringLiteral("snippets"));
     }
+    // Use counts kept in QSettings by trigger move into the library records
+    if (s.contains(QStringLiteral("shortcutUses"))
+        && m_shortcutLibrary->adoptUses(s.value(QStringLiteral("shortcutUses")).toMap()))
+        s.remove(QStringLiteral("shortcutUses"));
+    connect(m_shortcutLibrary, &ShortcutLibrary::changed, this, &KeyboardController::shortcutsChanged);
+
+    // The matchers and the suggestion index follow row edits instead of
+    // being rebuilt
+    m_shortcutSuggestions = s.value(QStringLiteral("shortcutSuggestions"), true).toBool();
+    connect(m_shortcutLibrary, &QAbstractItemModel::rowsInserted, this,
+            [this](const QModelIndex &, int first, int last) { addShortcutRows(first, last); });
+    connect(m_shortcutLibrary, &QAbstractItemModel::rowsAboutToBeRemoved, this,
+            [this](const QModelIndex &, int first, int last) {
+        for (int row = last; row >= first; --row)
+            removeShortcutRow(row);
+    });
+    connect(m_shortcutLibrary, &ShortcutLibrary::entryReplaced, this, &KeyboardController::replaceShortcutRow);
+    connect(m_shortcutLibrary, &QAbstractItemModel::modelReset, this, &KeyboardController::loadShortcuts);
+    connect(m_shortcutLibrary, &ShortcutLibrary::storageMoved, this, &KeyboardController::loadShortcuts);
+    loadShortcuts();
 
     // New settings
     m_opacity = s.value(QStringLiteral("opacity"), 1.0).toDouble();
     m_fontSize = s.value(QStringLiteral("fontSize"), 14).toInt();
     m_keyRadius = s.value(QStringLiteral("keyRadius"), 6).toInt();
     m_autoHideDelay = s.value(QStringLiteral("autoHideDelay"), 0).toInt();
+    m_releaseHiddenDelay = s.value(QStringLiteral("releaseHiddenDelay"), 0).toInt();
     m_soundFeedback = s.value(QStringLiteral("soundFeedback"), false).toBool();
+    m_softwareRendering = s.value(QStringLiteral("softwareRendering"), false).toBool();
+    // As requested; the window's renderer settles it once it is running
+    m_softwareRenderingActive = QQuickWindow::graphicsApi() == QSGRendererInterface::Software
+                                || QQuickWindow::sceneGraphBackend() == QLatin1String("software");
+    // Animated presses repaint a key for several frames; on the software
+    // rasterizer they default to off
+    m_pressAnimation = s.value(QStringLiteral("pressAnimation"), !softwareRenderingActive()).toBool();
     m_closeOnPaste = s.value(QStringLiteral("closeOnPaste"), false).toBool();
+    m_directClipboard = s.value(QStringLiteral("directClipboard"), true).toBool();
+    m_nativeClipboard = s.value(QStringLiteral("clipboardBackend")).toString() == QLatin1String("native");
+    if (m_nativeClipboard && !openClipboardStore())
+        m_nativeClipboard = false;
     m_closeOnInsertShortcut = s.value(QStringLiteral("closeOnInsertShortcut"), false).toBool();
+    m_followTextFocus = s.value(QStringLiteral("followTextFocus"), true).toBool();
     m_stickyPosition = s.value(QStringLiteral("stickyPosition"), 0).toInt();
     m_keySpacing = s.value(QStringLiteral("keySpacing"), 3).toInt();
     m_compactMode = s.value(QStringLiteral("compactMode"), false).toBool();
@@ -141,34 +279,87 @@ KeyboardController::KeyboardController(QObject *parent)
     m_defaultScreen = s.value(QStringLiteral("defaultScreen"), 0).toInt();
     m_autostartEnabled = QFile::exists(autostartFilePath());
 
+    // Macros
+    m_macros = s.value(QStringLiteral("macros")).toList();
+    m_macroEngine->setRate(s.value(QStringLiteral("macroRate"), 0).toInt());
+
+    // Word completion
+    m_wordCompletion = s.value(QStringLiteral("wordCompletion"), false).toBool();
+    m_swipeTyping = s.value(QStringLiteral("swipeTyping"), false).toBool();
+    m_flickGestures = s.value(QStringLiteral("flickGestures"), true).toBool();
+    {
+        const QVariantMap alternates = s.value(QStringLiteral("flickAlternates")).toMap();
+        for (auto it = alternates.cbegin(); it != alternates.cend(); ++it) {
+            bool ok = false;
+            const int code = it.key().toInt(&ok);
+            if (ok && !it.value().toString().isEmpty())
+                m_flickAlternates.insert(code, it.value().toString());
+        }
+    }
+    m_flickClock.start();
+    if (m_wordCompletion || m_swipeTyping)
+        loadCompletionDictionary();
+    m_autocorrect = s.value(QStringLiteral("autocorrect"), false).toBool();
+    if (m_autocorrect)
+        loadAutocorrectIndex();
+    loadComposeTable();
+
     // Auto-hide timer
     m_autoHideTimer.setSingleShot(true);
     connect(&m_autoHideTimer, &QTimer::timeout, this, [this]() {
         minimizeToTray();
     });
 
+    // Never leave modifiers held on the device behind us
+    connect(qApp, &QCoreApplication::aboutToQuit, this, &KeyboardController::releaseAllKeys);
+
+    // Low-memory mode: release the scene once hidden long enough
+    m_releaseTimer.setSingleShot(true);
+    connect(&m_releaseTimer, &QTimer::timeout, this, &KeyboardController::releaseScene);
+
     // Buffer inactivity timer
     m_bufferTimer.setSingleShot(true);
     m_bufferTimer.setInterval(3000);
     connect(&m_bufferTimer, &QTimer::timeout, this, [this]() {
-        m_typeBuffer.clear();
+        m_core.resetBuffer();
+        clearSuggestions();
     });
+
+    // The field's text is compared with the buffer once typing settles:
+    // until then it lags behind keys still on their way through uinput
+    m_fieldSyncTimer.setSingleShot(true);
+    m_fieldSyncTimer.setInterval(100);
+    connect(&m_fieldSyncTimer, &QTimer::timeout, this, &KeyboardController::syncBufferWithField);
 }
 
 KeyboardController::~KeyboardController() = default;
 
+void KeyboardController::serveTypeClients()
+{
+    if (m_typeServer || !m_vk->isReady() || m_vk->isRemote()) return;
+    m_typeServer = new TypeServer(m_vk, m_keymap, this);
+    m_typeServer->listen();
+}
+
 // ---------------------------------------------------------------------------
 // Property getters
 // ---------------------------------------------------------------------------
-bool KeyboardController::shiftActive() const { return m_shift; }
-bool KeyboardController::ctrlActive() const { return m_ctrl; }
-bool KeyboardController::altActive() const { return m_alt; }
-bool KeyboardController::superActive() const { return m_super; }
-bool KeyboardController::capsLockActive() const { return m_capsLock; }
-bool KeyboardController::shiftLocked() const { return m_shiftLocked; }
-bool KeyboardController::ctrlLocked() const { return m_ctrlLocked; }
-bool KeyboardController::altLocked() const { return m_altLocked; }
-bool KeyboardController::superLocked() const { return m_superLocked; }
+bool KeyboardController::shiftActive() const { return m_core.modifiers().isActive(ModifierState::Shift); }
+bool KeyboardController::ctrlActive() const { return m_core.modifiers().isActive(ModifierState::Ctrl); }
+bool KeyboardController::altActive() const { return m_core.modifiers().isActive(ModifierState::Alt); }
+bool KeyboardController::superActive() const { return m_core.modifiers().isActive(ModifierState::Meta); }
+bool KeyboardController::capsLockActive() const { return m_core.modifiers().capsLock(); }
+int KeyboardController::keymapRevision() const { return m_keymap->revision(); }
+
+QString KeyboardController::keyLabel(int keyCode, bool shift) const
+{
+    return m_keymap->label(keyCode, shift);
+}
+
+bool KeyboardController::shiftLocked() const { return m_core.modifiers().isLocked(ModifierState::Shift); }
+bool KeyboardController::ctrlLocked() const { return m_core.modifiers().isLocked(ModifierState::Ctrl); }
+bool KeyboardController::altLocked() const { return m_core.modifiers().isLocked(ModifierState::Alt); }
+bool KeyboardController::superLocked() const { return m_core.modifiers().isLocked(ModifierState::Meta); }
 
 QString KeyboardController::backgroundColor() const { return m_backgroundColor; }
 
@@ -176,7 +367,7 @@ void KeyboardController::setBackgroundColor(const QString &color)
 {
     if (m_backgroundColor != color) {
         m_backgroundColor = color;
-        QSettings().setValue(QStringLiteral("backgroundColor"), color);
+        storeSetting(QStringLiteral("backgroundColor"), color);
         emit backgroundColorChanged();
     }
 }
@@ -188,7 +379,7 @@ void KeyboardController::setKeyRepeatDelay(int ms)
     ms = qBound(100, ms, 1000);
     if (m_keyRepeatDelay != ms) {
         m_keyRepeatDelay = ms;
-        QSettings().setValue(QStringLiteral("keyRepeatDelay"), ms);
+        storeSetting(QStringLiteral("keyRepeatDelay"), ms);
         emit keyRepeatDelayChanged();
     }
 }
@@ -200,7 +391,7 @@ void KeyboardController::setKeyRepeatInterval(int ms)
     ms = qBound(20, ms, 200);
     if (m_keyRepeatInterval != ms) {
         m_keyRepeatInterval = ms;
-        QSettings().setValue(QStringLiteral("keyRepeatInterval"), ms);
+        storeSetting(QStringLiteral("keyRepeatInterval"), ms);
         emit keyRepeatIntervalChanged();
     }
 }
@@ -234,7 +425,7 @@ void KeyboardController::setKeyboardWidth(int px)
     px = qBound(450, px, 2000);
     if (m_keyboardWidth != px) {
         m_keyboardWidth = px;
-        QSettings().setValue(QStringLiteral("keyboardWidth"), px);
+        storeSetting(QStringLiteral("keyboardWidth"), px);
         emit keyboardWidthChanged();
     }
 }
@@ -246,7 +437,7 @@ void KeyboardController::setKeyboardHeight(int px)
     px = qBound(150, px, 800);
     if (m_keyboardHeight != px) {
         m_keyboardHeight = px;
-        QSettings().setValue(QStringLiteral("keyboardHeight"), px);
+        storeSetting(QStringLiteral("keyboardHeight"), px);
         emit keyboardHeightChanged();
     }
 }
@@ -270,7 +461,7 @@ void KeyboardController::setKeyBorderEnabled(bool enabled)
 {
     if (m_keyBorderEnabled != enabled) {
         m_keyBorderEnabled = enabled;
-        QSettings().setValue(QStringLiteral("keyBorderEnabled"), enabled);
+        storeSetting(QStringLiteral("keyBorderEnabled"), enabled);
         emit keyBorderEnabledChanged();
     }
 }
@@ -284,7 +475,7 @@ void KeyboardController::setKeyPressColor(const QString &color)
 {
     if (m_keyPressColor != color) {
         m_keyPressColor = color;
-        QSettings().setValue(QStringLiteral("keyPressColor"), color);
+        storeSetting(QStringLiteral("keyPressColor"), color);
         emit keyPressColorChanged();
     }
 }
@@ -295,7 +486,7 @@ void KeyboardController::setLockedKeyColor(const QString &color)
 {
     if (m_lockedKeyColor != color) {
         m_lockedKeyColor = color;
-        QSettings().setValue(QStringLiteral("lockedKeyColor"), color);
+        storeSetting(QStringLiteral("lockedKeyColor"), color);
         emit lockedKeyColorChanged();
     }
 }
@@ -306,7 +497,7 @@ void KeyboardController::setKeyBorderColor(const QString &color)
 {
     if (m_keyBorderColor != color) {
         m_keyBorderColor = color;
-        QSettings().setValue(QStringLiteral("keyBorderColor"), color);
+        storeSetting(QStringLiteral("keyBorderColor"), color);
         emit keyBorderColorChanged();
     }
 }
@@ -338,6 +529,7 @@ void KeyboardController::savePanelPosition(int x, int y)
 {
     m_panelX = x;
     m_panelY = y;
+    OSK_TRACE_SCOPE("QSettings::setValue");
     QSettings s;
     s.setValue(QStringLiteral("panelX"), x);
     s.setValue(QStringLiteral("panelY"), y);
@@ -350,7 +542,7 @@ void KeyboardController::setPagePanelHeight(int px)
     px = qBound(150, px, 800);
     if (m_pagePanelHeight != px) {
         m_pagePanelHeight = px;
-        QSettings().setValue(QStringLiteral("pagePanelHeight"), px);
+        storeSetting(QStringLiteral("pagePanelHeight"), px);
         emit pagePanelHeightChanged();
     }
 }
@@ -361,13 +553,15 @@ void KeyboardController::setWhisperModelPath(const QString &path)
 {
     if (m_whisperModelPath != path) {
         m_whisperModelPath = path;
-        QSettings().setValue(QStringLiteral("whisperModelPath"), path);
+        storeSetting(QStringLiteral("whisperModelPath"), path);
         emit whisperModelPathChanged();
     }
 }
 
 void KeyboardController::browseWhisperModel()
 {
+    // Runs a nested event loop; shows up as the operation behind stalls
+    OSK_TRACE_SCOPE("KeyboardController::browseWhisperModel");
     QString startDir = QFileInfo(m_whisperModelPath).path();
     QString path = QFileDialog::getOpenFileName(nullptr,
         QStringLiteral("Select Whisper Model"), startDir,
@@ -402,6 +596,7 @@ void KeyboardController::toggleVoiceTyping()
             startTranscription();
         });
 
+        OSK_TRACE_SCOPE("QProcess pw-record");
         m_recordProcess->start(QStringLiteral("pw-record"),
             {QStringLiteral("--rate=16000"),
              QStringLiteral("--channels=1"),
@@ -435,15 +630,12 @@ void KeyboardController::startTranscription()
         m_voiceTempFile.clear();
 
         if (!output.isEmpty()) {
-            QDBusInterface klipper(QStringLiteral("org.kde.klipper"),
-                                   QStringLiteral("/klipper"),
-                                   QStringLiteral("org.kde.klipper.klipper"));
-            klipper.call(QStringLiteral("setClipboardContents"), output);
             m_savedWindowIsTerminal = isActiveWindowTerminal();
-            QTimer::singleShot(50, this, [this]() { sendPaste(); });
+            m_pasteSequencer->start(output, pasteRoute(), QString());
         }
     });
 
+    OSK_TRACE_SCOPE("QProcess whisper-cli");
     m_transcribeProcess->start(QStringLiteral("whisper-cli"),
         {QStringLiteral("-m"), m_whisperModelPath,
          QStringLiteral("-nt"),
@@ -460,7 +652,7 @@ void KeyboardController::startTranscription()
 }
 
 
-bool KeyboardController::isActiveWindowTerminal()
+bool KeyboardController::isTerminalClass(const QString &windowClass)
 {
     // Terminal class names that use Ctrl+Shift+V for paste.
     // Matched against the end of the class (e.g. "org.kde.konsole" matches "konsole").
@@ -478,17 +670,56 @@ bool KeyboardController::isActiveWindowTerminal()
         QStringLiteral("urxvt"),
         QStringLiteral("yakuake"),
     };
+    for (const QString &term : terminals) {
+        if (windowClass == term || windowClass.endsWith(QLatin1Char('.') + term))
+            return true;
+    }
+    return false;
+}
+
+bool KeyboardController::isActiveWindowTerminal()
+{
+    // Paste needs the current answer, so this one waits for kdotool
+    OSK_TRACE_SCOPE("QProcess kdotool (blocking)");
     QProcess proc;
     proc.start(QStringLiteral("kdotool"),
                {QStringLiteral("getactivewindow"), QStringLiteral("getwindowclassname")});
-    if (proc.waitForFinished(200)) {
-        QString resClass = QString::fromUtf8(proc.readAllStandardOutput()).trimmed().toLower();
-        for (const QString &term : terminals) {
-            if (resClass == term || resClass.endsWith(QLatin1Char('.') + term))
-                return true;
-        }
-    }
-    return false;
+    if (!proc.waitForFinished(200)) return false;
+    setActiveWindowClass(QString::fromUtf8(proc.readAllStandardOutput()).trimmed().toLower());
+    return isTerminalClass(m_activeWindowClass);
+}
+
+QString KeyboardController::activeWindowClass() const { return m_activeWindowClass; }
+
+// Asynchronous refresh of the cached window class; at most one query in flight
+void KeyboardController::refreshActiveWindowClass()
+{
+    if (m_windowClassProcess) return;
+
+    m_windowClassProcess = new QProcess(this);
+    connect(m_windowClassProcess, &QProcess::finished, this, [this]() {
+        const QString windowClass =
+            QString::fromUtf8(m_windowClassProcess->readAllStandardOutput()).trimmed().toLower();
+        m_windowClassProcess->deleteLater();
+        m_windowClassProcess = nullptr;
+        setActiveWindowClass(windowClass);
+    });
+    connect(m_windowClassProcess, &QProcess::errorOccurred, this, [this](QProcess::ProcessError error) {
+        if (error != QProcess::FailedToStart) return;
+        m_windowClassProcess->deleteLater();
+        m_windowClassProcess = nullptr;
+    });
+    OSK_TRACE_SCOPE("QProcess kdotool");
+    m_windowClassProcess->start(QStringLiteral("kdotool"),
+        {QStringLiteral("getactivewindow"), QStringLiteral("getwindowclassname")});
+}
+
+void KeyboardController::setActiveWindowClass(const QString &windowClass)
+{
+    if (m_activeWindowClass == windowClass) return;
+    m_activeWindowClass = windowClass;
+    selectShortcutMatcher();
+    emit activeWindowClassChanged();
 }
 
 // ---------------------------------------------------------------------------
@@ -500,7 +731,7 @@ void KeyboardController::setOpacity(qreal value)
     value = qBound(0.1, value, 1.0);
     if (qFuzzyCompare(m_opacity, value)) return;
     m_opacity = value;
-    QSettings().setValue(QStringLiteral("opacity"), value);
+    storeSetting(QStringLiteral("opacity"), value);
     emit opacityChanged();
 }
 
@@ -510,7 +741,7 @@ void KeyboardController::setFontSize(int px)
     px = qBound(8, px, 28);
     if (m_fontSize == px) return;
     m_fontSize = px;
-    QSettings().setValue(QStringLiteral("fontSize"), px);
+    storeSetting(QStringLiteral("fontSize"), px);
     emit fontSizeChanged();
 }
 
@@ -520,7 +751,7 @@ void KeyboardController::setKeyRadius(int px)
     px = qBound(0, px, 20);
     if (m_keyRadius == px) return;
     m_keyRadius = px;
-    QSettings().setValue(QStringLiteral("keyRadius"), px);
+    storeSetting(QStringLiteral("keyRadius"), px);
     emit keyRadiusChanged();
 }
 
@@ -530,17 +761,71 @@ void KeyboardController::setAutoHideDelay(int seconds)
     seconds = qBound(0, seconds, 300);
     if (m_autoHideDelay == seconds) return;
     m_autoHideDelay = seconds;
-    QSettings().setValue(QStringLiteral("autoHideDelay"), seconds);
+    storeSetting(QStringLiteral("autoHideDelay"), seconds);
     resetAutoHideTimer();
     emit autoHideDelayChanged();
 }
 
+int KeyboardController::releaseHiddenDelay() const { return m_releaseHiddenDelay; }
+void KeyboardController::setReleaseHiddenDelay(int seconds)
+{
+    seconds = qBound(0, seconds, 3600);
+    if (m_releaseHiddenDelay == seconds) return;
+    m_releaseHiddenDelay = seconds;
+    storeSetting(QStringLiteral("releaseHiddenDelay"), seconds);
+    if (m_window) {
+        // Scene graph and graphics must be allowed to go away while hidden
+        m_window->setPersistentSceneGraph(seconds == 0);
+        m_window->setPersistentGraphics(seconds == 0);
+    }
+    emit releaseHiddenDelayChanged();
+}
+
+bool KeyboardController::sceneReleased() const { return m_sceneReleased; }
+
+bool KeyboardController::softwareRendering() const { return m_softwareRendering; }
+void KeyboardController::setSoftwareRendering(bool enabled)
+{
+    if (m_softwareRendering == enabled) return;
+    m_softwareRendering = enabled;
+    storeSetting(QStringLiteral("softwareRendering"), enabled);
+    emit softwareRenderingChanged();
+}
+
+// Also true when forced through QT_QUICK_BACKEND=software, or once the
+// scene graph came up on the software renderer for lack of a GPU
+bool KeyboardController::softwareRenderingActive() const { return m_softwareRenderingActive; }
+
+void KeyboardController::updateSoftwareRenderingActive()
+{
+    const QSGRendererInterface *renderer = m_window ? m_window->rendererInterface() : nullptr;
+    if (!renderer) return;
+    const bool active = renderer->graphicsApi() == QSGRendererInterface::Software;
+    if (m_softwareRenderingActive == active) return;
+    m_softwareRenderingActive = active;
+    // The press animation default follows, unless it was chosen
+    if (!QSettings().contains(QStringLiteral("pressAnimation")) && m_pressAnimation == active) {
+        m_pressAnimation = !active;
+        emit pressAnimationChanged();
+    }
+    emit softwareRenderingActiveChanged();
+}
+
+bool KeyboardController::pressAnimation() const { return m_pressAnimation; }
+void KeyboardController::setPressAnimation(bool enabled)
+{
+    if (m_pressAnimation == enabled) return;
+    m_pressAnimation = enabled;
+    storeSetting(QStringLiteral("pressAnimation"), enabled);
+    emit pressAnimationChanged();
+}
+
 bool KeyboardController::soundFeedback() const { return m_soundFeedback; }
 void KeyboardController::setSoundFeedback(bool enabled)
 {
     if (m_soundFeedback == enabled) return;
     m_soundFeedback = enabled;
-    QSettings().setValue(QStringLiteral("soundFeedback"), enabled);
+    storeSetting(QStringLiteral("soundFeedback"), enabled);
     emit soundFeedbackChanged();
 }
 
@@ -549,16 +834,37 @@ void KeyboardController::setCloseOnPaste(bool enabled)
 {
     if (m_closeOnPaste == enabled) return;
     m_closeOnPaste = enabled;
-    QSettings().setValue(QStringLiteral("closeOnPaste"), enabled);
+    storeSetting(QStringLiteral("closeOnPaste"), enabled);
     emit closeOnPasteChanged();
 }
 
+bool KeyboardController::followTextFocus() const { return m_followTextFocus; }
+void KeyboardController::setFollowTextFocus(bool enabled)
+{
+    if (m_followTextFocus == enabled) return;
+    m_followTextFocus = enabled;
+    m_shownForTextFocus = false;
+    storeSetting(QStringLiteral("followTextFocus"), enabled);
+    emit followTextFocusChanged();
+}
+
+bool KeyboardController::inputMethodAvailable() const { return m_inputMethod->isAvailable(); }
+
+bool KeyboardController::directClipboard() const { return m_directClipboard; }
+void KeyboardController::setDirectClipboard(bool enabled)
+{
+    if (m_directClipboard == enabled) return;
+    m_directClipboard = enabled;
+    storeSetting(QStringLiteral("directClipboard"), enabled);
+    emit directClipboardChanged();
+}
+
 bool KeyboardController::closeOnInsertShortcut() const { return m_closeOnInsertShortcut; }
 void KeyboardController::setCloseOnInsertShortcut(bool enabled)
 {
     if (m_closeOnInsertShortcut == enabled) return;
     m_closeOnInsertShortcut = enabled;
-    QSettings().setValue(QStringLiteral("closeOnInsertShortcut"), enabled);
+    storeSetting(QStringLiteral("closeOnInsertShortcut"), enabled);
     emit closeOnInsertShortcutChanged();
 }
 
@@ -568,7 +874,7 @@ void KeyboardController::setStickyPosition(int pos)
     pos = qBound(0, pos, 2);
     if (m_stickyPosition == pos) return;
     m_stickyPosition = pos;
-    QSettings().setValue(QStringLiteral("stickyPosition"), pos);
+    storeSetting(QStringLiteral("stickyPosition"), pos);
     emit stickyPositionChanged();
 }
 
@@ -578,7 +884,7 @@ void KeyboardController::setKeySpacing(int px)
     px = qBound(0, px, 10);
     if (m_keySpacing == px) return;
     m_keySpacing = px;
-    QSettings().setValue(QStringLiteral("keySpacing"), px);
+    storeSetting(QStringLiteral("keySpacing"), px);
     emit keySpacingChanged();
 }
 
@@ -587,7 +893,7 @@ void KeyboardController::setCompactMode(bool enabled)
 {
     if (m_compactMode == enabled) return;
     m_compactMode = enabled;
-    QSettings().setValue(QStringLiteral("compactMode"), enabled);
+    storeSetting(QStringLiteral("compactMode"), enabled);
     emit compactModeChanged();
 }
 
@@ -596,7 +902,7 @@ void KeyboardController::setNumpadVisible(bool visible)
 {
     if (m_numpadVisible == visible) return;
     m_numpadVisible = visible;
-    QSettings().setValue(QStringLiteral("numpadVisible"), visible);
+    storeSetting(QStringLiteral("numpadVisible"), visible);
     emit numpadVisibleChanged();
 }
 
@@ -608,12 +914,15 @@ void KeyboardController::setAutostartEnabled(bool enabled)
     QString destPath = autostartFilePath();
     if (enabled) {
         QDir().mkpath(QFileInfo(destPath).path());
+        // The osk launcher next to us, not osk-ui: it takes the instance
+        // lock and starts osk-daemon first
+        const QString launcher = QDir(QCoreApplication::applicationDirPath()).filePath(QStringLiteral("osk"));
         QFile f(destPath);
         if (f.open(QIODevice::WriteOnly | QIODevice::Text)) {
             f.write("[Desktop Entry]\n"
                     "Type=Application\n"
                     "Name=OSK\n"
-                    "Exec=" + QCoreApplication::applicationFilePath().toUtf8() + "\n"
+                    "Exec=" + launcher.toUtf8() + "\n"
                     "Icon=input-keyboard\n"
                     "X-GNOME-Autostart-enabled=true\n");
             f.close();
@@ -633,7 +942,7 @@ void KeyboardController::setGlobalShortcut(const QString &shortcut)
     QKeySequence seq(shortcut);
     if (seq.isEmpty()) return;
     m_globalShortcut = shortcut;
-    QSettings().setValue(QStringLiteral("globalShortcut"), shortcut);
+    storeSetting(QStringLiteral("globalShortcut"), shortcut);
     if (m_toggleAction)
         KGlobalAccel::self()->setShortcut(m_toggleAction, {seq});
     emit globalShortcutChanged();
@@ -645,10 +954,508 @@ void KeyboardController::setDefaultScreen(int index)
     index = qBound(0, index, qMax(0, QGuiApplication::screens().size() - 1));
     if (m_defaultScreen == index) return;
     m_defaultScreen = index;
-    QSettings().setValue(QStringLiteral("defaultScreen"), index);
+    storeSetting(QStringLiteral("defaultScreen"), index);
     emit defaultScreenChanged();
 }
 
+// ---------------------------------------------------------------------------
+// Word completion
+// ---------------------------------------------------------------------------
+bool KeyboardController::wordCompletion() const { return m_wordCompletion; }
+void KeyboardController::setWordCompletion(bool enabled)
+{
+    if (m_wordCompletion == enabled) return;
+    m_wordCompletion = enabled;
+    storeSetting(QStringLiteral("wordCompletion"), enabled);
+    if (enabled)
+        loadCompletionDictionary();
+    else
+        clearSuggestions();
+    emit wordCompletionChanged();
+}
+
+bool KeyboardController::shortcutSuggestions() const { return m_shortcutSuggestions; }
+void KeyboardController::setShortcutSuggestions(bool enabled)
+{
+    if (m_shortcutSuggestions == enabled) return;
+    m_shortcutSuggestions = enabled;
+    storeSetting(QStringLiteral("shortcutSuggestions"), enabled);
+    if (!enabled)
+        clearSuggestions();
+    emit shortcutSuggestionsChanged();
+}
+
+void KeyboardController::loadCompletionDictionary()
+{
+    if (m_dictionary->isOpen()) return;
+
+    const QString source = CompletionDictionary::defaultSourcePath();
+    const QString compiled = CompletionDictionary::compiledPath();
+    // A cache of an older format does not open and is compiled again
+    if (CompletionDictionary::isUpToDate(source, compiled) && m_dictionary->open(compiled))
+        return;
+    if (source.isEmpty()) return;
+
+    // Compile the word list off the GUI thread; the result is only mapped
+    QThread *worker = QThread::create([source, compiled]() {
+        if (!CompletionDictionary::compile(source, compiled))
+            qWarning("Failed to compile completion dictionary from %s", qPrintable(source));
+    });
+    connect(worker, &QThread::finished, this, [this, worker, compiled]() {
+        worker->deleteLater();
+        if (m_wordCompletion || m_swipeTyping)
+            m_dictionary->open(compiled);
+    });
+    worker->start(QThread::LowPriority);
+}
+
+QVariantList KeyboardController::suggestions() const
+{
+    QVariantList out;
+    out.reserve(m_suggestions.size());
+    for (const Suggestion &suggestion : m_suggestions) {
+        QVariantMap item;
+        item[QStringLiteral("text")] = suggestion.text;
+        item[QStringLiteral("undo")] = suggestion.kind == Suggestion::UndoCorrection;
+        item[QStringLiteral("shortcut")] = suggestion.kind == Suggestion::Shortcut;
+        item[QStringLiteral("detail")] = suggestion.detail;
+        out.append(item);
+    }
+    return out;
+}
+
+QString KeyboardController::currentWord() const
+{
+    // Trailing run of letters (and apostrophes) in the type buffer
+    const std::u16string_view buffer = m_core.buffer().view();
+    std::size_t start = buffer.size();
+    while (start > 0) {
+        const QChar c(buffer[start - 1]);
+        if (!c.isLetter() && c != QLatin1Char('\'')) break;
+        --start;
+    }
+    return QString::fromUtf16(buffer.data() + start, qsizetype(buffer.size() - start));
+}
+
+// Applies the capitalization of what the user typed to a lower-case word
+static QString matchCase(QString word, const QString &typed)
+{
+    if (typed.isEmpty() || word.isEmpty()) return word;
+    if (typed.size() > 1 && typed == typed.toUpper())
+        return word.toUpper();
+    if (typed.at(0).isUpper())
+        word[0] = word.at(0).toUpper();
+    return word;
+}
+
+void KeyboardController::updateSuggestions()
+{
+    // Shortcuts whose trigger is being typed come first
+    QList<Suggestion> suggestions = shortcutSuggestions(3);
+
+    const QString word = currentWord();
+    if (m_wordCompletion && m_dictionary->isOpen() && !word.isEmpty() && suggestions.size() < 3) {
+        // Ask for one extra so the word itself can be dropped
+        const QStringList found = m_dictionary->complete(word, 4);
+        for (const QString &candidate : found) {
+            if (candidate.size() <= word.size()) continue;
+            suggestions.append({matchCase(candidate, word), Suggestion::Completion});
+            if (suggestions.size() == 3) break;
+        }
+    }
+    setSuggestions(suggestions);
+}
+
+// Most used shortcuts extending the type buffer that the focused window's
+// scope would expand
+QList<KeyboardController::Suggestion> KeyboardController::shortcutSuggestions(int limit) const
+{
+    if (!m_shortcutSuggestions || m_shortcutPageVisible || m_core.buffer().isEmpty()) return {};
+
+    auto expands = [this](std::u16string_view trigger) {
+        const auto match = m_core.matchTrigger(trigger);
+        return match && match->length == trigger.size();
+    };
+    PrefixIndex::Candidate found[3];
+    const std::size_t count = m_triggerIndex.complete(
+        m_core.buffer().view(), std::span(found, std::min<std::size_t>(limit, std::size(found))), expands);
+
+    QList<Suggestion> out;
+    for (std::size_t i = 0; i < count; ++i) {
+        const ShortcutLibrary::Entry shortcut =
+            m_shortcutLibrary->entryById(shortcutAt(*m_core.matchTrigger(found[i].trigger)));
+        QString detail = shortcut.expansion.section(QLatin1Char('\n'), 0, 0);
+        if (detail.size() > 24)
+            detail = detail.left(23) + QChar(0x2026);
+        out.append({shortcut.trigger, Suggestion::Shortcut, detail});
+    }
+    return out;
+}
+
+void KeyboardController::setSuggestions(const QList<Suggestion> &suggestions)
+{
+    if (m_suggestions == suggestions) return;
+    m_suggestions = suggestions;
+    emit suggestionsChanged();
+}
+
+void KeyboardController::clearSuggestions()
+{
+    setSuggestions({});
+}
+
+void KeyboardController::acceptSuggestion(int index)
+{
+    if (index < 0 || index >= m_suggestions.size()) return;
+    const Suggestion suggestion = m_suggestions.at(index);
+
+    switch (suggestion.kind) {
+    case Suggestion::Completion: {
+        const QString word = currentWord();
+        if (!suggestion.text.startsWith(word, Qt::CaseInsensitive)) return;
+        // Only the missing tail is typed; the prefix is already in the app
+        const QString rest = suggestion.text.mid(word.size());
+        insertText(rest);
+        m_core.buffer().append(ShortcutMatcher::view(rest));
+        m_bufferTimer.start();
+        break;
+    }
+    case Suggestion::SwipeAlternative: {
+        // Replace the word the swipe committed
+        const QString replacement = suggestion.text + QLatin1Char(' ');
+        if (m_inputMethod->canReplace(m_lastSwipeWord)) {
+            m_inputMethod->replace(m_lastSwipeWord, replacement);
+        } else {
+            for (int i = 0; i < m_lastSwipeWord.size(); ++i)
+                m_vk->sendKey(KEY_BACKSPACE);
+            typeText(replacement);
+        }
+        m_lastSwipeWord = replacement;
+        break;
+    }
+    case Suggestion::UndoCorrection: {
+        // Put back what was typed, keeping the separator
+        const QString corrected = m_lastCorrection.replacement + m_lastCorrection.separator;
+        const QString original = m_lastCorrection.original + m_lastCorrection.separator;
+        if (m_inputMethod->canReplace(corrected)) {
+            m_inputMethod->replace(corrected, original);
+        } else {
+            for (int i = 0; i < corrected.size(); ++i)
+                m_vk->sendKey(KEY_BACKSPACE);
+            typeText(original);
+        }
+        m_lastCorrection = {};
+        break;
+    }
+    case Suggestion::Shortcut:
+        // Expands now: what was typed of the trigger is replaced
+        if (const auto match = m_core.matchTrigger(ShortcutMatcher::view(suggestion.text));
+            match && match->length == std::size_t(suggestion.text.size()) && m_vk && m_vk->isReady())
+            expandShortcut(m_shortcutLibrary->entryById(shortcutAt(*match)), int(m_core.buffer().size()));
+        break;
+    }
+    clearSuggestions();
+}
+
+// ---------------------------------------------------------------------------
+// Swipe typing
+// ---------------------------------------------------------------------------
+bool KeyboardController::swipeTyping() const { return m_swipeTyping; }
+void KeyboardController::setSwipeTyping(bool enabled)
+{
+    if (m_swipeTyping == enabled) return;
+    m_swipeTyping = enabled;
+    storeSetting(QStringLiteral("swipeTyping"), enabled);
+    if (enabled)
+        loadCompletionDictionary();
+    emit swipeTypingChanged();
+}
+
+void KeyboardController::setKeyGeometry(const QString &letter, qreal x, qreal y, qreal w, qreal h)
+{
+    if (letter.size() != 1) return;
+    m_swipeDecoder->setKey(letter.at(0), QRectF(x, y, w, h));
+}
+
+void KeyboardController::clearKeyGeometry()
+{
+    m_swipeDecoder->clearKeys();
+}
+
+void KeyboardController::commitSwipe(const QVariantList &points)
+{
+    if (!m_vk || !m_vk->isReady() || !m_dictionary->isOpen()) return;
+
+    QVector<QPointF> stroke;
+    stroke.reserve(points.size());
+    for (const QVariant &p : points)
+        stroke.append(p.toPointF());
+
+    QStringList words = m_swipeDecoder->decode(stroke, *m_dictionary, 4);
+    if (words.isEmpty()) return;
+
+    for (QString &word : words) {
+        if (capsLockActive())
+            word = word.toUpper();
+        else if (shiftActive())
+            word[0] = word.at(0).toUpper();
+    }
+    resetOneShot();
+
+    m_lastSwipeWord = words.takeFirst() + QLatin1Char(' ');
+    insertText(m_lastSwipeWord);
+    m_core.resetBuffer(true);
+    m_bufferTimer.stop();
+
+    QList<Suggestion> alternatives;
+    for (const QString &word : std::as_const(words))
+        alternatives.append({word, Suggestion::SwipeAlternative});
+    setSuggestions(alternatives);
+}
+
+// ---------------------------------------------------------------------------
+// Flick gestures
+// ---------------------------------------------------------------------------
+bool KeyboardController::flickGestures() const { return m_flickGestures; }
+void KeyboardController::setFlickGestures(bool enabled)
+{
+    if (m_flickGestures == enabled) return;
+    m_flickGestures = enabled;
+    storeSetting(QStringLiteral("flickGestures"), enabled);
+    emit flickGesturesChanged();
+}
+
+void KeyboardController::flickBegin(int keyCode, qreal x, qreal y, qreal keyHeight)
+{
+    m_flickKey = keyCode;
+    m_flick.begin(QPointF(x, y), m_flickClock.elapsed(), keyHeight);
+}
+
+QString KeyboardController::flickUpdate(qreal x, qreal y)
+{
+    const FlickRecognizer::Direction direction = m_flick.update(QPointF(x, y), m_flickClock.elapsed());
+    if (direction == FlickRecognizer::None) return QString();
+    return typeAlternate(m_flickKey, direction);
+}
+
+QString KeyboardController::typeShifted(int keyCode)
+{
+    return typeAlternate(keyCode, FlickRecognizer::Up);
+}
+
+// Types the alternate directly at its level: the global modifiers (and the
+// property notifications every key listens to) are left alone
+QString KeyboardController::typeAlternate(int keyCode, FlickRecognizer::Direction direction)
+{
+    uint8_t level = direction == FlickRecognizer::Up ? KeyMap::Shift : KeyMap::AltGr;
+    QString text = direction == FlickRecognizer::Down ? m_flickAlternates.value(keyCode) : QString();
+    if (text.isEmpty()) {
+        const char32_t ch = m_keymap->character(keyCode, level);
+        if (ch < 0x20 || ch == 0x7f) return QString();
+        text = QString::fromUcs4(&ch, 1);
+    } else {
+        level = 0xff;   // free text, typed through the keymap
+    }
+
+    resetAutoHideTimer();
+    if (m_soundFeedback)
+        QApplication::beep();
+
+    if (m_textInputMode && m_window) {
+        QKeyEvent press(QEvent::KeyPress, 0, Qt::NoModifier, text);
+        QKeyEvent release(QEvent::KeyRelease, 0, Qt::NoModifier, text);
+        QCoreApplication::sendEvent(m_window, &press);
+        QCoreApplication::sendEvent(m_window, &release);
+        return text;
+    }
+    if (!m_vk || !m_vk->isReady()) return QString();
+
+    if (m_core.buffer().isEmpty() && !m_scopedMatchers.isEmpty())
+        refreshActiveWindowClass();
+    m_core.buffer().append(ShortcutMatcher::view(text));
+    m_bufferTimer.start();
+
+    if (level == 0xff) {
+        // Recorded as the keys that type it; characters off the layout
+        // have none and are left out
+        for (const char32_t ch : text.toUcs4()) {
+            uint8_t charLevel = 0;
+            const int code = m_keymap->fromChar(ch, &charLevel);
+            if (code >= 0)
+                m_macroEngine->record(code, macroLevel(charLevel));
+        }
+        typeText(text);
+    } else {
+        m_macroEngine->record(keyCode, macroLevel(level));
+        m_vk->sendKeyAtLevel(uint32_t(keyCode), level & KeyMap::Shift, level & KeyMap::AltGr);
+    }
+
+    if (!m_shortcutPageVisible)
+        checkShortcutExpansion();
+    if (m_core.buffer().isEmpty())
+        clearSuggestions();
+    else
+        updateSuggestions();
+    return text;
+}
+
+// ---------------------------------------------------------------------------
+// Autocorrect
+// ---------------------------------------------------------------------------
+bool KeyboardController::autocorrect() const { return m_autocorrect; }
+void KeyboardController::setAutocorrect(bool enabled)
+{
+    if (m_autocorrect == enabled) return;
+    m_autocorrect = enabled;
+    storeSetting(QStringLiteral("autocorrect"), enabled);
+    if (enabled)
+        loadAutocorrectIndex();
+    emit autocorrectChanged();
+}
+
+void KeyboardController::loadAutocorrectIndex()
+{
+    if (m_autocorrectIndex->isOpen()) return;
+
+    const QString source = CompletionDictionary::defaultSourcePath();
+    const QString compiled = AutocorrectIndex::compiledPath();
+    if (CompletionDictionary::isUpToDate(source, compiled) && m_autocorrectIndex->open(compiled))
+        return;
+    if (source.isEmpty()) return;
+
+    // Generating the deletes is the expensive part; keep it off the GUI thread
+    QThread *worker = QThread::create([source, compiled]() {
+        if (!AutocorrectIndex::compile(source, compiled))
+            qWarning("Failed to build autocorrect index from %s", qPrintable(source));
+    });
+    connect(worker, &QThread::finished, this, [this, worker, compiled]() {
+        worker->deleteLater();
+        if (m_autocorrect)
+            m_autocorrectIndex->open(compiled);
+    });
+    worker->start(QThread::LowPriority);
+}
+
+// Replaces the word just finished with its correction, before the separator
+// is sent. Returns true when a correction was typed.
+bool KeyboardController::autocorrectWord(QChar separator)
+{
+    if (!m_autocorrect || !m_autocorrectIndex->isOpen()) return false;
+
+    const QString word = currentWord();
+    // Only whole words: the buffer may have started mid-word after a pause
+    const TypeBuffer &buffer = m_core.buffer();
+    if (word.isEmpty() || (std::size_t(word.size()) == buffer.size() && !buffer.atWordStart()))
+        return false;
+
+    const QString correction = m_autocorrectIndex->correct(word);
+    if (correction.isEmpty()) return false;
+
+    m_lastCorrection = {word, matchCase(correction, word), separator};
+    for (int i = 0; i < word.size(); ++i)
+        m_vk->sendKey(KEY_BACKSPACE);
+    typeText(m_lastCorrection.replacement);
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Macros
+// ---------------------------------------------------------------------------
+bool KeyboardController::macroRecording() const { return m_macroEngine->isRecording(); }
+bool KeyboardController::macroPlaying() const { return m_macroEngine->isPlaying(); }
+QVariantList KeyboardController::macros() const
+{
+    // Expose metadata only; the packed events stay on the C++ side
+    QVariantList out;
+    out.reserve(m_macros.size());
+    for (const QVariant &v : m_macros) {
+        const QVariantMap entry = v.toMap();
+        QVariantMap info;
+        info[QStringLiteral("name")] = entry.value(QStringLiteral("name"));
+        info[QStringLiteral("trigger")] = entry.value(QStringLiteral("trigger"));
+        info[QStringLiteral("keys")] = MacroEngine::eventCount(
+            entry.value(QStringLiteral("events")).toByteArray());
+        out.append(info);
+    }
+    return out;
+}
+
+int KeyboardController::macroRate() const { return m_macroEngine->rate(); }
+void KeyboardController::setMacroRate(int keysPerSecond)
+{
+    keysPerSecond = qBound(0, keysPerSecond, 1000);
+    if (m_macroEngine->rate() == keysPerSecond) return;
+    m_macroEngine->setRate(keysPerSecond);
+    storeSetting(QStringLiteral("macroRate"), keysPerSecond);
+    emit macroRateChanged();
+}
+
+void KeyboardController::toggleMacroRecording()
+{
+    if (!m_macroEngine->isRecording()) {
+        m_macroEngine->startRecording();
+        return;
+    }
+
+    const QByteArray events = m_macroEngine->stopRecording();
+    if (events.isEmpty()) return;
+
+    QVariantMap entry;
+    entry[QStringLiteral("name")] = QStringLiteral("Macro %1").arg(m_macros.size() + 1);
+    entry[QStringLiteral("trigger")] = QString();
+    entry[QStringLiteral("events")] = events;
+    m_macros.append(entry);
+    saveMacros();
+    emit macrosChanged();
+}
+
+void KeyboardController::playMacro(int index)
+{
+    if (index < 0 || index >= m_macros.size()) return;
+    m_macroEngine->play(m_macros.at(index).toMap().value(QStringLiteral("events")).toByteArray());
+}
+
+void KeyboardController::playLastMacro()
+{
+    if (m_macroEngine->isPlaying())
+        m_macroEngine->stop();
+    else
+        playMacro(m_macros.size() - 1);
+}
+
+void KeyboardController::stopMacro()
+{
+    m_macroEngine->stop();
+}
+
+void KeyboardController::removeMacro(int index)
+{
+    if (index < 0 || index >= m_macros.size()) return;
+    m_macros.removeAt(index);
+    saveMacros();
+    emit macrosChanged();
+}
+
+void KeyboardController::setMacroTrigger(int index, const QString &trigger)
+{
+    if (index < 0 || index >= m_macros.size()) return;
+    QVariantMap entry = m_macros.at(index).toMap();
+    entry[QStringLiteral("trigger")] = trigger;
+    m_macros[index] = entry;
+    saveMacros();
+    emit macrosChanged();
+}
+
+void KeyboardController::saveMacros()
+{
+    storeSetting(QStringLiteral("macros"), m_macros);
+}
+
+uint16_t KeyboardController::currentModifierMask() const
+{
+    return m_core.modifiers().activeMask();
+}
+
 void KeyboardController::setToggleAction(QAction *action)
 {
     m_toggleAction = action;
@@ -669,8 +1476,15 @@ QString KeyboardController::autostartFilePath() const
     return QDir::homePath() + QStringLiteral("/.config/autostart/osk.desktop");
 }
 
+PasteSequencer::Route KeyboardController::pasteRoute() const
+{
+    return m_directClipboard ? PasteSequencer::Route::Direct : PasteSequencer::Route::Klipper;
+}
+
 void KeyboardController::sendPaste()
 {
+    m_holdKeysForPaste = false;
+    const QList<int> keys = std::exchange(m_keysAfterPaste, {});
     if (!m_vk || !m_vk->isReady()) return;
 
     // Terminals need Ctrl+Shift+V instead of Ctrl+V.
@@ -679,11 +1493,12 @@ void KeyboardController::sendPaste()
     bool useShift = m_savedWindowIsTerminal;
     m_savedWindowIsTerminal = false;
 
-    if (useShift) m_vk->sendKeyPress(KEY_LEFTSHIFT);
-    m_vk->sendKeyPress(KEY_LEFTCTRL);
-    m_vk->sendKey(KEY_V);
-    m_vk->sendKeyRelease(KEY_LEFTCTRL);
-    if (useShift) m_vk->sendKeyRelease(KEY_LEFTSHIFT);
+    m_vk->sendKeyWith(KEY_V, ModifierState::Ctrl | (useShift ? ModifierState::Shift : 0));
+
+    // Keys held for this paste, in order; one may start another paste, and
+    // the rest then wait for that one
+    for (const int keyCode : keys)
+        pressKey(keyCode);
 }
 
 // ---------------------------------------------------------------------------
@@ -705,19 +1520,30 @@ void KeyboardController::setClipboardPageVisible(bool visible)
 }
 
 QStringList KeyboardController::clipboardHistory() const { return m_clipboardHistory; }
+QObject *KeyboardController::clipboardModel() const { return m_clipboardModel; }
 
 void KeyboardController::refreshClipboardHistory()
 {
-    QDBusInterface klipper(QStringLiteral("org.kde.klipper"),
-                           QStringLiteral("/klipper"),
-                           QStringLiteral("org.kde.klipper.klipper"));
-    QDBusReply<QStringList> reply = klipper.call(QStringLiteral("getClipboardHistoryMenu"));
+    if (m_nativeClipboard) {
+        updateStoredClipboardModel();
+        return;
+    }
+
+    QDBusReply<QStringList> reply;
+    {
+        OSK_TRACE_SCOPE("D-Bus klipper.getClipboardHistoryMenu");
+        QDBusInterface klipper(QStringLiteral("org.kde.klipper"),
+                               QStringLiteral("/klipper"),
+                               QStringLiteral("org.kde.klipper.klipper"));
+        reply = klipper.call(QStringLiteral("getClipboardHistoryMenu"));
+    }
 
     if (reply.isValid()) {
         m_clipboardHistory = reply.value();
     } else {
         m_clipboardHistory.clear();
     }
+    m_clipboardModel->setEntries(m_clipboardHistory);
     emit clipboardHistoryChanged();
 }
 
@@ -725,92 +1551,298 @@ void KeyboardController::insertClipboardEntry(const QString &text)
 {
     if (text.isEmpty()) return;
 
-    // Tell Klipper to select this entry (moves it to top of its history)
-    QDBusInterface klipper(QStringLiteral("org.kde.klipper"),
-                           QStringLiteral("/klipper"),
-                           QStringLiteral("org.kde.klipper.klipper"));
-    klipper.call(QStringLiteral("setClipboardContents"), text);
+    // The sequencer sets the clipboard (Klipper moves the entry to the top
+    // of its history; the native store sees the change and does the same)
+    // and gives focus back to the previous window before pasting
+    const QString windowId = m_savedWindowId;
+    m_savedWindowId.clear();
+    if (m_inputMethod->isActive()) {
+        // The field still has focus: no clipboard round trip needed
+        m_inputMethod->commitString(text);
+    } else {
+        PasteSequencer::Route route = pasteRoute();
+        if (route == PasteSequencer::Route::Klipper && m_nativeClipboard)
+            route = PasteSequencer::Route::Local;
+        m_pasteSequencer->start(text, route, windowId);
+    }
 
-    // Update local list immediately
-    m_clipboardHistory.removeAll(text);
-    m_clipboardHistory.prepend(text);
-    emit clipboardHistoryChanged();
+    if (!m_nativeClipboard) {
+        // Update local list immediately
+        m_clipboardHistory.removeAll(text);
+        m_clipboardHistory.prepend(text);
+        m_clipboardModel->setEntries(m_clipboardHistory);
+        emit clipboardHistoryChanged();
+    }
 
-    // Restore focus to the previous window so paste lands in the right place
-    restoreActiveWindow();
     m_textInputMode = false;
 
     if (m_closeOnPaste) {
         setClipboardPageVisible(false);
     }
+}
+
+void KeyboardController::pasteClipboardRow(int row)
+{
+    // Native entries are listed from their previews; the body is read now
+    if (m_nativeClipboard)
+        insertClipboardEntry(m_clipboardStore->load(m_clipboardModel->entryId(row)));
+    else
+        insertClipboardEntry(m_clipboardModel->entryText(row));
+}
+
+void KeyboardController::removeClipboardRow(int row)
+{
+    if (!m_nativeClipboard) return;
+    m_clipboardStore->remove(m_clipboardModel->entryId(row));
+}
+
+QString KeyboardController::clipboardBackend() const
+{
+    return m_nativeClipboard ? QStringLiteral("native") : QStringLiteral("klipper");
+}
+
+void KeyboardController::setClipboardBackend(const QString &backend)
+{
+    const bool native = backend == QLatin1String("native");
+    if (m_nativeClipboard == native) return;
+    if (native && !openClipboardStore()) {
+        // The selector snaps back to Klipper
+        emit clipboardBackendChanged();
+        return;
+    }
+    m_nativeClipboard = native;
+    storeSetting(QStringLiteral("clipboardBackend"), clipboardBackend());
+    refreshClipboardHistory();
+    emit clipboardBackendChanged();
+}
 
-    // Paste via Ctrl+V after the window manager restores focus.
-    QTimer::singleShot(150, this, [this]() {
-        sendPaste();
+bool KeyboardController::openClipboardStore()
+{
+    if (m_clipboardStore) return true;
+    m_clipboardStore = new ClipboardStore(ClipboardStore::defaultDirectory(), this);
+    if (!m_clipboardStore->open()) {
+        qWarning("Falling back to Klipper for the clipboard history");
+        delete m_clipboardStore;
+        m_clipboardStore = nullptr;
+        return false;
+    }
+
+    connect(m_clipboardStore, &ClipboardStore::entriesChanged,
+            this, &KeyboardController::updateStoredClipboardModel);
+    // Seen without keyboard focus, unlike QClipboard::dataChanged
+    KSystemClipboard *clipboard = KSystemClipboard::instance();
+    connect(clipboard, &KSystemClipboard::changed, this, [this, clipboard](QClipboard::Mode mode) {
+        if (mode != QClipboard::Clipboard || !m_nativeClipboard) return;
+        const QMimeData *mime = clipboard->mimeData(mode);
+        // Our own transient pastes and password managers mark their text
+        if (!mime || mime->data(QString::fromLatin1(ClipboardOwner::PasswordHint)) == "secret")
+            return;
+        m_clipboardStore->add(mime->text());
     });
+    updateStoredClipboardModel();
+    return true;
+}
+
+void KeyboardController::updateStoredClipboardModel()
+{
+    if (!m_nativeClipboard) return;
+    QVector<ClipboardModel::StoredEntry> entries;
+    const QVector<ClipboardStore::Summary> summaries = m_clipboardStore->entries();
+    entries.reserve(summaries.size());
+    for (const ClipboardStore::Summary &summary : summaries) {
+        ClipboardModel::Preview preview;
+        preview.text = summary.preview;
+        preview.length = summary.length;
+        preview.lineCount = summary.lineCount;
+        preview.ready = true;
+        entries.append({summary.hash, preview});
+    }
+    m_clipboardModel->setStoredEntries(entries);
 }
 
 // ---------------------------------------------------------------------------
 // Shortcuts CRUD
 // ---------------------------------------------------------------------------
-QVariantList KeyboardController::shortcuts() const { return m_shortcuts; }
+QObject *KeyboardController::shortcutModel() const { return m_shortcutLibrary; }
+int KeyboardController::shortcutCount() const { return m_shortcutLibrary->count(); }
+
+QVariantMap KeyboardController::shortcutAt(int index) const
+{
+    if (index < 0 || index >= m_shortcutLibrary->count()) return {};
+    const ShortcutLibrary::Entry entry = m_shortcutLibrary->entry(index);
+    return {
+        {QStringLiteral("shortcut"), entry.trigger},
+        {QStringLiteral("expansion"), entry.expansion},
+        {QStringLiteral("scope"), entry.scope},
+    };
+}
 
-void KeyboardController::addShortcut(const QString &shortcut, const QString &expansion)
+void KeyboardController::addShortcut(const QString &shortcut, const QString &expansion,
+                                     const QString &scope)
 {
     if (shortcut.isEmpty() || expansion.isEmpty()) return;
-    QVariantMap entry;
-    entry[QStringLiteral("shortcut")] = shortcut;
-    entry[QStringLiteral("expansion")] = expansion;
-    m_shortcuts.append(entry);
-    saveShortcuts();
-    emit shortcutsChanged();
+    m_shortcutLibrary->append({shortcut, expansion, scope.trimmed().toLower()});
 }
 
-void KeyboardController::editShortcut(int index, const QString &shortcut, const QString &expansion)
+void KeyboardController::editShortcut(int index, const QString &shortcut, const QString &expansion,
+                                      const QString &scope)
 {
-    if (index < 0 || index >= m_shortcuts.size()) return;
+    if (index < 0 || index >= m_shortcutLibrary->count()) return;
     if (shortcut.isEmpty() || expansion.isEmpty()) return;
-    QVariantMap entry;
-    entry[QStringLiteral("shortcut")] = shortcut;
-    entry[QStringLiteral("expansion")] = expansion;
-    m_shortcuts[index] = entry;
-    saveShortcuts();
-    emit shortcutsChanged();
+    m_shortcutLibrary->replace(index, {shortcut, expansion, scope.trimmed().toLower()});
 }
 
 void KeyboardController::removeShortcut(int index)
 {
-    if (index < 0 || index >= m_shortcuts.size()) return;
-    m_shortcuts.removeAt(index);
-    saveShortcuts();
-    emit shortcutsChanged();
+    m_shortcutLibrary->remove(index);
+}
+
+void KeyboardController::importShortcuts()
+{
+    OSK_TRACE_SCOPE("KeyboardController::importShortcuts");
+    const QString path = QFileDialog::getOpenFileName(nullptr,
+        QStringLiteral("Import Shortcuts"), QDir::homePath(),
+        QStringLiteral("Shortcut files (*.json);;All files (*)"));
+    if (path.isEmpty()) return;
+    if (m_shortcutLibrary->importFile(path) < 0)
+        qWarning("Failed to import shortcuts from %s", qPrintable(path));
+}
+
+void KeyboardController::exportShortcuts()
+{
+    OSK_TRACE_SCOPE("KeyboardController::exportShortcuts");
+    const QString path = QFileDialog::getSaveFileName(nullptr,
+        QStringLiteral("Export Shortcuts"), QDir::homePath() + QStringLiteral("/osk-shortcuts.json"),
+        QStringLiteral("Shortcut files (*.json);;All files (*)"));
+    if (path.isEmpty()) return;
+    if (!m_shortcutLibrary->exportFile(path))
+        qWarning("Failed to export shortcuts to %s", qPrintable(path));
 }
 
 void KeyboardController::insertShortcutExpansion(int index)
 {
-    if (index < 0 || index >= m_shortcuts.size()) return;
-    QVariantMap entry = m_shortcuts.at(index).toMap();
-    QString expansion = entry.value(QStringLiteral("expansion")).toString();
+    if (index < 0 || index >= m_shortcutLibrary->count()) return;
+    QString expansion = m_shortcutLibrary->entry(index).expansion;
     if (expansion.isEmpty()) return;
 
     if (m_closeOnInsertShortcut) {
         setShortcutPageVisible(false);
     }
 
+    if (m_inputMethod->isActive()) {
+        m_inputMethod->commitString(expansion);
+        return;
+    }
     // Set clipboard and paste via Ctrl+V for reliable insertion
-    QDBusInterface klipper(QStringLiteral("org.kde.klipper"),
-                           QStringLiteral("/klipper"),
-                           QStringLiteral("org.kde.klipper.klipper"));
-    klipper.call(QStringLiteral("setClipboardContents"), expansion);
+    m_pasteSequencer->start(expansion, pasteRoute(), QString());
+}
 
-    QTimer::singleShot(150, this, [this]() {
-        sendPaste();
-    });
+// Each shortcut goes into its scope's matcher only, global ones into the
+// global matcher. Among equals the later row wins.
+void KeyboardController::addToMatchers(ShortcutLibrary::EntryId id, quint32 serial)
+{
+    const ShortcutLibrary::View entry = m_shortcutLibrary->view(id);
+    if (entry.trigger.empty() || entry.expansion.empty()) return;
+    if (entry.scope.empty()) {
+        m_globalMatcher.insert(serial, id, entry.trigger);
+        return;
+    }
+    // Looked up in place; only a new scope's name is copied
+    const QString scope = QString::fromRawData(reinterpret_cast<const QChar *>(entry.scope.data()),
+                                               qsizetype(entry.scope.size()));
+    auto it = m_scopedMatchers.find(scope);
+    if (it == m_scopedMatchers.end())
+        it = m_scopedMatchers.insert(QString(scope.constData(), scope.size()), ShortcutMatcher());
+    it->insert(serial, id, entry.trigger);
+}
+
+void KeyboardController::removeFromMatchers(ShortcutLibrary::EntryId id, quint32 serial)
+{
+    const ShortcutLibrary::View entry = m_shortcutLibrary->view(id);
+    if (entry.scope.empty()) {
+        m_globalMatcher.remove(serial, entry.trigger);
+        return;
+    }
+    auto it = m_scopedMatchers.find(QString::fromRawData(reinterpret_cast<const QChar *>(entry.scope.data()),
+                                                         qsizetype(entry.scope.size())));
+    if (it == m_scopedMatchers.end()) return;
+    it->remove(serial, entry.trigger);
+    if (it->size() == 0)
+        m_scopedMatchers.erase(it);
+}
+
+// The matchers and the trigger index hold library ids and views of the
+// library's text, so this copies no strings; it runs at startup and again
+// whenever the library moves to a new snapshot
+void KeyboardController::loadShortcuts()
+{
+    m_globalMatcher.clear();
+    m_scopedMatchers.clear();
+    m_shortcutSerials.clear();
+    m_triggerIndex.clear();
+    addShortcutRows(0, m_shortcutLibrary->count() - 1);
+}
+
+void KeyboardController::addShortcutRows(int first, int last)
+{
+    std::vector<PrefixIndex::Item> items;
+    items.reserve(std::size_t(std::max(0, last - first + 1)));
+    for (int row = first; row <= last; ++row) {
+        const ShortcutLibrary::EntryId id = m_shortcutLibrary->entryId(row);
+        const quint32 serial = m_nextShortcutSerial++;
+        m_shortcutSerials.insert(row, serial);
+        addToMatchers(id, serial);
+        items.push_back({m_shortcutLibrary->view(id).trigger, m_shortcutLibrary->uses(row)});
+    }
+    m_triggerIndex.add(items);
+    selectShortcutMatcher();
+}
+
+void KeyboardController::removeShortcutRow(int row)
+{
+    const ShortcutLibrary::EntryId id = m_shortcutLibrary->entryId(row);
+    removeFromMatchers(id, m_shortcutSerials.takeAt(row));
+    m_triggerIndex.remove(m_shortcutLibrary->view(id).trigger);
+    selectShortcutMatcher();
 }
 
-void KeyboardController::saveShortcuts()
+// The row's previous version stays readable until the library next moves
+void KeyboardController::replaceShortcutRow(int row, ShortcutLibrary::EntryId before)
 {
-    QSettings().setValue(QStringLiteral("shortcuts"), m_shortcuts);
+    const ShortcutLibrary::EntryId id = m_shortcutLibrary->entryId(row);
+    const quint32 serial = m_shortcutSerials.at(row);
+    removeFromMatchers(before, serial);
+    addToMatchers(id, serial);
+    const std::u16string_view trigger = m_shortcutLibrary->view(id).trigger;
+    const std::u16string_view previous = m_shortcutLibrary->view(before).trigger;
+    if (trigger != previous) {
+        m_triggerIndex.remove(previous);
+        m_triggerIndex.add(trigger, m_shortcutLibrary->uses(row));
+    }
+    selectShortcutMatcher();
+}
+
+void KeyboardController::selectShortcutMatcher()
+{
+    const ShortcutMatcher *matcher = nullptr;
+    if (!m_activeWindowClass.isEmpty() && !m_scopedMatchers.isEmpty()) {
+        // Full class, then its last component ("org.kde.konsole" → "konsole"),
+        // then the "terminal" group
+        auto it = m_scopedMatchers.constFind(m_activeWindowClass);
+        if (it == m_scopedMatchers.cend())
+            it = m_scopedMatchers.constFind(m_activeWindowClass.section(QLatin1Char('.'), -1));
+        if (it == m_scopedMatchers.cend() && isTerminalClass(m_activeWindowClass))
+            it = m_scopedMatchers.constFind(QStringLiteral("terminal"));
+        if (it != m_scopedMatchers.cend())
+            matcher = &it.value();
+    }
+    m_scopedMatcher = matcher;
+    m_core.setTriggers(&m_globalMatcher.table(), matcher ? &matcher->table() : nullptr);
+}
+
+ShortcutLibrary::EntryId KeyboardController::shortcutAt(const KeyboardCore::TriggerMatch &match) const
+{
+    return (match.scoped ? m_scopedMatcher : &m_globalMatcher)->entryAt(match.id);
 }
 
 // ---------------------------------------------------------------------------
@@ -819,8 +1851,32 @@ void KeyboardController::saveShortcuts()
 void KeyboardController::setWindow(QQuickWindow *window)
 {
     m_window = window;
-    if (m_window && !m_pendingRegion.isEmpty())
+    if (!m_window) return;
+    if (!m_pendingRegion.isEmpty())
         m_window->setMask(m_pendingRegion);
+    m_window->setPersistentSceneGraph(m_releaseHiddenDelay == 0);
+    m_window->setPersistentGraphics(m_releaseHiddenDelay == 0);
+    connect(m_window, &QWindow::visibleChanged, this, &KeyboardController::onWindowVisibleChanged);
+    // Emitted on the render thread; only then is the renderer known
+    connect(m_window, &QQuickWindow::sceneGraphInitialized, this,
+            &KeyboardController::updateSoftwareRenderingActive, Qt::QueuedConnection);
+
+    // Frame and scene-graph sync spans, recorded on the render thread
+    connect(m_window, &QQuickWindow::beforeFrameBegin, this,
+            []() { Tracer::begin("frame"); }, Qt::DirectConnection);
+    connect(m_window, &QQuickWindow::afterFrameEnd, this,
+            []() { Tracer::end("frame"); }, Qt::DirectConnection);
+    connect(m_window, &QQuickWindow::beforeSynchronizing, this,
+            []() { Tracer::begin("frame.sync"); }, Qt::DirectConnection);
+    connect(m_window, &QQuickWindow::afterSynchronizing, this,
+            []() { Tracer::end("frame.sync"); }, Qt::DirectConnection);
+
+    // Sync runs with the GUI thread blocked, so the press state is in the
+    // scene graph by now; the queued call runs once the GUI thread resumes
+    connect(m_window, &QQuickWindow::afterSynchronizing, this, [this]() {
+        if (m_framePressWaiting.exchange(false))
+            QMetaObject::invokeMethod(this, &KeyboardController::flushFramePresses, Qt::QueuedConnection);
+    }, Qt::DirectConnection);
 }
 
 void KeyboardController::setLayerWindow(LayerShellQt::Window *lsw)
@@ -845,7 +1901,7 @@ void KeyboardController::setTextInputMode(bool mode)
 void KeyboardController::pressCtrlCombo(int keyCode)
 {
     if (m_textInputMode && m_window) {
-        QChar ch = evdevToChar(keyCode, false);
+        QChar ch = m_keymap->toChar(keyCode, false);
         int qtKey = ch.isNull() ? 0 : ch.toUpper().unicode();
         if (!qtKey) return;
         QKeyEvent press(QEvent::KeyPress, qtKey, Qt::ControlModifier);
@@ -855,35 +1911,70 @@ void KeyboardController::pressCtrlCombo(int keyCode)
         return;
     }
     if (!m_vk || !m_vk->isReady()) return;
-    m_vk->sendKeyPress(KEY_LEFTCTRL);
-    m_vk->sendKey(static_cast<uint32_t>(keyCode));
-    m_vk->sendKeyRelease(KEY_LEFTCTRL);
+    m_macroEngine->record(keyCode, MacroEngine::ModCtrl);
+    m_vk->sendKeyWith(static_cast<uint32_t>(keyCode), ModifierState::Ctrl);
 }
 
 // ---------------------------------------------------------------------------
 // Key dispatch + auto-expansion
 // ---------------------------------------------------------------------------
+void KeyboardController::pressKeyAfterFrame(int keyCode)
+{
+    if (!m_window || !m_window->isExposed()) {
+        pressKey(keyCode);
+        return;
+    }
+    m_framePresses.append(keyCode);
+    m_framePressWaiting = true;
+    // A frame even when the press changes nothing on screen
+    m_window->update();
+}
+
+void KeyboardController::flushFramePresses()
+{
+    const QList<int> presses = std::exchange(m_framePresses, {});
+    for (const int keyCode : presses)
+        pressKey(keyCode);
+}
+
 void KeyboardController::pressKey(int keyCode)
 {
+    OSK_TRACE_SCOPE("KeyboardController::pressKey");
+    // Keys pressed earlier go first
+    if (!m_framePresses.isEmpty())
+        flushFramePresses();
+    m_fieldSyncTimer.stop();
+    // A trigger still waiting to be replaced is pasted over now, and this
+    // key waits for that paste
+    if (m_inputMethod->hasPendingReplace())
+        m_inputMethod->abandonReplace();
+    if (m_holdKeysForPaste) {
+        m_keysAfterPaste.append(keyCode);
+        return;
+    }
     resetAutoHideTimer();
     if (m_soundFeedback)
         QApplication::beep();
 
+    if (composeKey(keyCode))
+        return;
+
     // Route to QML text fields when a dialog/filter is focused
     if (m_textInputMode && m_window) {
+        const ModifierState &modifiers = m_core.modifiers();
         Qt::KeyboardModifiers mods = Qt::NoModifier;
-        if (m_shift || m_capsLock) mods |= Qt::ShiftModifier;
-        if (m_ctrl) mods |= Qt::ControlModifier;
-        if (m_alt) mods |= Qt::AltModifier;
-        if (m_super) mods |= Qt::MetaModifier;
+        if (modifiers.shiftLevel()) mods |= Qt::ShiftModifier;
+        if (modifiers.isActive(ModifierState::Ctrl)) mods |= Qt::ControlModifier;
+        if (modifiers.isActive(ModifierState::Alt)) mods |= Qt::AltModifier;
+        if (modifiers.isActive(ModifierState::Meta)) mods |= Qt::MetaModifier;
 
         int qtKey = 0;
         QString text;
-        QChar ch = evdevToChar(keyCode, m_shift || m_capsLock);
+        const QChar ch(m_core.character(keyCode));
 
         if (!ch.isNull()) {
             qtKey = ch.toUpper().unicode();
-            if (!m_ctrl && !m_alt && !m_super)
+            if (modifiers.isPlain())
                 text = QString(ch);
         } else {
             switch (keyCode) {
@@ -912,151 +2003,331 @@ void KeyboardController::pressKey(int keyCode)
 
     if (!m_vk || !m_vk->isReady()) return;
 
-    bool isShift = m_shift || m_capsLock;
+    const bool plain = m_core.modifiers().isPlain();
+
+    // Fix the finished word before the separator reaches the app
+    bool corrected = false;
+    if (plain && keyCode == KEY_SPACE)
+        corrected = autocorrectWord(QLatin1Char(' '));
+    else if (plain && keyCode == KEY_ENTER)
+        corrected = autocorrectWord(QLatin1Char('\n'));
 
     // Update type buffer BEFORE sending the key
-    if (m_ctrl || m_alt || m_super) {
-        // Modifier combo — not regular typing
-        m_typeBuffer.clear();
-        m_bufferTimer.stop();
-    } else if (keyCode == KEY_BACKSPACE) {
-        if (!m_typeBuffer.isEmpty())
-            m_typeBuffer.chop(1);
-    } else if (keyCode == KEY_SPACE || keyCode == KEY_ENTER || keyCode == KEY_TAB || keyCode == KEY_ESC) {
-        m_typeBuffer.clear();
+    const KeyboardCore::Press press = m_core.press(keyCode);
+    switch (press.buffer) {
+    case KeyboardCore::BufferChange::Appended:
+        // Focus may have moved since the last word; re-check the window
+        // class in the background before a trigger can complete
+        if (m_core.buffer().size() == 1 && !m_scopedMatchers.isEmpty())
+            refreshActiveWindowClass();
+        m_bufferTimer.start();
+        break;
+    case KeyboardCore::BufferChange::Reset:
         m_bufferTimer.stop();
-    } else {
-        QChar ch = evdevToChar(keyCode, isShift);
-        if (!ch.isNull()) {
-            m_typeBuffer.append(ch);
-            m_bufferTimer.start();
-        }
+        break;
+    case KeyboardCore::BufferChange::Chopped:
+    case KeyboardCore::BufferChange::None:
+        break;
     }
 
+    m_macroEngine->record(keyCode, press.sendMask);
+
     // Send the actual key
-    applyModifiers();
+    syncModifiers(press.sendMask);
     m_vk->sendKey(static_cast<uint32_t>(keyCode));
-    releaseModifiers();
     resetOneShot();
+    syncModifiers(lockedModifierMask());
 
     // Check for shortcut expansion after the key has been sent
     // (skip when shortcuts page is open — user may be typing into fields)
-    if (!m_shortcutPageVisible && !m_ctrl && !m_alt && !m_super)
+    if (!m_shortcutPageVisible && plain)
         checkShortcutExpansion();
+
+    if (corrected)
+        setSuggestions({{m_lastCorrection.original, Suggestion::UndoCorrection}});
+    else if (m_core.buffer().isEmpty())
+        clearSuggestions();
+    else
+        updateSuggestions();
 }
 
 void KeyboardController::checkShortcutExpansion()
 {
-    if (m_typeBuffer.isEmpty()) return;
+    OSK_TRACE_SCOPE("KeyboardController::checkShortcutExpansion");
+    if (m_core.buffer().isEmpty()) return;
 
-    for (const QVariant &v : std::as_const(m_shortcuts)) {
-        const QVariantMap entry = v.toMap();
-        const QString trigger = entry.value(QStringLiteral("shortcut")).toString();
-        const QString expansion = entry.value(QStringLiteral("expansion")).toString();
+    if (const auto found = m_core.matchTrigger()) {
+        expandShortcut(m_shortcutLibrary->entryById(shortcutAt(*found)), int(found->length));
+        return;
+    }
 
-        if (trigger.isEmpty() || expansion.isEmpty()) continue;
-        if (!m_typeBuffer.endsWith(trigger)) continue;
+    // Macro triggers: remove the trigger text, then replay the macro
+    for (const QVariant &v : std::as_const(m_macros)) {
+        const QVariantMap entry = v.toMap();
+        const QString trigger = entry.value(QStringLiteral("trigger")).toString();
+        if (trigger.isEmpty() || !m_core.buffer().endsWith(ShortcutMatcher::view(trigger))) continue;
 
-        // Match found! Backspace to remove the trigger text
-        for (int i = 0; i < trigger.length(); ++i) {
+        for (int i = 0; i < trigger.length(); ++i)
             m_vk->sendKey(KEY_BACKSPACE);
-        }
 
-        // Clear buffer immediately
-        m_typeBuffer.clear();
+        m_core.resetBuffer();
         m_bufferTimer.stop();
+        m_macroEngine->play(entry.value(QStringLiteral("events")).toByteArray());
+        return;
+    }
+}
 
-        // Set clipboard and paste for reliable insertion
-        QDBusInterface klipper(QStringLiteral("org.kde.klipper"),
-                               QStringLiteral("/klipper"),
-                               QStringLiteral("org.kde.klipper.klipper"));
-        klipper.call(QStringLiteral("setClipboardContents"), expansion);
+// Replaces the last `typed` characters with the shortcut's expansion
+void KeyboardController::expandShortcut(const ShortcutLibrary::Entry &shortcut, int typed)
+{
+    // With the field's text at hand the trigger is swapped for the
+    // expansion in one change, once the field shows the trigger's last key
+    if (m_inputMethod->hasSurroundingText()) {
+        const std::u16string_view buffer = m_core.buffer().view();
+        const std::size_t count = std::min(std::size_t(typed), buffer.size());
+        const QString trigger = QString::fromUtf16(buffer.data() + buffer.size() - count, qsizetype(count));
+        m_core.resetBuffer();
+        m_bufferTimer.stop();
+        noteShortcutUse(shortcut);
+        m_inputMethod->replaceWhenTyped(trigger, shortcut.expansion);
+        return;
+    }
 
-        // Detect terminal now while the target window is still focused
-        m_savedWindowIsTerminal = isActiveWindowTerminal();
+    // Clear buffer immediately
+    m_core.resetBuffer();
+    m_bufferTimer.stop();
+    noteShortcutUse(shortcut);
+    pasteOverTrigger(typed, shortcut.expansion);
+}
 
-        QTimer::singleShot(50, this, [this]() {
-            sendPaste();
-        });
-        break;
-    }
+void KeyboardController::pasteOverTrigger(int typed, const QString &expansion)
+{
+    if (!m_vk || !m_vk->isReady()) return;
+    // Backspace to remove the trigger text
+    for (int i = 0; i < typed; ++i)
+        m_vk->sendKey(KEY_BACKSPACE);
+
+    // Detect terminal now while the target window is still focused
+    m_savedWindowIsTerminal = isActiveWindowTerminal();
+
+    // Set clipboard and paste for reliable insertion
+    m_pasteSequencer->start(expansion, pasteRoute(), QString());
+    m_holdKeysForPaste = true;
+}
+
+// One journal record in the library; nothing else is rewritten
+void KeyboardController::noteShortcutUse(const ShortcutLibrary::Entry &shortcut)
+{
+    if (const quint32 uses = m_shortcutLibrary->noteUse(shortcut.trigger, shortcut.scope))
+        m_triggerIndex.setUses(ShortcutMatcher::view(shortcut.trigger), uses);
 }
 
 // ---------------------------------------------------------------------------
 // Modifiers
 // ---------------------------------------------------------------------------
-void KeyboardController::applyModifiers()
+// The device mirrors the modifier state: locked modifiers (and Caps Lock,
+// which is typed as a held Shift) stay pressed between keys, one-shot ones
+// are pressed for a single key. VirtualKeyboard tracks what is held and
+// sends only transitions.
+void KeyboardController::syncModifiers(uint16_t mask)
+{
+    if (m_vk) m_vk->setModifiers(mask);
+}
+
+uint16_t KeyboardController::lockedModifierMask() const
 {
-    if (!m_vk) return;
-    if (m_shift || m_capsLock) m_vk->sendKeyPress(KEY_LEFTSHIFT);
-    if (m_ctrl)                m_vk->sendKeyPress(KEY_LEFTCTRL);
-    if (m_alt)                 m_vk->sendKeyPress(KEY_LEFTALT);
-    if (m_super)               m_vk->sendKeyPress(KEY_LEFTMETA);
+    return m_core.modifiers().lockedMask();
 }
 
-void KeyboardController::releaseModifiers()
+void KeyboardController::emitModifierChanges(uint16_t changed)
 {
-    if (!m_vk) return;
-    if (m_super)               m_vk->sendKeyRelease(KEY_LEFTMETA);
-    if (m_alt)                 m_vk->sendKeyRelease(KEY_LEFTALT);
-    if (m_ctrl)                m_vk->sendKeyRelease(KEY_LEFTCTRL);
-    if (m_shift || m_capsLock) m_vk->sendKeyRelease(KEY_LEFTSHIFT);
+    if (changed & ModifierState::Shift)    emit shiftActiveChanged();
+    if (changed & ModifierState::Ctrl)     emit ctrlActiveChanged();
+    if (changed & ModifierState::Alt)      emit altActiveChanged();
+    if (changed & ModifierState::Meta)     emit superActiveChanged();
+    if (changed & ModifierState::CapsLock) emit capsLockActiveChanged();
+}
+
+// Drops every lock and releases everything held on the device (hide, quit)
+void KeyboardController::releaseAllKeys()
+{
+    emitModifierChanges(m_core.modifiers().clear());
+    if (m_vk)
+        m_vk->releaseAll();
 }
 
 void KeyboardController::toggleShift()
 {
-    if (m_shiftLocked) {
-        m_shift = false; m_shiftLocked = false;
-    } else if (m_shift) {
-        m_shiftLocked = true;
-    } else {
-        m_shift = true;
-    }
+    // Keys still waiting for their frame are typed with the old modifiers
+    flushFramePresses();
+    m_core.modifiers().toggle(ModifierState::Shift);
+    syncModifiers(lockedModifierMask());
     emit shiftActiveChanged();
 }
 
 void KeyboardController::toggleCtrl()
 {
-    if (m_ctrlLocked) {
-        m_ctrl = false; m_ctrlLocked = false;
-    } else if (m_ctrl) {
-        m_ctrlLocked = true;
-    } else {
-        m_ctrl = true;
-    }
+    flushFramePresses();
+    m_core.modifiers().toggle(ModifierState::Ctrl);
+    syncModifiers(lockedModifierMask());
     emit ctrlActiveChanged();
 }
 
 void KeyboardController::toggleAlt()
 {
-    if (m_altLocked) {
-        m_alt = false; m_altLocked = false;
-    } else if (m_alt) {
-        m_altLocked = true;
-    } else {
-        m_alt = true;
-    }
+    flushFramePresses();
+    m_core.modifiers().toggle(ModifierState::Alt);
+    syncModifiers(lockedModifierMask());
     emit altActiveChanged();
 }
 
 void KeyboardController::toggleSuper()
 {
-    if (m_superLocked) {
-        m_super = false; m_superLocked = false;
-    } else if (m_super) {
-        m_superLocked = true;
-    } else {
-        m_super = true;
-    }
+    flushFramePresses();
+    m_core.modifiers().toggle(ModifierState::Meta);
+    syncModifiers(lockedModifierMask());
     emit superActiveChanged();
 }
 
 void KeyboardController::toggleCapsLock()
 {
-    m_capsLock = !m_capsLock;
+    flushFramePresses();
+    m_core.modifiers().toggleCapsLock();
+    syncModifiers(lockedModifierMask());
     emit capsLockActiveChanged();
 }
 
+// ---------------------------------------------------------------------------
+// Compose
+// ---------------------------------------------------------------------------
+bool KeyboardController::composeActive() const { return m_composeState != ComposeDfa::NoMatch; }
+
+void KeyboardController::toggleCompose()
+{
+    if (composeActive()) {
+        setComposeState(ComposeDfa::NoMatch);
+        return;
+    }
+    if (!m_composeTable->isOpen()) {
+        qWarning("No compose table loaded");
+        return;
+    }
+    setComposeState(m_composeTable->dfa().step(ComposeDfa::Start, ComposeDfa::ComposeKey));
+}
+
+void KeyboardController::loadComposeTable()
+{
+    if (m_composeTable->isOpen()) return;
+
+    const QString locale = ComposeTable::locale();
+    const QString compiled = ComposeTable::compiledPath(locale);
+    if (ComposeTable::isUpToDate(locale, compiled) && m_composeTable->open(compiled))
+        return;
+
+    // Parsing the Compose files takes tens of milliseconds; later starts
+    // only map the cached result
+    QThread *worker = QThread::create([locale, compiled]() {
+        if (!ComposeTable::compile(locale, compiled))
+            qWarning("Failed to compile the compose table for %s", qPrintable(locale));
+    });
+    connect(worker, &QThread::finished, this, [this, worker, compiled]() {
+        worker->deleteLater();
+        if (m_composeTable->open(compiled))
+            qInfo("Compose table: %zu sequences", m_composeTable->dfa().sequenceCount());
+    });
+    worker->start(QThread::LowPriority);
+}
+
+// Feeds a key to the sequence being composed, or starts one on a dead key.
+// True when the key was used up by it.
+bool KeyboardController::composeKey(int keyCode)
+{
+    if (!m_composeTable->isOpen()) return false;
+    const ComposeDfa &dfa = m_composeTable->dfa();
+
+    char32_t symbol = m_core.character(keyCode);
+    const uint8_t dead = symbol ? 0 : m_keymap->table().deadKey(
+        keyCode, m_core.modifiers().shiftLevel() ? KeyMap::Shift : 0);
+    if (dead)
+        symbol = ComposeDfa::deadKey(dead);
+
+    if (!composeActive()) {
+        // Dead keys without a sequence still go to the compositor
+        if (!dead || !m_core.modifiers().isPlain()) return false;
+        const ComposeDfa::State next = dfa.step(ComposeDfa::Start, symbol);
+        if (next == ComposeDfa::NoMatch) return false;
+        setComposeState(next);
+        resetOneShot();
+        return true;
+    }
+
+    // Keys that type nothing end the sequence; Esc and Backspace only that
+    if (!symbol) {
+        setComposeState(ComposeDfa::NoMatch);
+        return keyCode == KEY_ESC || keyCode == KEY_BACKSPACE;
+    }
+
+    // A key no sequence continues with cancels it and is dropped, as in X
+    const ComposeDfa::State next = dfa.step(m_composeState, symbol);
+    resetOneShot();
+    if (!dfa.accepts(next)) {
+        setComposeState(next);
+        return true;
+    }
+    const std::u32string_view output = dfa.output(next);
+    setComposeState(ComposeDfa::NoMatch);
+    commitComposed(QString::fromUcs4(output.data(), qsizetype(output.size())));
+    return true;
+}
+
+void KeyboardController::setComposeState(ComposeDfa::State state)
+{
+    const bool wasActive = composeActive();
+    m_composeState = state;
+    if (wasActive != composeActive())
+        emit composeActiveChanged();
+}
+
+void KeyboardController::commitComposed(const QString &text)
+{
+    if (m_textInputMode && m_window) {
+        QKeyEvent press(QEvent::KeyPress, 0, Qt::NoModifier, text);
+        QKeyEvent release(QEvent::KeyRelease, 0, Qt::NoModifier, text);
+        QCoreApplication::sendEvent(m_window, &press);
+        QCoreApplication::sendEvent(m_window, &release);
+        return;
+    }
+    const bool direct = m_inputMethod->isActive();
+    if (!direct && (!m_vk || !m_vk->isReady())) return;
+
+    bool onLayout = true;
+    for (const char32_t ch : text.toUcs4()) {
+        uint8_t level = 0;
+        if (!direct && m_keymap->fromChar(ch, &level) < 0) {
+            onLayout = false;
+            break;
+        }
+    }
+    // Characters the layout cannot type (é on US) are pasted instead
+    if (!onLayout) {
+        m_core.resetBuffer();
+        clearSuggestions();
+        m_savedWindowIsTerminal = isActiveWindowTerminal();
+        m_pasteSequencer->start(text, pasteRoute(), QString());
+        return;
+    }
+
+    m_core.buffer().append(ShortcutMatcher::view(text));
+    m_bufferTimer.start();
+    insertText(text);
+    if (!m_shortcutPageVisible)
+        checkShortcutExpansion();
+    if (m_core.buffer().isEmpty())
+        clearSuggestions();
+    else
+        updateSuggestions();
+}
+
 bool KeyboardController::switchScreen(int direction)
 {
     if (!m_window) return false;
@@ -1091,6 +2362,89 @@ void KeyboardController::minimizeToTray()
         m_window->hide();
 }
 
+void KeyboardController::toggleVisibility()
+{
+    if (m_window)
+        m_window->setVisible(!m_window->isVisible());
+}
+
+bool KeyboardController::runCommand(const QString &command)
+{
+    if (command == QLatin1String("toggle")) {
+        toggleVisibility();
+        return true;
+    }
+    if (command == QLatin1String("hide")) {
+        if (m_window) m_window->hide();
+        return true;
+    }
+
+    const bool settings = command == QLatin1String("settings");
+    const bool shortcuts = command == QLatin1String("shortcuts");
+    const bool clipboard = command == QLatin1String("clipboard");
+    if (!settings && !shortcuts && !clipboard && command != QLatin1String("show"))
+        return false;
+
+    if (m_window) {
+        m_window->show();
+        m_window->raise();
+    }
+    if (settings) setSettingsVisible(true);
+    if (shortcuts) setShortcutPageVisible(true);
+    if (clipboard) setClipboardPageVisible(true);
+    return true;
+}
+
+void KeyboardController::onWindowVisibleChanged(bool visible)
+{
+    if (!visible) {
+        m_shownForTextFocus = false;
+        flushFramePresses();
+        releaseAllKeys();
+        if (m_releaseHiddenDelay > 0)
+            m_releaseTimer.start(m_releaseHiddenDelay * 1000);
+        return;
+    }
+
+    // Fast path back: the page Loaders rebuild from the (compiled) QML
+    m_releaseTimer.stop();
+    if (m_sceneReleased) {
+        m_sceneReleased = false;
+        emit sceneReleasedChanged();
+    }
+}
+
+void KeyboardController::releaseScene()
+{
+    if (!m_window || m_window->isVisible() || m_sceneReleased) return;
+
+    const qint64 before = residentKiB();
+    m_sceneReleased = true;
+    emit sceneReleasedChanged(); // unloads the page Loaders
+    m_window->releaseResources();
+
+    // Unloaded items are deleted on the next event loop pass
+    QTimer::singleShot(0, this, [this, before]() {
+        if (QQmlEngine *engine = qmlEngine(m_window)) {
+            engine->collectGarbage();
+            engine->trimComponentCache();
+        }
+#ifdef __GLIBC__
+        malloc_trim(0);
+#endif
+        qInfo("Released hidden scene: RSS %lld KiB -> %lld KiB", before, residentKiB());
+    });
+}
+
+qint64 KeyboardController::residentKiB()
+{
+    QFile statm(QStringLiteral("/proc/self/statm"));
+    if (!statm.open(QIODevice::ReadOnly)) return 0;
+    const QList<QByteArray> fields = statm.readAll().split(' ');
+    if (fields.size() < 2) return 0;
+    return fields.at(1).toLongLong() * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
 void KeyboardController::closeApp()
 {
     QCoreApplication::quit();
@@ -1112,6 +2466,7 @@ void KeyboardController::saveActiveWindow()
     // so sendPaste() can use the right key combo later.
     m_savedWindowIsTerminal = isActiveWindowTerminal();
 
+    OSK_TRACE_SCOPE("D-Bus KWin.activeWindow");
     QDBusMessage msg = QDBusMessage::createMethodCall(
         QStringLiteral("org.kde.KWin"),
         QStringLiteral("/KWin"),
@@ -1133,6 +2488,7 @@ void KeyboardController::restoreActiveWindow()
 {
     if (m_savedWindowId.isEmpty()) return;
 
+    OSK_TRACE_SCOPE("D-Bus KWin.activateWindow");
     QDBusInterface kwin(QStringLiteral("org.kde.KWin"),
                         QStringLiteral("/KWin"),
                         QStringLiteral("org.kde.KWin"));
@@ -1142,8 +2498,5 @@ void KeyboardController::restoreActiveWindow()
 
 void KeyboardController::resetOneShot()
 {
-    if (m_shift && !m_shiftLocked) { m_shift = false; emit shiftActiveChanged(); }
-    if (m_ctrl  && !m_ctrlLocked)  { m_ctrl = false;  emit ctrlActiveChanged(); }
-    if (m_alt   && !m_altLocked)   { m_alt = false;   emit altActiveChanged(); }
-    if (m_super && !m_superLocked) { m_super = false; emit superActiveChanged(); }
+    emitModifierChanges(m_core.modifiers().consumeOneShot());
 }
@@ -1,13 +1,36 @@
 #pragma once
 
+#include <QElapsedTimer>
+#include <QHash>
 #include <QObject>
 #include <QProcess>
 #include <QRegion>
 #include <QStringList>
 #include <QTimer>
 #include <QVariantList>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include "core/composedfa.h"
+#include "core/keyboardcore.h"
+#include "core/prefixindex.h"
+#include "flickrecognizer.h"
+#include "pastesequencer.h"
+#include "shortcutlibrary.h"
+#include "shortcutmatcher.h"
 
 class QAction;
+class AutocorrectIndex;
+class ClipboardModel;
+class ClipboardStore;
+class ComposeTable;
+class CompletionDictionary;
+class InputMethod;
+class MacroEngine;
+class KeyMap;
+class SwipeDecoder;
+class TypeServer;
 class VirtualKeyboard;
 class QQuickWindow;
 namespace LayerShellQt { class Window; }
@@ -25,18 +48,24 @@ class KeyboardController : public QObject
     Q_PROPERTY(bool ctrlLocked READ ctrlLocked NOTIFY ctrlActiveChanged)
     Q_PROPERTY(bool altLocked READ altLocked NOTIFY altActiveChanged)
     Q_PROPERTY(bool superLocked READ superLocked NOTIFY superActiveChanged)
+    Q_PROPERTY(bool composeActive READ composeActive NOTIFY composeActiveChanged)
+    Q_PROPERTY(int keymapRevision READ keymapRevision NOTIFY keymapChanged)
 
     Q_PROPERTY(QString backgroundColor READ backgroundColor WRITE setBackgroundColor NOTIFY backgroundColorChanged)
     Q_PROPERTY(int keyRepeatDelay READ keyRepeatDelay WRITE setKeyRepeatDelay NOTIFY keyRepeatDelayChanged)
     Q_PROPERTY(int keyRepeatInterval READ keyRepeatInterval WRITE setKeyRepeatInterval NOTIFY keyRepeatIntervalChanged)
     Q_PROPERTY(bool settingsVisible READ settingsVisible WRITE setSettingsVisible NOTIFY settingsVisibleChanged)
     Q_PROPERTY(bool shortcutPageVisible READ shortcutPageVisible WRITE setShortcutPageVisible NOTIFY shortcutPageVisibleChanged)
-    Q_PROPERTY(QVariantList shortcuts READ shortcuts NOTIFY shortcutsChanged)
+    Q_PROPERTY(QObject *shortcutModel READ shortcutModel CONSTANT)
+    Q_PROPERTY(int shortcutCount READ shortcutCount NOTIFY shortcutsChanged)
+    Q_PROPERTY(QString activeWindowClass READ activeWindowClass NOTIFY activeWindowClassChanged)
     Q_PROPERTY(int keyboardWidth READ keyboardWidth WRITE setKeyboardWidth NOTIFY keyboardWidthChanged)
     Q_PROPERTY(int keyboardHeight READ keyboardHeight WRITE setKeyboardHeight NOTIFY keyboardHeightChanged)
     Q_PROPERTY(bool sizePopupVisible READ sizePopupVisible WRITE setSizePopupVisible NOTIFY sizePopupVisibleChanged)
     Q_PROPERTY(bool clipboardPageVisible READ clipboardPageVisible WRITE setClipboardPageVisible NOTIFY clipboardPageVisibleChanged)
     Q_PROPERTY(QStringList clipboardHistory READ clipboardHistory NOTIFY clipboardHistoryChanged)
+    Q_PROPERTY(QObject *clipboardModel READ clipboardModel CONSTANT)
+    Q_PROPERTY(QString clipboardBackend READ clipboardBackend WRITE setClipboardBackend NOTIFY clipboardBackendChanged)
     Q_PROPERTY(bool keyBorderEnabled READ keyBorderEnabled WRITE setKeyBorderEnabled NOTIFY keyBorderEnabledChanged)
     Q_PROPERTY(QString keyPressColor READ keyPressColor WRITE setKeyPressColor NOTIFY keyPressColorChanged)
     Q_PROPERTY(QString lockedKeyColor READ lockedKeyColor WRITE setLockedKeyColor NOTIFY lockedKeyColorChanged)
@@ -54,9 +83,17 @@ class KeyboardController : public QObject
 
     // Behavior
     Q_PROPERTY(int autoHideDelay READ autoHideDelay WRITE setAutoHideDelay NOTIFY autoHideDelayChanged)
+    Q_PROPERTY(int releaseHiddenDelay READ releaseHiddenDelay WRITE setReleaseHiddenDelay NOTIFY releaseHiddenDelayChanged)
+    Q_PROPERTY(bool sceneReleased READ sceneReleased NOTIFY sceneReleasedChanged)
     Q_PROPERTY(bool soundFeedback READ soundFeedback WRITE setSoundFeedback NOTIFY soundFeedbackChanged)
+    Q_PROPERTY(bool softwareRendering READ softwareRendering WRITE setSoftwareRendering NOTIFY softwareRenderingChanged)
+    Q_PROPERTY(bool softwareRenderingActive READ softwareRenderingActive NOTIFY softwareRenderingActiveChanged)
+    Q_PROPERTY(bool pressAnimation READ pressAnimation WRITE setPressAnimation NOTIFY pressAnimationChanged)
     Q_PROPERTY(bool closeOnPaste READ closeOnPaste WRITE setCloseOnPaste NOTIFY closeOnPasteChanged)
+    Q_PROPERTY(bool directClipboard READ directClipboard WRITE setDirectClipboard NOTIFY directClipboardChanged)
     Q_PROPERTY(bool closeOnInsertShortcut READ closeOnInsertShortcut WRITE setCloseOnInsertShortcut NOTIFY closeOnInsertShortcutChanged)
+    Q_PROPERTY(bool followTextFocus READ followTextFocus WRITE setFollowTextFocus NOTIFY followTextFocusChanged)
+    Q_PROPERTY(bool inputMethodAvailable READ inputMethodAvailable NOTIFY inputMethodAvailableChanged)
 
     // Layout
     Q_PROPERTY(int stickyPosition READ stickyPosition WRITE setStickyPosition NOTIFY stickyPositionChanged)
@@ -69,6 +106,20 @@ class KeyboardController : public QObject
     Q_PROPERTY(QString globalShortcut READ globalShortcut WRITE setGlobalShortcut NOTIFY globalShortcutChanged)
     Q_PROPERTY(int defaultScreen READ defaultScreen WRITE setDefaultScreen NOTIFY defaultScreenChanged)
 
+    // Macros
+    Q_PROPERTY(bool macroRecording READ macroRecording NOTIFY macroRecordingChanged)
+    Q_PROPERTY(bool macroPlaying READ macroPlaying NOTIFY macroPlayingChanged)
+    Q_PROPERTY(QVariantList macros READ macros NOTIFY macrosChanged)
+    Q_PROPERTY(int macroRate READ macroRate WRITE setMacroRate NOTIFY macroRateChanged)
+
+    // Word completion
+    Q_PROPERTY(bool wordCompletion READ wordCompletion WRITE setWordCompletion NOTIFY wordCompletionChanged)
+    Q_PROPERTY(bool shortcutSuggestions READ shortcutSuggestions WRITE setShortcutSuggestions NOTIFY shortcutSuggestionsChanged)
+    Q_PROPERTY(QVariantList suggestions READ suggestions NOTIFY suggestionsChanged)
+    Q_PROPERTY(bool swipeTyping READ swipeTyping WRITE setSwipeTyping NOTIFY swipeTypingChanged)
+    Q_PROPERTY(bool flickGestures READ flickGestures WRITE setFlickGestures NOTIFY flickGesturesChanged)
+    Q_PROPERTY(bool autocorrect READ autocorrect WRITE setAutocorrect NOTIFY autocorrectChanged)
+
 public:
     explicit KeyboardController(QObject *parent = nullptr);
     ~KeyboardController() override;
@@ -81,6 +132,9 @@ public:
     bool altActive() const;
     bool superActive() const;
     bool capsLockActive() const;
+    // Key labels from the active XKB layout; empty for non-character keys
+    int keymapRevision() const;
+    Q_INVOKABLE QString keyLabel(int keyCode, bool shift) const;
     bool shiftLocked() const;
     bool ctrlLocked() const;
     bool altLocked() const;
@@ -101,13 +155,24 @@ public:
     bool shortcutPageVisible() const;
     Q_INVOKABLE void setShortcutPageVisible(bool visible);
 
-    QVariantList shortcuts() const;
-    Q_INVOKABLE void addShortcut(const QString &shortcut, const QString &expansion);
-    Q_INVOKABLE void editShortcut(int index, const QString &shortcut, const QString &expansion);
+    QObject *shortcutModel() const;
+    int shortcutCount() const;
+    // {shortcut, expansion, scope} of one row
+    Q_INVOKABLE QVariantMap shortcutAt(int index) const;
+    // scope: window class the shortcut is limited to ("terminal" for any
+    // terminal); empty for all applications
+    Q_INVOKABLE void addShortcut(const QString &shortcut, const QString &expansion,
+                                 const QString &scope = QString());
+    Q_INVOKABLE void editShortcut(int index, const QString &shortcut, const QString &expansion,
+                                  const QString &scope = QString());
     Q_INVOKABLE void removeShortcut(int index);
     Q_INVOKABLE void insertShortcutExpansion(int index);
+    // JSON files of {shortcut, expansion, scope} objects
+    Q_INVOKABLE void importShortcuts();
+    Q_INVOKABLE void exportShortcuts();
 
     Q_INVOKABLE void setShortcutDialogOpen(bool open);
+    QString activeWindowClass() const;
     Q_INVOKABLE void setTextInputMode(bool mode);
     Q_INVOKABLE void pressCtrlCombo(int keyCode);
 
@@ -121,8 +186,14 @@ public:
     bool clipboardPageVisible() const;
     Q_INVOKABLE void setClipboardPageVisible(bool visible);
     QStringList clipboardHistory() const;
+    QObject *clipboardModel() const;
     Q_INVOKABLE void refreshClipboardHistory();
     Q_INVOKABLE void insertClipboardEntry(const QString &text);
+    Q_INVOKABLE void pasteClipboardRow(int row);
+    Q_INVOKABLE void removeClipboardRow(int row);
+    // "klipper" or "native" (built-in persistent store)
+    QString clipboardBackend() const;
+    Q_INVOKABLE void setClipboardBackend(const QString &backend);
 
     bool keyBorderEnabled() const;
     Q_INVOKABLE void setKeyBorderEnabled(bool enabled);
@@ -163,12 +234,37 @@ public:
     // Behavior
     int autoHideDelay() const;
     Q_INVOKABLE void setAutoHideDelay(int seconds);
+    // Low-memory mode: seconds hidden before the scene is released (0 = off)
+    int releaseHiddenDelay() const;
+    Q_INVOKABLE void setReleaseHiddenDelay(int seconds);
+    bool sceneReleased() const;
+    Q_INVOKABLE void toggleVisibility();
+    // Commands forwarded by a second launch (ControlServer): toggle, show,
+    // hide, settings, shortcuts, clipboard. False for unknown commands.
+    bool runCommand(const QString &command);
+    // Software rendering (applies on next start) and key press animation
+    bool softwareRendering() const;
+    Q_INVOKABLE void setSoftwareRendering(bool enabled);
+    bool softwareRenderingActive() const;
+    bool pressAnimation() const;
+    Q_INVOKABLE void setPressAnimation(bool enabled);
     bool soundFeedback() const;
     Q_INVOKABLE void setSoundFeedback(bool enabled);
     bool closeOnPaste() const;
     Q_INVOKABLE void setCloseOnPaste(bool enabled);
+
+    // Pastes offer the text themselves and put the previous clipboard back;
+    // off, they go through Klipper and stay in its history
+    bool directClipboard() const;
+    Q_INVOKABLE void setDirectClipboard(bool enabled);
     bool closeOnInsertShortcut() const;
     Q_INVOKABLE void setCloseOnInsertShortcut(bool enabled);
+
+    // With input-method-v2: show when a text field takes focus, and hide
+    // again when it loses it (unless the keyboard was already showing)
+    bool followTextFocus() const;
+    Q_INVOKABLE void setFollowTextFocus(bool enabled);
+    bool inputMethodAvailable() const;
     // Layout
     int stickyPosition() const;
     Q_INVOKABLE void setStickyPosition(int pos);
@@ -187,15 +283,68 @@ public:
     int defaultScreen() const;
     Q_INVOKABLE void setDefaultScreen(int index);
 
+    // Macros
+    bool macroRecording() const;
+    bool macroPlaying() const;
+    QVariantList macros() const;
+    int macroRate() const;
+    Q_INVOKABLE void setMacroRate(int keysPerSecond);
+    Q_INVOKABLE void toggleMacroRecording();
+    Q_INVOKABLE void playMacro(int index);
+    Q_INVOKABLE void playLastMacro();
+    Q_INVOKABLE void stopMacro();
+    Q_INVOKABLE void removeMacro(int index);
+    Q_INVOKABLE void setMacroTrigger(int index, const QString &trigger);
+
+    // Word completion
+    bool wordCompletion() const;
+    Q_INVOKABLE void setWordCompletion(bool enabled);
+    bool shortcutSuggestions() const;
+    Q_INVOKABLE void setShortcutSuggestions(bool enabled);
+    QVariantList suggestions() const;
+    Q_INVOKABLE void acceptSuggestion(int index);
+
+    // Swipe typing
+    bool swipeTyping() const;
+    Q_INVOKABLE void setSwipeTyping(bool enabled);
+    Q_INVOKABLE void setKeyGeometry(const QString &letter, qreal x, qreal y, qreal w, qreal h);
+    Q_INVOKABLE void clearKeyGeometry();
+    Q_INVOKABLE void commitSwipe(const QVariantList &points);
+
+    // Flick gestures: up types the Shift level of a key, down its alternate
+    // (the "flickAlternates" setting, else the AltGr level). Character keys
+    // commit on release while this is on; samples come from KeyButton.
+    bool flickGestures() const;
+    Q_INVOKABLE void setFlickGestures(bool enabled);
+    Q_INVOKABLE void flickBegin(int keyCode, qreal x, qreal y, qreal keyHeight);
+    // Text typed when the sample completes a flick, else empty
+    Q_INVOKABLE QString flickUpdate(qreal x, qreal y);
+    // Shift level of a key without touching the Shift modifier (right-click)
+    Q_INVOKABLE QString typeShifted(int keyCode);
+
+    // Autocorrect
+    bool autocorrect() const;
+    Q_INVOKABLE void setAutocorrect(bool enabled);
+
     void setToggleAction(QAction *action);
 
     Q_INVOKABLE void pressKey(int keyCode);
+    // pressKey() once the frame showing the press has been synchronized:
+    // the highlight is then on its way to the screen even if the press
+    // blocks this thread (D-Bus, kdotool)
+    Q_INVOKABLE void pressKeyAfterFrame(int keyCode);
     Q_INVOKABLE void toggleShift();
     Q_INVOKABLE void toggleCtrl();
     Q_INVOKABLE void toggleAlt();
     Q_INVOKABLE void toggleSuper();
     Q_INVOKABLE void toggleCapsLock();
 
+    // Compose: the Compose key, or a dead key of the layout, starts a
+    // sequence that the following keys resolve through the Compose table;
+    // the result is typed when the sequence completes
+    bool composeActive() const;
+    Q_INVOKABLE void toggleCompose();
+
     Q_INVOKABLE bool switchScreen(int direction);
 
     Q_INVOKABLE void minimizeToTray();
@@ -209,17 +358,20 @@ signals:
     void altActiveChanged();
     void superActiveChanged();
     void capsLockActiveChanged();
+    void keymapChanged();
     void backgroundColorChanged();
     void keyRepeatDelayChanged();
     void keyRepeatIntervalChanged();
     void settingsVisibleChanged();
     void shortcutPageVisibleChanged();
     void shortcutsChanged();
+    void activeWindowClassChanged();
     void keyboardWidthChanged();
     void keyboardHeightChanged();
     void sizePopupVisibleChanged();
     void clipboardPageVisibleChanged();
     void clipboardHistoryChanged();
+    void clipboardBackendChanged();
     void keyBorderEnabledChanged();
     void keyPressColorChanged();
     void lockedKeyColorChanged();
@@ -233,9 +385,17 @@ signals:
     void fontSizeChanged();
     void keyRadiusChanged();
     void autoHideDelayChanged();
+    void releaseHiddenDelayChanged();
+    void sceneReleasedChanged();
     void soundFeedbackChanged();
+    void softwareRenderingChanged();
+    void softwareRenderingActiveChanged();
+    void pressAnimationChanged();
     void closeOnPasteChanged();
+    void directClipboardChanged();
     void closeOnInsertShortcutChanged();
+    void followTextFocusChanged();
+    void inputMethodAvailableChanged();
     void stickyPositionChanged();
     void keySpacingChanged();
     void compactModeChanged();
@@ -243,36 +403,98 @@ signals:
     void autostartEnabledChanged();
     void globalShortcutChanged();
     void defaultScreenChanged();
+    void macroRecordingChanged();
+    void macroPlayingChanged();
+    void macrosChanged();
+    void macroRateChanged();
+    void wordCompletionChanged();
+    void shortcutSuggestionsChanged();
+    void suggestionsChanged();
+    void swipeTypingChanged();
+    void flickGesturesChanged();
+    void autocorrectChanged();
+    void composeActiveChanged();
 
 private:
-    void applyModifiers();
-    void releaseModifiers();
+    // Strip entry; the kind decides what accepting it does
+    struct Suggestion {
+        enum Kind { Completion, SwipeAlternative, UndoCorrection, Shortcut };
+        QString text;
+        Kind kind = Completion;
+        QString detail;   // Shortcut: start of the expansion
+        bool operator==(const Suggestion &) const = default;
+    };
+
+    // osk-daemon serves osk-type when it runs; otherwise we do, once our
+    // own device is up
+    void serveTypeClients();
+    // Presses/releases only the modifiers whose state differs from mask
+    void syncModifiers(uint16_t mask);
+    uint16_t lockedModifierMask() const;
+    void releaseAllKeys();
     void resetOneShot();
+    void emitModifierChanges(uint16_t changed);
     void checkShortcutExpansion();
-    void saveShortcuts();
+    void expandShortcut(const ShortcutLibrary::Entry &shortcut, int typed);
+    // Backspaces over the trigger's typed characters, then pastes the expansion
+    void pasteOverTrigger(int typed, const QString &expansion);
+    void noteShortcutUse(const ShortcutLibrary::Entry &shortcut);
+    void addToMatchers(ShortcutLibrary::EntryId id, quint32 serial);
+    void removeFromMatchers(ShortcutLibrary::EntryId id, quint32 serial);
+    void loadShortcuts();
+    void addShortcutRows(int first, int last);
+    void removeShortcutRow(int row);
+    void replaceShortcutRow(int row, ShortcutLibrary::EntryId before);
+    void selectShortcutMatcher();
+    ShortcutLibrary::EntryId shortcutAt(const KeyboardCore::TriggerMatch &match) const;
+    void refreshActiveWindowClass();
+    void setActiveWindowClass(const QString &windowClass);
+    static bool isTerminalClass(const QString &windowClass);
+    void saveMacros();
+    uint16_t currentModifierMask() const;
     void saveActiveWindow();
     void restoreActiveWindow();
-    static QChar evdevToChar(int keyCode, bool shift);
+    void typeText(const QString &text);
+    void insertText(const QString &text);
+    void onTextFocusChanged(bool focused);
+    void syncBufferWithField();
+    void flushFramePresses();
+    QString currentWord() const;
+    void updateSuggestions();
+    QList<Suggestion> shortcutSuggestions(int limit) const;
+    void setSuggestions(const QList<Suggestion> &suggestions);
+    void clearSuggestions();
+    void loadCompletionDictionary();
+    void loadAutocorrectIndex();
+    void loadComposeTable();
+    bool composeKey(int keyCode);
+    void setComposeState(ComposeDfa::State state);
+    void commitComposed(const QString &text);
+    // False (and Klipper stays in use) when the store cannot be opened
+    bool openClipboardStore();
+    void updateSoftwareRenderingActive();
+    void updateStoredClipboardModel();
+    bool autocorrectWord(QChar separator);
+    PasteSequencer::Route pasteRoute() const;
+    QString typeAlternate(int keyCode, FlickRecognizer::Direction direction);
     void sendPaste();
     bool isActiveWindowTerminal();
     void startTranscription();
     void resetAutoHideTimer();
+    void onWindowVisibleChanged(bool visible);
+    void releaseScene();
+    static qint64 residentKiB();
     QString autostartFilePath() const;
 
     VirtualKeyboard *m_vk = nullptr;
+    KeyMap *m_keymap = nullptr;
+    TypeServer *m_typeServer = nullptr;
     QQuickWindow *m_window = nullptr;
     LayerShellQt::Window *m_layerWindow = nullptr;
     QRegion m_pendingRegion;
 
-    bool m_shift = false;
-    bool m_ctrl = false;
-    bool m_alt = false;
-    bool m_super = false;
-    bool m_capsLock = false;
-    bool m_shiftLocked = false;
-    bool m_ctrlLocked = false;
-    bool m_altLocked = false;
-    bool m_superLocked = false;
+    // Modifiers, type buffer and trigger matching; see core/keyboardcore.h
+    KeyboardCore m_core;
 
     QString m_backgroundColor = QStringLiteral("#232629");
     int m_keyRepeatDelay = 400;
@@ -293,12 +515,32 @@ private:
     bool m_textInputMode = false;
     QString m_savedWindowId;
     bool m_savedWindowIsTerminal = false;
+    // Keys pressed while an expansion is pasted over its trigger wait for
+    // the paste, so they land after the expansion
+    bool m_holdKeysForPaste = false;
+    QList<int> m_keysAfterPaste;
     QStringList m_clipboardHistory;
-    QVariantList m_shortcuts;
-
-    // Auto-expansion buffer
-    QString m_typeBuffer;
+    ClipboardModel *m_clipboardModel = nullptr;
+    ClipboardStore *m_clipboardStore = nullptr;
+    bool m_nativeClipboard = false;
+    ShortcutLibrary *m_shortcutLibrary = nullptr;
+
+    // Compiled shortcuts: the global ones, and each scope's own. The core
+    // checks global then the focused window's scope (see KeyboardCore), so
+    // a focus change is a pointer swap. Entries are ranked by a serial per
+    // library row, in row order.
+    ShortcutMatcher m_globalMatcher;
+    QHash<QString, ShortcutMatcher> m_scopedMatchers;
+    QVector<quint32> m_shortcutSerials;   // by library row
+    quint32 m_nextShortcutSerial = 0;
+    const ShortcutMatcher *m_scopedMatcher = nullptr;   // of the focused window
+    QString m_activeWindowClass;
+    QProcess *m_windowClassProcess = nullptr;
+
+    // Clears the auto-expansion buffer after a pause
     QTimer m_bufferTimer;
+    // Brings it in line with the text field once typing settles
+    QTimer m_fieldSyncTimer;
 
     // Voice typing
     QProcess *m_recordProcess = nullptr;
@@ -312,9 +554,18 @@ private:
     int m_fontSize = 14;
     int m_keyRadius = 6;
     int m_autoHideDelay = 0;
+    int m_releaseHiddenDelay = 0;
+    bool m_sceneReleased = false;
+    QTimer m_releaseTimer;
     bool m_soundFeedback = false;
+    bool m_softwareRendering = false;
+    bool m_softwareRenderingActive = false;
+    bool m_pressAnimation = true;
     bool m_closeOnPaste = false;
+    bool m_directClipboard = true;
     bool m_closeOnInsertShortcut = false;
+    bool m_followTextFocus = true;
+    bool m_shownForTextFocus = false;
     int m_stickyPosition = 0;
     int m_keySpacing = 3;
     bool m_compactMode = false;
@@ -324,4 +575,39 @@ private:
     int m_defaultScreen = 0;
     QTimer m_autoHideTimer;
     QAction *m_toggleAction = nullptr;
+
+    // Word completion / swipe typing / autocorrect
+    bool m_wordCompletion = false;
+    bool m_shortcutSuggestions = true;
+    // Triggers by prefix for the strip, and how often each was expanded
+    PrefixIndex m_triggerIndex;
+    bool m_swipeTyping = false;
+    bool m_flickGestures = true;
+    FlickRecognizer m_flick;
+    int m_flickKey = -1;
+    QElapsedTimer m_flickClock;
+    // Presses waiting for their frame; the flag is read on the render thread
+    QList<int> m_framePresses;
+    std::atomic<bool> m_framePressWaiting {false};
+    QHash<int, QString> m_flickAlternates;   // evdev code → text
+    bool m_autocorrect = false;
+    std::unique_ptr<CompletionDictionary> m_dictionary;
+    std::unique_ptr<SwipeDecoder> m_swipeDecoder;
+    std::unique_ptr<AutocorrectIndex> m_autocorrectIndex;
+    std::unique_ptr<ComposeTable> m_composeTable;
+    ComposeDfa::State m_composeState = ComposeDfa::NoMatch;   // NoMatch: not composing
+    QList<Suggestion> m_suggestions;
+    QString m_lastSwipeWord;   // committed text, including the trailing space
+    struct Correction {
+        QString original;
+        QString replacement;
+        QChar separator;
+    };
+    Correction m_lastCorrection;
+
+    // Macros: list of { name, trigger, events (packed QByteArray) }
+    MacroEngine *m_macroEngine = nullptr;
+    PasteSequencer *m_pasteSequencer = nullptr;
+    InputMethod *m_inputMethod = nullptr;
+    QVariantList m_macros;
 };
@@ -0,0 +1,278 @@
+#include "keymap.h"
+#include "core/composedfa.h"
+
+#include <linux/input-event-codes.h>
+#include <xkbcommon/xkbcommon.h>
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QSettings>
+#include <QStandardPaths>
+#include <memory>
+
+namespace {
+QString kxkbrcPath()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::GenericConfigLocation)
+           + QStringLiteral("/kxkbrc");
+}
+
+// Spacing forms drawn on dead keys, which produce no character themselves
+QString deadKeyLabel(const char *name)
+{
+    static const QHash<QByteArray, QString> labels = {
+        {"dead_grave", QStringLiteral("`")},
+        {"dead_acute", QStringLiteral("´")},
+        {"dead_circumflex", QStringLiteral("^")},
+        {"dead_tilde", QStringLiteral("~")},
+        {"dead_diaeresis", QStringLiteral("¨")},
+        {"dead_cedilla", QStringLiteral("¸")},
+        {"dead_abovering", QStringLiteral("˚")},
+        {"dead_caron", QStringLiteral("ˇ")},
+        {"dead_macron", QStringLiteral("¯")},
+    };
+    return labels.value(QByteArray(name));
+}
+}
+
+KeyMap::KeyMap(QObject *parent)
+    : QObject(parent)
+{
+    // kxkbrc is replaced by rename, so watch its directory as well
+    const QString path = kxkbrcPath();
+    m_watcher.addPath(QFileInfo(path).absolutePath());
+    if (QFile::exists(path))
+        m_watcher.addPath(path);
+    auto onChange = [this, path]() {
+        if (QFile::exists(path) && !m_watcher.files().contains(path))
+            m_watcher.addPath(path);
+        reload();
+    };
+    connect(&m_watcher, &QFileSystemWatcher::fileChanged, this, onChange);
+    connect(&m_watcher, &QFileSystemWatcher::directoryChanged, this, onChange);
+
+    m_names = readKxkbrc();
+    if (!compile())
+        fillUs();
+    m_table.index();
+
+    // Follow layout switches (e.g. Meta+Alt+K) between the configured layouts
+    QDBusConnection::sessionBus().connect(QStringLiteral("org.kde.keyboard"), QStringLiteral("/Layouts"),
+        QStringLiteral("org.kde.KeyboardLayouts"), QStringLiteral("layoutChanged"),
+        this, SLOT(onLayoutChanged(uint)));
+    QDBusConnection::sessionBus().callWithCallback(QDBusMessage::createMethodCall(
+        QStringLiteral("org.kde.keyboard"), QStringLiteral("/Layouts"),
+        QStringLiteral("org.kde.KeyboardLayouts"), QStringLiteral("getLayout")),
+        this, SLOT(onLayoutChanged(uint)));
+}
+
+void KeyMap::onLayoutChanged(uint index)
+{
+    setLayoutIndex(int(index));
+}
+
+QChar KeyMap::toChar(int keyCode, bool shift) const
+{
+    const char16_t c = m_table.unit(keyCode, shift);
+    return c ? QChar(c) : QChar();
+}
+
+int KeyMap::fromChar(char32_t ch, uint8_t *modifiers) const
+{
+    return m_table.find(ch, modifiers);
+}
+
+char32_t KeyMap::character(int keyCode, uint8_t modifiers) const
+{
+    return m_table.character(keyCode, modifiers);
+}
+
+QString KeyMap::label(int keyCode, bool shift) const
+{
+    if (keyCode <= 0 || keyCode >= KeyCount) return QString();
+    return m_labels[keyCode * 2 + (shift ? 1 : 0)];
+}
+
+void KeyMap::setLayoutIndex(int layoutIndex)
+{
+    if (layoutIndex < 0 || layoutIndex == m_layoutIndex) return;
+    m_layoutIndex = layoutIndex;
+    if (!compile())
+        fillUs();
+    m_table.index();
+    ++m_revision;
+    emit changed();
+}
+
+int KeyMap::revision() const { return m_revision; }
+
+void KeyMap::reload()
+{
+    const Names names = readKxkbrc();
+    if (names == m_names) return;   // some other file in the directory
+    m_names = names;
+    m_layoutIndex = 0;
+    if (!compile())
+        fillUs();
+    m_table.index();
+    ++m_revision;
+    qInfo("Keymap reloaded: %s", qPrintable(m_names.layout.isEmpty() ? QStringLiteral("default") : m_names.layout));
+    emit changed();
+}
+
+KeyMap::Names KeyMap::readKxkbrc()
+{
+    QSettings rc(kxkbrcPath(), QSettings::IniFormat);
+    rc.beginGroup(QStringLiteral("Layout"));
+    Names names;
+    // Use=false means the system default, which libxkbcommon reads from the
+    // XKB_DEFAULT_* environment when the names are left empty
+    if (!rc.value(QStringLiteral("Use"), false).toBool())
+        return names;
+    auto list = [&rc](const char *key) {
+        return rc.value(QLatin1String(key)).toStringList().join(QLatin1Char(','));
+    };
+    names.model = list("Model");
+    names.layout = list("LayoutList");
+    names.variant = list("VariantList");
+    names.options = list("Options");
+    return names;
+}
+
+bool KeyMap::compile()
+{
+    const QByteArray model = m_names.model.toUtf8();
+    const QByteArray layout = m_names.layout.toUtf8();
+    const QByteArray variant = m_names.variant.toUtf8();
+    const QByteArray options = m_names.options.toUtf8();
+    auto orNull = [](const QByteArray &s) { return s.isEmpty() ? nullptr : s.constData(); };
+    const xkb_rule_names names {nullptr, orNull(model), orNull(layout), orNull(variant), orNull(options)};
+
+    std::unique_ptr<xkb_context, decltype(&xkb_context_unref)> context(
+        xkb_context_new(XKB_CONTEXT_NO_FLAGS), &xkb_context_unref);
+    if (!context) return false;
+    std::unique_ptr<xkb_keymap, decltype(&xkb_keymap_unref)> keymap(
+        xkb_keymap_new_from_names(context.get(), &names, XKB_KEYMAP_COMPILE_NO_FLAGS), &xkb_keymap_unref);
+    if (!keymap) {
+        qWarning("Cannot compile XKB layout '%s', using US", layout.constData());
+        return false;
+    }
+    std::unique_ptr<xkb_state, decltype(&xkb_state_unref)> state(
+        xkb_state_new(keymap.get()), &xkb_state_unref);
+    if (!state) return false;
+
+    const xkb_layout_index_t group = xkb_layout_index_t(m_layoutIndex)
+                                     < xkb_keymap_num_layouts(keymap.get()) ? m_layoutIndex : 0;
+    const xkb_mod_index_t shift = xkb_keymap_mod_get_index(keymap.get(), XKB_MOD_NAME_SHIFT);
+    // ISO_Level3_Shift (AltGr) is bound to Mod5 by the stock rules. Those
+    // levels are typed by holding Right Alt, so they only exist when that
+    // key is ISO_Level3_Shift; on US it is plain Alt, and holding it would
+    // make a menu accelerator of the key.
+    xkb_mod_index_t altGr = xkb_keymap_mod_get_index(keymap.get(), "Mod5");
+    xkb_state_update_mask(state.get(), 0, 0, 0, 0, 0, group);
+    if (xkb_state_key_get_one_sym(state.get(), xkb_keycode_t(KEY_RIGHTALT + 8)) != XKB_KEY_ISO_Level3_Shift)
+        altGr = XKB_MOD_INVALID;
+
+    for (int level = 0; level < Levels; ++level) {
+        xkb_mod_mask_t mods = 0;
+        if ((level & Shift) && shift != XKB_MOD_INVALID) mods |= 1u << shift;
+        if (level & AltGr) {
+            if (altGr == XKB_MOD_INVALID) {
+                for (int code = 0; code < KeyCount; ++code) {
+                    m_table.set(code, level, 0);
+                    m_table.setDeadKey(code, level, 0);
+                }
+                continue;
+            }
+            mods |= 1u << altGr;
+        }
+        xkb_state_update_mask(state.get(), mods, 0, 0, 0, 0, group);
+
+        for (int code = 0; code < KeyCount; ++code) {
+            // XKB keycodes are evdev codes offset by 8
+            const char32_t c = xkb_state_key_get_utf32(state.get(), xkb_keycode_t(code + 8));
+            m_table.set(code, level, c);
+            const xkb_keysym_t sym = KeyTable::isPrintable(c) ? XKB_KEY_NoSymbol
+                : xkb_state_key_get_one_sym(state.get(), xkb_keycode_t(code + 8));
+            m_table.setDeadKey(code, level, ComposeDfa::deadKeyIndex(sym));
+            if (level >= 2) continue;
+
+            QString &label = m_labels[code * 2 + level];
+            if (KeyTable::isPrintable(c)) {
+                label = QString::fromUcs4(&c, 1);
+            } else {
+                char name[64];
+                label = xkb_keysym_get_name(sym, name, sizeof(name)) > 0 ? deadKeyLabel(name) : QString();
+            }
+        }
+    }
+    return true;
+}
+
+void KeyMap::fillUs()
+{
+    m_table.clear();
+    for (int code = 0; code < KeyCount; ++code) {
+        for (int level = 0; level < 2; ++level) {
+            const QChar c = usChar(code, level == 1);
+            m_table.set(code, level, c.unicode());
+            m_labels[code * 2 + level] = c.isNull() ? QString() : QString(c);
+        }
+    }
+    m_table.set(KEY_TAB, 0, U'\t');
+    m_table.set(KEY_ENTER, 0, U'\r');
+}
+
+// ---------------------------------------------------------------------------
+// US QWERTY fallback
+// ---------------------------------------------------------------------------
+QChar KeyMap::usChar(int keyCode, bool shift)
+{
+    // Letters: KEY_Q=16 .. KEY_P=25, KEY_A=30 .. KEY_L=38, KEY_Z=44 .. KEY_M=50
+    static const char letterMap[] = {
+        // index 0-9: keycodes 16-25 (top row)
+        'q','w','e','r','t','y','u','i','o','p',
+        // index 10-13: gap (keycodes 26-29)
+        0, 0, 0, 0,
+        // index 14-22: keycodes 30-38 (home row)
+        'a','s','d','f','g','h','j','k','l',
+        // index 23-27: gap (keycodes 39-43)
+        0, 0, 0, 0, 0,
+        // index 28-34: keycodes 44-50 (bottom row)
+        'z','x','c','v','b','n','m'
+    };
+
+    if (keyCode >= 16 && keyCode <= 50) {
+        char c = letterMap[keyCode - 16];
+        if (c != 0)
+            return shift ? QChar(c).toUpper() : QChar(c);
+    }
+
+    // Number row: KEY_1=2 .. KEY_0=11
+    static const char numNormal[]  = "1234567890";
+    static const char numShift[]   = "!@#$%^&*()";
+    if (keyCode >= 2 && keyCode <= 11) {
+        int idx = keyCode - 2;
+        return QChar(shift ? numShift[idx] : numNormal[idx]);
+    }
+
+    // Punctuation keys
+    switch (keyCode) {
+    case 41: return shift ? QChar('~') : QChar('`');
+    case 12: return shift ? QChar('_') : QChar('-');
+    case 13: return shift ? QChar('+') : QChar('=');
+    case 26: return shift ? QChar('{') : QChar('[');
+    case 27: return shift ? QChar('}') : QChar(']');
+    case 43: return shift ? QChar('|') : QChar('\\');
+    case 39: return shift ? QChar(':') : QChar(';');
+    case 40: return shift ? QChar('"') : QChar('\'');
+    case 51: return shift ? QChar('<') : QChar(',');
+    case 52: return shift ? QChar('>') : QChar('.');
+    case 53: return shift ? QChar('?') : QChar('/');
+    case 57: return QChar(' ');  // space
+    }
+
+    return QChar(); // non-character key
+}
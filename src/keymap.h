@@ -0,0 +1,76 @@
+#pragma once
+
+#include <QChar>
+#include <QFileSystemWatcher>
+#include <QObject>
+#include <QString>
+#include <array>
+#include <cstdint>
+
+#include "core/keytable.h"
+
+// Evdev keycode ↔ character tables for the user's XKB layout, shared by the
+// UI (key labels, type buffer, text routing) and osk-daemon (text
+// injection).
+//
+// The layout configured in kxkbrc is compiled with libxkbcommon into a
+// KeyTable (see core/keytable.h), which the keyboard core reads directly.
+// Lookups are a table index; xkb is only involved when kxkbrc or the active
+// layout changes. The active layout follows the compositor's layout
+// switches (org.kde.keyboard), in the UI and osk-daemon alike. If the
+// layout cannot be compiled, US QWERTY is used.
+class KeyMap : public QObject
+{
+    Q_OBJECT
+public:
+    // Level bits: modifiers that must be held to produce a character
+    enum Modifier : uint8_t {
+        Shift = KeyTable::Shift,
+        AltGr = KeyTable::AltGr,
+    };
+
+    explicit KeyMap(QObject *parent = nullptr);
+
+    // Character a key produces, or a null QChar for non-character keys
+    QChar toChar(int keyCode, bool shift) const;
+    // Keycode producing ch (setting *modifiers to the level), or -1
+    int fromChar(char32_t ch, uint8_t *modifiers) const;
+    // Codepoint at any level (Modifier bits), or 0
+    char32_t character(int keyCode, uint8_t modifiers) const;
+    // What to draw on a key; empty for keys without a printable symbol
+    QString label(int keyCode, bool shift) const;
+
+    // Group within the configured layout list (follows the compositor)
+    void setLayoutIndex(int layoutIndex);
+    // Increments whenever the tables change
+    int revision() const;
+    const KeyTable &table() const { return m_table; }
+
+signals:
+    void changed();
+
+private slots:
+    void onLayoutChanged(uint index);
+
+private:
+    static constexpr int KeyCount = KeyTable::KeyCount;
+    static constexpr int Levels = KeyTable::Levels;
+
+    struct Names {
+        QString model, layout, variant, options;
+        bool operator==(const Names &) const = default;
+    };
+
+    void reload();
+    bool compile();
+    void fillUs();
+    static Names readKxkbrc();
+    static QChar usChar(int keyCode, bool shift);
+
+    Names m_names;
+    int m_layoutIndex = 0;
+    int m_revision = 0;
+    KeyTable m_table;
+    std::array<QString, KeyCount * 2> m_labels;    // levels none and Shift
+    QFileSystemWatcher m_watcher;
+};
@@ -0,0 +1,95 @@
+// osk: the command users and compositor bindings run.
+//
+//   osk [toggle|show|hide|settings|shortcuts|clipboard]
+//
+// When a keyboard is already running the command is forwarded to it and
+// this exits; otherwise the instance lock is kept, osk-daemon is started
+// if it is not running, and osk-ui, installed next to this binary,
+// replaces the process. Plain POSIX, so a second launch pays for no Qt
+// library being mapped or relocated.
+
+#include "singleinstance.h"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+namespace {
+
+// osk-daemon takes a moment to create its device; the keyboard started
+// before it listens makes a device of its own
+constexpr int DaemonStartTimeoutMs = 1000;
+constexpr int DaemonRetryMs = 10;
+
+std::string siblingPath(const char *name)
+{
+    char self[PATH_MAX];
+    const ssize_t n = readlink("/proc/self/exe", self, sizeof(self) - 1);
+    if (n <= 0) return name;
+    self[n] = '\0';
+    const char *slash = std::strrchr(self, '/');
+    return std::string(self, size_t(slash - self + 1)) + name;
+}
+
+bool answers(const std::string &path)
+{
+    sockaddr_un addr {};
+    addr.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(addr.sun_path)) return false;
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return false;
+    const bool connected = connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0;
+    close(fd);
+    return connected;
+}
+
+// Starts osk-daemon detached from this session's process tree, so it
+// outlives the keyboard, and waits until it serves the device
+void startDaemon()
+{
+    const std::string socketPath = SingleInstance::runtimePath("inject.sock");
+    if (socketPath.empty() || answers(socketPath)) return;
+
+    const std::string daemon = siblingPath("osk-daemon");
+    if (access(daemon.c_str(), X_OK) != 0) return;
+    const pid_t child = fork();
+    if (child < 0) return;
+    if (child == 0) {
+        // Forked twice so the daemon is not left a child of osk-ui
+        setsid();
+        if (fork() == 0) {
+            char *const args[] = {const_cast<char *>(daemon.c_str()), nullptr};
+            execv(daemon.c_str(), args);
+        }
+        _exit(0);
+    }
+    waitpid(child, nullptr, 0);
+
+    for (int waited = 0; waited < DaemonStartTimeoutMs && !answers(socketPath); waited += DaemonRetryMs)
+        usleep(DaemonRetryMs * 1000);
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    const char *command = argc > 1 ? argv[1] : nullptr;
+    if (!SingleInstance::acquire())
+        return SingleInstance::forward(command ? command : "show");
+
+    startDaemon();
+    SingleInstance::handOver();
+    const std::string ui = siblingPath("osk-ui");
+    argv[0] = const_cast<char *>(ui.c_str());
+    execv(ui.c_str(), argv);
+    std::fprintf(stderr, "osk: cannot start %s: %s\n", ui.c_str(), std::strerror(errno));
+    return 1;
+}
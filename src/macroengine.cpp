@@ -0,0 +1,123 @@
+#include "macroengine.h"
+#include "virtualkeyboard.h"
+
+#include <QtEndian>
+
+namespace {
+// One frame at 60 Hz
+constexpr int FrameIntervalMs = 16;
+// Upper bound per frame so the evdev client buffer never overflows
+// (each key is up to 10 input events including modifiers and SYN_REPORTs).
+constexpr int MaxEventsPerFrame = 32;
+}
+
+MacroEngine::MacroEngine(VirtualKeyboard *vk, QObject *parent)
+    : QObject(parent)
+    , m_vk(vk)
+{
+    m_frameTimer.setTimerType(Qt::PreciseTimer);
+    m_frameTimer.setInterval(FrameIntervalMs);
+    connect(&m_frameTimer, &QTimer::timeout, this, &MacroEngine::tick);
+}
+
+// ---------------------------------------------------------------------------
+// Recording
+// ---------------------------------------------------------------------------
+bool MacroEngine::isRecording() const { return m_recording; }
+
+void MacroEngine::startRecording()
+{
+    if (m_recording) return;
+    stop();
+    m_buffer.clear();
+    m_recording = true;
+    emit recordingChanged();
+}
+
+QByteArray MacroEngine::stopRecording()
+{
+    if (!m_recording) return {};
+    m_recording = false;
+    emit recordingChanged();
+    QByteArray out = m_buffer;
+    m_buffer.clear();
+    return out;
+}
+
+void MacroEngine::record(int keyCode, uint16_t modifiers)
+{
+    if (!m_recording || keyCode < 0 || keyCode > KeyMask) return;
+    const uint16_t ev = qToLittleEndian<uint16_t>(uint16_t(keyCode) | (modifiers & ~KeyMask));
+    m_buffer.append(reinterpret_cast<const char *>(&ev), sizeof(ev));
+}
+
+int MacroEngine::eventCount(const QByteArray &macro)
+{
+    return int(macro.size() / sizeof(uint16_t));
+}
+
+// ---------------------------------------------------------------------------
+// Playback
+// ---------------------------------------------------------------------------
+bool MacroEngine::isPlaying() const { return m_frameTimer.isActive(); }
+
+void MacroEngine::play(const QByteArray &macro)
+{
+    if (m_recording || eventCount(macro) == 0) return;
+    const bool wasPlaying = isPlaying();
+    m_playback = macro;
+    m_playPos = 0;
+    m_playEmitted = 0;
+    m_playClock.start();
+    m_frameTimer.start();
+    tick();
+    if (!wasPlaying && isPlaying())
+        emit playingChanged();
+}
+
+void MacroEngine::stop()
+{
+    if (!isPlaying()) return;
+    m_frameTimer.stop();
+    m_playback.clear();
+    m_playPos = 0;
+    emit playingChanged();
+}
+
+int MacroEngine::rate() const { return m_rate; }
+
+void MacroEngine::setRate(int keysPerSecond)
+{
+    m_rate = qMax(0, keysPerSecond);
+}
+
+void MacroEngine::tick()
+{
+    const int total = eventCount(m_playback);
+
+    int budget = MaxEventsPerFrame;
+    if (m_rate > 0) {
+        // Catch up to where a fixed-rate clock says we should be
+        const qint64 due = m_playClock.elapsed() * m_rate / 1000 + 1;
+        budget = int(qBound<qint64>(0, due - m_playEmitted, MaxEventsPerFrame));
+    }
+
+    const auto *events = reinterpret_cast<const uint16_t *>(m_playback.constData());
+    while (budget-- > 0 && m_playPos < total) {
+        emitEvent(qFromLittleEndian(events[m_playPos++]));
+        ++m_playEmitted;
+    }
+
+    if (m_playPos >= total)
+        stop();
+}
+
+void MacroEngine::emitEvent(uint16_t ev)
+{
+    if (!m_vk || !m_vk->isReady()) return;
+    // The recorded modifiers exactly, whatever is locked on the keyboard now
+    if (ev & ModAltGr)
+        m_vk->sendKeyAtLevel(ev & KeyMask, ev & ModShift, true);
+    else
+        m_vk->sendKeyWith(ev & KeyMask, ev & ModifierState::Modifiers);
+}
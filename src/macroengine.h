@@ -0,0 +1,75 @@
+#pragma once
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QObject>
+#include <QTimer>
+#include <cstdint>
+
+#include "core/modifierstate.h"
+
+class VirtualKeyboard;
+
+// Records OSK key presses into a compact binary stream and replays them
+// through the uinput device.
+//
+// A macro is a packed array of little-endian uint16 events: the low 10 bits
+// hold the evdev keycode (KEY_MAX is 0x2ff), the upper bits the modifiers
+// that were active when the key was pressed, or ModAltGr for a key typed at
+// its AltGr level.
+//
+// Playback is paced by a frame timer. Each tick emits a batch of events:
+// either as many as the batch limit allows (rate 0 — as fast as the
+// compositor drains the device) or just enough to keep a fixed keys/second.
+class MacroEngine : public QObject
+{
+    Q_OBJECT
+public:
+    // Same bits as the keyboard core's modifier masks
+    enum Modifier : uint16_t {
+        ModShift = ModifierState::Shift,
+        ModCtrl  = ModifierState::Ctrl,
+        ModAlt   = ModifierState::Alt,
+        ModMeta  = ModifierState::Meta,
+        // Macros only: the key was typed at its AltGr level
+        ModAltGr = 1 << 15,
+    };
+
+    static constexpr uint16_t KeyMask = 0x03ff;
+
+    explicit MacroEngine(VirtualKeyboard *vk, QObject *parent = nullptr);
+
+    bool isRecording() const;
+    void startRecording();
+    QByteArray stopRecording();
+    void record(int keyCode, uint16_t modifiers);
+
+    bool isPlaying() const;
+    void play(const QByteArray &macro);
+    void stop();
+
+    int rate() const;
+    void setRate(int keysPerSecond);
+
+    static int eventCount(const QByteArray &macro);
+
+signals:
+    void recordingChanged();
+    void playingChanged();
+
+private:
+    void tick();
+    void emitEvent(uint16_t ev);
+
+    VirtualKeyboard *m_vk;
+
+    bool m_recording = false;
+    QByteArray m_buffer;
+
+    QByteArray m_playback;
+    int m_playPos = 0;          // next event index
+    qint64 m_playEmitted = 0;   // events emitted since play() (fixed-rate pacing)
+    QElapsedTimer m_playClock;
+    QTimer m_frameTimer;
+    int m_rate = 0;
+};
@@ -4,16 +4,31 @@
 #include <QQuickWindow>
 #include <QAction>
 #include <QScreen>
+#include <QSettings>
+
+#include <cstring>
 
 #include <LayerShellQt/Shell>
 #include <LayerShellQt/Window>
 #include <KStatusNotifierItem>
 #include <KGlobalAccel>
 
+#include "controlserver.h"
 #include "keyboardcontroller.h"
+#include "singleinstance.h"
+#include "stallwatchdog.h"
+#include "traceservice.h"
+#include "tracer.h"
 
 int main(int argc, char *argv[])
 {
+    // osk-ui [toggle|show|hide|settings|shortcuts|clipboard], normally
+    // started by the osk launcher with the instance lock already taken.
+    // Started directly, a second launch still only forwards its command.
+    const char *command = argc > 1 ? argv[1] : nullptr;
+    if (!SingleInstance::adopt() && !SingleInstance::acquire())
+        return SingleInstance::forward(command ? command : "show");
+
     // Must be called before QApplication — enables layer-shell for windows
     LayerShellQt::Shell::useLayerShell();
 
@@ -23,6 +38,19 @@ int main(int argc, char *argv[])
     app.setApplicationDisplayName(QStringLiteral("OSK"));
     app.setDesktopFileName(QStringLiteral("osk"));
 
+    // OSK_TRACE=<path> records from startup; D-Bus toggles it later
+    Tracer::initFromEnvironment();
+    // Logs event-loop stalls over OSK_STALL_MS (default 32, 0 disables)
+    auto *watchdog = new StallWatchdog(&app);
+    watchdog->initFromEnvironment();
+    auto *traceService = new TraceService(watchdog, &app);
+    if (!traceService->registerOnSessionBus())
+        qWarning("Trace control is not available on D-Bus");
+
+    // Must be chosen before the first window is created
+    if (QSettings().value(QStringLiteral("softwareRendering"), false).toBool())
+        QQuickWindow::setGraphicsApi(QSGRendererInterface::Software);
+
     auto *controller = new KeyboardController(&app);
 
     QQmlApplicationEngine engine;
@@ -60,7 +88,19 @@ int main(int argc, char *argv[])
         window->setScreen(screens[screenIdx]);
     }
 
-    window->show();
+    // Nothing is showing yet, so toggle means show; only the pages need
+    // the controller
+    const bool hidden = command && std::strcmp(command, "hide") == 0;
+    const bool visibility = !command || hidden || std::strcmp(command, "show") == 0
+                            || std::strcmp(command, "toggle") == 0;
+    if (!hidden)
+        window->show();
+    if (!visibility && !controller->runCommand(QString::fromLocal8Bit(command)))
+        qWarning("Unknown command: %s", command);
+
+    auto *controlServer = new ControlServer(controller, &app);
+    if (!controlServer->listen())
+        qWarning("Later launches cannot reach this instance");
 
     // System tray
     auto *tray = new KStatusNotifierItem(QStringLiteral("osk"), &app);
@@ -72,8 +112,8 @@ int main(int argc, char *argv[])
     tray->setToolTipSubTitle(QStringLiteral("Click to toggle"));
 
     QObject::connect(tray, &KStatusNotifierItem::activateRequested,
-                     window, [window](bool, const QPoint &) {
-        window->setVisible(!window->isVisible());
+                     controller, [controller](bool, const QPoint &) {
+        controller->toggleVisibility();
     });
 
     // Global shortcut
@@ -85,9 +125,7 @@ int main(int argc, char *argv[])
     KGlobalAccel::self()->setShortcut(toggleAction,
         {userShortcut.isEmpty() ? QKeySequence(Qt::META | Qt::Key_K) : userShortcut});
     QObject::connect(toggleAction, &QAction::triggered,
-                     window, [window]() {
-        window->setVisible(!window->isVisible());
-    });
+                     controller, &KeyboardController::toggleVisibility);
 
     controller->setToggleAction(toggleAction);
 
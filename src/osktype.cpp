@@ -0,0 +1,114 @@
+// osk-type: streams text to OSK's text injection socket.
+//
+//   osk-type [--rate N] [TEXT...]
+//
+// Types TEXT, or standard input when no text is given. Input is copied in
+// fixed-size chunks; the server reads only as fast as it types, so blocking
+// writes keep memory bounded however large the input is. Plain POSIX so the
+// tool starts instantly from scripts.
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+namespace {
+
+// Stream header understood by TypeServer
+constexpr char Magic[4] = {'O', 'S', 'K', 'T'};
+
+bool writeAll(int fd, const char *data, size_t size)
+{
+    while (size > 0) {
+        const ssize_t n = write(fd, data, size);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += n;
+        size -= size_t(n);
+    }
+    return true;
+}
+
+int usage(FILE *out)
+{
+    std::fprintf(out, "Usage: osk-type [--rate CHARS_PER_SECOND] [TEXT...]\n"
+                      "Types TEXT (or standard input) through OSK.\n");
+    return out == stdout ? 0 : 2;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    uint32_t rate = 0;
+    int first = 1;
+    for (; first < argc; ++first) {
+        const std::string arg = argv[first];
+        if (arg == "--help" || arg == "-h")
+            return usage(stdout);
+        if (arg == "--rate" && first + 1 < argc) {
+            rate = uint32_t(std::strtoul(argv[++first], nullptr, 10));
+        } else if (arg == "--") {
+            ++first;
+            break;
+        } else if (arg.rfind("--", 0) == 0) {
+            return usage(stderr);
+        } else {
+            break;
+        }
+    }
+
+    const char *runtimeDir = std::getenv("XDG_RUNTIME_DIR");
+    if (!runtimeDir) {
+        std::fprintf(stderr, "osk-type: XDG_RUNTIME_DIR is not set\n");
+        return 1;
+    }
+    sockaddr_un addr {};
+    addr.sun_family = AF_UNIX;
+    std::snprintf(addr.sun_path, sizeof(addr.sun_path), "%s/osk/type.sock", runtimeDir);
+
+    // A server that goes away mid-stream is reported, not fatal
+    std::signal(SIGPIPE, SIG_IGN);
+    const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0) {
+        std::fprintf(stderr, "osk-type: cannot connect to %s: %s\n", addr.sun_path, std::strerror(errno));
+        return 1;
+    }
+
+    char header[8];
+    std::memcpy(header, Magic, sizeof(Magic));
+    for (int i = 0; i < 4; ++i)
+        header[4 + i] = char((rate >> (8 * i)) & 0xff);
+    bool ok = writeAll(fd, header, sizeof(header));
+
+    if (first < argc) {
+        for (int i = first; ok && i < argc; ++i) {
+            ok = (i == first || writeAll(fd, " ", 1)) && writeAll(fd, argv[i], std::strlen(argv[i]));
+        }
+    } else {
+        char buffer[16 * 1024];
+        while (ok) {
+            const ssize_t n = read(STDIN_FILENO, buffer, sizeof(buffer));
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) {
+                ok = n == 0;
+                break;
+            }
+            ok = writeAll(fd, buffer, size_t(n));
+        }
+    }
+
+    if (!ok)
+        std::fprintf(stderr, "osk-type: %s\n", std::strerror(errno));
+    close(fd);
+    return ok ? 0 : 1;
+}
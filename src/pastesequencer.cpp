@@ -0,0 +1,192 @@
+#include "pastesequencer.h"
+#include "clipboardowner.h"
+#include "selectionmonitor.h"
+#include "tracer.h"
+
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <QDBusPendingCallWatcher>
+#include <QDBusPendingReply>
+#include <QDBusVariant>
+#include <QClipboard>
+#include <QGuiApplication>
+#include <QMimeData>
+
+PasteSequencer::PasteSequencer(QObject *parent)
+    : QObject(parent)
+    , m_monitor(new SelectionMonitor(this))
+    , m_owner(new ClipboardOwner(m_monitor, this))
+{
+    if (!m_monitor->connectToCompositor())
+        qInfo("No wlr-data-control; the clipboard is copied synchronously before pastes");
+
+    m_timeout.setSingleShot(true);
+    m_timeout.setInterval(TimeoutMs);
+    connect(&m_timeout, &QTimer::timeout, this, [this]() { finish(true); });
+
+    m_ownerGrace.setSingleShot(true);
+    m_ownerGrace.setInterval(OwnerGraceMs);
+    connect(&m_ownerGrace, &QTimer::timeout, this, [this]() { confirm(OwnerStep); });
+
+    m_focusPoll.setSingleShot(true);
+    m_focusPoll.setInterval(FocusPollMs);
+    connect(&m_focusPoll, &QTimer::timeout, this, &PasteSequencer::pollActiveWindow);
+
+    // Announced by the compositor, so the change has really taken effect;
+    // KSystemClipboard reports our own selection before it has
+    connect(m_monitor, &SelectionMonitor::selectionChanged,
+            this, &PasteSequencer::onSelectionChanged);
+}
+
+void PasteSequencer::start(const QString &text, Route route, const QString &windowId)
+{
+    cancel();
+    m_text = text;
+    m_windowId = windowId;
+    m_started = Tracer::now();
+    m_pending = ClipboardStep | OwnerStep | (windowId.isEmpty() ? 0 : FocusStep);
+    m_timeout.start();
+
+    if (!windowId.isEmpty())
+        activateWindow();
+
+    if (route == Route::Klipper) {
+        m_marker.clear();
+        setKlipperContents();
+        return;
+    }
+    m_marker = QStringLiteral("application/x-osk-paste;id=%1").arg(++m_offers);
+    // Deferred so ready() is never emitted before start() returns
+    const int generation = m_generation;
+    QTimer::singleShot(0, this, [this, generation, route]() {
+        if (generation != m_generation) return;
+        if (route == Route::Direct) {
+            m_owner->offer(m_text, m_marker);
+        } else {
+            auto *mime = new QMimeData;
+            mime->setText(m_text);
+            mime->setData(m_marker, QByteArray());
+            QGuiApplication::clipboard()->setMimeData(mime);
+        }
+        confirm(ClipboardStep);
+    });
+}
+
+void PasteSequencer::cancel()
+{
+    ++m_generation;
+    m_pending = 0;
+    m_timeout.stop();
+    m_ownerGrace.stop();
+    m_focusPoll.stop();
+}
+
+bool PasteSequencer::isActive() const { return m_pending != 0; }
+
+void PasteSequencer::setKlipperContents()
+{
+    QDBusMessage msg = QDBusMessage::createMethodCall(
+        QStringLiteral("org.kde.klipper"),
+        QStringLiteral("/klipper"),
+        QStringLiteral("org.kde.klipper.klipper"),
+        QStringLiteral("setClipboardContents"));
+    msg << m_text;
+
+    const int generation = m_generation;
+    auto *watcher = new QDBusPendingCallWatcher(
+        QDBusConnection::sessionBus().asyncCall(msg, TimeoutMs), this);
+    connect(watcher, &QDBusPendingCallWatcher::finished, this,
+            [this, generation](QDBusPendingCallWatcher *call) {
+        call->deleteLater();
+        if (generation != m_generation) return;
+        // Without Klipper the paste still goes out, as it always did
+        if (call->isError())
+            qWarning("Klipper did not take the clipboard: %s", qPrintable(call->error().message()));
+        confirm(ClipboardStep);
+    });
+}
+
+void PasteSequencer::activateWindow()
+{
+    QDBusMessage msg = QDBusMessage::createMethodCall(
+        QStringLiteral("org.kde.KWin"),
+        QStringLiteral("/KWin"),
+        QStringLiteral("org.kde.KWin"),
+        QStringLiteral("activateWindow"));
+    msg << m_windowId;
+
+    const int generation = m_generation;
+    auto *watcher = new QDBusPendingCallWatcher(
+        QDBusConnection::sessionBus().asyncCall(msg, TimeoutMs), this);
+    connect(watcher, &QDBusPendingCallWatcher::finished, this,
+            [this, generation](QDBusPendingCallWatcher *call) {
+        call->deleteLater();
+        if (generation != m_generation) return;
+        pollActiveWindow();
+    });
+}
+
+void PasteSequencer::pollActiveWindow()
+{
+    QDBusMessage msg = QDBusMessage::createMethodCall(
+        QStringLiteral("org.kde.KWin"),
+        QStringLiteral("/KWin"),
+        QStringLiteral("org.freedesktop.DBus.Properties"),
+        QStringLiteral("Get"));
+    msg << QStringLiteral("org.kde.KWin") << QStringLiteral("activeWindow");
+
+    const int generation = m_generation;
+    auto *watcher = new QDBusPendingCallWatcher(
+        QDBusConnection::sessionBus().asyncCall(msg, TimeoutMs), this);
+    connect(watcher, &QDBusPendingCallWatcher::finished, this,
+            [this, generation](QDBusPendingCallWatcher *call) {
+        call->deleteLater();
+        if (generation != m_generation) return;
+        QDBusPendingReply<QDBusVariant> reply = *call;
+        if (!reply.isError() && reply.value().variant().toString() == m_windowId)
+            confirm(FocusStep);
+        else
+            m_focusPoll.start();
+    });
+}
+
+void PasteSequencer::onSelectionChanged(const QStringList &formats)
+{
+    if (!(m_pending & OwnerStep)) return;
+    if (m_marker.isEmpty() || formats.contains(m_marker))
+        confirm(OwnerStep);
+}
+
+void PasteSequencer::confirm(Step step)
+{
+    if (!(m_pending & step)) return;
+    m_pending &= ~step;
+
+    if (Tracer::isEnabled()) {
+        switch (step) {
+        case ClipboardStep: Tracer::complete("paste.clipboard", m_started); break;
+        case OwnerStep: Tracer::complete("paste.owner", m_started); break;
+        case FocusStep: Tracer::complete("paste.focus", m_started); break;
+        }
+    }
+
+    if (step == ClipboardStep && (m_pending & OwnerStep) && !m_monitor->isAvailable())
+        m_ownerGrace.start();
+    if (!m_pending)
+        finish(false);
+}
+
+void PasteSequencer::finish(bool timedOut)
+{
+    if (timedOut) {
+        qWarning("Pasting after %d ms without confirmation of:%s%s%s", TimeoutMs,
+                 (m_pending & ClipboardStep) ? " clipboard" : "",
+                 (m_pending & OwnerStep) ? " owner" : "",
+                 (m_pending & FocusStep) ? " focus" : "");
+    }
+    if (Tracer::isEnabled())
+        Tracer::complete("paste.ready", m_started);
+    cancel();
+    m_text.clear();
+    emit ready();
+}
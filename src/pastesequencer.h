@@ -0,0 +1,79 @@
+#pragma once
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QTimer>
+#include <cstdint>
+
+class ClipboardOwner;
+class SelectionMonitor;
+
+// Decides when a paste can be sent, instead of sleeping a fixed time.
+//
+// A paste is ready once its preconditions are confirmed:
+//   clipboard  the text is set: offered by ClipboardOwner, or Klipper's
+//              setClipboardContents reply has arrived, or the local
+//              clipboard was set
+//   owner      the compositor has announced the new selection (through
+//              SelectionMonitor): ours is recognised by a marker format
+//              offered with the text, Klipper's as the next one announced.
+//              Without data-control the clipboard step stands in for it
+//              after a short grace period
+//   focus      KWin reports the window to paste into as active again
+// The steps run concurrently. ready() follows the last confirmation, or the
+// timeout, whichever comes first; per-step times go to the trace recorder.
+class PasteSequencer : public QObject
+{
+    Q_OBJECT
+
+public:
+    static constexpr int TimeoutMs = 500;
+    static constexpr int OwnerGraceMs = 30;
+    static constexpr int FocusPollMs = 8;
+
+    // How the text gets onto the clipboard
+    enum class Route {
+        Direct,    // ClipboardOwner: served by us, previous selection restored
+        Klipper,   // Klipper's setClipboardContents; stays in its history
+        Local,     // QClipboard, for the native history store
+    };
+
+    explicit PasteSequencer(QObject *parent = nullptr);
+
+    // Sets text on the clipboard and, when windowId is not empty,
+    // reactivates that KWin window. A sequence still in flight is abandoned.
+    void start(const QString &text, Route route, const QString &windowId);
+    void cancel();
+    bool isActive() const;
+
+signals:
+    void ready();
+
+private:
+    enum Step : uint8_t {
+        ClipboardStep = 1 << 0,
+        OwnerStep = 1 << 1,
+        FocusStep = 1 << 2,
+    };
+
+    void setKlipperContents();
+    void activateWindow();
+    void pollActiveWindow();
+    void onSelectionChanged(const QStringList &formats);
+    void confirm(Step step);
+    void finish(bool timedOut);
+
+    SelectionMonitor *m_monitor;
+    ClipboardOwner *m_owner;
+    QString m_text;
+    QString m_marker;            // format identifying our selection; empty for Klipper
+    QString m_windowId;
+    uint8_t m_pending = 0;       // steps not confirmed yet
+    int m_generation = 0;        // replies from abandoned sequences are ignored
+    int m_offers = 0;            // numbers the markers
+    int64_t m_started = 0;       // Tracer::now() at start()
+    QTimer m_timeout;
+    QTimer m_ownerGrace;
+    QTimer m_focusPoll;
+};
@@ -11,8 +11,6 @@ Rectangle {
         }
     }
 
-    property string filterText: ""
-
     // Block clicks from reaching the keyboard behind
     MouseArea { anchors.fill: parent }
 
@@ -72,7 +70,7 @@ Rectangle {
                 selectionColor: Theme.keyBackgroundPressed
                 font.pixelSize: 13
                 verticalAlignment: TextEdit.AlignVCenter
-                onTextChanged: clipboardRoot.filterText = text.toLowerCase()
+                onTextChanged: KeyboardController.clipboardModel.setFilter(text)
             }
 
             Text {
@@ -80,7 +78,8 @@ Rectangle {
                 anchors.leftMargin: 6
                 anchors.verticalCenter: parent.verticalCenter
                 visible: filterInput.text.length === 0
-                text: "Filter"
+                // The native store keeps bodies on disk; only previews are searched
+                text: KeyboardController.clipboardBackend === "native" ? "Filter previews" : "Filter"
                 color: Theme.keyTextDim
                 font.pixelSize: 13
             }
@@ -115,79 +114,101 @@ Rectangle {
             radius: 4
             color: Qt.darker(Theme.keyboardBackground, 1.1)
 
-            Flickable {
+            ListView {
+                id: entryList
                 anchors.fill: parent
                 anchors.margins: 4
                 clip: true
-                contentHeight: listCol.height
+                spacing: 3
                 boundsBehavior: Flickable.StopAtBounds
+                model: KeyboardController.clipboardModel
+                reuseItems: true
+
+                // Only the preview is fetched; a click pastes by row, so an
+                // entry's full text never reaches the delegate
+                delegate: Rectangle {
+                    id: entry
+                    required property int index
+                    required property string preview
+                    required property int length
+                    required property int lineCount
+                    width: entryList.width
+                    height: Math.max(32, previewText.implicitHeight + 12)
+                    radius: 3
+                    color: entryMa.containsMouse
+                           ? Qt.lighter(Theme.keyBackground, 1.1)
+                           : Theme.keyBackground
 
-                Column {
-                    id: listCol
-                    width: parent.width
-                    spacing: 3
-
-                    Repeater {
-                        model: {
-                            var items = KeyboardController.clipboardHistory;
-                            if (clipboardRoot.filterText === "")
-                                return items;
-                            var f = clipboardRoot.filterText;
-                            var result = [];
-                            for (var i = 0; i < items.length; i++) {
-                                if (items[i].toLowerCase().indexOf(f) >= 0)
-                                    result.push(items[i]);
-                            }
-                            return result;
-                        }
-
-                        delegate: Rectangle {
-                            required property var modelData
-                            required property int index
-                            width: listCol.width
-                            height: 32
-                            radius: 3
-                            color: entryMa.containsMouse
-                                   ? Qt.lighter(Theme.keyBackground, 1.1)
-                                   : Theme.keyBackground
-
-                            Text {
-                                anchors.left: parent.left
-                                anchors.leftMargin: 8
-                                anchors.right: parent.right
-                                anchors.rightMargin: 8
-                                anchors.verticalCenter: parent.verticalCenter
-                                text: modelData.replace(/\n/g, " ")
-                                color: Theme.keyText
-                                font.pixelSize: 12
-                                elide: Text.ElideRight
-                                maximumLineCount: 1
-                            }
-
-                            MouseArea {
-                                id: entryMa
-                                anchors.fill: parent
-                                hoverEnabled: true
-                                onClicked: {
-                                    var entry = modelData;
-                                    KeyboardController.insertClipboardEntry(entry);
-                                }
-                            }
-                        }
+                    Text {
+                        id: previewText
+                        anchors.left: parent.left
+                        anchors.leftMargin: 8
+                        anchors.right: metaText.left
+                        anchors.rightMargin: 8
+                        anchors.verticalCenter: parent.verticalCenter
+                        text: entry.preview
+                        color: Theme.keyText
+                        font.pixelSize: 12
+                        wrapMode: Text.Wrap
+                        elide: Text.ElideRight
+                        maximumLineCount: 3
                     }
 
+                    // Size hint for long entries
                     Text {
-                        visible: KeyboardController.clipboardHistory.length === 0
-                        text: "No clipboard history.\nKDE Klipper may not be running."
+                        id: metaText
+                        anchors.right: removeBtn.visible ? removeBtn.left : parent.right
+                        anchors.rightMargin: 8
+                        anchors.verticalCenter: parent.verticalCenter
+                        text: (entry.lineCount > 1 ? entry.lineCount + " lines, " : "") + entry.length + " chars"
                         color: Theme.keyTextDim
-                        font.pixelSize: 11
-                        width: parent.width
-                        horizontalAlignment: Text.AlignHCenter
-                        wrapMode: Text.WordWrap
-                        topPadding: 20
+                        font.pixelSize: 10
+                    }
+
+                    MouseArea {
+                        id: entryMa
+                        anchors.fill: parent
+                        hoverEnabled: true
+                        onClicked: KeyboardController.pasteClipboardRow(entry.index)
+                    }
+
+                    // Only the built-in store can forget entries
+                    Rectangle {
+                        id: removeBtn
+                        anchors.right: parent.right
+                        anchors.rightMargin: 4
+                        anchors.verticalCenter: parent.verticalCenter
+                        width: 22; height: 22; radius: 3
+                        visible: KeyboardController.clipboardBackend === "native"
+                        color: removeMa.pressed ? Theme.keyBackgroundPressed : "transparent"
+
+                        Text {
+                            anchors.centerIn: parent
+                            text: "\u00d7"
+                            color: Theme.keyTextDim
+                            font.pixelSize: 14
+                        }
+
+                        MouseArea {
+                            id: removeMa; anchors.fill: parent
+                            onClicked: KeyboardController.removeClipboardRow(entry.index)
+                        }
                     }
                 }
             }
+
+            Text {
+                visible: entryList.count === 0 && filterInput.text.length === 0
+                text: KeyboardController.clipboardBackend === "native"
+                      ? "No clipboard history yet."
+                      : "No clipboard history.\nKDE Klipper may not be running."
+                color: Theme.keyTextDim
+                font.pixelSize: 11
+                width: parent.width
+                horizontalAlignment: Text.AlignHCenter
+                wrapMode: Text.WordWrap
+                topPadding: 20
+            }
         }
     }
 }
@@ -17,12 +17,46 @@ AbstractButton {
     implicitWidth: Theme.keyHeight * keyWidth + (keyWidth > 1 ? Theme.keySpacing * (keyWidth - 1) : 0)
     implicitHeight: Theme.keyHeight
 
-    readonly property bool _isLetter: label.length === 1 && label >= "a" && label <= "z"
+    // Character keys show what the active XKB layout produces; label and
+    // shiftLabel are the US fallback
+    readonly property bool _isCharacter: keyCode > 0 && label.length === 1
+    readonly property string keyText: _isCharacter ? _layoutLabel(KeyboardController.keymapRevision, false) : label
+    readonly property string shiftKeyText: _isCharacter ? _layoutLabel(KeyboardController.keymapRevision, true) : shiftLabel
+
+    function _layoutLabel(revision, shift) {
+        var text = KeyboardController.keyLabel(keyCode, shift);
+        return text !== "" ? text : (shift ? shiftLabel : label);
+    }
+
+    readonly property bool _isLetter: keyText.length === 1 && keyText.toLowerCase() !== keyText.toUpperCase()
+
+    // Character keys recognise flicks, and letter keys start swipes; they
+    // commit on release (or when the repeat delay runs out) instead of on
+    // press
+    readonly property bool _flicks: KeyboardController.flickGestures && _isCharacter && !isModifier
+    // Set by the layout the swipe decoder measures keys in
+    property Item swipeSurface: null
+    readonly property bool _swipes: swipeSurface !== null && KeyboardController.swipeTyping && _isLetter && !isModifier
+    property bool _tracking: false
+    property bool _committed: false
+
+    function _flash(text) {
+        flashText = text;
+        flashTimer.restart();
+    }
+
+    function _endPress(commit) {
+        repeatDelay.stop();
+        repeatTimer.stop();
+        if (commit && _tracking && !_committed)
+            KeyboardController.pressKey(keyCode);
+        _tracking = false;
+    }
 
     readonly property string displayLabel: {
-        if (shiftLabel !== "" && (KeyboardController.shiftActive || KeyboardController.capsLockActive))
-            return shiftLabel;
-        return label;
+        if (shiftKeyText !== "" && (KeyboardController.shiftActive || KeyboardController.capsLockActive))
+            return shiftKeyText;
+        return keyText;
     }
 
     Timer {
@@ -34,8 +68,6 @@ AbstractButton {
     background: Rectangle {
         radius: Theme.keyRadius
         color: {
-            if ((root.pressed || rightClickArea.pressed) && Theme.keyPressEnabled)
-                return Theme.keyBackgroundPressed;
             if (root.isModifier && root.modifierLocked && Theme.lockedKeyEnabled)
                 return Theme.keyBackgroundLocked;
             if (root.isModifier && root.modifierActive)
@@ -45,11 +77,45 @@ AbstractButton {
         border.width: KeyboardController.keyBorderEnabled ? 1 : 0
         border.color: Theme.keyBorderColor
 
-        Behavior on color { ColorAnimation { duration: 80 } }
+        Behavior on color {
+            enabled: KeyboardController.pressAnimation
+            ColorAnimation { duration: 80 }
+        }
+
+        // Pressed state as an overlay faded by an animator: its opacity is
+        // animated on the render thread, so the fade keeps running while the
+        // GUI thread is busy with the key the press typed
+        Rectangle {
+            id: pressHighlight
+            anchors.fill: parent
+            radius: parent.radius
+            color: Theme.keyBackgroundPressed
+            border.width: parent.border.width
+            border.color: parent.border.color
+            opacity: 0
+            visible: Theme.keyPressEnabled
+        }
+    }
+
+    readonly property bool _down: pressed || rightClickArea.pressed
+
+    on_DownChanged: {
+        pressFade.stop();
+        pressFade.to = _down ? 1 : 0;
+        pressFade.duration = KeyboardController.pressAnimation ? 80 : 0;
+        pressFade.start();
+    }
+
+    OpacityAnimator {
+        id: pressFade
+        target: pressHighlight
     }
 
     contentItem: Item {
-        // Flash overlay (shown briefly on right-click)
+        // The software rasterizer redraws glyphs on every repaint; keep the
+        // labels as a cached image so a press only refills the key
+        layer.enabled: KeyboardController.softwareRenderingActive
+        // Flash overlay (shown briefly on right-click or flick)
         Text {
             visible: root.flashText !== ""
             anchors.centerIn: parent
@@ -63,19 +129,19 @@ AbstractButton {
 
         // Dual label: shift symbol small on top, main below (non-letter keys with shiftLabel)
         Column {
-            visible: root.flashText === "" && root.shiftLabel !== "" && !root._isLetter
+            visible: root.flashText === "" && root.shiftKeyText !== "" && !root._isLetter
             anchors.centerIn: parent
             spacing: 0
 
             Text {
-                text: root.shiftLabel
+                text: root.shiftKeyText
                 color: Theme.keyTextDim
                 font.pixelSize: 9
                 horizontalAlignment: Text.AlignHCenter
                 anchors.horizontalCenter: parent.horizontalCenter
             }
             Text {
-                text: root.label
+                text: root.keyText
                 color: Theme.keyText
                 font.pixelSize: Theme.fontSize
                 horizontalAlignment: Text.AlignHCenter
@@ -85,7 +151,7 @@ AbstractButton {
 
         // Single label: letters, modifiers, special keys
         Text {
-            visible: root.flashText === "" && (root.shiftLabel === "" || root._isLetter)
+            visible: root.flashText === "" && (root.shiftKeyText === "" || root._isLetter)
             anchors.centerIn: parent
             text: root.displayLabel
             color: Theme.keyText
@@ -101,7 +167,13 @@ AbstractButton {
         id: repeatDelay
         interval: KeyboardController.keyRepeatDelay
         repeat: false
-        onTriggered: repeatTimer.start()
+        onTriggered: {
+            if (root._tracking && !root._committed) {
+                root._committed = true;
+                KeyboardController.pressKey(root.keyCode);
+            }
+            repeatTimer.start();
+        }
     }
 
     Timer {
@@ -116,30 +188,93 @@ AbstractButton {
 
     onPressed: {
         if (!isModifier && keyCode >= 0) {
-            KeyboardController.pressKey(keyCode);
+            if (_flicks || _swipes) {
+                _tracking = true;
+                _committed = false;
+                if (_flicks)
+                    KeyboardController.flickBegin(keyCode, pressX, pressY, height);
+            } else {
+                // Typed after the highlight is synchronized to the render thread
+                KeyboardController.pressKeyAfterFrame(keyCode);
+            }
             repeatDelay.start();
         }
     }
 
-    onReleased: {
-        repeatDelay.stop();
-        repeatTimer.stop();
+    // Move samples; the recogniser runs in C++
+    onPressYChanged: {
+        if (!_flicks || !_tracking || _committed) return;
+        var typed = KeyboardController.flickUpdate(pressX, pressY);
+        if (typed !== "") {
+            _committed = true;
+            repeatDelay.stop();
+            _flash(typed);
+        }
     }
 
-    onCanceled: {
-        repeatDelay.stop();
-        repeatTimer.stop();
+    onReleased: _endPress(true)
+
+    // Also reached when the finger slid off the key before lifting; the
+    // press still types, as it did when keys committed on press. A swipe
+    // taking the press over cancels it as well, and only becomes active
+    // after that, so the commit waits for the event to be through.
+    onCanceled: Qt.callLater(root._endPress, true)
+
+    // Swipe typing: the press stays the key's until the stroke travels half
+    // a key, then the handler takes it over as a word. A press that already
+    // typed (flicked, or held into repeat) is not a swipe.
+    DragHandler {
+        id: swipeHandler
+        target: null
+        enabled: root._swipes && !root._committed
+        dragThreshold: root.height / 2
+        grabPermissions: PointerHandler.CanTakeOverFromItems
+
+        property var points: []
+        property bool abandoned: false
+
+        function surfacePoint(p) {
+            return root.mapToItem(root.swipeSurface, p.x, p.y);
+        }
+
+        onActiveChanged: {
+            if (active) {
+                root._endPress(false);
+                abandoned = false;
+                points = [surfacePoint(centroid.pressPosition), surfacePoint(centroid.position)];
+                return;
+            }
+            // A stolen grab deactivates before canceled() is emitted
+            Qt.callLater(finishStroke);
+        }
+
+        function finishStroke() {
+            if (!abandoned && points.length > 1)
+                KeyboardController.commitSwipe(points);
+            points = [];
+        }
+
+        onCentroidChanged: {
+            if (active)
+                points.push(surfacePoint(centroid.position));
+        }
+
+        onCanceled: abandoned = true
     }
 
-    // Right-click sends shift variant with highlight and flash
+    // Right-click types the shift variant with highlight and flash
     MouseArea {
         id: rightClickArea
         anchors.fill: parent
         acceptedButtons: Qt.RightButton
         onPressed: {
-            if (!root.isModifier && root.keyCode >= 0) {
-                root.flashText = root.shiftLabel !== "" ? root.shiftLabel : root.label;
-                flashTimer.restart();
+            if (root.isModifier || root.keyCode < 0) return;
+            var typed = KeyboardController.typeShifted(root.keyCode);
+            if (typed !== "") {
+                root._flash(typed);
+            } else {
+                // Keys without a Shift level still go through Shift
+                root._flash(root.keyText);
                 if (!KeyboardController.shiftActive)
                     KeyboardController.toggleShift();
                 KeyboardController.pressKey(root.keyCode);
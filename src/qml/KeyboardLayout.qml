@@ -4,7 +4,38 @@ Item {
     id: layout
 
     LettersPage {
+        id: letters
         anchors.fill: parent
         anchors.margins: Theme.keySpacing
     }
+
+    // Tell the swipe decoder where every letter key sits, and the keys
+    // where their strokes are decoded. Keys reported before (another
+    // keymap's letters) are dropped first.
+    function reportKeyGeometry() {
+        if (!KeyboardController.swipeTyping) return;
+        KeyboardController.clearKeyGeometry();
+        for (var r = 0; r < letters.children.length; ++r) {
+            var row = letters.children[r];
+            if (!row.visible) continue;
+            for (var k = 0; k < row.children.length; ++k) {
+                var key = row.children[k];
+                if (!key._isLetter) continue;
+                var p = key.mapToItem(layout, 0, 0);
+                KeyboardController.setKeyGeometry(key.keyText, p.x, p.y, key.width, key.height);
+                key.swipeSurface = layout;
+            }
+        }
+    }
+
+    Component.onCompleted: Qt.callLater(reportKeyGeometry)
+    onWidthChanged: Qt.callLater(reportKeyGeometry)
+    onHeightChanged: Qt.callLater(reportKeyGeometry)
+
+    Connections {
+        target: KeyboardController
+        function onCompactModeChanged() { Qt.callLater(layout.reportKeyGeometry) }
+        function onSwipeTypingChanged() { Qt.callLater(layout.reportKeyGeometry) }
+        function onKeymapChanged() { Qt.callLater(layout.reportKeyGeometry) }
+    }
 }
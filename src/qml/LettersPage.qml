@@ -143,7 +143,12 @@ Column {
             modifierLocked: KeyboardController.altLocked
             onClicked: KeyboardController.toggleAlt()
         }
-        KeyButton { label: ""; keyCode: 57; keyWidth: 4.5 }
+        KeyButton { label: ""; keyCode: 57; keyWidth: 3.5 }
+        KeyButton {
+            label: "\u2384"; keyWidth: 1.0; isModifier: true
+            modifierActive: KeyboardController.composeActive
+            onClicked: KeyboardController.toggleCompose()
+        }
         KeyButton {
             label: "Alt"; keyWidth: 1.0; isModifier: true
             modifierActive: KeyboardController.altActive
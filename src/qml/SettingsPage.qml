@@ -660,6 +660,84 @@ Rectangle {
                     }
                 }
 
+                // Low-memory mode: release the scene after being hidden this long
+                Row {
+                    spacing: 8
+                    anchors.horizontalCenter: parent.horizontalCenter
+
+                    Text {
+                        text: "Free memory:"
+                        color: Theme.keyText
+                        font.pixelSize: 13
+                        width: 100
+                        anchors.verticalCenter: parent.verticalCenter
+                    }
+
+                    Rectangle {
+                        width: 28; height: 28; radius: 4
+                        color: decReleaseMa.pressed ? Theme.keyBackgroundPressed : Theme.keyBackground
+                        Text { anchors.centerIn: parent; text: "-"; color: Theme.keyText; font.pixelSize: 14 }
+                        MouseArea {
+                            id: decReleaseMa; anchors.fill: parent
+                            onClicked: KeyboardController.setReleaseHiddenDelay(KeyboardController.releaseHiddenDelay - 30)
+                        }
+                    }
+
+                    Text {
+                        text: KeyboardController.releaseHiddenDelay === 0 ? "Off"
+                              : KeyboardController.releaseHiddenDelay + " s"
+                        color: Theme.keyText
+                        font.pixelSize: 13
+                        width: 60
+                        horizontalAlignment: Text.AlignHCenter
+                        anchors.verticalCenter: parent.verticalCenter
+                    }
+
+                    Rectangle {
+                        width: 28; height: 28; radius: 4
+                        color: incReleaseMa.pressed ? Theme.keyBackgroundPressed : Theme.keyBackground
+                        Text { anchors.centerIn: parent; text: "+"; color: Theme.keyText; font.pixelSize: 14 }
+                        MouseArea {
+                            id: incReleaseMa; anchors.fill: parent
+                            onClicked: KeyboardController.setReleaseHiddenDelay(KeyboardController.releaseHiddenDelay + 30)
+                        }
+                    }
+                }
+
+                // Show and hide with text field focus (input-method-v2 only)
+                Row {
+                    visible: KeyboardController.inputMethodAvailable
+                    spacing: 8
+                    anchors.horizontalCenter: parent.horizontalCenter
+
+                    Text {
+                        text: "Follow text focus:"
+                        color: Theme.keyText
+                        font.pixelSize: 13
+                        width: 120
+                        anchors.verticalCenter: parent.verticalCenter
+                    }
+
+                    Rectangle {
+                        width: 60; height: 28; radius: 4
+                        color: KeyboardController.followTextFocus
+                               ? Theme.keyBackgroundModActive
+                               : Theme.keyBackground
+
+                        Text {
+                            anchors.centerIn: parent
+                            text: KeyboardController.followTextFocus ? "On" : "Off"
+                            color: Theme.keyText
+                            font.pixelSize: 13
+                        }
+
+                        MouseArea {
+                            anchors.fill: parent
+                            onClicked: KeyboardController.setFollowTextFocus(!KeyboardController.followTextFocus)
+                        }
+                    }
+                }
+
                 // Sound feedback
                 Row {
                     spacing: 8
@@ -726,6 +804,39 @@ Rectangle {
                     }
                 }
 
+                // Direct paste: serve pasted text ourselves and restore the clipboard
+                Row {
+                    spacing: 8
+                    anchors.horizontalCenter: parent.horizontalCenter
+
+                    Text {
+                        text: "Direct paste:"
+                        color: Theme.keyText
+                        font.pixelSize: 13
+                        width: 120
+                        anchors.verticalCenter: parent.verticalCenter
+                    }
+
+                    Rectangle {
+                        width: 60; height: 28; radius: 4
+                        color: KeyboardController.directClipboard
+                               ? Theme.keyBackgroundModActive
+                               : Theme.keyBackground
+
+                        Text {
+                            anchors.centerIn: parent
+                            text: KeyboardController.directClipboard ? "On" : "Off"
+                            color: Theme.keyText
+                            font.pixelSize: 13
+                        }
+
+                        MouseArea {
+                            anchors.fill: parent
+                            onClicked: KeyboardController.setDirectClipboard(!KeyboardController.directClipboard)
+                        }
+                    }
+                }
+
                 // Close on insert shortcut
                 Row {
                     spacing: 8
@@ -759,6 +870,329 @@ Rectangle {
                     }
                 }
 
+                // Word completion
+                Row {
+                    spacing: 8
+                    anchors.horizontalCenter: parent.horizontalCenter
+
+                    Text {
+                        text: "Word completion:"
+                        color: Theme.keyText
+                        font.pixelSize: 13
+                        width: 120
+                        anchors.verticalCenter: parent.verticalCenter
+                    }
+
+                    Rectangle {
+                        width: 60; height: 28; radius: 4
+                        color: KeyboardController.wordCompletion
+                               ? Theme.keyBackgroundModActive
+                               : Theme.keyBackground
+
+                        Text {
+                            anchors.centerIn: parent
+                            text: KeyboardController.wordCompletion ? "On" : "Off"
+                            color: Theme.keyText
+                            font.pixelSize: 13
+                        }
+
+                        MouseArea {
+                            anchors.fill: parent
+                            onClicked: KeyboardController.setWordCompletion(!KeyboardController.wordCompletion)
+                        }
+                    }
+                }
+
+                // Suggest shortcuts while their trigger is typed
+                Row {
+                    spacing: 8
+                    anchors.horizontalCenter: parent.horizontalCenter
+
+                    Text {
+                        text: "Shortcut hints:"
+                        color: Theme.keyText
+                        font.pixelSize: 13
+                        width: 120
+                        anchors.verticalCenter: parent.verticalCenter
+                    }
+
+                    Rectangle {
+                        width: 60; height: 28; radius: 4
+                        color: KeyboardController.shortcutSuggestions
+                               ? Theme.keyBackgroundModActive
+                               : Theme.keyBackground
+
+                        Text {
+                            anchors.centerIn: parent
+                            text: KeyboardController.shortcutSuggestions ? "On" : "Off"
+                            color: Theme.keyText
+                            font.pixelSize: 13
+                        }
+
+                        MouseArea {
+                            anchors.fill: parent
+                            onClicked: KeyboardController.setShortcutSuggestions(!KeyboardController.shortcutSuggestions)
+                        }
+                    }
+                }
+
+                // Swipe typing
+                Row {
+                    spacing: 8
+                    anchors.horizontalCenter: parent.horizontalCenter
+
+                    Text {
+                        text: "Swipe typing:"
+                        color: Theme.keyText
+                        font.pixelSize: 13
+                        width: 120
+                        anchors.verticalCenter: parent.verticalCenter
+                    }
+
+                    Rectangle {
+                        width: 60; height: 28; radius: 4
+                        color: KeyboardController.swipeTyping
+                               ? Theme.keyBackgroundModActive
+                               : Theme.keyBackground
+
+                        Text {
+                            anchors.centerIn: parent
+                            text: KeyboardController.swipeTyping ? "On" : "Off"
+                            color: Theme.keyText
+                            font.pixelSize: 13
+                        }
+
+                        MouseArea {
+                            anchors.fill: parent
+                            onClicked: KeyboardController.setSwipeTyping(!KeyboardController.swipeTyping)
+                        }
+                    }
+                }
+
+                // Autocorrect
+                Row {
+                    spacing: 8
+                    anchors.horizontalCenter: parent.horizontalCenter
+
+                    Text {
+                        text: "Autocorrect:"
+                        color: Theme.keyText
+                        font.pixelSize: 13
+                        width: 120
+                        anchors.verticalCenter: parent.verticalCenter
+                    }
+
+                    Rectangle {
+                        width: 60; height: 28; radius: 4
+                        color: KeyboardController.autocorrect
+                               ? Theme.keyBackgroundModActive
+                               : Theme.keyBackground
+
+                        Text {
+                            anchors.centerIn: parent
+                            text: KeyboardController.autocorrect ? "On" : "Off"
+                            color: Theme.keyText
+                            font.pixelSize: 13
+                        }
+
+                        MouseArea {
+                            anchors.fill: parent
+                            onClicked: KeyboardController.setAutocorrect(!KeyboardController.autocorrect)
+                        }
+                    }
+                }
+
+                // Clipboard history source
+                Row {
+                    spacing: 8
+                    anchors.horizontalCenter: parent.horizontalCenter
+
+                    Text {
+                        text: "Clipboard:"
+                        color: Theme.keyText
+                        font.pixelSize: 13
+                        width: 120
+                        anchors.verticalCenter: parent.verticalCenter
+                    }
+
+                    Row {
+                        spacing: 4
+
+                        Repeater {
+                            model: [
+                                { label: "Klipper", value: "klipper" },
+                                { label: "Built-in", value: "native" }
+                            ]
+
+                            Rectangle {
+                                required property var modelData
+                                width: 66; height: 28; radius: 4
+                                color: KeyboardController.clipboardBackend === modelData.value
+                                       ? Theme.keyBackgroundModActive
+                                       : Theme.keyBackground
+
+                                Text {
+                                    anchors.centerIn: parent
+                                    text: modelData.label
+                                    color: Theme.keyText
+                                    font.pixelSize: 12
+                                }
+
+                                MouseArea {
+                                    anchors.fill: parent
+                                    onClicked: KeyboardController.setClipboardBackend(modelData.value)
+                                }
+                            }
+                        }
+                    }
+                }
+
+                // Software rendering (Qt Quick software rasterizer, applies on restart)
+                Row {
+                    spacing: 8
+                    anchors.horizontalCenter: parent.horizontalCenter
+
+                    Text {
+                        text: "Software rendering:"
+                        color: Theme.keyText
+                        font.pixelSize: 13
+                        width: 120
+                        anchors.verticalCenter: parent.verticalCenter
+                    }
+
+                    Rectangle {
+                        width: 60; height: 28; radius: 4
+                        color: KeyboardController.softwareRendering
+                               ? Theme.keyBackgroundModActive
+                               : Theme.keyBackground
+
+                        Text {
+                            anchors.centerIn: parent
+                            text: KeyboardController.softwareRendering ? "On" : "Off"
+                            color: Theme.keyText
+                            font.pixelSize: 13
+                        }
+
+                        MouseArea {
+                            anchors.fill: parent
+                            onClicked: KeyboardController.setSoftwareRendering(!KeyboardController.softwareRendering)
+                        }
+                    }
+                }
+
+                // Animated key press colour
+                Row {
+                    spacing: 8
+                    anchors.horizontalCenter: parent.horizontalCenter
+
+                    Text {
+                        text: "Press animation:"
+                        color: Theme.keyText
+                        font.pixelSize: 13
+                        width: 120
+                        anchors.verticalCenter: parent.verticalCenter
+                    }
+
+                    Rectangle {
+                        width: 60; height: 28; radius: 4
+                        color: KeyboardController.pressAnimation
+                               ? Theme.keyBackgroundModActive
+                               : Theme.keyBackground
+
+                        Text {
+                            anchors.centerIn: parent
+                            text: KeyboardController.pressAnimation ? "On" : "Off"
+                            color: Theme.keyText
+                            font.pixelSize: 13
+                        }
+
+                        MouseArea {
+                            anchors.fill: parent
+                            onClicked: KeyboardController.setPressAnimation(!KeyboardController.pressAnimation)
+                        }
+                    }
+                }
+
+                // Flick up/down on a key for its shifted/alternate character
+                Row {
+                    spacing: 8
+                    anchors.horizontalCenter: parent.horizontalCenter
+
+                    Text {
+                        text: "Flick keys:"
+                        color: Theme.keyText
+                        font.pixelSize: 13
+                        width: 120
+                        anchors.verticalCenter: parent.verticalCenter
+                    }
+
+                    Rectangle {
+                        width: 60; height: 28; radius: 4
+                        color: KeyboardController.flickGestures
+                               ? Theme.keyBackgroundModActive
+                               : Theme.keyBackground
+
+                        Text {
+                            anchors.centerIn: parent
+                            text: KeyboardController.flickGestures ? "On" : "Off"
+                            color: Theme.keyText
+                            font.pixelSize: 13
+                        }
+
+                        MouseArea {
+                            anchors.fill: parent
+                            onClicked: KeyboardController.setFlickGestures(!KeyboardController.flickGestures)
+                        }
+                    }
+                }
+
+                // Macro playback speed
+                Row {
+                    spacing: 8
+                    anchors.horizontalCenter: parent.horizontalCenter
+
+                    Text {
+                        text: "Macro speed:"
+                        color: Theme.keyText
+                        font.pixelSize: 13
+                        width: 120
+                        anchors.verticalCenter: parent.verticalCenter
+                    }
+
+                    Row {
+                        spacing: 4
+
+                        Repeater {
+                            model: [
+                                { label: "Max", value: 0 },
+                                { label: "100/s", value: 100 },
+                                { label: "30/s", value: 30 },
+                                { label: "10/s", value: 10 }
+                            ]
+
+                            Rectangle {
+                                required property var modelData
+                                width: 44; height: 28; radius: 4
+                                color: KeyboardController.macroRate === modelData.value
+                                       ? Theme.keyBackgroundModActive
+                                       : Theme.keyBackground
+
+                                Text {
+                                    anchors.centerIn: parent
+                                    text: modelData.label
+                                    color: Theme.keyText
+                                    font.pixelSize: 12
+                                }
+
+                                MouseArea {
+                                    anchors.fill: parent
+                                    onClicked: KeyboardController.setMacroRate(modelData.value)
+                                }
+                            }
+                        }
+                    }
+                }
+
                 // Compact mode
                 Row {
                     spacing: 8
@@ -7,6 +7,7 @@ Rectangle {
 
     property bool dialogOpen: false
     property int editingIndex: -1
+    property int editingMacroIndex: -1
     property int selectedIndex: -1
     property int confirmDeleteIndex: -1
 
@@ -37,6 +38,26 @@ Rectangle {
                 anchors.verticalCenter: parent.verticalCenter
                 spacing: 6
 
+                Rectangle {
+                    width: 60; height: 26; radius: 4
+                    color: importMa.pressed ? Theme.keyBackgroundPressed : Theme.keyBackground
+                    Text { anchors.centerIn: parent; text: "Import"; color: Theme.keyText; font.pixelSize: 12 }
+                    MouseArea {
+                        id: importMa; anchors.fill: parent
+                        onClicked: KeyboardController.importShortcuts()
+                    }
+                }
+
+                Rectangle {
+                    width: 60; height: 26; radius: 4
+                    color: exportMa.pressed ? Theme.keyBackgroundPressed : Theme.keyBackground
+                    Text { anchors.centerIn: parent; text: "Export"; color: Theme.keyText; font.pixelSize: 12 }
+                    MouseArea {
+                        id: exportMa; anchors.fill: parent
+                        onClicked: KeyboardController.exportShortcuts()
+                    }
+                }
+
                 Rectangle {
                     width: 60; height: 26; radius: 4
                     color: addMa.pressed ? Theme.keyBackgroundPressed : Theme.keyBackground
@@ -46,6 +67,7 @@ Rectangle {
                         onClicked: {
                             shortcutInput.text = "";
                             expansionInput.text = "";
+                            scopeInput.text = "";
                             shortcutsRoot.editingIndex = -1;
                             shortcutsRoot.dialogOpen = true;
                             KeyboardController.setShortcutDialogOpen(true);
@@ -69,20 +91,129 @@ Rectangle {
                 radius: 4
                 color: Qt.darker(Theme.keyboardBackground, 1.1)
 
-                Flickable {
+                ListView {
+                    id: shortcutList
                     anchors.fill: parent
                     anchors.margins: 4
                     clip: true
-                    contentHeight: listCol.height
+                    spacing: 3
                     boundsBehavior: Flickable.StopAtBounds
+                    model: KeyboardController.shortcutModel
+                    reuseItems: true
+
+                    delegate: Rectangle {
+                        required property int index
+                        required property string shortcut
+                        required property string expansion
+                        required property string scope
+                        width: shortcutList.width
+                        height: 28
+                        radius: 3
+                        color: shortcutsRoot.selectedIndex === index
+                               ? Theme.keyBackgroundPressed
+                               : itemMa.containsMouse ? Qt.lighter(Theme.keyBackground, 1.1) : Theme.keyBackground
+
+                        Text {
+                            anchors.left: parent.left
+                            anchors.leftMargin: 8
+                            anchors.right: itemBtnRow.left
+                            anchors.rightMargin: 4
+                            anchors.verticalCenter: parent.verticalCenter
+                            text: shortcut + (scope ? "  [" + scope + "]" : "")
+                            color: Theme.keyText
+                            font.pixelSize: 12
+                            font.bold: true
+                            elide: Text.ElideRight
+                        }
+
+                        Row {
+                            id: itemBtnRow
+                            anchors.right: parent.right
+                            anchors.rightMargin: 4
+                            anchors.verticalCenter: parent.verticalCenter
+                            spacing: 2
+
+                            Rectangle {
+                                width: 36; height: 22; radius: 3
+                                color: insertItemMa.pressed ? Theme.keyBackgroundPressed : Qt.lighter(Theme.keyBackground, 1.3)
+                                Text { anchors.centerIn: parent; text: "Insert"; color: Theme.keyText; font.pixelSize: 9 }
+                                MouseArea {
+                                    id: insertItemMa; anchors.fill: parent
+                                    onClicked: KeyboardController.insertShortcutExpansion(index)
+                                }
+                            }
+
+                            Rectangle {
+                                width: 28; height: 22; radius: 3
+                                color: editItemMa.pressed ? Theme.keyBackgroundPressed : Qt.lighter(Theme.keyBackground, 1.3)
+                                Text { anchors.centerIn: parent; text: "Edit"; color: Theme.keyText; font.pixelSize: 9 }
+                                MouseArea {
+                                    id: editItemMa; anchors.fill: parent
+                                    onClicked: {
+                                        shortcutInput.text = shortcut;
+                                        expansionInput.text = expansion;
+                                        scopeInput.text = scope;
+                                        shortcutsRoot.editingIndex = index;
+                                        shortcutsRoot.dialogOpen = true;
+                                        KeyboardController.setShortcutDialogOpen(true);
+                                        shortcutInput.forceActiveFocus();
+                                    }
+                                }
+                            }
 
-                    Column {
+                            Rectangle {
+                                width: 22; height: 22; radius: 3
+                                color: delItemMa.pressed ? "#c0392b" : "transparent"
+                                Text {
+                                    anchors.centerIn: parent; text: "\u2715"
+                                    color: delItemMa.pressed ? "#ffffff" : Theme.keyTextDim; font.pixelSize: 10
+                                }
+                                MouseArea {
+                                    id: delItemMa; anchors.fill: parent
+                                    onClicked: shortcutsRoot.confirmDeleteIndex = index
+                                }
+                            }
+                        }
+
+                        MouseArea {
+                            id: itemMa
+                            anchors.fill: parent
+                            anchors.rightMargin: itemBtnRow.width + 8
+                            hoverEnabled: true
+                            onClicked: shortcutsRoot.selectedIndex = index
+                        }
+                    }
+
+                    // Empty state and recorded macros follow the shortcuts
+                    footer: Column {
                         id: listCol
-                        width: parent.width
+                        width: shortcutList.width
+                        topPadding: 3
                         spacing: 3
 
+                        Text {
+                            visible: KeyboardController.shortcutCount === 0
+                            text: "No shortcuts yet.\nTap \"Add\" to create one."
+                            color: Theme.keyTextDim
+                            font.pixelSize: 11
+                            width: parent.width
+                            horizontalAlignment: Text.AlignHCenter
+                            wrapMode: Text.WordWrap
+                            topPadding: 20
+                        }
+
+                        // Recorded macros (record with the \u25cf button in the drag bar)
+                        Text {
+                            visible: KeyboardController.macros.length > 0
+                            text: "MACROS"
+                            color: Theme.keyTextDim
+                            font.pixelSize: 10
+                            font.bold: true
+                            topPadding: 6
+                        }
+
                         Repeater {
-                            model: KeyboardController.shortcuts
+                            model: KeyboardController.macros
 
                             delegate: Rectangle {
                                 required property var modelData
@@ -90,25 +221,23 @@ Rectangle {
                                 width: listCol.width
                                 height: 28
                                 radius: 3
-                                color: shortcutsRoot.selectedIndex === index
-                                       ? Theme.keyBackgroundPressed
-                                       : itemMa.containsMouse ? Qt.lighter(Theme.keyBackground, 1.1) : Theme.keyBackground
+                                color: Theme.keyBackground
 
                                 Text {
                                     anchors.left: parent.left
                                     anchors.leftMargin: 8
-                                    anchors.right: itemBtnRow.left
+                                    anchors.right: macroBtnRow.left
                                     anchors.rightMargin: 4
                                     anchors.verticalCenter: parent.verticalCenter
-                                    text: modelData.shortcut || ""
+                                    text: (modelData.trigger ? modelData.trigger + "  " : "")
+                                          + modelData.name + " (" + modelData.keys + " keys)"
                                     color: Theme.keyText
                                     font.pixelSize: 12
-                                    font.bold: true
                                     elide: Text.ElideRight
                                 }
 
                                 Row {
-                                    id: itemBtnRow
+                                    id: macroBtnRow
                                     anchors.right: parent.right
                                     anchors.rightMargin: 4
                                     anchors.verticalCenter: parent.verticalCenter
@@ -116,24 +245,24 @@ Rectangle {
 
                                     Rectangle {
                                         width: 36; height: 22; radius: 3
-                                        color: insertItemMa.pressed ? Theme.keyBackgroundPressed : Qt.lighter(Theme.keyBackground, 1.3)
-                                        Text { anchors.centerIn: parent; text: "Insert"; color: Theme.keyText; font.pixelSize: 9 }
+                                        color: playMacroMa.pressed ? Theme.keyBackgroundPressed : Qt.lighter(Theme.keyBackground, 1.3)
+                                        Text { anchors.centerIn: parent; text: "Play"; color: Theme.keyText; font.pixelSize: 9 }
                                         MouseArea {
-                                            id: insertItemMa; anchors.fill: parent
-                                            onClicked: KeyboardController.insertShortcutExpansion(index)
+                                            id: playMacroMa; anchors.fill: parent
+                                            onClicked: KeyboardController.playMacro(index)
                                         }
                                     }
 
                                     Rectangle {
                                         width: 28; height: 22; radius: 3
-                                        color: editItemMa.pressed ? Theme.keyBackgroundPressed : Qt.lighter(Theme.keyBackground, 1.3)
+                                        color: editMacroMa.pressed ? Theme.keyBackgroundPressed : Qt.lighter(Theme.keyBackground, 1.3)
                                         Text { anchors.centerIn: parent; text: "Edit"; color: Theme.keyText; font.pixelSize: 9 }
                                         MouseArea {
-                                            id: editItemMa; anchors.fill: parent
+                                            id: editMacroMa; anchors.fill: parent
                                             onClicked: {
-                                                shortcutInput.text = modelData.shortcut || "";
-                                                expansionInput.text = modelData.expansion || "";
-                                                shortcutsRoot.editingIndex = index;
+                                                shortcutInput.text = modelData.trigger || "";
+                                                shortcutsRoot.editingIndex = -1;
+                                                shortcutsRoot.editingMacroIndex = index;
                                                 shortcutsRoot.dialogOpen = true;
                                                 KeyboardController.setShortcutDialogOpen(true);
                                                 shortcutInput.forceActiveFocus();
@@ -143,38 +272,19 @@ Rectangle {
 
                                     Rectangle {
                                         width: 22; height: 22; radius: 3
-                                        color: delItemMa.pressed ? "#c0392b" : "transparent"
+                                        color: delMacroMa.pressed ? "#c0392b" : "transparent"
                                         Text {
                                             anchors.centerIn: parent; text: "\u2715"
-                                            color: delItemMa.pressed ? "#ffffff" : Theme.keyTextDim; font.pixelSize: 10
+                                            color: delMacroMa.pressed ? "#ffffff" : Theme.keyTextDim; font.pixelSize: 10
                                         }
                                         MouseArea {
-                                            id: delItemMa; anchors.fill: parent
-                                            onClicked: shortcutsRoot.confirmDeleteIndex = index
+                                            id: delMacroMa; anchors.fill: parent
+                                            onClicked: KeyboardController.removeMacro(index)
                                         }
                                     }
                                 }
-
-                                MouseArea {
-                                    id: itemMa
-                                    anchors.fill: parent
-                                    anchors.rightMargin: itemBtnRow.width + 8
-                                    hoverEnabled: true
-                                    onClicked: shortcutsRoot.selectedIndex = index
-                                }
                             }
                         }
-
-                        Text {
-                            visible: KeyboardController.shortcuts.length === 0
-                            text: "No shortcuts yet.\nTap \"Add\" to create one."
-                            color: Theme.keyTextDim
-                            font.pixelSize: 11
-                            width: parent.width
-                            horizontalAlignment: Text.AlignHCenter
-                            wrapMode: Text.WordWrap
-                            topPadding: 20
-                        }
                     }
                 }
             }
@@ -201,8 +311,8 @@ Rectangle {
                         font.pixelSize: 12
                         text: {
                             if (shortcutsRoot.selectedIndex >= 0
-                                && shortcutsRoot.selectedIndex < KeyboardController.shortcuts.length) {
-                                return KeyboardController.shortcuts[shortcutsRoot.selectedIndex].expansion || "";
+                                && shortcutsRoot.selectedIndex < KeyboardController.shortcutCount) {
+                                return KeyboardController.shortcutAt(shortcutsRoot.selectedIndex).expansion || "";
                             }
                             return "";
                         }
@@ -211,7 +321,7 @@ Rectangle {
 
                 Text {
                     visible: shortcutsRoot.selectedIndex < 0
-                             || shortcutsRoot.selectedIndex >= KeyboardController.shortcuts.length
+                             || shortcutsRoot.selectedIndex >= KeyboardController.shortcutCount
                     anchors.centerIn: parent
                     text: "Select a shortcut\nto see its expansion"
                     color: Theme.keyTextDim
@@ -245,8 +355,8 @@ Rectangle {
                 width: Math.min(shortcutsRoot.width - 80, 300)
                 text: {
                     var idx = shortcutsRoot.confirmDeleteIndex;
-                    if (idx >= 0 && idx < KeyboardController.shortcuts.length) {
-                        var e = KeyboardController.shortcuts[idx];
+                    if (idx >= 0 && idx < KeyboardController.shortcutCount) {
+                        var e = KeyboardController.shortcutAt(idx);
                         return (e.shortcut || "") + " \u2192 " + (e.expansion || "");
                     }
                     return "";
@@ -306,7 +416,8 @@ Rectangle {
             width: Math.min(parent.width - 40, 400)
 
             Text {
-                text: shortcutsRoot.editingIndex >= 0 ? "Edit Shortcut" : "Add Shortcut"
+                text: shortcutsRoot.editingMacroIndex >= 0 ? "Macro Trigger"
+                      : shortcutsRoot.editingIndex >= 0 ? "Edit Shortcut" : "Add Shortcut"
                 color: Theme.keyText
                 font.pixelSize: 16
                 font.bold: true
@@ -342,8 +453,62 @@ Rectangle {
                 }
             }
 
+            // App scope field (window class; blank = all applications)
+            Column {
+                visible: shortcutsRoot.editingMacroIndex < 0
+                width: parent.width
+                spacing: 2
+
+                Item {
+                    width: parent.width
+                    height: scopeLabel.height
+
+                    Text {
+                        id: scopeLabel
+                        text: "App (blank for all, \"terminal\" for any terminal)"
+                        color: Theme.keyTextDim
+                        font.pixelSize: 11
+                    }
+
+                    Text {
+                        anchors.right: parent.right
+                        visible: KeyboardController.activeWindowClass !== ""
+                        text: "Use " + KeyboardController.activeWindowClass
+                        color: useClassMa.pressed ? Theme.keyText : Theme.keyTextDim
+                        font.pixelSize: 11
+                        font.underline: true
+                        MouseArea {
+                            id: useClassMa; anchors.fill: parent
+                            onClicked: scopeInput.text = KeyboardController.activeWindowClass
+                        }
+                    }
+                }
+
+                Rectangle {
+                    width: parent.width
+                    height: 30
+                    radius: 4
+                    color: Qt.lighter(Theme.keyboardBackground, 1.3)
+                    border.color: Theme.keyTextDim
+                    border.width: 1
+
+                    TextEdit {
+                        id: scopeInput
+                        anchors.fill: parent
+                        anchors.margins: 6
+                        color: Theme.keyText
+                        selectionColor: Theme.keyBackgroundPressed
+                        font.pixelSize: 13
+                        verticalAlignment: TextEdit.AlignVCenter
+                        Keys.onReturnPressed: expansionInput.forceActiveFocus()
+                        Keys.onEnterPressed: expansionInput.forceActiveFocus()
+                    }
+                }
+            }
+
             // Expansion field
             Column {
+                visible: shortcutsRoot.editingMacroIndex < 0
                 width: parent.width
                 spacing: 2
 
@@ -387,15 +552,22 @@ Rectangle {
                     MouseArea {
                         id: saveMa; anchors.fill: parent
                         onClicked: {
-                            if (shortcutInput.text.length > 0 && expansionInput.text.length > 0) {
+                            if (shortcutsRoot.editingMacroIndex >= 0) {
+                                KeyboardController.setMacroTrigger(shortcutsRoot.editingMacroIndex,
+                                                                   shortcutInput.text);
+                            } else if (shortcutInput.text.length > 0 && expansionInput.text.length > 0) {
                                 if (shortcutsRoot.editingIndex >= 0)
                                     KeyboardController.editShortcut(shortcutsRoot.editingIndex,
-                                                                     shortcutInput.text, expansionInput.text);
+                                                                     shortcutInput.text, expansionInput.text,
+                                                                     scopeInput.text);
                                 else
-                                    KeyboardController.addShortcut(shortcutInput.text, expansionInput.text);
+                                    KeyboardController.addShortcut(shortcutInput.text, expansionInput.text,
+                                                                   scopeInput.text);
                             }
                             shortcutInput.text = "";
                             expansionInput.text = "";
+                            scopeInput.text = "";
+                            shortcutsRoot.editingMacroIndex = -1;
                             shortcutsRoot.dialogOpen = false;
                             KeyboardController.setShortcutDialogOpen(false);
                         }
@@ -411,6 +583,8 @@ Rectangle {
                         onClicked: {
                             shortcutInput.text = "";
                             expansionInput.text = "";
+                            scopeInput.text = "";
+                            shortcutsRoot.editingMacroIndex = -1;
                             shortcutsRoot.dialogOpen = false;
                             KeyboardController.setShortcutDialogOpen(false);
                         }
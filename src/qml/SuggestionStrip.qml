@@ -0,0 +1,38 @@
+import QtQuick
+
+// Candidate strip shown in the drag bar while typing
+Row {
+    id: strip
+    spacing: 4
+
+    Repeater {
+        model: KeyboardController.suggestions
+
+        delegate: Rectangle {
+            required property var modelData
+            required property int index
+            width: Math.max(40, suggestionText.implicitWidth + 16)
+            height: 22
+            radius: 4
+            color: suggestionMa.pressed ? Theme.keyBackgroundPressed : Theme.keyBackground
+
+            Text {
+                id: suggestionText
+                anchors.centerIn: parent
+                // Undo entries show the word autocorrect replaced; shortcut
+                // entries show their trigger and the start of the expansion
+                text: modelData.undo ? "\u21b6 " + modelData.text
+                      : modelData.shortcut ? modelData.text + " \u2192 " + modelData.detail
+                      : modelData.text
+                color: Theme.keyText
+                font.pixelSize: 12
+            }
+
+            MouseArea {
+                id: suggestionMa
+                anchors.fill: parent
+                onClicked: KeyboardController.acceptSuggestion(index)
+            }
+        }
+    }
+}
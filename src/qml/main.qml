@@ -110,16 +110,23 @@ Window {
             anchors.topMargin: 6
             clip: true
 
-            ShortcutsPage {
+            // Pages are dropped while the scene is released (low-memory mode)
+            Loader {
                 anchors.fill: parent
+                active: !KeyboardController.sceneReleased
+                sourceComponent: ShortcutsPage {}
             }
 
-            ClipboardPage {
+            Loader {
                 anchors.fill: parent
+                active: !KeyboardController.sceneReleased
+                sourceComponent: ClipboardPage {}
             }
 
-            SettingsPage {
+            Loader {
                 anchors.fill: parent
+                active: !KeyboardController.sceneReleased
+                sourceComponent: SettingsPage {}
             }
         }
     }
@@ -187,6 +194,7 @@ Window {
 
             // Drag dots in center
             Row {
+                visible: KeyboardController.suggestions.length === 0
                 anchors.centerIn: parent
                 spacing: 4
                 Repeater {
@@ -238,6 +246,14 @@ Window {
                 }
             }
 
+            // Completion candidates (on top of drag area)
+            SuggestionStrip {
+                z: 1
+                anchors.left: parent.left
+                anchors.leftMargin: 6
+                anchors.verticalCenter: parent.verticalCenter
+            }
+
             // Control buttons (on top of drag area)
             Row {
                 z: 1
@@ -265,6 +281,43 @@ Window {
                     }
                 }
 
+                // Macro record toggle
+                Rectangle {
+                    width: 22; height: 22; radius: 4
+                    color: KeyboardController.macroRecording
+                           ? "#c0392b"
+                           : (macroRecMa.containsMouse ? Theme.keyBackground : "transparent")
+                    Text {
+                        anchors.centerIn: parent
+                        text: "\u25cf"
+                        color: KeyboardController.macroRecording ? "#ffffff" : Theme.keyTextDim
+                        font.pixelSize: 12
+                    }
+                    MouseArea {
+                        id: macroRecMa; anchors.fill: parent; hoverEnabled: true
+                        onClicked: KeyboardController.toggleMacroRecording()
+                    }
+                }
+
+                // Macro playback (last recorded macro)
+                Rectangle {
+                    visible: KeyboardController.macros.length > 0
+                    width: 22; height: 22; radius: 4
+                    color: KeyboardController.macroPlaying
+                           ? Theme.keyBackgroundModActive
+                           : (macroPlayMa.containsMouse ? Theme.keyBackground : "transparent")
+                    Text {
+                        anchors.centerIn: parent
+                        text: KeyboardController.macroPlaying ? "\u25a0" : "\u25b6"
+                        color: KeyboardController.macroPlaying ? Theme.keyText : Theme.keyTextDim
+                        font.pixelSize: 11
+                    }
+                    MouseArea {
+                        id: macroPlayMa; anchors.fill: parent; hoverEnabled: true
+                        onClicked: KeyboardController.playLastMacro()
+                    }
+                }
+
                 // Compact mode toggle
                 Rectangle {
                     width: 22; height: 22; radius: 4
@@ -592,13 +645,15 @@ Window {
                     }
                 }
 
-                NumpadPage {
+                Loader {
+                    active: KeyboardController.numpadVisible && !KeyboardController.sceneReleased
                     visible: KeyboardController.numpadVisible
                     anchors.top: parent.top
                     anchors.right: parent.right
                     anchors.bottom: parent.bottom
                     anchors.topMargin: Theme.keySpacing
                     width: scaler.numpadWidth
+                    sourceComponent: NumpadPage {}
                 }
             }
 
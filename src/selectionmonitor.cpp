@@ -0,0 +1,277 @@
+#include "selectionmonitor.h"
+#include "tracer.h"
+
+#include <QSocketNotifier>
+
+#include <wayland-client.h>
+#include "wlr-data-control-unstable-v1-client-protocol.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <utility>
+
+namespace {
+// Text in any flavour, and one lossless image format
+bool worthCopying(const QString &format)
+{
+    return format.startsWith(QLatin1String("text/")) || format == QLatin1String("image/png");
+}
+}
+
+SelectionMonitor::SelectionMonitor(QObject *parent)
+    : QObject(parent)
+{
+    m_copyTimeout.setSingleShot(true);
+    m_copyTimeout.setInterval(CopyTimeoutMs);
+    connect(&m_copyTimeout, &QTimer::timeout, this, [this]() {
+        qWarning("Clipboard copy incomplete after %d ms; keeping what arrived", CopyTimeoutMs);
+        while (!m_reads.empty())
+            closeRead(m_reads.back(), false);
+        finishCopy();
+    });
+}
+
+SelectionMonitor::~SelectionMonitor()
+{
+    // Whoever waits for copied() is going away as well
+    blockSignals(true);
+    disconnectFromCompositor();
+}
+
+bool SelectionMonitor::connectToCompositor()
+{
+    if (m_device) return true;
+    m_display = wl_display_connect(nullptr);
+    if (!m_display) return false;
+
+    static const wl_registry_listener registryListener = {
+        &SelectionMonitor::registryGlobal,
+        &SelectionMonitor::registryGlobalRemove,
+    };
+    m_registry = wl_display_get_registry(m_display);
+    wl_registry_add_listener(m_registry, &registryListener, this);
+    wl_display_roundtrip(m_display);
+    if (!m_manager || !m_seat) {
+        disconnectFromCompositor();
+        return false;
+    }
+
+    static const zwlr_data_control_device_v1_listener deviceListener = {
+        &SelectionMonitor::onDataOffer,
+        &SelectionMonitor::onSelection,
+        &SelectionMonitor::onFinished,
+        &SelectionMonitor::onPrimarySelection,
+    };
+    m_device = zwlr_data_control_manager_v1_get_data_device(m_manager, m_seat);
+    zwlr_data_control_device_v1_add_listener(m_device, &deviceListener, this);
+    // The current selection is sent right away
+    wl_display_roundtrip(m_display);
+
+    m_notifier = new QSocketNotifier(wl_display_get_fd(m_display), QSocketNotifier::Read, this);
+    connect(m_notifier, &QSocketNotifier::activated, this, &SelectionMonitor::dispatch);
+    return true;
+}
+
+void SelectionMonitor::disconnectFromCompositor()
+{
+    // The pipes would keep working, but without the device nothing tells
+    // which selection they belong to any more
+    const bool wasCopying = m_copying;
+    while (!m_reads.empty())
+        closeRead(m_reads.back(), false);
+    m_copyTimeout.stop();
+    m_copying = nullptr;
+    m_selection = nullptr;
+    for (auto it = m_offers.cbegin(); it != m_offers.cend(); ++it)
+        zwlr_data_control_offer_v1_destroy(it.key());
+    m_offers.clear();
+
+    delete m_notifier;
+    m_notifier = nullptr;
+    if (m_device) zwlr_data_control_device_v1_destroy(m_device);
+    if (m_manager) zwlr_data_control_manager_v1_destroy(m_manager);
+    if (m_seat) wl_seat_destroy(m_seat);
+    if (m_registry) wl_registry_destroy(m_registry);
+    m_device = nullptr;
+    m_manager = nullptr;
+    m_seat = nullptr;
+    m_registry = nullptr;
+    if (m_display) wl_display_disconnect(m_display);
+    m_display = nullptr;
+    if (wasCopying)
+        emit copied();
+}
+
+bool SelectionMonitor::isAvailable() const { return m_device != nullptr; }
+bool SelectionMonitor::isCopying() const { return m_copying != nullptr; }
+
+bool SelectionMonitor::startCopy(qsizetype limit)
+{
+    if (!m_device || m_copying) return false;
+    OSK_TRACE_SCOPE("SelectionMonitor::startCopy");
+    // Catch up with selection changes not dispatched yet
+    wl_display_roundtrip(m_display);
+    if (!m_selection) return false;
+
+    m_copy.clear();
+    m_limit = limit;
+    m_total = 0;
+    const QStringList formats = m_offers.value(m_selection);
+    for (const QString &format : formats) {
+        if (!worthCopying(format)) continue;
+        int fds[2];
+        if (pipe2(fds, O_CLOEXEC | O_NONBLOCK) < 0) break;
+        zwlr_data_control_offer_v1_receive(m_selection, format.toUtf8().constData(), fds[1]);
+        close(fds[1]);
+
+        auto *read = new Read;
+        read->format = format;
+        read->fd = fds[0];
+        read->notifier = new QSocketNotifier(fds[0], QSocketNotifier::Read, this);
+        connect(read->notifier, &QSocketNotifier::activated, this, [this, read]() { readAvailable(read); });
+        m_reads.push_back(read);
+    }
+    if (m_reads.empty()) return false;
+
+    m_copying = m_selection;
+    m_copyTimeout.start();
+    // The compositor forwards each receive to the owner before anything
+    // sent afterwards on another connection (the new selection) is handled
+    wl_display_roundtrip(m_display);
+    return true;
+}
+
+SelectionMonitor::Formats SelectionMonitor::takeCopy()
+{
+    return std::exchange(m_copy, {});
+}
+
+void SelectionMonitor::readAvailable(Read *read)
+{
+    char buffer[64 * 1024];
+    for (;;) {
+        const ssize_t n = ::read(read->fd, buffer, sizeof(buffer));
+        if (n > 0) {
+            m_total += n;
+            if (m_total > m_limit) {
+                // Too large to keep; the owner sees the pipe close
+                m_total -= read->data.size() + n;
+                closeRead(read, false);
+                break;
+            }
+            read->data.append(buffer, n);
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && errno == EAGAIN) return;
+        closeRead(read, n == 0);
+        break;
+    }
+    if (m_reads.empty())
+        finishCopy();
+}
+
+void SelectionMonitor::closeRead(Read *read, bool keep)
+{
+    if (keep && !read->data.isEmpty())
+        m_copy.append({read->format, read->data});
+    // Possibly inside the notifier's own signal
+    read->notifier->setEnabled(false);
+    read->notifier->deleteLater();
+    close(read->fd);
+    m_reads.erase(std::find(m_reads.begin(), m_reads.end(), read));
+    delete read;
+}
+
+void SelectionMonitor::finishCopy()
+{
+    m_copyTimeout.stop();
+    zwlr_data_control_offer_v1 *offer = std::exchange(m_copying, nullptr);
+    if (offer != m_selection)
+        releaseOffer(offer);
+    emit copied();
+}
+
+// Offers are destroyed once they are neither the selection nor being read
+void SelectionMonitor::releaseOffer(zwlr_data_control_offer_v1 *offer)
+{
+    if (!offer || offer == m_selection || offer == m_copying) return;
+    m_offers.remove(offer);
+    zwlr_data_control_offer_v1_destroy(offer);
+}
+
+void SelectionMonitor::registryGlobal(void *data, wl_registry *registry, uint32_t name,
+                                      const char *interface, uint32_t version)
+{
+    Q_UNUSED(version);
+    auto *self = static_cast<SelectionMonitor *>(data);
+    if (std::strcmp(interface, zwlr_data_control_manager_v1_interface.name) == 0) {
+        // Version 1: the primary selection is of no interest
+        self->m_manager = static_cast<zwlr_data_control_manager_v1 *>(
+            wl_registry_bind(registry, name, &zwlr_data_control_manager_v1_interface, 1));
+    } else if (std::strcmp(interface, wl_seat_interface.name) == 0 && !self->m_seat) {
+        self->m_seat = static_cast<wl_seat *>(wl_registry_bind(registry, name, &wl_seat_interface, 1));
+    }
+}
+
+void SelectionMonitor::registryGlobalRemove(void *, wl_registry *, uint32_t)
+{
+}
+
+void SelectionMonitor::onDataOffer(void *data, zwlr_data_control_device_v1 *,
+                                   zwlr_data_control_offer_v1 *offer)
+{
+    static const zwlr_data_control_offer_v1_listener offerListener = {
+        &SelectionMonitor::onOfferMimeType,
+    };
+    auto *self = static_cast<SelectionMonitor *>(data);
+    self->m_offers.insert(offer, QStringList());
+    zwlr_data_control_offer_v1_add_listener(offer, &offerListener, self);
+}
+
+void SelectionMonitor::onOfferMimeType(void *data, zwlr_data_control_offer_v1 *offer, const char *mimeType)
+{
+    auto *self = static_cast<SelectionMonitor *>(data);
+    auto it = self->m_offers.find(offer);
+    if (it != self->m_offers.end())
+        it->append(QString::fromUtf8(mimeType));
+}
+
+void SelectionMonitor::onSelection(void *data, zwlr_data_control_device_v1 *,
+                                   zwlr_data_control_offer_v1 *offer)
+{
+    auto *self = static_cast<SelectionMonitor *>(data);
+    zwlr_data_control_offer_v1 *previous = std::exchange(self->m_selection, offer);
+    if (previous != offer)
+        self->releaseOffer(previous);
+    // Receivers may start a copy, which must not dispatch from in here
+    const QStringList formats = self->m_offers.value(offer);
+    QMetaObject::invokeMethod(self, [self, formats]() {
+        emit self->selectionChanged(formats);
+    }, Qt::QueuedConnection);
+}
+
+void SelectionMonitor::onFinished(void *data, zwlr_data_control_device_v1 *)
+{
+    auto *self = static_cast<SelectionMonitor *>(data);
+    qWarning("The data-control device went away; clipboard copies block again");
+    // Not from inside the dispatch that delivered this
+    QMetaObject::invokeMethod(self, &SelectionMonitor::disconnectFromCompositor, Qt::QueuedConnection);
+}
+
+void SelectionMonitor::onPrimarySelection(void *data, zwlr_data_control_device_v1 *,
+                                          zwlr_data_control_offer_v1 *offer)
+{
+    static_cast<SelectionMonitor *>(data)->releaseOffer(offer);
+}
+
+void SelectionMonitor::dispatch()
+{
+    if (wl_display_dispatch(m_display) < 0) {
+        qWarning("Lost the Wayland connection of the clipboard monitor");
+        disconnectFromCompositor();
+    }
+}
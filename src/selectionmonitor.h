@@ -0,0 +1,107 @@
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QObject>
+#include <QPair>
+#include <QString>
+#include <QStringList>
+#include <QTimer>
+#include <QVector>
+#include <vector>
+
+class QSocketNotifier;
+struct wl_display;
+struct wl_registry;
+struct wl_seat;
+struct zwlr_data_control_device_v1;
+struct zwlr_data_control_manager_v1;
+struct zwlr_data_control_offer_v1;
+
+// Follows the clipboard selection over wlr-data-control, on a Wayland
+// connection of its own, and copies it without blocking.
+//
+// A selection reported here has been set as far as the compositor is
+// concerned: keys sent to it afterwards find it in place.
+//
+// The offer announces its formats before anything is transferred, so only
+// the ones worth keeping (text, and PNG for images) are requested. Each is
+// read from its pipe as the owning application writes it; one that grows
+// past the limit is dropped mid-transfer. The offer stays alive until the
+// reads are done, whatever happens to the selection meanwhile.
+class SelectionMonitor : public QObject
+{
+    Q_OBJECT
+
+public:
+    using Formats = QVector<QPair<QString, QByteArray>>;
+
+    // Reads still running by then are given up
+    static constexpr int CopyTimeoutMs = 2000;
+
+    explicit SelectionMonitor(QObject *parent = nullptr);
+    ~SelectionMonitor() override;
+
+    // false when there is no Wayland display or no data-control manager
+    bool connectToCompositor();
+    bool isAvailable() const;
+
+    // Starts copying the current selection; false when there is nothing to
+    // copy. The owning application has been asked for the data by the time
+    // this returns, so the selection may be replaced right after.
+    bool startCopy(qsizetype limit);
+    bool isCopying() const;
+    // The formats read completely by the last copy
+    Formats takeCopy();
+
+signals:
+    // The compositor announced a new selection (empty formats: none)
+    void selectionChanged(const QStringList &formats);
+    // A copy has ended, complete or not
+    void copied();
+
+private:
+    struct Read {
+        QString format;
+        int fd = -1;
+        QSocketNotifier *notifier = nullptr;
+        QByteArray data;
+    };
+
+    static void registryGlobal(void *data, wl_registry *registry, uint32_t name,
+                               const char *interface, uint32_t version);
+    static void registryGlobalRemove(void *data, wl_registry *registry, uint32_t name);
+    static void onDataOffer(void *data, zwlr_data_control_device_v1 *device,
+                            zwlr_data_control_offer_v1 *offer);
+    static void onSelection(void *data, zwlr_data_control_device_v1 *device,
+                            zwlr_data_control_offer_v1 *offer);
+    static void onFinished(void *data, zwlr_data_control_device_v1 *device);
+    static void onPrimarySelection(void *data, zwlr_data_control_device_v1 *device,
+                                   zwlr_data_control_offer_v1 *offer);
+    static void onOfferMimeType(void *data, zwlr_data_control_offer_v1 *offer, const char *mimeType);
+
+    void readAvailable(Read *read);
+    void closeRead(Read *read, bool keep);
+    void finishCopy();
+    void releaseOffer(zwlr_data_control_offer_v1 *offer);
+    void dispatch();
+    void disconnectFromCompositor();
+
+    wl_display *m_display = nullptr;
+    wl_registry *m_registry = nullptr;
+    wl_seat *m_seat = nullptr;
+    zwlr_data_control_manager_v1 *m_manager = nullptr;
+    zwlr_data_control_device_v1 *m_device = nullptr;
+    QSocketNotifier *m_notifier = nullptr;
+
+    // Formats of every offer not destroyed yet
+    QHash<zwlr_data_control_offer_v1 *, QStringList> m_offers;
+    zwlr_data_control_offer_v1 *m_selection = nullptr;
+    zwlr_data_control_offer_v1 *m_copying = nullptr;
+
+    std::vector<Read *> m_reads;
+    Formats m_copy;
+    qsizetype m_limit = 0;
+    qsizetype m_total = 0;
+    QTimer m_copyTimeout;
+};
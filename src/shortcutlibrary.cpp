@@ -0,0 +1,638 @@
+#include "shortcutlibrary.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QThread>
+
+#include <cstdio>
+#include <cstring>
+#include <utility>
+
+namespace {
+struct LibraryHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t recordCount;
+    uint32_t blobLength;      // UTF-16 units after the records
+    uint64_t generation;
+};
+// Version 2 follows the blob with a uint32_t use count per record
+
+struct JournalHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t generation;      // snapshot the operations apply to
+};
+
+struct JournalRecord {
+    uint8_t op;
+    uint8_t reserved[3];
+    int32_t row;
+    uint32_t lengths[3];      // trigger, expansion, scope; UTF-16 follows
+};
+
+constexpr char LibraryMagic[4] = {'O', 'S', 'K', 'S'};
+constexpr char JournalMagic[4] = {'O', 'S', 'K', 'J'};
+constexpr uint32_t LibraryVersion = 2;
+constexpr uint32_t JournalVersion = 1;
+
+// The journal is folded into a new snapshot once it is larger than this
+// and than half the snapshot
+constexpr qint64 CompactMinJournalSize = 64 * 1024;
+
+const QString keyShortcut = QStringLiteral("shortcut");
+const QString keyExpansion = QStringLiteral("expansion");
+const QString keyScope = QStringLiteral("scope");
+
+std::u16string_view blobView(const char16_t *blob, uint32_t blobLength, uint32_t offset, uint32_t length)
+{
+    if (uint64_t(offset) + length > blobLength) return {};
+    return {blob + offset, length};
+}
+
+QString blobString(const char16_t *blob, uint32_t blobLength, uint32_t offset, uint32_t length)
+{
+    const std::u16string_view text = blobView(blob, blobLength, offset, length);
+    return QString::fromUtf16(text.data(), qsizetype(text.size()));
+}
+
+std::u16string_view stringView(const QString &text)
+{
+    return {reinterpret_cast<const char16_t *>(text.utf16()), std::size_t(text.size())};
+}
+}
+
+ShortcutLibrary::ShortcutLibrary(const QString &directory, QObject *parent)
+    : QAbstractListModel(parent)
+    , m_directory(directory)
+{
+}
+
+ShortcutLibrary::~ShortcutLibrary()
+{
+    // The worker reads from the mapping
+    cancelCompaction();
+    unmapSnapshot();
+}
+
+QString ShortcutLibrary::defaultDirectory()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)
+           + QStringLiteral("/shortcuts");
+}
+
+bool ShortcutLibrary::open()
+{
+    QDir().mkpath(m_directory);
+    m_libraryPath = m_directory + QStringLiteral("/library");
+    m_journal.setFileName(m_directory + QStringLiteral("/journal"));
+    // Left by a compaction that was cut short
+    QFile::remove(m_libraryPath + QStringLiteral(".compact"));
+
+    beginResetModel();
+    if (QFile::exists(m_libraryPath) && !mapSnapshot()) {
+        // Keep the damaged file for inspection rather than overwriting it
+        qWarning("Unreadable shortcut library in %s, starting a new one", qPrintable(m_directory));
+        QFile::remove(m_libraryPath + QStringLiteral(".bad"));
+        QFile::rename(m_libraryPath, m_libraryPath + QStringLiteral(".bad"));
+    }
+    const bool ok = m_map ? true : writeSnapshot();
+    if (ok)
+        replayJournal();
+    endResetModel();
+    return ok;
+}
+
+// Maps the snapshot file in place of the current mapping. When it cannot be
+// mapped or is not a snapshot, the current mapping and rows stay as they are.
+bool ShortcutLibrary::mapSnapshot()
+{
+    auto file = std::make_unique<QFile>(m_libraryPath);
+    if (!file->open(QIODevice::ReadOnly)) return false;
+    const qint64 size = file->size();
+    if (size < qint64(sizeof(LibraryHeader))) return false;
+    uchar *map = file->map(0, size);
+    if (!map) return false;
+
+    const auto *header = reinterpret_cast<const LibraryHeader *>(map);
+    const bool hasUses = header->version >= 2;
+    const qint64 usesOffset = qint64(sizeof(LibraryHeader))
+                              + qint64(header->recordCount) * qint64(sizeof(Record))
+                              + qint64(header->blobLength) * qint64(sizeof(char16_t));
+    const qint64 needed = usesOffset + (hasUses ? qint64(header->recordCount) * qint64(sizeof(uint32_t)) : 0);
+    if (memcmp(header->magic, LibraryMagic, sizeof(LibraryMagic)) != 0
+        || header->version < 1 || header->version > LibraryVersion || needed > size)
+        return false;
+
+    unmapSnapshot();
+    m_library = std::move(file);
+    m_map = map;
+    m_mapSize = size;
+    m_generation = header->generation;
+    m_recordCount = header->recordCount;
+    m_blobLength = header->blobLength;
+    m_records = reinterpret_cast<const Record *>(m_map + sizeof(LibraryHeader));
+    m_blob = reinterpret_cast<const char16_t *>(m_records + m_recordCount);
+
+    m_overlay.clear();
+    m_rows.resize(qsizetype(m_recordCount));
+    for (uint32_t i = 0; i < m_recordCount; ++i)
+        m_rows[i] = qint32(i);
+    // Copied out: the counts change, and the array need not be aligned
+    m_uses.fill(0, qsizetype(m_recordCount));
+    if (hasUses && m_recordCount)
+        memcpy(m_uses.data(), m_map + usesOffset, m_recordCount * sizeof(uint32_t));
+    return true;
+}
+
+void ShortcutLibrary::unmapSnapshot()
+{
+    if (m_map)
+        m_library->unmap(m_map);
+    m_library.reset();
+    m_map = nullptr;
+    m_mapSize = 0;
+    m_records = nullptr;
+    m_blob = nullptr;
+    m_recordCount = 0;
+    m_blobLength = 0;
+}
+
+int ShortcutLibrary::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : count();
+}
+
+int ShortcutLibrary::count() const { return int(m_rows.size()); }
+
+ShortcutLibrary::Entry ShortcutLibrary::entry(int row) const
+{
+    if (row < 0 || row >= m_rows.size()) return {};
+    return entryById(m_rows.at(row));
+}
+
+ShortcutLibrary::EntryId ShortcutLibrary::entryId(int row) const
+{
+    return m_rows.at(row);
+}
+
+// Overlay entries are only ever appended, so their strings stay put too
+ShortcutLibrary::View ShortcutLibrary::view(EntryId id) const
+{
+    if (id < 0) {
+        const Entry &e = m_overlay.at(-id - 1);
+        return {stringView(e.trigger), stringView(e.expansion), stringView(e.scope)};
+    }
+    const Record &record = m_records[id];
+    return {blobView(m_blob, m_blobLength, record.trigger, record.triggerLength),
+            blobView(m_blob, m_blobLength, record.expansion, record.expansionLength),
+            blobView(m_blob, m_blobLength, record.scope, record.scopeLength)};
+}
+
+ShortcutLibrary::Entry ShortcutLibrary::entryById(EntryId id) const
+{
+    if (id < 0)
+        return m_overlay.at(-id - 1);
+    const Record &record = m_records[id];
+    return {blobString(m_blob, m_blobLength, record.trigger, record.triggerLength),
+            blobString(m_blob, m_blobLength, record.expansion, record.expansionLength),
+            blobString(m_blob, m_blobLength, record.scope, record.scopeLength)};
+}
+
+quint32 ShortcutLibrary::uses(int row) const
+{
+    return row >= 0 && row < m_uses.size() ? m_uses.at(row) : 0;
+}
+
+QVariant ShortcutLibrary::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_rows.size())
+        return QVariant();
+    const Entry e = entry(index.row());
+    switch (role) {
+    case ShortcutRole:
+        return e.trigger;
+    case ExpansionRole:
+        return e.expansion;
+    case ScopeRole:
+        return e.scope;
+    }
+    return QVariant();
+}
+
+QHash<int, QByteArray> ShortcutLibrary::roleNames() const
+{
+    return {
+        {ShortcutRole, "shortcut"},
+        {ExpansionRole, "expansion"},
+        {ScopeRole, "scope"},
+    };
+}
+
+// ---------------------------------------------------------------------------
+// Editing
+// ---------------------------------------------------------------------------
+bool ShortcutLibrary::apply(Op op, int row, const Entry &entry)
+{
+    switch (op) {
+    case OpAppend:
+        m_overlay.append(entry);
+        m_rows.append(-qint32(m_overlay.size()));
+        m_uses.append(0);
+        return true;
+    case OpReplace:
+        if (row < 0 || row >= m_rows.size()) return false;
+        m_overlay.append(entry);
+        m_rows[row] = -qint32(m_overlay.size());
+        return true;
+    case OpRemove:
+        if (row < 0 || row >= m_rows.size()) return false;
+        m_rows.removeAt(row);
+        m_uses.removeAt(row);
+        return true;
+    case OpUse:
+        if (row < 0 || row >= m_rows.size()) return false;
+        ++m_uses[row];
+        return true;
+    }
+    return false;
+}
+
+void ShortcutLibrary::append(const Entry &entry)
+{
+    beginInsertRows(QModelIndex(), count(), count());
+    apply(OpAppend, -1, entry);
+    endInsertRows();
+    appendJournal(OpAppend, -1, entry);
+    maybeCompact();
+    emit changed();
+}
+
+void ShortcutLibrary::replace(int row, const Entry &entry)
+{
+    if (row < 0 || row >= count()) return;
+    const EntryId before = entryId(row);
+    if (!apply(OpReplace, row, entry)) return;
+    emit dataChanged(index(row), index(row));
+    emit entryReplaced(row, before);
+    appendJournal(OpReplace, row, entry);
+    maybeCompact();
+    emit changed();
+}
+
+void ShortcutLibrary::remove(int row)
+{
+    if (row < 0 || row >= count()) return;
+    beginRemoveRows(QModelIndex(), row, row);
+    apply(OpRemove, row, {});
+    endRemoveRows();
+    appendJournal(OpRemove, row, {});
+    maybeCompact();
+    emit changed();
+}
+
+bool ShortcutLibrary::appendAll(const QVector<Entry> &entries)
+{
+    if (entries.isEmpty()) return true;
+    beginInsertRows(QModelIndex(), count(), count() + int(entries.size()) - 1);
+    for (const Entry &e : entries)
+        apply(OpAppend, -1, e);
+    endInsertRows();
+    const bool written = writeSnapshot();
+    if (!written) {
+        // Kept for this session: the journal records them instead
+        for (const Entry &e : entries)
+            appendJournal(OpAppend, -1, e);
+    }
+    emit changed();
+    return written;
+}
+
+quint32 ShortcutLibrary::noteUse(const QString &trigger, const QString &scope)
+{
+    // Compared in place: nothing is materialized per row
+    auto same = [this](uint32_t offset, uint32_t length, const QString &text) {
+        return length == uint32_t(text.size())
+               && uint64_t(offset) + length <= m_blobLength
+               && memcmp(m_blob + offset, text.utf16(), length * sizeof(char16_t)) == 0;
+    };
+    int row = count() - 1;
+    for (; row >= 0; --row) {
+        const qint32 ref = m_rows.at(row);
+        if (ref < 0) {
+            const Entry &e = m_overlay.at(-ref - 1);
+            if (e.trigger == trigger && e.scope == scope) break;
+        } else {
+            const Record &record = m_records[ref];
+            if (same(record.trigger, record.triggerLength, trigger)
+                && same(record.scope, record.scopeLength, scope))
+                break;
+        }
+    }
+    if (row < 0) return 0;
+
+    apply(OpUse, row, {});
+    appendJournal(OpUse, row, {});
+    maybeCompact();
+    return m_uses.at(row);
+}
+
+bool ShortcutLibrary::adoptUses(const QVariantMap &usesByTrigger)
+{
+    for (int row = 0; row < count(); ++row) {
+        const auto it = usesByTrigger.constFind(entry(row).trigger);
+        if (it != usesByTrigger.cend())
+            m_uses[row] = qMax(m_uses.at(row), it->toUInt());
+    }
+    return writeSnapshot();
+}
+
+// ---------------------------------------------------------------------------
+// Journal
+// ---------------------------------------------------------------------------
+void ShortcutLibrary::replayJournal()
+{
+    m_journal.close();
+    if (!m_journal.open(QIODevice::ReadWrite)) {
+        qWarning("Cannot open shortcut journal %s", qPrintable(m_journal.fileName()));
+        return;
+    }
+
+    JournalHeader header{};
+    const QByteArray data = m_journal.readAll();
+    if (data.size() >= qsizetype(sizeof(header)))
+        memcpy(&header, data.constData(), sizeof(header));
+    if (data.size() < qsizetype(sizeof(header))
+        || memcmp(header.magic, JournalMagic, sizeof(JournalMagic)) != 0
+        || header.version != JournalVersion || header.generation != m_generation) {
+        // Missing, damaged, or already folded into the snapshot
+        resetJournal();
+        return;
+    }
+
+    qsizetype pos = sizeof(header);
+    while (pos + qsizetype(sizeof(JournalRecord)) <= data.size()) {
+        JournalRecord record;
+        memcpy(&record, data.constData() + pos, sizeof(record));
+        qint64 textBytes = 0;
+        for (uint32_t length : record.lengths)
+            textBytes += qint64(length) * qint64(sizeof(char16_t));
+        if (pos + qsizetype(sizeof(record)) + textBytes > data.size())
+            break;   // torn write at the end
+
+        const auto *text = reinterpret_cast<const QChar *>(data.constData() + pos + sizeof(record));
+        Entry e;
+        e.trigger = QString(text, record.lengths[0]);
+        e.expansion = QString(text + record.lengths[0], record.lengths[1]);
+        e.scope = QString(text + record.lengths[0] + record.lengths[1], record.lengths[2]);
+        if (!apply(Op(record.op), record.row, e))
+            break;
+        pos += qsizetype(sizeof(record) + textBytes);
+    }
+
+    // Drop whatever could not be replayed so appends start on a boundary
+    m_journal.resize(pos);
+    m_journal.seek(pos);
+}
+
+void ShortcutLibrary::resetJournal(const QByteArray &records)
+{
+    if (!m_journal.isOpen() && !m_journal.open(QIODevice::ReadWrite)) {
+        qWarning("Cannot open shortcut journal %s", qPrintable(m_journal.fileName()));
+        return;
+    }
+    JournalHeader fresh{};
+    memcpy(fresh.magic, JournalMagic, sizeof(JournalMagic));
+    fresh.version = JournalVersion;
+    fresh.generation = m_generation;
+    m_journal.resize(0);
+    m_journal.seek(0);
+    m_journal.write(reinterpret_cast<const char *>(&fresh), sizeof(fresh));
+    m_journal.write(records);
+    m_journal.flush();
+}
+
+bool ShortcutLibrary::appendJournal(Op op, int row, const Entry &entry)
+{
+    JournalRecord record{};
+    record.op = op;
+    record.row = row;
+    record.lengths[0] = uint32_t(entry.trigger.size());
+    record.lengths[1] = uint32_t(entry.expansion.size());
+    record.lengths[2] = uint32_t(entry.scope.size());
+
+    QByteArray bytes(reinterpret_cast<const char *>(&record), sizeof(record));
+    for (const QString *s : {&entry.trigger, &entry.expansion, &entry.scope})
+        bytes.append(reinterpret_cast<const char *>(s->constData()), s->size() * qsizetype(sizeof(QChar)));
+    if (m_journal.write(bytes) != bytes.size() || !m_journal.flush()) {
+        qWarning("Failed to write shortcut journal");
+        return false;
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Snapshot
+// ---------------------------------------------------------------------------
+void ShortcutLibrary::maybeCompact()
+{
+    if (m_compactor) return;
+    const qint64 journalSize = m_journal.size();
+    if (journalSize <= CompactMinJournalSize || journalSize <= m_mapSize / 2) return;
+
+    const uint64_t generation = nextGeneration();
+    const Rows snapshot = rows();
+    const QString path = m_libraryPath + QStringLiteral(".compact");
+    m_compactJournalStart = journalSize;
+    auto ok = std::make_shared<bool>(false);
+
+    QThread *compactor = QThread::create([path, generation, snapshot, ok]() {
+        *ok = writeSnapshotFile(path, generation, snapshot);
+    });
+    m_compactor = compactor;
+    compactor->setParent(this);
+    connect(compactor, &QThread::finished, this, [this, compactor, generation, ok]() {
+        if (m_compactor != compactor) return;   // cancelled
+        m_compactor = nullptr;
+        compactor->deleteLater();
+        finishCompaction(generation, *ok);
+    });
+    compactor->start(QThread::LowPriority);
+}
+
+// Swaps the compacted snapshot in, with a journal holding what was edited
+// while the worker ran. The library goes first: stopping before the
+// journal follows loses only those edits.
+void ShortcutLibrary::finishCompaction(uint64_t generation, bool ok)
+{
+    const QString compacted = m_libraryPath + QStringLiteral(".compact");
+    if (!ok) {
+        qWarning("Failed to compact shortcut library %s", qPrintable(m_libraryPath));
+        QFile::remove(compacted);
+        return;
+    }
+
+    m_journal.seek(m_compactJournalStart);
+    const QByteArray newer = m_journal.readAll();
+    if (std::rename(QFile::encodeName(compacted).constData(), QFile::encodeName(m_libraryPath).constData()) != 0) {
+        qWarning("Cannot replace shortcut library %s", qPrintable(m_libraryPath));
+        QFile::remove(compacted);
+        return;
+    }
+    m_generation = generation;
+    resetJournal(newer);
+    // Unmappable: the rows in memory still match the files
+    if (mapSnapshot()) {
+        replayJournal();
+        emit storageMoved();
+    }
+}
+
+// A snapshot written now supersedes one still being compacted
+void ShortcutLibrary::cancelCompaction()
+{
+    QThread *compactor = std::exchange(m_compactor, nullptr);
+    if (!compactor) return;
+    compactor->wait();
+    compactor->deleteLater();
+    QFile::remove(m_libraryPath + QStringLiteral(".compact"));
+}
+
+uint64_t ShortcutLibrary::nextGeneration() const
+{
+    return qMax<uint64_t>(m_generation + 1, uint64_t(QDateTime::currentMSecsSinceEpoch()));
+}
+
+ShortcutLibrary::Rows ShortcutLibrary::rows() const
+{
+    return {m_records, m_blob, m_blobLength, m_rows, m_overlay, m_uses};
+}
+
+ShortcutLibrary::Entry ShortcutLibrary::Rows::entry(int row) const
+{
+    const qint32 ref = refs.at(row);
+    if (ref < 0)
+        return overlay.at(-ref - 1);
+    const Record &record = records[ref];
+    return {blobString(blob, blobLength, record.trigger, record.triggerLength),
+            blobString(blob, blobLength, record.expansion, record.expansionLength),
+            blobString(blob, blobLength, record.scope, record.scopeLength)};
+}
+
+// Writes the rows into a new snapshot file. Tens of thousands of shortcuts
+// are a few MB. Also runs on the compaction worker, so it touches nothing
+// but its arguments.
+bool ShortcutLibrary::writeSnapshotFile(const QString &path, uint64_t generation, const Rows &rows)
+{
+    QVector<Record> records;
+    records.reserve(rows.refs.size());
+    QString blob;
+    for (int row = 0; row < rows.refs.size(); ++row) {
+        const Entry e = rows.entry(row);
+        Record record{};
+        record.trigger = uint32_t(blob.size());
+        record.triggerLength = uint32_t(e.trigger.size());
+        blob += e.trigger;
+        record.expansion = uint32_t(blob.size());
+        record.expansionLength = uint32_t(e.expansion.size());
+        blob += e.expansion;
+        record.scope = uint32_t(blob.size());
+        record.scopeLength = uint32_t(e.scope.size());
+        blob += e.scope;
+        records.append(record);
+    }
+
+    LibraryHeader header{};
+    memcpy(header.magic, LibraryMagic, sizeof(LibraryMagic));
+    header.version = LibraryVersion;
+    header.recordCount = uint32_t(records.size());
+    header.blobLength = uint32_t(blob.size());
+    header.generation = generation;
+
+    QSaveFile out(path);
+    if (!out.open(QIODevice::WriteOnly)) {
+        qWarning("Cannot write shortcut library %s", qPrintable(path));
+        return false;
+    }
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char *>(records.constData()), records.size() * qsizetype(sizeof(Record)));
+    out.write(reinterpret_cast<const char *>(blob.constData()), blob.size() * qsizetype(sizeof(QChar)));
+    out.write(reinterpret_cast<const char *>(rows.uses.constData()), rows.uses.size() * qsizetype(sizeof(quint32)));
+    if (!out.commit()) {
+        qWarning("Failed to write shortcut library %s", qPrintable(path));
+        return false;
+    }
+    return true;
+}
+
+// Writes every current row into a new snapshot right away and starts an
+// empty journal for it; false when nothing was written
+bool ShortcutLibrary::writeSnapshot()
+{
+    cancelCompaction();
+    const uint64_t generation = nextGeneration();
+    if (!writeSnapshotFile(m_libraryPath, generation, rows()))
+        return false;
+
+    // The new snapshot holds everything; the old journal no longer applies.
+    // Unmappable, the rows in memory stay on the previous mapping, which
+    // holds the same entries.
+    m_generation = generation;
+    resetJournal();
+    if (mapSnapshot())
+        emit storageMoved();
+    else
+        qWarning("Cannot map shortcut library %s; keeping the previous one in memory", qPrintable(m_libraryPath));
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Import / export
+// ---------------------------------------------------------------------------
+int ShortcutLibrary::importFile(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) return -1;
+    QJsonParseError error{};
+    const QJsonDocument doc = QJsonDocument::fromJson(file.readAll(), &error);
+    if (error.error != QJsonParseError::NoError || !doc.isArray()) {
+        qWarning("Cannot import shortcuts from %s: %s", qPrintable(path), qPrintable(error.errorString()));
+        return -1;
+    }
+
+    QVector<Entry> entries;
+    const QJsonArray array = doc.array();
+    entries.reserve(array.size());
+    for (const QJsonValue &value : array) {
+        const QJsonObject object = value.toObject();
+        Entry e {object.value(keyShortcut).toString(),
+                 object.value(keyExpansion).toString(),
+                 object.value(keyScope).toString().trimmed().toLower()};
+        if (!e.expansion.isEmpty())
+            entries.append(e);
+    }
+    appendAll(entries);
+    return int(entries.size());
+}
+
+bool ShortcutLibrary::exportFile(const QString &path) const
+{
+    QJsonArray array;
+    for (int row = 0; row < count(); ++row) {
+        const Entry e = entry(row);
+        QJsonObject object {{keyShortcut, e.trigger}, {keyExpansion, e.expansion}};
+        if (!e.scope.isEmpty())
+            object.insert(keyScope, e.scope);
+        array.append(object);
+    }
+
+    QSaveFile out(path);
+    if (!out.open(QIODevice::WriteOnly)) return false;
+    out.write(QJsonDocument(array).toJson(QJsonDocument::Indented));
+    return out.commit();
+}
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <QAbstractListModel>
+#include <QFile>
+#include <QString>
+#include <QVariantMap>
+#include <QVector>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+
+class QThread;
+
+// Text shortcuts stored in their own files instead of QSettings.
+//
+// The library directory holds two files:
+//   library  a compact snapshot: a header, one fixed-size record per
+//            shortcut, a UTF-16 string blob the records point into and the
+//            use count of each record
+//   journal  append-only add/replace/remove/use operations since the
+//            snapshot
+// Opening maps the snapshot (nothing is parsed; rows refer straight into
+// the mapping) and replays the short journal. Every edit appends one
+// journal record, and so does every expansion. Once the journal outgrows
+// the snapshot a worker thread folds it into a new snapshot, which is
+// swapped in with whatever was journaled meanwhile. Both files carry the
+// snapshot generation, so a journal that was already folded in is never
+// replayed twice.
+//
+// The library is also the list model behind the shortcuts page, so only
+// rows the view shows are ever materialized.
+class ShortcutLibrary : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    enum Role {
+        ShortcutRole = Qt::UserRole + 1,
+        ExpansionRole,
+        ScopeRole,
+    };
+
+    struct Entry {
+        QString trigger;
+        QString expansion;
+        QString scope;
+    };
+
+    explicit ShortcutLibrary(const QString &directory, QObject *parent = nullptr);
+    ~ShortcutLibrary() override;
+
+    bool open();
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role) const override;
+    QHash<int, QByteArray> roleNames() const override;
+
+    int count() const;
+    Entry entry(int row) const;
+
+    // An id names one version of an entry: an edit gives its row a new one.
+    // Ids, and the text views of them, point into the mapping and stay
+    // valid until storageMoved(); nothing is copied out for them.
+    using EntryId = qint32;
+    struct View {
+        std::u16string_view trigger;
+        std::u16string_view expansion;
+        std::u16string_view scope;
+    };
+    EntryId entryId(int row) const;
+    View view(EntryId id) const;
+    Entry entryById(EntryId id) const;
+    // How often the row's shortcut has been expanded
+    quint32 uses(int row) const;
+
+    void append(const Entry &entry);
+    void replace(int row, const Entry &entry);
+    void remove(int row);
+    // Bulk add: written straight into a new snapshot, not the journal;
+    // false when that snapshot could not be written
+    bool appendAll(const QVector<Entry> &entries);
+
+    // Counts an expansion of the entry with this trigger and scope (the
+    // last one, which is the one matched); returns its new count, or 0 when
+    // there is no such entry
+    quint32 noteUse(const QString &trigger, const QString &scope);
+    // Takes over counts kept by trigger (the old "shortcutUses" setting)
+    // into a new snapshot; false when that could not be written
+    bool adoptUses(const QVariantMap &usesByTrigger);
+
+    // JSON array of {"shortcut", "expansion", "scope"} objects
+    int importFile(const QString &path);
+    bool exportFile(const QString &path) const;
+
+    static QString defaultDirectory();
+
+signals:
+    // Any change to the rows; the controller recompiles its matchers
+    void changed();
+    // replace() changed a row, which keeps its use count; before is the id
+    // it had until then
+    void entryReplaced(int row, ShortcutLibrary::EntryId before);
+    // The rows were reread from a new snapshot: ids and views handed out
+    // before are invalid, though the rows themselves are unchanged
+    void storageMoved();
+
+private:
+    enum Op : uint8_t {
+        OpAppend = 1,
+        OpReplace = 2,
+        OpRemove = 3,
+        OpUse = 4,
+    };
+
+    struct Record {
+        uint32_t trigger;         // offsets and lengths in UTF-16 units
+        uint32_t triggerLength;   // into the string blob
+        uint32_t expansion;
+        uint32_t expansionLength;
+        uint32_t scope;
+        uint32_t scopeLength;
+    };
+
+    // What a snapshot is written from, on the compaction worker too: copies
+    // of the row tables (shared until the next edit) and the mapping their
+    // records point into, which stays mapped until the worker is done
+    struct Rows {
+        const Record *records = nullptr;
+        const char16_t *blob = nullptr;
+        uint32_t blobLength = 0;
+        QVector<qint32> refs;
+        QVector<Entry> overlay;
+        QVector<quint32> uses;
+
+        Entry entry(int row) const;
+    };
+
+    Rows rows() const;
+    static bool writeSnapshotFile(const QString &path, uint64_t generation, const Rows &rows);
+    uint64_t nextGeneration() const;
+
+    void replayJournal();
+    // Starts the journal over for the current generation with these records
+    void resetJournal(const QByteArray &records = QByteArray());
+    bool apply(Op op, int row, const Entry &entry);
+    bool appendJournal(Op op, int row, const Entry &entry);
+    bool writeSnapshot();
+    bool mapSnapshot();
+    void unmapSnapshot();
+    void maybeCompact();
+    void finishCompaction(uint64_t generation, bool ok);
+    void cancelCompaction();
+
+    QString m_directory;
+    QString m_libraryPath;
+    std::unique_ptr<QFile> m_library;   // open while mapped
+    QFile m_journal;
+    uint64_t m_generation = 0;
+
+    QThread *m_compactor = nullptr;
+    qint64 m_compactJournalStart = 0;   // journal records after this are newer
+
+    // Mapped snapshot
+    uchar *m_map = nullptr;
+    qint64 m_mapSize = 0;
+    const Record *m_records = nullptr;
+    uint32_t m_recordCount = 0;
+    const char16_t *m_blob = nullptr;
+    uint32_t m_blobLength = 0;
+
+    // Current rows: >= 0 is a snapshot record, < 0 is -(overlay index) - 1
+    QVector<qint32> m_rows;
+    QVector<quint32> m_uses;     // by row
+    QVector<Entry> m_overlay;    // entries added or edited since the snapshot
+};
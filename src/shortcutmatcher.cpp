@@ -0,0 +1,59 @@
+#include "shortcutmatcher.h"
+
+qsizetype ShortcutMatcher::idOf(std::u16string_view trigger) const
+{
+    // The longest trigger ending the text is the text itself, if present
+    const auto found = m_table.match(trigger);
+    return found && found->length == trigger.size() ? qsizetype(found->id) : -1;
+}
+
+void ShortcutMatcher::insert(quint64 rank, qint32 entryId, std::u16string_view trigger)
+{
+    if (trigger.empty()) return;
+    const qsizetype id = idOf(trigger);
+    if (id >= 0) {
+        QMap<quint64, Ref> &ranked = m_entries[id];
+        const qsizetype before = ranked.size();
+        ranked.insert(rank, {entryId, trigger});
+        m_size += int(ranked.size() - before);
+        // The table keeps the text of the entry it matches
+        m_table.insert(ranked.last().trigger, uint32_t(id));
+        return;
+    }
+
+    uint32_t newId;
+    if (!m_freeIds.isEmpty()) {
+        newId = m_freeIds.takeLast();
+    } else {
+        newId = uint32_t(m_entries.size());
+        m_entries.append({});
+    }
+    m_entries[newId].insert(rank, {entryId, trigger});
+    m_table.insert(trigger, newId);
+    ++m_size;
+}
+
+void ShortcutMatcher::remove(quint64 rank, std::u16string_view trigger)
+{
+    if (trigger.empty()) return;
+    const qsizetype id = idOf(trigger);
+    if (id < 0) return;
+    QMap<quint64, Ref> &ranked = m_entries[id];
+    m_size -= int(ranked.remove(rank));
+    if (!ranked.isEmpty()) {
+        m_table.insert(ranked.last().trigger, uint32_t(id));
+        return;
+    }
+    m_table.remove(trigger);
+    m_freeIds.append(uint32_t(id));
+}
+
+void ShortcutMatcher::clear()
+{
+    m_table.clear();
+    m_entries.clear();
+    m_freeIds.clear();
+    m_size = 0;
+}
+
+bool ShortcutMatcher::isEmpty() const { return m_table.isEmpty(); }
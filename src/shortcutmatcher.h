@@ -0,0 +1,53 @@
+#pragma once
+
+#include <QMap>
+#include <QString>
+#include <QVector>
+#include <string_view>
+
+#include "core/triggertable.h"
+
+// Trigger → library entry lookup compiled from the shortcut list.
+//
+// Matching is done by a TriggerTable (see core/triggertable.h), which the
+// keyboard core runs against the type buffer without allocating; an id it
+// returns indexes the entries kept here. The longest matching trigger wins.
+//
+// Entries come and go one at a time as the list is edited. Each is added
+// under a rank; when several share a trigger the highest ranked one is
+// matched, and removing it brings back the next. Entries are library ids
+// and their trigger text is referenced, not copied: it must stay valid
+// while the entry is here.
+class ShortcutMatcher
+{
+public:
+    void insert(quint64 rank, qint32 entryId, std::u16string_view trigger);
+    // Takes back what insert() added under rank
+    void remove(quint64 rank, std::u16string_view trigger);
+    void clear();
+    bool isEmpty() const;
+    // Entries added and not removed, shadowed ones included
+    int size() const { return m_size; }
+
+    qint32 entryAt(uint32_t id) const { return m_entries.at(id).last().entryId; }
+    const TriggerTable &table() const { return m_table; }
+
+    static std::u16string_view view(const QString &text)
+    {
+        return {reinterpret_cast<const char16_t *>(text.utf16()), std::size_t(text.size())};
+    }
+
+private:
+    struct Ref {
+        qint32 entryId;
+        std::u16string_view trigger;
+    };
+
+    // Id of exactly this trigger in the table, or -1
+    qsizetype idOf(std::u16string_view trigger) const;
+
+    TriggerTable m_table;
+    QVector<QMap<quint64, Ref>> m_entries;   // by trigger id, by rank
+    QVector<uint32_t> m_freeIds;             // of triggers removed
+    int m_size = 0;
+};
@@ -0,0 +1,153 @@
+#include "singleinstance.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/file.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+namespace SingleInstance {
+
+namespace {
+
+// The first instance takes the lock before Qt starts but only listens once
+// its window is up, so a racing launch waits this long for the socket
+constexpr int ConnectTimeoutMs = 5000;
+constexpr int ConnectRetryMs = 10;
+constexpr int ReplyTimeoutMs = 2000;
+
+// Names the inherited lock descriptor for adopt()
+constexpr const char *LockVariable = "OSK_INSTANCE_LOCK_FD";
+
+int lockFd = -1;
+
+int64_t monotonicMs()
+{
+    timespec ts {};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return int64_t(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+}
+
+int connectControl(const std::string &path)
+{
+    sockaddr_un addr {};
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) return -1;
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+    const int64_t deadline = monotonicMs() + ConnectTimeoutMs;
+    for (;;) {
+        const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) return -1;
+        if (connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0)
+            return fd;
+        const int error = errno;
+        close(fd);
+        if ((error != ENOENT && error != ECONNREFUSED) || monotonicMs() >= deadline)
+            return -1;
+        usleep(ConnectRetryMs * 1000);
+    }
+}
+
+} // namespace
+
+std::string runtimePath(const char *name)
+{
+    const char *runtimeDir = std::getenv("XDG_RUNTIME_DIR");
+    if (!runtimeDir || !*runtimeDir) return {};
+    const std::string dir = std::string(runtimeDir) + "/osk";
+    mkdir(dir.c_str(), 0700);
+    return dir + '/' + name;
+}
+
+bool acquire()
+{
+    const std::string path = runtimePath("instance.lock");
+    // Without a runtime directory there is nowhere to coordinate: just run
+    if (path.empty()) return true;
+
+    // Held (and deliberately never closed) for the life of the process;
+    // CLOEXEC keeps spawned helpers from inheriting it
+    const int fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd < 0) return true;
+    if (flock(fd, LOCK_EX | LOCK_NB) == 0) {
+        lockFd = fd;
+        return true;
+    }
+    const bool held = errno == EWOULDBLOCK;
+    close(fd);
+    return !held;
+}
+
+void handOver()
+{
+    if (lockFd < 0) return;
+    fcntl(lockFd, F_SETFD, 0);
+    setenv(LockVariable, std::to_string(lockFd).c_str(), 1);
+}
+
+bool adopt()
+{
+    const char *value = std::getenv(LockVariable);
+    if (!value) return false;
+    const int fd = std::atoi(value);
+    unsetenv(LockVariable);
+    // The lock is the open file description, not the number: make sure it
+    // is still open, and keep it from helpers spawned from here on
+    if (fd < 0 || fcntl(fd, F_SETFD, FD_CLOEXEC) < 0) return false;
+    lockFd = fd;
+    return true;
+}
+
+int forward(const char *command)
+{
+    const int fd = connectControl(runtimePath("control.sock"));
+    if (fd < 0) {
+        std::fprintf(stderr, "osk: another instance is running but not answering\n");
+        return 1;
+    }
+
+    std::string line = command;
+    line += '\n';
+    const char *data = line.data();
+    size_t left = line.size();
+    while (left > 0) {
+        const ssize_t n = write(fd, data, left);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            close(fd);
+            return 1;
+        }
+        data += n;
+        left -= size_t(n);
+    }
+
+    // One reply line: "ok", or the reason the command was refused
+    char reply[256];
+    size_t size = 0;
+    pollfd pfd {fd, POLLIN, 0};
+    while (size < sizeof(reply) - 1 && poll(&pfd, 1, ReplyTimeoutMs) > 0) {
+        const ssize_t n = read(fd, reply + size, sizeof(reply) - 1 - size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        size += size_t(n);
+        if (std::memchr(reply, '\n', size)) break;
+    }
+    close(fd);
+    reply[size] = '\0';
+    if (char *end = std::strchr(reply, '\n')) *end = '\0';
+
+    if (std::strcmp(reply, "ok") == 0) return 0;
+    std::fprintf(stderr, "osk: %s\n", size ? reply : "no answer from the running instance");
+    return 2;
+}
+
+} // namespace SingleInstance
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <string>
+
+// One osk per session.
+//
+// The first process takes an flock on $XDG_RUNTIME_DIR/osk/instance.lock
+// and keeps it until it exits (the kernel drops it on a crash, so nothing
+// goes stale). Later launches find the lock taken and hand their command
+// to the running instance over control.sock (see ControlServer) instead of
+// starting Qt, a uinput device and a tray icon of their own.
+//
+// The osk launcher (see launchermain.cpp) takes the lock and execs the
+// keyboard, osk-ui, which inherits it; a second launch never maps Qt.
+//
+// Runs before QApplication exists, so it is plain POSIX.
+namespace SingleInstance {
+
+// Takes the instance lock; false when another osk holds it
+bool acquire();
+
+// Keeps the lock open across exec() and names it in the environment, for
+// the program about to be started
+void handOver();
+
+// Takes over a lock handed over by the launcher; false when started
+// directly
+bool adopt();
+
+// Sends command to the running instance and waits for its answer. Returns
+// the exit status for the launching process.
+int forward(const char *command);
+
+// $XDG_RUNTIME_DIR/osk/<name>, creating the private directory; empty
+// when XDG_RUNTIME_DIR is not set
+std::string runtimePath(const char *name);
+
+} // namespace SingleInstance
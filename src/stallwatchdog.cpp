@@ -0,0 +1,250 @@
+#include "stallwatchdog.h"
+#include "tracer.h"
+
+#include <QAbstractEventDispatcher>
+#include <QThread>
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+
+#if __has_include(<execinfo.h>)
+#include <execinfo.h>
+#define OSK_HAVE_BACKTRACE 1
+#endif
+
+namespace {
+
+#ifdef OSK_HAVE_BACKTRACE
+// Written by the handler on the watched thread, read by the watchdog
+void *g_frames[StallWatchdog::MaxFrames];
+std::atomic<int> g_frameCount{-1};
+
+int backtraceSignal() { return SIGRTMIN + 3; }
+
+void onBacktraceSignal(int)
+{
+    const int savedErrno = errno;
+    g_frameCount.store(backtrace(g_frames, StallWatchdog::MaxFrames), std::memory_order_release);
+    errno = savedErrno;
+}
+
+void installBacktraceHandler()
+{
+    static bool installed = false;
+    if (installed) return;
+    installed = true;
+
+    // The first backtrace() loads libgcc, which must not happen in a handler
+    void *warmUp[1];
+    backtrace(warmUp, 1);
+
+    struct sigaction action {};
+    action.sa_handler = onBacktraceSignal;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    sigaction(backtraceSignal(), &action, nullptr);
+}
+#endif
+
+} // namespace
+
+StallWatchdog::StallWatchdog(QObject *parent)
+    : QObject(parent)
+{
+}
+
+StallWatchdog::~StallWatchdog()
+{
+    stop();
+}
+
+void StallWatchdog::setThreshold(int ms)
+{
+    ms = std::max(0, ms);
+    m_thresholdMs.store(ms, std::memory_order_relaxed);
+    if (ms > 0)
+        start();
+    else
+        stop();
+}
+
+int StallWatchdog::threshold() const
+{
+    return m_thresholdMs.load(std::memory_order_relaxed);
+}
+
+QVector<StallWatchdog::Stall> StallWatchdog::stalls() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_log;
+}
+
+void StallWatchdog::initFromEnvironment()
+{
+    bool ok = false;
+    const int ms = qEnvironmentVariableIntValue("OSK_STALL_MS", &ok);
+    setThreshold(ok ? ms : DefaultThresholdMs);
+}
+
+void StallWatchdog::start()
+{
+    if (m_thread) return;
+    QAbstractEventDispatcher *dispatcher = QAbstractEventDispatcher::instance();
+    if (!dispatcher) {
+        qWarning("Stall watchdog needs an event loop on the calling thread");
+        return;
+    }
+#ifdef OSK_HAVE_BACKTRACE
+    installBacktraceHandler();
+#endif
+    m_watched = pthread_self();
+    Tracer::setThreadWatched(true);
+    m_awake = connect(dispatcher, &QAbstractEventDispatcher::awake,
+                      this, &StallWatchdog::onAwake, Qt::DirectConnection);
+    m_aboutToBlock = connect(dispatcher, &QAbstractEventDispatcher::aboutToBlock,
+                             this, &StallWatchdog::onAboutToBlock, Qt::DirectConnection);
+
+    // Startup before the loop first waits is not counted
+    m_stopping.store(false);
+    m_busySince.store(0);
+    m_thread = QThread::create([this]() { run(); });
+    m_thread->setObjectName(QStringLiteral("osk-watchdog"));
+    m_thread->start(QThread::HighPriority);
+}
+
+void StallWatchdog::stop()
+{
+    if (!m_thread) return;
+    disconnect(m_awake);
+    disconnect(m_aboutToBlock);
+    Tracer::setThreadWatched(false);
+
+    m_stopping.store(true);
+    m_wake.release();
+    m_thread->wait();
+    delete m_thread;
+    m_thread = nullptr;
+
+    m_busySince.store(0);
+    m_parked.store(false);
+    m_wake.tryAcquire(m_wake.available());
+}
+
+// Both run on the watched thread, once per loop iteration: keep them cheap
+void StallWatchdog::onAwake()
+{
+    if (m_busySince.load(std::memory_order_relaxed) == 0)
+        m_busySince.store(Tracer::now());
+    // Pairs with the parking in run(): either it sees the busy stamp, or
+    // we see it parked and wake it
+    if (m_parked.load() && m_parked.exchange(false))
+        m_wake.release();
+}
+
+void StallWatchdog::onAboutToBlock()
+{
+    const int64_t since = m_busySince.exchange(0);
+    if (!since) return;
+    const int64_t durationMs = (Tracer::now() - since) / 1000000;
+    if (durationMs < m_thresholdMs.load(std::memory_order_relaxed)) return;
+
+    if (Tracer::isEnabled())
+        Tracer::complete("stall", since);
+
+    Stall stall;
+    {
+        QMutexLocker lock(&m_mutex);
+        if (m_sampledSince == since)
+            stall = std::move(m_sample);
+        m_sampledSince = 0;
+    }
+    stall.when = QDateTime::currentDateTime().addMSecs(-durationMs);
+    stall.durationMs = durationMs;
+    qWarning("GUI thread stalled for %lld ms%s%s", static_cast<long long>(durationMs),
+             stall.operation.isEmpty() ? "" : " in ", qPrintable(stall.operation));
+
+    QMutexLocker lock(&m_mutex);
+    m_log.append(std::move(stall));
+    if (m_log.size() > LogCapacity)
+        m_log.removeFirst();
+}
+
+// ---------------------------------------------------------------------------
+// Watchdog thread
+// ---------------------------------------------------------------------------
+void StallWatchdog::run()
+{
+    int64_t sampled = 0;    // busy period already sampled
+    int64_t hangSince = 0;  // busy period already reported as a hang
+    while (!m_stopping.load()) {
+        const int64_t since = m_busySince.load();
+        if (since == 0) {
+            // Idle: sleep until onAwake() (or stop()) releases us
+            m_parked.store(true);
+            if (m_busySince.load() == 0 && !m_stopping.load())
+                m_wake.acquire();
+            else if (!m_parked.exchange(false))
+                m_wake.acquire();   // onAwake() got in first and released
+            continue;
+        }
+
+        const int threshold = m_thresholdMs.load(std::memory_order_relaxed);
+        const int64_t busyMs = (Tracer::now() - since) / 1000000;
+        if (busyMs >= threshold && since != sampled) {
+            sampled = since;
+            sample(since);
+        } else if (busyMs >= HangMs && since != hangSince) {
+            hangSince = since;
+            reportHang(busyMs);
+        }
+        m_wake.tryAcquire(1, std::max(1, threshold / 2));
+    }
+}
+
+void StallWatchdog::sample(int64_t since)
+{
+    Stall stall;
+    if (const char *operation = Tracer::inFlight())
+        stall.operation = QString::fromLatin1(operation);
+    stall.backtrace = captureBacktrace(m_watched);
+
+    QMutexLocker lock(&m_mutex);
+    m_sampledSince = since;
+    m_sample = std::move(stall);
+}
+
+// The loop may never come back to log the stall, so say what we know now
+void StallWatchdog::reportHang(int64_t busyMs)
+{
+    QMutexLocker lock(&m_mutex);
+    qWarning("GUI thread blocked for %lld ms so far%s%s", static_cast<long long>(busyMs),
+             m_sample.operation.isEmpty() ? "" : " in ", qPrintable(m_sample.operation));
+    for (const QString &frame : std::as_const(m_sample.backtrace))
+        qWarning("    %s", qPrintable(frame));
+}
+
+QStringList StallWatchdog::captureBacktrace(pthread_t thread)
+{
+#ifdef OSK_HAVE_BACKTRACE
+    g_frameCount.store(-1, std::memory_order_relaxed);
+    if (pthread_kill(thread, backtraceSignal()) != 0) return {};
+    // The handler runs as soon as the thread is scheduled, even mid-syscall
+    for (int i = 0; i < 20 && g_frameCount.load(std::memory_order_acquire) < 0; ++i)
+        QThread::msleep(1);
+    const int count = g_frameCount.load(std::memory_order_acquire);
+    if (count <= 0) return {};
+
+    char **symbols = backtrace_symbols(g_frames, count);
+    if (!symbols) return {};
+    QStringList frames;
+    // Skip the handler and the signal trampoline
+    for (int i = 2; i < count; ++i)
+        frames.append(QString::fromLocal8Bit(symbols[i]));
+    std::free(symbols);
+    return frames;
+#else
+    Q_UNUSED(thread);
+    return {};
+#endif
+}
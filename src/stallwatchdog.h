@@ -0,0 +1,82 @@
+#pragma once
+
+#include <QDateTime>
+#include <QMutex>
+#include <QObject>
+#include <QSemaphore>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <atomic>
+#include <cstdint>
+#include <pthread.h>
+
+class QThread;
+
+// Detects stalls of the GUI thread's event loop and records what caused them.
+//
+// The event dispatcher's awake/aboutToBlock signals bracket every busy
+// period; one longer than the threshold is a stall, measured exactly when
+// the loop gets back to waiting. A watchdog thread samples the busy period
+// while it lasts: the instrumented operation in flight (Tracer::inFlight(),
+// i.e. the innermost OSK_TRACE_SCOPE) and, where glibc's backtrace() is
+// available, the GUI thread's stack, taken from a signal handler. While
+// the loop is idle the watchdog thread sleeps on a semaphore, so watching
+// costs no wakeups.
+//
+// The last LogCapacity stalls are kept for TraceService; a loop that stays
+// blocked for HangMs is reported right away, without waiting for its end.
+class StallWatchdog : public QObject
+{
+    Q_OBJECT
+
+public:
+    static constexpr int DefaultThresholdMs = 32;
+    static constexpr int LogCapacity = 64;
+    static constexpr int HangMs = 2000;
+    static constexpr int MaxFrames = 32;
+
+    struct Stall {
+        QDateTime when;          // start of the busy period
+        int64_t durationMs = 0;
+        QString operation;       // empty when no instrumented scope was open
+        QStringList backtrace;
+    };
+
+    explicit StallWatchdog(QObject *parent = nullptr);
+    ~StallWatchdog() override;
+
+    // Watches the calling thread's event loop; 0 stops watching
+    void setThreshold(int ms);
+    int threshold() const;
+
+    QVector<Stall> stalls() const;
+
+    // OSK_STALL_MS overrides the default threshold (0 disables)
+    void initFromEnvironment();
+
+private:
+    void start();
+    void stop();
+    void onAwake();
+    void onAboutToBlock();
+    void run();
+    void sample(int64_t since);
+    void reportHang(int64_t busyMs);
+    static QStringList captureBacktrace(pthread_t thread);
+
+    std::atomic<int> m_thresholdMs{0};
+    std::atomic<int64_t> m_busySince{0};   // Tracer::now(), 0 while idle
+    std::atomic<bool> m_parked{false};     // watchdog waits on m_wake
+    std::atomic<bool> m_stopping{false};
+    QSemaphore m_wake;
+    QThread *m_thread = nullptr;
+    pthread_t m_watched {};
+    QMetaObject::Connection m_awake;
+    QMetaObject::Connection m_aboutToBlock;
+
+    mutable QMutex m_mutex;
+    int64_t m_sampledSince = 0;   // busy period m_sample belongs to
+    Stall m_sample;
+    QVector<Stall> m_log;         // oldest first
+};
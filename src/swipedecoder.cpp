@@ -0,0 +1,204 @@
+#include "swipedecoder.h"
+#include "completiondictionary.h"
+
+#include <QLineF>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+// Weight of the word-frequency prior, in key widths per decade of frequency
+constexpr float PriorWeight = 0.1f;
+// Start/end keys considered for pruning
+constexpr int MaxEndpointKeys = 3;
+
+// Mean point-to-point distance between two resampled paths (SoA layout)
+float pathDistance(const float *ax, const float *ay, const float *bx, const float *by)
+{
+    constexpr int N = SwipeDecoder::SampleCount;
+    static_assert(N % 4 == 0, "sample count must be a multiple of the SIMD width");
+#if defined(__SSE2__)
+    __m128 acc = _mm_setzero_ps();
+    for (int i = 0; i < N; i += 4) {
+        const __m128 dx = _mm_sub_ps(_mm_loadu_ps(ax + i), _mm_loadu_ps(bx + i));
+        const __m128 dy = _mm_sub_ps(_mm_loadu_ps(ay + i), _mm_loadu_ps(by + i));
+        acc = _mm_add_ps(acc, _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy))));
+    }
+    alignas(16) float lanes[4];
+    _mm_store_ps(lanes, acc);
+    return (lanes[0] + lanes[1] + lanes[2] + lanes[3]) / N;
+#else
+    // Written so the compiler can vectorize it for other targets
+    float sum = 0.0f;
+    for (int i = 0; i < N; ++i) {
+        const float dx = ax[i] - bx[i];
+        const float dy = ay[i] - by[i];
+        sum += std::sqrt(dx * dx + dy * dy);
+    }
+    return sum / N;
+#endif
+}
+
+uint32_t bucketKey(char16_t first, char16_t last)
+{
+    return (uint32_t(first) << 16) | last;
+}
+}
+
+void SwipeDecoder::setKey(QChar letter, const QRectF &rect)
+{
+    m_keys.insert(letter.toLower().unicode(), rect);
+    m_keyWidth = float(qMax<qreal>(1.0, rect.width()));
+    m_buckets.clear();
+}
+
+void SwipeDecoder::clearKeys()
+{
+    m_keys.clear();
+    m_buckets.clear();
+}
+
+bool SwipeDecoder::hasKeys() const { return !m_keys.isEmpty(); }
+
+QVector<QPointF> SwipeDecoder::resample(const QVector<QPointF> &points)
+{
+    QVector<QPointF> out;
+    out.reserve(SampleCount);
+    if (points.isEmpty()) return out;
+
+    qreal total = 0;
+    for (int i = 1; i < points.size(); ++i)
+        total += QLineF(points[i - 1], points[i]).length();
+
+    if (total <= 0) {
+        out.fill(points.first(), SampleCount);
+        return out;
+    }
+
+    // Walk the polyline emitting a point every `step` units
+    const qreal step = total / (SampleCount - 1);
+    out.append(points.first());
+    qreal carried = 0;
+    QPointF prev = points.first();
+    for (int i = 1; i < points.size() && out.size() < SampleCount; ++i) {
+        QPointF cur = points[i];
+        qreal seg = QLineF(prev, cur).length();
+        while (carried + seg >= step && out.size() < SampleCount) {
+            const qreal t = (step - carried) / seg;
+            prev = prev + (cur - prev) * t;
+            out.append(prev);
+            seg = QLineF(prev, cur).length();
+            carried = 0;
+        }
+        carried += seg;
+        prev = cur;
+    }
+    while (out.size() < SampleCount)
+        out.append(points.last());
+    return out;
+}
+
+QVector<char16_t> SwipeDecoder::keysNear(const QPointF &p) const
+{
+    QVector<QPair<qreal, char16_t>> byDistance;
+    for (auto it = m_keys.cbegin(); it != m_keys.cend(); ++it)
+        byDistance.append({QLineF(p, it.value().center()).length(), it.key()});
+    std::sort(byDistance.begin(), byDistance.end());
+
+    // The nearest key always counts; neighbours only when within a key width
+    QVector<char16_t> keys;
+    for (const auto &[distance, letter] : byDistance) {
+        if (keys.size() >= MaxEndpointKeys) break;
+        if (!keys.isEmpty() && distance > m_keyWidth) break;
+        keys.append(letter);
+    }
+    return keys;
+}
+
+const QVector<SwipeDecoder::Template> &SwipeDecoder::bucket(char16_t first, char16_t last,
+                                                           const CompletionDictionary &dict)
+{
+    const uint32_t key = bucketKey(first, last);
+    auto it = m_buckets.find(key);
+    if (it != m_buckets.end())
+        return it.value();
+
+    QVector<Template> templates;
+    dict.forEachWord(QString(QChar(first)), [&](const QString &word, uint32_t freq) {
+        if (word.size() < 2 || word.back().unicode() != last) return;
+
+        // Ideal path: key centres, with repeated letters collapsed
+        QVector<QPointF> path;
+        for (const QChar c : word) {
+            auto keyIt = m_keys.constFind(c.unicode());
+            if (keyIt == m_keys.cend()) return; // not typeable on this layout
+            const QPointF centre = keyIt.value().center();
+            if (path.isEmpty() || path.last() != centre)
+                path.append(centre);
+        }
+
+        const QVector<QPointF> samples = resample(path);
+        Template t;
+        for (int i = 0; i < SampleCount; ++i) {
+            t.xs[i] = float(samples[i].x()) / m_keyWidth;
+            t.ys[i] = float(samples[i].y()) / m_keyWidth;
+        }
+        t.prior = PriorWeight * std::log10(1.0f + float(freq));
+        t.word = word;
+        templates.append(t);
+    });
+
+    return m_buckets.insert(key, templates).value();
+}
+
+QStringList SwipeDecoder::decode(const QVector<QPointF> &stroke, const CompletionDictionary &dict,
+                                 int maxResults)
+{
+    QStringList results;
+    if (stroke.size() < 2 || m_keys.isEmpty() || !dict.isOpen() || maxResults <= 0)
+        return results;
+
+    const QVector<QPointF> samples = resample(stroke);
+    float sx[SampleCount];
+    float sy[SampleCount];
+    for (int i = 0; i < SampleCount; ++i) {
+        sx[i] = float(samples[i].x()) / m_keyWidth;
+        sy[i] = float(samples[i].y()) / m_keyWidth;
+    }
+
+    if (dict.generation() != m_dictGeneration) {
+        m_buckets.clear();
+        m_dictGeneration = dict.generation();
+    }
+
+    // Resolve buckets first: inserting into m_buckets may move earlier ones
+    QVector<QVector<Template>> candidates;
+    const QVector<char16_t> starts = keysNear(stroke.first());
+    const QVector<char16_t> ends = keysNear(stroke.last());
+    for (char16_t first : starts) {
+        for (char16_t last : ends)
+            candidates.append(bucket(first, last, dict));
+    }
+
+    struct Scored {
+        float score;
+        const Template *t;
+    };
+    std::vector<Scored> scored;
+    for (const QVector<Template> &templates : std::as_const(candidates)) {
+        for (const Template &t : templates)
+            scored.push_back({pathDistance(sx, sy, t.xs, t.ys) - t.prior, &t});
+    }
+
+    const size_t n = std::min(scored.size(), size_t(maxResults));
+    std::partial_sort(scored.begin(), scored.begin() + n, scored.end(),
+                      [](const Scored &a, const Scored &b) { return a.score < b.score; });
+    for (size_t i = 0; i < n; ++i)
+        results.append(scored[i].t->word);
+    return results;
+}
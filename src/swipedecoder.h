@@ -0,0 +1,53 @@
+#pragma once
+
+#include <QHash>
+#include <QPointF>
+#include <QRectF>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <cstdint>
+
+class CompletionDictionary;
+
+// Gesture-typing decoder.
+//
+// A stroke is resampled to a fixed number of equidistant points and compared
+// with the ideal path through the key centres of each candidate word. Only
+// words whose first and last letters lie under the start and end of the
+// stroke are considered; their templates are built lazily from the
+// completion dictionary and cached per (first, last) letter pair until the
+// keys move or the dictionary is reopened.
+//
+// Key rectangles come from the QML layout, in layout coordinates, so the
+// decoder always matches what is on screen.
+class SwipeDecoder
+{
+public:
+    static constexpr int SampleCount = 32;
+
+    void setKey(QChar letter, const QRectF &rect);
+    void clearKeys();
+    bool hasKeys() const;
+
+    // Best matches, most likely first
+    QStringList decode(const QVector<QPointF> &stroke, const CompletionDictionary &dict,
+                       int maxResults);
+
+private:
+    struct Template {
+        float xs[SampleCount];
+        float ys[SampleCount];
+        float prior;        // frequency bonus, in key widths
+        QString word;
+    };
+
+    static QVector<QPointF> resample(const QVector<QPointF> &points);
+    QVector<char16_t> keysNear(const QPointF &p) const;
+    const QVector<Template> &bucket(char16_t first, char16_t last, const CompletionDictionary &dict);
+
+    QHash<char16_t, QRectF> m_keys;
+    QHash<uint32_t, QVector<Template>> m_buckets;
+    uint64_t m_dictGeneration = 0;   // of the dictionary m_buckets came from
+    float m_keyWidth = 1.0f;
+};
@@ -0,0 +1,249 @@
+#include "tracer.h"
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDir>
+#include <QSaveFile>
+
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <pthread.h>
+#include <unistd.h>
+
+namespace Tracer {
+
+std::atomic<bool> g_enabled{false};
+std::atomic<const char *> g_inFlight{nullptr};
+constinit thread_local bool t_watched = false;
+
+namespace {
+
+constexpr uint64_t RingCapacity = 1 << 14;   // events per thread (512 KiB)
+// Rings of exited threads kept for the next dump; beyond this a new thread
+// takes over the one whose thread exited first
+constexpr std::size_t MaxExitedRings = 8;
+
+enum Kind : uint32_t { Complete, Begin, End, Counter };
+
+struct Event {
+    const char *name;
+    int64_t timestamp;  // ns, steady clock
+    int64_t value;      // duration (Complete) or counter value
+    uint32_t kind;
+};
+
+struct Ring {
+    int tid = 0;
+    char threadName[16] = {};
+    // Only the owning thread writes; dump() reads behind it
+    std::atomic<uint64_t> head{0};
+    // Under g_ringsMutex: 0 while the thread runs, else when it exited
+    uint64_t exited = 0;
+    Event events[RingCapacity];
+};
+
+std::mutex g_ringsMutex;
+std::vector<std::unique_ptr<Ring>> g_rings;  // until dumped after their thread exits
+uint64_t g_exits = 0;
+QString g_exitPath;
+
+// Hands the ring back when its thread exits, so short-lived workers do not
+// each leave one behind
+struct RingOwner {
+    Ring *ring = nullptr;
+    ~RingOwner()
+    {
+        if (!ring) return;
+        std::lock_guard<std::mutex> lock(g_ringsMutex);
+        ring->exited = ++g_exits;
+    }
+};
+thread_local RingOwner t_owner;
+
+Ring *threadRing()
+{
+    if (t_owner.ring) return t_owner.ring;
+    std::lock_guard<std::mutex> lock(g_ringsMutex);
+    Ring *ring = nullptr;
+    std::size_t exited = 0;
+    for (const auto &r : g_rings) {
+        if (!r->exited) continue;
+        ++exited;
+        if (!ring || r->exited < ring->exited)
+            ring = r.get();
+    }
+    if (exited < MaxExitedRings) {
+        g_rings.push_back(std::make_unique<Ring>());
+        ring = g_rings.back().get();
+    }
+    ring->tid = int(::gettid());
+    std::memset(ring->threadName, 0, sizeof ring->threadName);
+    pthread_getname_np(pthread_self(), ring->threadName, sizeof ring->threadName);
+    ring->head.store(0, std::memory_order_relaxed);
+    ring->exited = 0;
+    t_owner.ring = ring;
+    return ring;
+}
+
+void record(const char *name, int64_t timestamp, int64_t value, Kind kind)
+{
+    Ring *ring = threadRing();
+    const uint64_t head = ring->head.load(std::memory_order_relaxed);
+    ring->events[head % RingCapacity] = {name, timestamp, value, kind};
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+void appendEscaped(QByteArray &out, const char *text)
+{
+    for (const char *p = text; *p; ++p) {
+        const unsigned char c = static_cast<unsigned char>(*p);
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += char(c);
+        } else if (c < 0x20) {
+            out += ' ';
+        } else {
+            out += char(c);
+        }
+    }
+}
+
+void appendMicroseconds(QByteArray &out, int64_t ns)
+{
+    out += QByteArray::number(ns / 1000);
+    out += '.';
+    out += QByteArray::number(ns % 1000).rightJustified(3, '0');
+}
+
+} // namespace
+
+void setEnabled(bool enabled)
+{
+    g_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+void setThreadWatched(bool watched)
+{
+    t_watched = watched;
+    g_inFlight.store(nullptr, std::memory_order_relaxed);
+}
+
+void complete(const char *name, int64_t start)
+{
+    const int64_t end = now();
+    record(name, start, end - start, Complete);
+}
+
+void begin(const char *name)
+{
+    if (isEnabled())
+        record(name, now(), 0, Begin);
+}
+
+void end(const char *name)
+{
+    if (isEnabled())
+        record(name, now(), 0, End);
+}
+
+void counter(const char *name, int64_t value)
+{
+    record(name, now(), value, Counter);
+}
+
+QString defaultPath()
+{
+    return QDir::temp().filePath(QStringLiteral("osk-trace-%1-%2.json")
+        .arg(QCoreApplication::applicationPid())
+        .arg(QDateTime::currentDateTime().toString(QStringLiteral("yyyyMMdd-hhmmss"))));
+}
+
+QString dump(const QString &path)
+{
+    const QString target = path.isEmpty() ? defaultPath() : path;
+    const QByteArray pid = QByteArray::number(QCoreApplication::applicationPid());
+
+    QByteArray out;
+    out.reserve(1 << 20);
+    out += "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    auto separate = [&]() {
+        if (!first) out += ",\n";
+        first = false;
+    };
+
+    std::vector<Event> events;
+    std::lock_guard<std::mutex> lock(g_ringsMutex);
+    for (const auto &ring : g_rings) {
+        const QByteArray tid = QByteArray::number(ring->tid);
+        separate();
+        out += "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":" + pid + ",\"tid\":" + tid
+               + ",\"args\":{\"name\":\"";
+        appendEscaped(out, ring->threadName);
+        out += "\"}}";
+
+        // The owner keeps recording: copy, then drop whatever it may have
+        // overwritten while we copied
+        const uint64_t head = ring->head.load(std::memory_order_acquire);
+        const uint64_t oldest = head > RingCapacity ? head - RingCapacity : 0;
+        events.assign(head - oldest, Event{});
+        for (uint64_t i = oldest; i < head; ++i)
+            events[i - oldest] = ring->events[i % RingCapacity];
+        const uint64_t after = ring->head.load(std::memory_order_acquire);
+        const uint64_t valid = after > RingCapacity ? after - RingCapacity : 0;
+        const size_t skip = valid > oldest ? size_t(valid - oldest) : 0;
+
+        for (size_t i = skip; i < events.size(); ++i) {
+            const Event &e = events[i];
+            separate();
+            out += "{\"name\":\"";
+            appendEscaped(out, e.name);
+            out += "\",\"pid\":" + pid + ",\"tid\":" + tid + ",\"ts\":";
+            appendMicroseconds(out, e.timestamp);
+            switch (e.kind) {
+            case Complete:
+                out += ",\"ph\":\"X\",\"dur\":";
+                appendMicroseconds(out, e.value);
+                break;
+            case Begin:
+                out += ",\"ph\":\"B\"";
+                break;
+            case End:
+                out += ",\"ph\":\"E\"";
+                break;
+            case Counter:
+                out += ",\"ph\":\"C\",\"args\":{\"value\":" + QByteArray::number(qlonglong(e.value)) + '}';
+                break;
+            }
+            out += '}';
+        }
+    }
+    out += "]}\n";
+
+    QSaveFile file(target);
+    if (!file.open(QIODevice::WriteOnly) || file.write(out) != out.size() || !file.commit()) {
+        qWarning("Tracer: cannot write %s", qPrintable(target));
+        return QString();
+    }
+    // Written out: rings of threads that are gone are not needed again
+    std::erase_if(g_rings, [](const std::unique_ptr<Ring> &ring) { return ring->exited != 0; });
+    return target;
+}
+
+void initFromEnvironment()
+{
+    const QString value = qEnvironmentVariable("OSK_TRACE");
+    if (value.isEmpty() || value == QLatin1String("0")) return;
+    g_exitPath = value == QLatin1String("1") ? defaultPath() : value;
+    setEnabled(true);
+    qAddPostRoutine([]() {
+        const QString written = dump(g_exitPath);
+        if (!written.isEmpty())
+            qInfo("Trace written to %s", qPrintable(written));
+    });
+}
+
+} // namespace Tracer
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <QString>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// In-process trace recorder.
+//
+// Events go into a fixed ring buffer owned by the recording thread, so
+// recording takes no lock and never allocates after a thread's first event;
+// when the ring is full the oldest events are overwritten. A thread's ring
+// outlives it until the next dump, or until enough threads have exited
+// that a new one takes it over. While tracing is
+// off every OSK_TRACE_* macro costs one relaxed atomic load (plus a
+// thread-local flag test for scopes).
+//
+// dump() writes the rings as Chrome trace-event JSON, which chrome://tracing
+// and ui.perfetto.dev open directly. Tracing starts when OSK_TRACE is set
+// (to an output path, or 1 for one in the temporary directory) and can be
+// toggled at runtime over D-Bus (see TraceService).
+//
+// Scopes on a watched thread (see StallWatchdog) also publish their name as
+// the operation in flight, whether or not tracing is on.
+//
+// Event names must be string literals: only the pointer is recorded.
+namespace Tracer {
+
+extern std::atomic<bool> g_enabled;
+extern std::atomic<const char *> g_inFlight;
+extern constinit thread_local bool t_watched;
+
+inline bool isEnabled() { return g_enabled.load(std::memory_order_relaxed); }
+
+inline int64_t now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void setEnabled(bool enabled);
+
+// Record one event on the calling thread. complete() and counter() leave
+// the isEnabled() check to the caller (the macros below).
+void complete(const char *name, int64_t start);
+void begin(const char *name);
+void end(const char *name);
+void counter(const char *name, int64_t value);
+
+// Writes every thread's ring; path defaults to defaultPath(). Returns the
+// path written, or an empty string on failure.
+QString dump(const QString &path = QString());
+QString defaultPath();
+
+// Applies OSK_TRACE and arranges for a dump at exit when it was set
+void initFromEnvironment();
+
+// Scopes on the calling thread publish themselves to inFlight(); only one
+// thread is watched at a time
+void setThreadWatched(bool watched);
+// Innermost scope running on the watched thread, or nullptr
+inline const char *inFlight() { return g_inFlight.load(std::memory_order_relaxed); }
+
+class Scope
+{
+public:
+    explicit Scope(const char *name)
+        : m_name(isEnabled() ? name : nullptr)
+        , m_start(m_name ? now() : 0)
+        , m_watched(t_watched)
+        , m_outer(m_watched ? g_inFlight.exchange(name, std::memory_order_relaxed) : nullptr)
+    {
+    }
+    ~Scope()
+    {
+        if (m_name)
+            complete(m_name, m_start);
+        if (m_watched)
+            g_inFlight.store(m_outer, std::memory_order_relaxed);
+    }
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+
+private:
+    const char *m_name;
+    int64_t m_start;
+    bool m_watched;
+    const char *m_outer;   // scope this one is nested in
+};
+
+} // namespace Tracer
+
+#define OSK_TRACE_CONCAT_(a, b) a##b
+#define OSK_TRACE_CONCAT(a, b) OSK_TRACE_CONCAT_(a, b)
+#define OSK_TRACE_SCOPE(name) Tracer::Scope OSK_TRACE_CONCAT(oskTraceScope_, __LINE__)(name)
+#define OSK_TRACE_COUNTER(name, value) \
+    do { if (Tracer::isEnabled()) Tracer::counter(name, int64_t(value)); } while (false)
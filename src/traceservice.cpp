@@ -0,0 +1,65 @@
+#include "traceservice.h"
+#include "stallwatchdog.h"
+#include "tracer.h"
+
+#include <QDBusConnection>
+
+TraceService::TraceService(StallWatchdog *watchdog, QObject *parent)
+    : QObject(parent)
+    , m_watchdog(watchdog)
+{
+}
+
+bool TraceService::registerOnSessionBus()
+{
+    QDBusConnection bus = QDBusConnection::sessionBus();
+    if (!bus.registerService(QStringLiteral("org.osk.Keyboard"))) return false;
+    return bus.registerObject(QStringLiteral("/Trace"), this, QDBusConnection::ExportScriptableSlots);
+}
+
+void TraceService::start()
+{
+    Tracer::setEnabled(true);
+}
+
+QString TraceService::stop(const QString &path)
+{
+    Tracer::setEnabled(false);
+    return Tracer::dump(path);
+}
+
+QString TraceService::dump(const QString &path)
+{
+    return Tracer::dump(path);
+}
+
+bool TraceService::isEnabled() const
+{
+    return Tracer::isEnabled();
+}
+
+QStringList TraceService::stalls() const
+{
+    QStringList out;
+    const auto stalls = m_watchdog->stalls();
+    for (const StallWatchdog::Stall &stall : stalls) {
+        QString entry = QStringLiteral("%1  %2 ms  %3")
+            .arg(stall.when.toString(Qt::ISODateWithMs))
+            .arg(stall.durationMs)
+            .arg(stall.operation.isEmpty() ? QStringLiteral("(no instrumented operation)") : stall.operation);
+        for (const QString &frame : stall.backtrace)
+            entry += QStringLiteral("\n    ") + frame;
+        out.append(entry);
+    }
+    return out;
+}
+
+int TraceService::stallThreshold() const
+{
+    return m_watchdog->threshold();
+}
+
+void TraceService::setStallThreshold(int ms)
+{
+    m_watchdog->setThreshold(ms);
+}
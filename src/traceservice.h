@@ -0,0 +1,41 @@
+#pragma once
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+
+class StallWatchdog;
+
+// D-Bus control for the trace recorder, registered as
+// org.osk.Keyboard /Trace:
+//   qdbus org.osk.Keyboard /Trace org.osk.Trace.start
+//   qdbus org.osk.Keyboard /Trace org.osk.Trace.stop [path]
+//   qdbus org.osk.Keyboard /Trace org.osk.Trace.stalls
+class TraceService : public QObject
+{
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "org.osk.Trace")
+
+public:
+    explicit TraceService(StallWatchdog *watchdog, QObject *parent = nullptr);
+
+    // Claims the service name and exports the object; false if either fails
+    bool registerOnSessionBus();
+
+public slots:
+    Q_SCRIPTABLE void start();
+    // Stops recording and writes the trace; returns the path written
+    Q_SCRIPTABLE QString stop(const QString &path = QString());
+    // Writes the trace without stopping
+    Q_SCRIPTABLE QString dump(const QString &path = QString());
+    Q_SCRIPTABLE bool isEnabled() const;
+
+    // Recent GUI-thread stalls, oldest first, one entry per stall
+    Q_SCRIPTABLE QStringList stalls() const;
+    Q_SCRIPTABLE int stallThreshold() const;
+    // Milliseconds; 0 stops the watchdog
+    Q_SCRIPTABLE void setStallThreshold(int ms);
+
+private:
+    StallWatchdog *m_watchdog;
+};
@@ -0,0 +1,161 @@
+#include "typeserver.h"
+#include "injectionprotocol.h"
+#include "keymap.h"
+#include "tracer.h"
+#include "virtualkeyboard.h"
+
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QSettings>
+#include <QtEndian>
+#include <cstring>
+
+namespace {
+constexpr char Magic[4] = {'O', 'S', 'K', 'T'};
+constexpr int HeaderSize = 8;
+// Bytes taken from the socket at a time; also caps its read buffer
+constexpr int ChunkBytes = 16 * 1024;
+// Stop reading while this many characters are waiting to be typed
+constexpr int HighWatermark = 32 * 1024;
+// Same frame and per-frame budget as macro playback
+constexpr int FrameIntervalMs = 16;
+constexpr int MaxCharsPerFrame = 32;
+}
+
+TypeServer::TypeServer(VirtualKeyboard *vk, const KeyMap *keymap, QObject *parent)
+    : QObject(parent)
+    , m_vk(vk)
+    , m_keymap(keymap)
+    , m_server(new QLocalServer(this))
+{
+    // Shared with the UI's settings, whichever process hosts the server
+    m_rate = QSettings(QStringLiteral("osk"), QStringLiteral("osk"))
+                 .value(QStringLiteral("typeRate"), 0).toInt();
+
+    m_frameTimer.setTimerType(Qt::PreciseTimer);
+    m_frameTimer.setInterval(FrameIntervalMs);
+    connect(&m_frameTimer, &QTimer::timeout, this, &TypeServer::tick);
+    connect(m_server, &QLocalServer::newConnection, this, &TypeServer::acceptClients);
+}
+
+TypeServer::~TypeServer()
+{
+    qDeleteAll(m_sessions);
+}
+
+bool TypeServer::listen()
+{
+    return InjectionProtocol::listenExclusive(m_server, InjectionProtocol::typeSocketPath());
+}
+
+int TypeServer::rate() const { return m_rate; }
+
+void TypeServer::setRate(int charsPerSecond)
+{
+    m_rate = qMax(0, charsPerSecond);
+}
+
+void TypeServer::acceptClients()
+{
+    while (QLocalSocket *socket = m_server->nextPendingConnection()) {
+        auto *session = new Session;
+        session->socket = socket;
+        socket->setReadBufferSize(ChunkBytes);
+        connect(socket, &QLocalSocket::readyRead, this, &TypeServer::schedule);
+        connect(socket, &QLocalSocket::disconnected, this, &TypeServer::schedule);
+        m_sessions.append(session);
+    }
+    schedule();
+}
+
+void TypeServer::schedule()
+{
+    if (m_sessions.isEmpty() || m_frameTimer.isActive()) return;
+    // Pace from now rather than catching up on the idle time
+    m_clock.start();
+    m_typed = 0;
+    m_frameTimer.start();
+    tick();
+}
+
+void TypeServer::tick()
+{
+    OSK_TRACE_SCOPE("TypeServer::tick");
+    if (m_sessions.isEmpty()) {
+        m_frameTimer.stop();
+        return;
+    }
+    Session &session = *m_sessions.first();
+    if (!fill(session)) {
+        qWarning("Dropping malformed text injection stream");
+        finishSession();
+        return;
+    }
+
+    const int rate = session.rate > 0 ? session.rate : m_rate;
+    int budget = MaxCharsPerFrame;
+    if (rate > 0) {
+        const qint64 due = m_clock.elapsed() * rate / 1000 + 1;
+        budget = int(qBound<qint64>(0, due - m_typed, MaxCharsPerFrame));
+    }
+
+    while (budget-- > 0 && session.pos < session.pending.size()) {
+        // The decoder never splits a surrogate pair across chunks
+        char32_t ch = session.pending.at(session.pos++).unicode();
+        if (QChar::isHighSurrogate(ch) && session.pos < session.pending.size())
+            ch = QChar::surrogateToUcs4(char16_t(ch), session.pending.at(session.pos++).unicode());
+        typeChar(ch);
+        ++m_typed;
+    }
+    OSK_TRACE_COUNTER("type.pending", session.pending.size() - session.pos);
+
+    if (session.pos < session.pending.size() || session.socket->bytesAvailable() > 0)
+        return;
+    if (session.socket->state() == QLocalSocket::UnconnectedState)
+        finishSession();
+    else
+        m_frameTimer.stop();   // idle until the client sends more
+}
+
+bool TypeServer::fill(Session &session)
+{
+    QLocalSocket *socket = session.socket;
+    if (!session.started) {
+        if (socket->bytesAvailable() < HeaderSize)
+            return socket->state() != QLocalSocket::UnconnectedState;
+        char header[HeaderSize];
+        socket->read(header, HeaderSize);
+        if (std::memcmp(header, Magic, sizeof(Magic)) != 0)
+            return false;
+        session.rate = int(qMin<quint32>(qFromLittleEndian<quint32>(header + 4), 100000));
+        session.started = true;
+    }
+
+    while (session.pending.size() - session.pos < HighWatermark && socket->bytesAvailable() > 0) {
+        const QByteArray bytes = socket->read(ChunkBytes);
+        session.pending.remove(0, session.pos);
+        session.pos = 0;
+        session.pending.append(session.decoder(bytes));
+    }
+    return true;
+}
+
+void TypeServer::typeChar(char32_t ch)
+{
+    if (!m_vk || !m_vk->isReady()) return;
+    uint8_t level = 0;
+    const int code = m_keymap->fromChar(ch, &level);
+    if (code < 0) return;   // not on the layout (includes '\r')
+    m_vk->sendKeyAtLevel(uint32_t(code), level & KeyMap::Shift, level & KeyMap::AltGr);
+}
+
+void TypeServer::finishSession()
+{
+    Session *session = m_sessions.takeFirst();
+    session->socket->disconnect(this);
+    session->socket->deleteLater();
+    delete session;
+
+    m_frameTimer.stop();
+    schedule();
+}
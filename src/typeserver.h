@@ -0,0 +1,64 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QList>
+#include <QObject>
+#include <QString>
+#include <QStringDecoder>
+#include <QTimer>
+
+class QLocalServer;
+class QLocalSocket;
+class KeyMap;
+class VirtualKeyboard;
+
+// Types UTF-8 text streamed by local clients (osk-type) through the
+// existing virtual keyboard.
+//
+// A stream starts with an 8-byte header ("OSKT" + little-endian uint32
+// rate in characters per second, 0 for the configured default) followed by
+// raw UTF-8. Text is pulled from the socket only while less than a high
+// watermark is waiting to be typed, and the socket's read buffer is capped,
+// so a large input stalls the writer in the kernel instead of being
+// buffered here. Streams are served one at a time in arrival order; typing
+// is paced by a frame timer the same way macro playback is.
+class TypeServer : public QObject
+{
+    Q_OBJECT
+public:
+    TypeServer(VirtualKeyboard *vk, const KeyMap *keymap, QObject *parent = nullptr);
+    ~TypeServer() override;
+
+    bool listen();
+
+    // Default characters per second (0 = as fast as the frame budget allows)
+    int rate() const;
+    void setRate(int charsPerSecond);
+
+private:
+    struct Session {
+        QLocalSocket *socket = nullptr;
+        QStringDecoder decoder {QStringDecoder::Utf8};
+        QString pending;        // decoded, not yet typed
+        qsizetype pos = 0;      // next character in pending
+        int rate = 0;
+        bool started = false;   // header consumed
+    };
+
+    void acceptClients();
+    void schedule();
+    void tick();
+    // Tops up pending from the socket; false if the stream is malformed
+    bool fill(Session &session);
+    void typeChar(char32_t ch);
+    void finishSession();
+
+    VirtualKeyboard *m_vk = nullptr;
+    const KeyMap *m_keymap = nullptr;
+    QLocalServer *m_server = nullptr;
+    QList<Session *> m_sessions;   // front is being typed
+    QTimer m_frameTimer;
+    QElapsedTimer m_clock;
+    qint64 m_typed = 0;            // since m_clock started
+    int m_rate = 0;
+};
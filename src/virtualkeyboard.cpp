@@ -1,18 +1,86 @@
 #include "virtualkeyboard.h"
+#include "injectionprotocol.h"
+#include "core/modifierstate.h"
 
 #include <linux/uinput.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <cstring>
+#include <iterator>
 #include <QDebug>
+#include <QLocalSocket>
+#include <QTimer>
 
-VirtualKeyboard::VirtualKeyboard(QObject *parent)
+VirtualKeyboard::VirtualKeyboard(Backend backend, QObject *parent)
     : QObject(parent)
+{
+    if (backend == Backend::Auto)
+        connectDaemon();
+    else
+        openDevice();
+}
+
+// Asks osk-daemon for its device without waiting on it: the answer arrives
+// through the event loop, and when the daemon is not running, fails the
+// handshake or stays silent the local device is opened instead
+void VirtualKeyboard::connectDaemon()
+{
+    using namespace InjectionProtocol;
+    auto *socket = new QLocalSocket(this);
+    auto *timeout = new QTimer(socket);
+    timeout->setSingleShot(true);
+
+    auto fallBack = [this, socket, timeout]() {
+        timeout->stop();
+        disconnect(socket, nullptr, this, nullptr);
+        disconnect(timeout, nullptr, this, nullptr);
+        socket->abort();
+        socket->deleteLater();
+        openDevice();
+    };
+    connect(socket, &QLocalSocket::errorOccurred, this, fallBack);
+    connect(timeout, &QTimer::timeout, this, fallBack);
+    connect(socket, &QLocalSocket::connected, this, [socket]() {
+        const Message hello {Hello, 0, 0, Version};
+        socket->write(reinterpret_cast<const char *>(&hello), sizeof(hello));
+    });
+    connect(socket, &QLocalSocket::readyRead, this, [this, socket, timeout, fallBack]() {
+        Message reply {};
+        if (socket->bytesAvailable() < qint64(sizeof(reply))) return;
+        socket->read(reinterpret_cast<char *>(&reply), sizeof(reply));
+        if (reply.op != Hello || reply.code != Version || !(reply.flags & DeviceReady))
+            return fallBack();
+        timeout->stop();
+        disconnect(socket, nullptr, this, nullptr);
+        useDaemon(socket);
+    });
+    timeout->start(HandshakeTimeoutMs);
+    socket->connectToServer(injectionSocketPath());
+}
+
+void VirtualKeyboard::useDaemon(QLocalSocket *socket)
+{
+    m_daemon = socket;
+    m_ready = true;
+    connect(socket, &QLocalSocket::disconnected, this, [this]() {
+        qWarning("osk-daemon went away, falling back to a local uinput device");
+        m_daemon->deleteLater();
+        m_daemon = nullptr;
+        m_ready = false;
+        m_held.reset();   // the daemon released them
+        emit readyChanged();
+        openDevice();
+    });
+    qInfo("Virtual keyboard ready (osk-daemon)");
+    emit readyChanged();
+}
+
+bool VirtualKeyboard::openDevice()
 {
     m_fd = open("/dev/uinput", O_WRONLY | O_NONBLOCK);
     if (m_fd < 0) {
         qWarning("Failed to open /dev/uinput — check permissions (user must be in 'input' group)");
-        return;
+        return false;
     }
 
     // Enable key events
@@ -35,7 +103,7 @@ VirtualKeyboard::VirtualKeyboard(QObject *parent)
         qWarning("Failed to create uinput device");
         close(m_fd);
         m_fd = -1;
-        return;
+        return false;
     }
 
     // Small delay for udev to register the device
@@ -43,10 +111,13 @@ VirtualKeyboard::VirtualKeyboard(QObject *parent)
 
     m_ready = true;
     qInfo("Virtual keyboard ready (uinput)");
+    emit readyChanged();
+    return true;
 }
 
 VirtualKeyboard::~VirtualKeyboard()
 {
+    releaseAll();
     if (m_fd >= 0) {
         ioctl(m_fd, UI_DEV_DESTROY);
         close(m_fd);
@@ -54,6 +125,14 @@ VirtualKeyboard::~VirtualKeyboard()
 }
 
 bool VirtualKeyboard::isReady() const { return m_ready; }
+bool VirtualKeyboard::isRemote() const { return m_daemon != nullptr; }
+
+void VirtualKeyboard::sendRemote(uint8_t op, uint32_t linuxKeyCode)
+{
+    const InjectionProtocol::Message message {op, 0, 0, linuxKeyCode};
+    m_daemon->write(reinterpret_cast<const char *>(&message), sizeof(message));
+    m_daemon->flush();
+}
 
 void VirtualKeyboard::emitEvent(int type, int code, int value)
 {
@@ -67,6 +146,7 @@ void VirtualKeyboard::emitEvent(int type, int code, int value)
 void VirtualKeyboard::sendKey(uint32_t linuxKeyCode)
 {
     if (!m_ready) return;
+    if (m_daemon) return sendRemote(InjectionProtocol::Tap, linuxKeyCode);
     emitEvent(EV_KEY, linuxKeyCode, 1);
     emitEvent(EV_SYN, SYN_REPORT, 0);
     emitEvent(EV_KEY, linuxKeyCode, 0);
@@ -76,6 +156,8 @@ void VirtualKeyboard::sendKey(uint32_t linuxKeyCode)
 void VirtualKeyboard::sendKeyPress(uint32_t linuxKeyCode)
 {
     if (!m_ready) return;
+    if (linuxKeyCode < m_held.size()) m_held.set(linuxKeyCode);
+    if (m_daemon) return sendRemote(InjectionProtocol::Press, linuxKeyCode);
     emitEvent(EV_KEY, linuxKeyCode, 1);
     emitEvent(EV_SYN, SYN_REPORT, 0);
 }
@@ -83,6 +165,72 @@ void VirtualKeyboard::sendKeyPress(uint32_t linuxKeyCode)
 void VirtualKeyboard::sendKeyRelease(uint32_t linuxKeyCode)
 {
     if (!m_ready) return;
+    if (linuxKeyCode < m_held.size()) m_held.reset(linuxKeyCode);
+    if (m_daemon) return sendRemote(InjectionProtocol::Release, linuxKeyCode);
     emitEvent(EV_KEY, linuxKeyCode, 0);
     emitEvent(EV_SYN, SYN_REPORT, 0);
 }
+
+namespace {
+constexpr struct { uint16_t bit; uint32_t key; } ModifierKeys[] = {
+    {ModifierState::Shift, KEY_LEFTSHIFT},
+    {ModifierState::Ctrl,  KEY_LEFTCTRL},
+    {ModifierState::Alt,   KEY_LEFTALT},
+    {ModifierState::Meta,  KEY_LEFTMETA},
+};
+}
+
+// Read back from the held keys, so presses relayed by osk-daemon for the
+// UI count as well
+uint16_t VirtualKeyboard::modifiers() const
+{
+    uint16_t mask = 0;
+    for (const auto &k : ModifierKeys) {
+        if (m_held.test(k.key)) mask |= k.bit;
+    }
+    return mask;
+}
+
+void VirtualKeyboard::setModifiers(uint16_t mask)
+{
+    if (!m_ready) return;
+    const uint16_t held = modifiers();
+    if (mask == held) return;
+    const uint16_t released = held & ~mask;
+    const uint16_t pressed = mask & ~held;
+    for (auto it = std::rbegin(ModifierKeys); it != std::rend(ModifierKeys); ++it) {
+        if (released & it->bit) sendKeyRelease(it->key);
+    }
+    for (const auto &k : ModifierKeys) {
+        if (pressed & k.bit) sendKeyPress(k.key);
+    }
+}
+
+void VirtualKeyboard::sendKeyWith(uint32_t linuxKeyCode, uint16_t mask)
+{
+    if (!m_ready) return;
+    const uint16_t held = modifiers();
+    setModifiers(mask);
+    sendKey(linuxKeyCode);
+    setModifiers(held);
+}
+
+void VirtualKeyboard::sendKeyAtLevel(uint32_t linuxKeyCode, bool shift, bool altGr)
+{
+    if (!m_ready) return;
+    const uint16_t held = modifiers();
+    setModifiers(shift ? ModifierState::Shift : 0);
+    if (altGr) sendKeyPress(KEY_RIGHTALT);
+    sendKey(linuxKeyCode);
+    if (altGr) sendKeyRelease(KEY_RIGHTALT);
+    setModifiers(held);
+}
+
+void VirtualKeyboard::releaseAll()
+{
+    if (!m_ready || m_held.none()) return;
+    for (uint32_t code = 0; code < m_held.size(); ++code) {
+        if (m_held.test(code))
+            sendKeyRelease(code);
+    }
+}
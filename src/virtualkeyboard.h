@@ -1,26 +1,69 @@
 #pragma once
 
 #include <QObject>
+#include <bitset>
 #include <cstdint>
 
+class QLocalSocket;
+
 // Uses Linux uinput to inject keyboard events at the kernel level.
 // Works on any Wayland compositor (KWin, wlroots, etc.)
+//
+// With Backend::Auto the events go to osk-daemon when it is running, which
+// keeps one device alive across UI restarts; otherwise (or if the daemon
+// goes away) the device is created in this process. The daemon is asked
+// without blocking, so the keyboard is not ready until readyChanged().
+//
+// The modifiers held on the device are tracked here, so every sender
+// (typing, macros, osk-type, pastes) works against the same state: a key
+// that needs a particular set of modifiers gets exactly that set and the
+// held ones are put back afterwards.
 class VirtualKeyboard : public QObject
 {
     Q_OBJECT
 public:
-    explicit VirtualKeyboard(QObject *parent = nullptr);
+    enum class Backend { Auto, Local };
+
+    explicit VirtualKeyboard(Backend backend = Backend::Auto, QObject *parent = nullptr);
     ~VirtualKeyboard() override;
 
     bool isReady() const;
+    bool isRemote() const;
 
     void sendKey(uint32_t linuxKeyCode);
     void sendKeyPress(uint32_t linuxKeyCode);
     void sendKeyRelease(uint32_t linuxKeyCode);
+    // Modifiers held between keys, as ModifierState bits
+    uint16_t modifiers() const;
+    // Presses and releases modifiers so that exactly mask is held; only
+    // transitions are sent
+    void setModifiers(uint16_t mask);
+    // Taps a key with exactly mask (ModifierState bits) held, then puts
+    // back the modifiers held before
+    void sendKeyWith(uint32_t linuxKeyCode, uint16_t mask);
+    // Taps a key with Shift and/or AltGr (right Alt) held and nothing else,
+    // to reach a level
+    void sendKeyAtLevel(uint32_t linuxKeyCode, bool shift, bool altGr);
+    // Releases every key this instance holds pressed
+    void releaseAll();
+
+signals:
+    // The device came up, went away, or moved between osk-daemon and this
+    // process
+    void readyChanged();
 
 private:
+    // How long osk-daemon may take to answer the handshake
+    static constexpr int HandshakeTimeoutMs = 500;
+
+    void connectDaemon();
+    void useDaemon(QLocalSocket *socket);
+    bool openDevice();
+    void sendRemote(uint8_t op, uint32_t linuxKeyCode);
     void emitEvent(int type, int code, int value);
 
     int m_fd = -1;
     bool m_ready = false;
+    QLocalSocket *m_daemon = nullptr;
+    std::bitset<0x300> m_held;   // KEY_CNT; keys currently pressed
 };
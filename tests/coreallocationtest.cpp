@@ -0,0 +1,227 @@
+// The key path must not allocate: every operator new between setup and the
+// end of a scenario is counted, and any count above zero fails the test.
+
+#include "core/composedfa.h"
+#include "core/keyboardcore.h"
+#include "core/keytable.h"
+#include "core/triggertable.h"
+
+#include <linux/input-event-codes.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string_view>
+#include <vector>
+
+namespace {
+std::atomic<bool> counting {false};
+std::atomic<std::size_t> allocations {0};
+
+void *allocate(std::size_t size)
+{
+    if (counting.load(std::memory_order_relaxed))
+        allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+}
+
+void *operator new(std::size_t size) { return allocate(size); }
+void *operator new[](std::size_t size) { return allocate(size); }
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+    try { return allocate(size); } catch (...) { return nullptr; }
+}
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept
+{
+    try { return allocate(size); } catch (...) { return nullptr; }
+}
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::size_t) noexcept { std::free(p); }
+
+namespace {
+int failures = 0;
+
+template <typename Scenario>
+void expectNoAllocation(const char *name, Scenario scenario)
+{
+    allocations = 0;
+    counting = true;
+    scenario();
+    counting = false;
+    if (allocations != 0) {
+        std::fprintf(stderr, "FAIL %s: %zu allocations\n", name, std::size_t(allocations));
+        ++failures;
+    } else {
+        std::printf("PASS %s\n", name);
+    }
+}
+
+void expect(bool condition, const char *what)
+{
+    if (!condition) {
+        std::fprintf(stderr, "FAIL %s\n", what);
+        ++failures;
+    }
+}
+
+// US letters and punctuation on the keys the tests press
+void fillUs(KeyTable &table)
+{
+    static constexpr struct { int code; char32_t normal; char32_t shifted; } keys[] = {
+        {KEY_Q, U'q', U'Q'}, {KEY_W, U'w', U'W'}, {KEY_E, U'e', U'E'}, {KEY_R, U'r', U'R'},
+        {KEY_T, U't', U'T'}, {KEY_Y, U'y', U'Y'}, {KEY_U, U'u', U'U'}, {KEY_I, U'i', U'I'},
+        {KEY_O, U'o', U'O'}, {KEY_P, U'p', U'P'}, {KEY_A, U'a', U'A'}, {KEY_S, U's', U'S'},
+        {KEY_D, U'd', U'D'}, {KEY_F, U'f', U'F'}, {KEY_G, U'g', U'G'}, {KEY_H, U'h', U'H'},
+        {KEY_J, U'j', U'J'}, {KEY_K, U'k', U'K'}, {KEY_L, U'l', U'L'}, {KEY_Z, U'z', U'Z'},
+        {KEY_X, U'x', U'X'}, {KEY_C, U'c', U'C'}, {KEY_V, U'v', U'V'}, {KEY_B, U'b', U'B'},
+        {KEY_N, U'n', U'N'}, {KEY_M, U'm', U'M'}, {KEY_1, U'1', U'!'}, {KEY_DOT, U'.', U'>'},
+        {KEY_SPACE, U' ', U' '},
+    };
+    for (const auto &k : keys) {
+        table.set(k.code, 0, k.normal);
+        table.set(k.code, KeyTable::Shift, k.shifted);
+    }
+    table.set(KEY_E, KeyTable::AltGr, U'€');
+    table.index();
+}
+
+void typeWord(KeyboardCore &core, std::initializer_list<int> keys)
+{
+    for (const int key : keys) {
+        core.press(key);
+        core.matchTrigger();
+        core.modifiers().consumeOneShot();
+    }
+}
+} // namespace
+
+int main()
+{
+    KeyTable keys;
+    fillUs(keys);
+
+    TriggerTable triggers;
+    triggers.insert(u"brb", 1);
+    triggers.insert(u"omw", 2);
+    triggers.insert(u"addr", 3);
+    // Enough distinct lengths and entries to make the table grow first
+    std::vector<std::u16string> filler;
+    for (int i = 0; i < 2000; ++i) {
+        std::u16string trigger = u"x";
+        for (int n = i; n > 0; n /= 26)
+            trigger.push_back(char16_t(u'a' + n % 26));
+        filler.push_back(trigger);
+    }
+    for (std::size_t i = 0; i < filler.size(); ++i)
+        triggers.insert(filler[i], uint32_t(100 + i));
+
+    KeyboardCore core;
+    core.setKeyTable(&keys);
+    core.setTriggers(&triggers);
+
+    expectNoAllocation("letters and trigger match", [&]() {
+        typeWord(core, {KEY_B, KEY_R, KEY_B});
+    });
+    const auto match = core.matchTrigger();
+    expect(match && match->id == 1 && match->length == 3, "brb matches trigger 1");
+
+    expectNoAllocation("backspace", [&]() {
+        typeWord(core, {KEY_BACKSPACE, KEY_BACKSPACE, KEY_BACKSPACE, KEY_BACKSPACE});
+    });
+    expect(core.buffer().isEmpty(), "backspace empties the buffer");
+
+    expectNoAllocation("separators", [&]() {
+        typeWord(core, {KEY_O, KEY_M, KEY_W, KEY_SPACE, KEY_A, KEY_ENTER, KEY_TAB, KEY_ESC});
+    });
+
+    expectNoAllocation("modifier combinations", [&]() {
+        core.modifiers().toggle(ModifierState::Shift);
+        typeWord(core, {KEY_A, KEY_B});
+        core.modifiers().toggle(ModifierState::Ctrl);
+        core.press(KEY_C);
+        core.matchTrigger();
+        core.modifiers().consumeOneShot();
+        core.modifiers().toggle(ModifierState::Alt);
+        core.modifiers().toggle(ModifierState::Alt);   // locked
+        typeWord(core, {KEY_T, KEY_T});
+        core.modifiers().toggle(ModifierState::Alt);
+        core.modifiers().toggle(ModifierState::Meta);
+        typeWord(core, {KEY_D});
+        core.modifiers().toggleCapsLock();
+        typeWord(core, {KEY_H, KEY_I, KEY_1});
+        core.modifiers().toggleCapsLock();
+    });
+
+    expectNoAllocation("buffer overflow", [&]() {
+        for (int i = 0; i < int(TypeBuffer::Capacity) * 3; ++i)
+            typeWord(core, {KEY_A});
+    });
+
+    expectNoAllocation("character lookups", [&]() {
+        uint8_t level = 0;
+        keys.find(U'Q', &level);
+        keys.find(U'€', &level);
+        keys.find(U'一', &level);
+        keys.character(KEY_E, KeyTable::AltGr);
+        keys.deadKey(KEY_E, 0);
+    });
+
+    // Edits go in place: the triggers left stay reachable
+    for (std::size_t i = 0; i < filler.size(); i += 2)
+        triggers.remove(filler[i]);
+    bool reachable = true;
+    for (std::size_t i = 1; i < filler.size(); i += 2) {
+        const auto found = triggers.match(filler[i]);
+        reachable = reachable && found && found->id == uint32_t(100 + i);
+    }
+    expect(reachable, "triggers left after removals match");
+    expect(!triggers.match(filler[2]), "a removed trigger no longer matches");
+    triggers.remove(u"brb");
+    triggers.insert(u"brb", 4);
+    core.resetBuffer();
+    expectNoAllocation("match after edits", [&]() {
+        typeWord(core, {KEY_B, KEY_R, KEY_B});
+    });
+    const auto edited = core.matchTrigger();
+    expect(edited && edited->id == 4, "a trigger added again matches with its new id");
+
+    // A window's own triggers are checked after the global ones
+    TriggerTable scoped;
+    scoped.insert(u"rb", 7);
+    core.setTriggers(&triggers, &scoped);
+    const auto longer = core.matchTrigger();
+    expect(longer && longer->id == 4 && !longer->scoped, "the longer global trigger wins");
+    scoped.insert(u"brb", 8);
+    expectNoAllocation("scoped trigger match", [&]() {
+        core.matchTrigger();
+    });
+    const auto tie = core.matchTrigger();
+    expect(tie && tie->id == 8 && tie->scoped, "a scoped trigger wins over the same global one");
+    core.setTriggers(&triggers);
+
+    ComposeDfa::Builder builder;
+    const char32_t acuteE[] = {ComposeDfa::ComposeKey, U'\'', U'e'};
+    const char32_t quoteE[] = {ComposeDfa::ComposeKey, U'"', U'e'};
+    builder.add(acuteE, U"é");
+    builder.add(quoteE, U"ë");
+    const std::vector<uint8_t> image = builder.build();
+    ComposeDfa dfa;
+    expect(dfa.attach(image.data(), image.size()), "compose image attaches");
+
+    expectNoAllocation("compose steps", [&]() {
+        ComposeDfa::State state = ComposeDfa::Start;
+        for (const char32_t symbol : acuteE)
+            state = dfa.step(state, symbol);
+        dfa.accepts(state);
+        dfa.output(state);
+        dfa.step(ComposeDfa::Start, U'x');
+    });
+
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
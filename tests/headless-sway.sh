@@ -0,0 +1,32 @@
+#!/bin/sh
+# Runs a test against sway on the headless backend, in a runtime directory
+# of its own. Exits 77 (skipped) when sway is not installed.
+set -u
+
+command -v sway >/dev/null 2>&1 || { echo "sway not found; skipping"; exit 77; }
+
+runtime=$(mktemp -d)
+trap 'kill "$sway" 2>/dev/null; wait "$sway" 2>/dev/null; rm -rf "$runtime"' EXIT
+: > "$runtime/config"
+
+XDG_RUNTIME_DIR=$runtime WLR_BACKENDS=headless WLR_LIBINPUT_NO_DEVICES=1 \
+    WLR_RENDERER=pixman sway -c "$runtime/config" >"$runtime/sway.log" 2>&1 &
+sway=$!
+
+socket=
+for _ in $(seq 50); do
+    for candidate in "$runtime"/wayland-*; do
+        case $candidate in *.lock) continue ;; esac
+        [ -S "$candidate" ] && socket=${candidate##*/}
+    done
+    [ -n "$socket" ] && break
+    kill -0 "$sway" 2>/dev/null || break
+    sleep 0.1
+done
+if [ -z "$socket" ]; then
+    echo "sway did not start:"
+    cat "$runtime/sway.log"
+    exit 1
+fi
+
+XDG_RUNTIME_DIR=$runtime WAYLAND_DISPLAY=$socket QT_QPA_PLATFORM=offscreen "$@"
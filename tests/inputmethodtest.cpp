@@ -0,0 +1,258 @@
+// InputMethod against a real compositor (run by headless-sway.sh): a text
+// field of this process's own, on a text-input-v3 connection, records what
+// the input method sends it.
+
+#include "inputmethod.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QSocketNotifier>
+#include <QStringList>
+
+#include <wayland-client.h>
+#include "text-input-unstable-v3-client-protocol.h"
+#include "xdg-shell-client-protocol.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <utility>
+
+namespace {
+int failures = 0;
+
+void expect(bool condition, const char *what)
+{
+    if (condition) {
+        std::printf("PASS %s\n", what);
+    } else {
+        std::fprintf(stderr, "FAIL %s\n", what);
+        ++failures;
+    }
+}
+
+bool waitFor(const std::function<bool()> &condition, int timeoutMs = 2000)
+{
+    QElapsedTimer timer;
+    timer.start();
+    while (!condition()) {
+        if (timer.elapsed() > timeoutMs) return false;
+        QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents, 50);
+    }
+    return true;
+}
+
+// A mapped toplevel with a text-input-v3 object: the focused text field
+struct TextField {
+    wl_display *display = nullptr;
+    wl_compositor *compositor = nullptr;
+    wl_shm *shm = nullptr;
+    wl_seat *seat = nullptr;
+    xdg_wm_base *wmBase = nullptr;
+    zwp_text_input_manager_v3 *textInputManager = nullptr;
+    wl_surface *surface = nullptr;
+    xdg_surface *xdgSurface = nullptr;
+    xdg_toplevel *toplevel = nullptr;
+    wl_buffer *buffer = nullptr;
+    zwp_text_input_v3 *textInput = nullptr;
+
+    bool focused = false;
+    // What the last done event applied
+    QStringList commits;
+    int deletedBefore = 0;
+    int deletedAfter = 0;
+    // Collected until done
+    QString pendingCommit;
+    int pendingBefore = 0;
+    int pendingAfter = 0;
+
+    void setText(const char *text)
+    {
+        const int cursor = int(std::strlen(text));
+        zwp_text_input_v3_set_surrounding_text(textInput, text, cursor, cursor);
+        zwp_text_input_v3_commit(textInput);
+        wl_display_flush(display);
+    }
+};
+
+void registryGlobal(void *data, wl_registry *registry, uint32_t name, const char *interface, uint32_t)
+{
+    auto *field = static_cast<TextField *>(data);
+    if (std::strcmp(interface, wl_compositor_interface.name) == 0)
+        field->compositor = static_cast<wl_compositor *>(wl_registry_bind(registry, name, &wl_compositor_interface, 4));
+    else if (std::strcmp(interface, wl_shm_interface.name) == 0)
+        field->shm = static_cast<wl_shm *>(wl_registry_bind(registry, name, &wl_shm_interface, 1));
+    else if (std::strcmp(interface, wl_seat_interface.name) == 0 && !field->seat)
+        field->seat = static_cast<wl_seat *>(wl_registry_bind(registry, name, &wl_seat_interface, 1));
+    else if (std::strcmp(interface, xdg_wm_base_interface.name) == 0)
+        field->wmBase = static_cast<xdg_wm_base *>(wl_registry_bind(registry, name, &xdg_wm_base_interface, 1));
+    else if (std::strcmp(interface, zwp_text_input_manager_v3_interface.name) == 0)
+        field->textInputManager = static_cast<zwp_text_input_manager_v3 *>(
+            wl_registry_bind(registry, name, &zwp_text_input_manager_v3_interface, 1));
+}
+
+void registryGlobalRemove(void *, wl_registry *, uint32_t) {}
+
+void wmBasePing(void *, xdg_wm_base *wmBase, uint32_t serial)
+{
+    xdg_wm_base_pong(wmBase, serial);
+}
+
+wl_buffer *createBuffer(wl_shm *shm, int width, int height)
+{
+    const int stride = width * 4;
+    const int size = stride * height;
+    const int fd = memfd_create("osk-test", MFD_CLOEXEC);
+    if (fd < 0 || ftruncate(fd, size) < 0) return nullptr;
+    wl_shm_pool *pool = wl_shm_create_pool(shm, fd, size);
+    wl_buffer *buffer = wl_shm_pool_create_buffer(pool, 0, width, height, stride, WL_SHM_FORMAT_XRGB8888);
+    wl_shm_pool_destroy(pool);
+    close(fd);
+    return buffer;
+}
+
+void xdgSurfaceConfigure(void *data, xdg_surface *xdgSurface, uint32_t serial)
+{
+    auto *field = static_cast<TextField *>(data);
+    xdg_surface_ack_configure(xdgSurface, serial);
+    if (!field->buffer)
+        field->buffer = createBuffer(field->shm, 64, 64);
+    wl_surface_attach(field->surface, field->buffer, 0, 0);
+    wl_surface_commit(field->surface);
+}
+
+void toplevelConfigure(void *, xdg_toplevel *, int32_t, int32_t, wl_array *) {}
+void toplevelClose(void *, xdg_toplevel *) {}
+
+void textInputEnter(void *data, zwp_text_input_v3 *textInput, wl_surface *)
+{
+    auto *field = static_cast<TextField *>(data);
+    field->focused = true;
+    zwp_text_input_v3_enable(textInput);
+    field->setText("hello ");
+}
+
+void textInputLeave(void *data, zwp_text_input_v3 *textInput, wl_surface *)
+{
+    static_cast<TextField *>(data)->focused = false;
+    zwp_text_input_v3_disable(textInput);
+    zwp_text_input_v3_commit(textInput);
+}
+
+void textInputPreedit(void *, zwp_text_input_v3 *, const char *, int32_t, int32_t) {}
+
+void textInputCommitString(void *data, zwp_text_input_v3 *, const char *text)
+{
+    static_cast<TextField *>(data)->pendingCommit = QString::fromUtf8(text);
+}
+
+void textInputDeleteSurrounding(void *data, zwp_text_input_v3 *, uint32_t before, uint32_t after)
+{
+    auto *field = static_cast<TextField *>(data);
+    field->pendingBefore = int(before);
+    field->pendingAfter = int(after);
+}
+
+void textInputDone(void *data, zwp_text_input_v3 *, uint32_t)
+{
+    auto *field = static_cast<TextField *>(data);
+    if (field->pendingCommit.isEmpty() && !field->pendingBefore && !field->pendingAfter)
+        return;
+    field->commits.append(std::exchange(field->pendingCommit, QString()));
+    field->deletedBefore = std::exchange(field->pendingBefore, 0);
+    field->deletedAfter = std::exchange(field->pendingAfter, 0);
+}
+
+bool openTextField(TextField &field)
+{
+    field.display = wl_display_connect(nullptr);
+    if (!field.display) return false;
+    static const wl_registry_listener registryListener = {registryGlobal, registryGlobalRemove};
+    wl_registry *registry = wl_display_get_registry(field.display);
+    wl_registry_add_listener(registry, &registryListener, &field);
+    wl_display_roundtrip(field.display);
+    if (!field.compositor || !field.shm || !field.seat || !field.wmBase || !field.textInputManager)
+        return false;
+
+    static const xdg_wm_base_listener wmBaseListener = {wmBasePing};
+    xdg_wm_base_add_listener(field.wmBase, &wmBaseListener, &field);
+    static const zwp_text_input_v3_listener textInputListener = {
+        textInputEnter, textInputLeave, textInputPreedit,
+        textInputCommitString, textInputDeleteSurrounding, textInputDone,
+    };
+    field.textInput = zwp_text_input_manager_v3_get_text_input(field.textInputManager, field.seat);
+    zwp_text_input_v3_add_listener(field.textInput, &textInputListener, &field);
+
+    static const xdg_surface_listener xdgSurfaceListener = {xdgSurfaceConfigure};
+    static const xdg_toplevel_listener toplevelListener = {toplevelConfigure, toplevelClose};
+    field.surface = wl_compositor_create_surface(field.compositor);
+    field.xdgSurface = xdg_wm_base_get_xdg_surface(field.wmBase, field.surface);
+    xdg_surface_add_listener(field.xdgSurface, &xdgSurfaceListener, &field);
+    field.toplevel = xdg_surface_get_toplevel(field.xdgSurface);
+    xdg_toplevel_add_listener(field.toplevel, &toplevelListener, &field);
+    xdg_toplevel_set_title(field.toplevel, "osk input method test");
+    wl_surface_commit(field.surface);
+    wl_display_flush(field.display);
+    return true;
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+
+    InputMethod method;
+    if (!method.connectToCompositor()) {
+        std::fprintf(stderr, "FAIL no input-method-v2 on this compositor\n");
+        return EXIT_FAILURE;
+    }
+
+    TextField field;
+    if (!openTextField(field)) {
+        std::fprintf(stderr, "FAIL the compositor lacks a global the text field needs\n");
+        return EXIT_FAILURE;
+    }
+    QSocketNotifier notifier(wl_display_get_fd(field.display), QSocketNotifier::Read);
+    QObject::connect(&notifier, &QSocketNotifier::activated, [&field]() {
+        if (wl_display_dispatch(field.display) < 0)
+            QCoreApplication::exit(EXIT_FAILURE);
+    });
+    wl_display_roundtrip(field.display);
+
+    QStringList abandoned;
+    QObject::connect(&method, &InputMethod::replaceAbandoned,
+                     [&abandoned](const QString &before, const QString &text) {
+        abandoned << before << text;
+    });
+
+    expect(waitFor([&]() { return method.textBeforeCursor() == QLatin1String("hello "); }),
+           "the focused field's surrounding text arrives");
+
+    // The trigger shows up after the request, as keys through uinput would
+    method.replaceWhenTyped(QStringLiteral("brb"), QStringLiteral("be right back"));
+    expect(method.hasPendingReplace(), "the replacement waits for its trigger");
+    field.setText("hello brb");
+    expect(waitFor([&]() { return !field.commits.isEmpty(); }), "the trigger is replaced");
+    expect(field.deletedBefore == 3 && field.deletedAfter == 0, "delete_surrounding_text removes the trigger");
+    expect(field.commits.value(0) == QLatin1String("be right back"), "commit_string inserts the expansion");
+    field.commits.clear();
+
+    method.commitString(QStringLiteral("!"));
+    expect(waitFor([&]() { return !field.commits.isEmpty(); }), "a string is committed");
+    expect(field.commits.value(0) == QLatin1String("!") && field.deletedBefore == 0,
+           "commit_string alone deletes nothing");
+    field.commits.clear();
+
+    // A trigger the field never shows is handed back for the uinput path
+    method.replaceWhenTyped(QStringLiteral("omw"), QStringLiteral("on my way"));
+    expect(waitFor([&]() { return !abandoned.isEmpty(); }, InputMethod::ConfirmMs * 4),
+           "an unconfirmed replacement is abandoned");
+    expect(abandoned == QStringList({QStringLiteral("omw"), QStringLiteral("on my way")}),
+           "the abandoned replacement carries its trigger and text");
+    expect(field.commits.isEmpty() && !method.hasPendingReplace(), "nothing reaches the field");
+
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}